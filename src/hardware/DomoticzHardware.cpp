@@ -92,6 +92,16 @@ void CDomoticzHardwareBase::StopHeartbeatThread()
 	}
 }
 
+CDomoticzHardwareBase::CRxBatch::CRxBatch(const CDomoticzHardwareBase *pHardware)
+{
+	m_mainworker.BeginRxBatch(pHardware);
+}
+
+CDomoticzHardwareBase::CRxBatch::~CRxBatch()
+{
+	m_mainworker.EndRxBatch();
+}
+
 void CDomoticzHardwareBase::Do_Heartbeat_Work()
 {
 	int secCounter = 0;
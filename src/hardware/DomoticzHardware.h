@@ -78,6 +78,16 @@ class CDomoticzHardwareBase : public StoppableTask
 	void StartHeartbeatThread(const char *ThreadName);
 	void StopHeartbeatThread();
 
+	// While in scope, the messages this hardware decodes on the calling thread are queued as one batch
+	class CRxBatch
+	{
+	      public:
+		explicit CRxBatch(const CDomoticzHardwareBase *pHardware);
+		~CRxBatch();
+		CRxBatch(const CRxBatch &) = delete;
+		CRxBatch &operator=(const CRxBatch &) = delete;
+	};
+
 	// Sensor Helpers
 	void SendTempSensor(int NodeID, int BatteryLevel, float temperature, const std::string &defaultname, int RssiLevel = 12);
 	void SendHumiditySensor(int NodeID, int BatteryLevel, int humidity, const std::string &defaultname, int RssiLevel = 12);
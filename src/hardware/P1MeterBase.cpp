@@ -348,6 +348,7 @@ bool P1MeterBase::MatchLine()
 	{
 		m_lexclmarkfound = 1;
 		m_lastUpdateTime = m_receivetime;
+		CRxBatch batch(this); // all values of the telegram
 
 		if (m_p1version == 0) // meter did not report its DSMR version
 		{
@@ -400,6 +400,7 @@ bool CRtl433::ParseData(std::map<std::string, std::string>& data)
 			return false; //invalid temp+hum
 	}
 
+	CRxBatch batch(this); // all values of the line
 	bool bHandled = false;
 	if (haveTemp && haveHumidity && havePressure)
 	{
@@ -650,6 +650,7 @@ void CTTNMQTT::on_message(const struct mosquitto_message *message)
 		return; //not interested in sub-topics
 
 	std::string qMessage = std::string((char*)message->payload, (char*)message->payload + message->payloadlen);
+	CRxBatch batch(this); // all sensors of the uplink
 
 #ifdef DEBUG_TTN_W
 	SaveString2Disk(qMessage, "ttn_mqtt.json");
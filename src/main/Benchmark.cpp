@@ -0,0 +1,230 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include "Logger.h"
+#include "RFXNames.h"
+#include "SQLHelper.h"
+#include <chrono>
+#include <cstdio>
+#include <inttypes.h>
+#include <random>
+
+namespace
+{
+	constexpr int BENCHMARK_WRITE_DEVICES = 50;
+	// a multiple of the group commit maximum, so the last transaction is full
+	constexpr int BENCHMARK_WRITE_UPDATES = 5000;
+	constexpr int BENCHMARK_WRITE_MAX_ROWS = 200;
+	constexpr int BENCHMARK_WRITE_WINDOW_MS = 50; // the default of -dbase_commit_window
+	constexpr int BENCHMARK_LOOKUP_ROUNDS = 100;
+	constexpr int BENCHMARK_SHORTLOG_DEVICES = 20;
+	constexpr int BENCHMARK_SHORTLOG_DAYS = 7;
+	constexpr int BENCHMARK_SHORTLOG_READS = 20; // day graphs read per device
+
+	void RemoveDatabaseFiles(const std::string &szDatabase)
+	{
+		std::remove(szDatabase.c_str());
+		std::remove((szDatabase + "-wal").c_str());
+		std::remove((szDatabase + "-shm").c_str());
+		std::remove((szDatabase + "-journal").c_str());
+	}
+
+	// Sensor updates as the RX path writes them (the DeviceStatus row and a short log row), returns rows per second
+	double MeasureWriteRate(const int windowMs)
+	{
+		m_sql.SetGroupCommit(windowMs, BENCHMARK_WRITE_MAX_ROWS);
+		auto tStart = std::chrono::steady_clock::now();
+		for (int ii = 0; ii < BENCHMARK_WRITE_UPDATES; ii++)
+		{
+			int idx = (ii % BENCHMARK_WRITE_DEVICES) + 1;
+			double temp = 20.0 + (ii % 100) / 10.0;
+			m_sql.safe_query("UPDATE DeviceStatus SET nValue=0, sValue='%.1f', LastUpdate=datetime('now','localtime') WHERE (ID == %d)", temp, idx);
+			m_sql.safe_query("INSERT INTO Temperature (DeviceRowID, Temperature) VALUES (%d, %.1f)", idx, temp);
+		}
+		// a PRAGMA commits the open group transaction
+		m_sql.safe_query("PRAGMA user_version");
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+		return (2.0 * BENCHMARK_WRITE_UPDATES) / seconds;
+	}
+
+	// Rows per second without and with group commit
+	bool BenchmarkSQLWrite(const std::string &szFolder)
+	{
+		std::string szDatabase = szFolder + "benchmark.db";
+		RemoveDatabaseFiles(szDatabase);
+		m_sql.SetDatabaseName(szDatabase);
+		if (!m_sql.OpenDatabase())
+		{
+			_log.Log(LOG_ERROR, "Benchmark: Could not create %s", szDatabase.c_str());
+			return false;
+		}
+		for (int ii = 1; ii <= BENCHMARK_WRITE_DEVICES; ii++)
+			m_sql.safe_query("INSERT INTO DeviceStatus (ID, HardwareID, DeviceID, Unit, Type, SubType, sValue) VALUES (%d, 1, '%04X', 1, %d, %d, '20.0')", ii, ii, pTypeTEMP, sTypeTEMP1);
+
+		double without = MeasureWriteRate(0);
+		double with = MeasureWriteRate(BENCHMARK_WRITE_WINDOW_MS);
+		_log.Log(LOG_STATUS, "Benchmark: %d sensor updates of %d devices (%d rows)", BENCHMARK_WRITE_UPDATES, BENCHMARK_WRITE_DEVICES, 2 * BENCHMARK_WRITE_UPDATES);
+		_log.Log(LOG_STATUS, "Benchmark: Without group commit: %.0f rows/sec", without);
+		_log.Log(LOG_STATUS, "Benchmark: With a group commit window of %d ms: %.0f rows/sec (%.1fx)", BENCHMARK_WRITE_WINDOW_MS, with, with / without);
+
+		m_sql.CloseDatabase();
+		RemoveDatabaseFiles(szDatabase);
+		return true;
+	}
+
+	// Cost of a type and subtype name lookup, over every possible pair so both hits and misses are included
+	bool BenchmarkRFXNames()
+	{
+		// keeps the lookups from being optimized away
+		volatile uintptr_t sink = 0;
+		auto tStart = std::chrono::steady_clock::now();
+		for (int round = 0; round < BENCHMARK_LOOKUP_ROUNDS; round++)
+			for (int dType = 0; dType < 256; dType++)
+				sink = sink + reinterpret_cast<uintptr_t>(RFX_Type_Desc(static_cast<unsigned char>(dType), 1));
+		double typeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count() / (BENCHMARK_LOOKUP_ROUNDS * 256);
+
+		tStart = std::chrono::steady_clock::now();
+		for (int round = 0; round < BENCHMARK_LOOKUP_ROUNDS; round++)
+			for (int dType = 0; dType < 256; dType++)
+				for (int sType = 0; sType < 256; sType++)
+					sink = sink + reinterpret_cast<uintptr_t>(RFX_Type_SubType_Desc(static_cast<unsigned char>(dType), static_cast<unsigned char>(sType)));
+		double subTypeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count() / (BENCHMARK_LOOKUP_ROUNDS * 256 * 256);
+
+		_log.Log(LOG_STATUS, "Benchmark: RFX_Type_Desc: %.1f ns per lookup", typeNs);
+		_log.Log(LOG_STATUS, "Benchmark: RFX_Type_SubType_Desc: %.1f ns per lookup", subTypeNs);
+		return true;
+	}
+
+	uint64_t GetDatabaseBytes()
+	{
+		auto result = m_sql.safe_query("SELECT page_count * page_size FROM pragma_page_count(), pragma_page_size()");
+		return result.empty() ? 0 : std::stoull(result[0][0]);
+	}
+
+	// Disk size of the Temperature short log in the database and in the short log store,
+	// and the time to read the rows of a day graph from either of them
+	bool BenchmarkShortLog(const std::string &szFolder)
+	{
+		std::string szDatabase = szFolder + "benchmark.db";
+		std::string szStore = szDatabase + "-shortlog";
+		std::string szErrorPath;
+		RemoveDatabaseFiles(szDatabase);
+		RemoveDir(szStore, szErrorPath);
+		m_sql.SetDatabaseName(szDatabase);
+		m_sql.SetShortLogStore(true);
+		if ((!m_sql.OpenDatabase()) || (!m_sql.m_shortlogstore.IsOpen()))
+		{
+			_log.Log(LOG_ERROR, "Benchmark: Could not create %s", szDatabase.c_str());
+			return false;
+		}
+
+		// a slowly changing sensor every 5 minutes
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<int> step(-1, 1);
+		time_t tNow = mytime(nullptr);
+		time_t tFirst = tNow - (BENCHMARK_SHORTLOG_DAYS * 86400);
+		uint64_t nRows = 0;
+		uint64_t nBytesBefore = GetDatabaseBytes();
+		m_sql.safe_query("BEGIN TRANSACTION");
+		for (int idx = 1; idx <= BENCHMARK_SHORTLOG_DEVICES; idx++)
+		{
+			int temp = 150 + (idx % 10) * 10; // in tenths
+			int humidity = 50;
+			int barometer = 1013;
+			for (time_t tDate = tFirst; tDate < tNow; tDate += 300)
+			{
+				temp += step(rng);
+				if (nRows % 6 == 0)
+					humidity += step(rng);
+				if (nRows % 12 == 0)
+					barometer += step(rng);
+				double dewpoint = std::round((temp / 10.0 - (100 - humidity) / 5.0) * 100.0) / 100.0;
+				std::string szDate = TimeToString(&tDate, TF_DateTime);
+				m_sql.prepared_query("INSERT INTO Temperature (DeviceRowID, Temperature, Chill, Humidity, Barometer, DewPoint, SetPoint, Date) VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+						     idx, temp / 10.0, temp / 10.0, humidity, barometer, dewpoint, 0.0, szDate)
+					.Execute();
+				nRows++;
+			}
+		}
+		m_sql.safe_query("COMMIT TRANSACTION");
+		uint64_t nDatabaseBytes = GetDatabaseBytes() - nBytesBefore;
+
+		// the one-time copy of the short log rows into the store
+		auto tStart = std::chrono::steady_clock::now();
+		m_sql.SyncShortLogStore();
+		double migrateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+		// closing writes the last block of every device, so the statistics count all samples
+		m_sql.m_shortlogstore.Close();
+		m_sql.m_shortlogstore.Open(szStore);
+		uint64_t nStoreBytes = 0;
+		uint64_t nSamples = 0;
+		m_sql.m_shortlogstore.GetStatistics(nStoreBytes, nSamples);
+		if ((!m_sql.m_shortlogstore.IsValid(CTimeSeriesStore::TABLE_TEMPERATURE)) || (nSamples != nRows))
+		{
+			_log.Log(LOG_ERROR, "Benchmark: The short log store holds %" PRIu64 " of %" PRIu64 " rows", nSamples, nRows);
+			m_sql.CloseDatabase();
+			return false;
+		}
+
+		// the rows of the streamed temperature day graph, as text
+		time_t tDay = tNow - 86400;
+		std::string szDay = TimeToString(&tDay, TF_DateTime);
+		std::vector<int> columns;
+		for (const char *szColumn : { "Temperature", "Chill", "Humidity", "Barometer", "SetPoint" })
+			columns.push_back(CTimeSeriesStore::GetColumn(CTimeSeriesStore::TABLE_TEMPERATURE, szColumn));
+		size_t nSQLRows = 0;
+		tStart = std::chrono::steady_clock::now();
+		for (int round = 0; round < BENCHMARK_SHORTLOG_READS; round++)
+			for (int idx = 1; idx <= BENCHMARK_SHORTLOG_DEVICES; idx++)
+				nSQLRows += m_sql.safe_readonly_query("SELECT Temperature, Chill, Humidity, Barometer, SetPoint, Date FROM Temperature WHERE (DeviceRowID==%d AND Date>='%q') ORDER BY Date ASC",
+								      idx, szDay.c_str())
+						    .size();
+		double sqlMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count() / (BENCHMARK_SHORTLOG_READS * BENCHMARK_SHORTLOG_DEVICES);
+
+		size_t nStoreRows = 0;
+		tStart = std::chrono::steady_clock::now();
+		for (int round = 0; round < BENCHMARK_SHORTLOG_READS; round++)
+		{
+			for (int idx = 1; idx <= BENCHMARK_SHORTLOG_DEVICES; idx++)
+			{
+				std::vector<std::vector<std::string>> result;
+				m_sql.m_shortlogstore.Read(CTimeSeriesStore::TABLE_TEMPERATURE, idx, tDay, [&](const time_t tDate, const double *values) {
+					char szTmp[40];
+					std::vector<std::string> sd;
+					for (const int col : columns)
+					{
+						sprintf(szTmp, "%.15g", values[col]);
+						sd.push_back(szTmp);
+					}
+					sd.push_back(TimeToString(&tDate, TF_DateTime));
+					result.push_back(sd);
+					return true;
+				});
+				nStoreRows += result.size();
+			}
+		}
+		double storeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count() / (BENCHMARK_SHORTLOG_READS * BENCHMARK_SHORTLOG_DEVICES);
+
+		_log.Log(LOG_STATUS, "Benchmark: %" PRIu64 " Temperature rows of %d devices over %d days", nRows, BENCHMARK_SHORTLOG_DEVICES, BENCHMARK_SHORTLOG_DAYS);
+		_log.Log(LOG_STATUS, "Benchmark: Database: %" PRIu64 " bytes (%.1f bytes per row, with indexes)", nDatabaseBytes, double(nDatabaseBytes) / nRows);
+		_log.Log(LOG_STATUS, "Benchmark: Short log store: %" PRIu64 " bytes (%.1f bytes per row), copied in %.0f ms", nStoreBytes, double(nStoreBytes) / nRows, migrateMs);
+		_log.Log(LOG_STATUS, "Benchmark: Day graph from the database: %.3f ms (%d rows)", sqlMs, static_cast<int>(nSQLRows / (BENCHMARK_SHORTLOG_READS * BENCHMARK_SHORTLOG_DEVICES)));
+		_log.Log(LOG_STATUS, "Benchmark: Day graph from the short log store: %.3f ms (%d rows)", storeMs, static_cast<int>(nStoreRows / (BENCHMARK_SHORTLOG_READS * BENCHMARK_SHORTLOG_DEVICES)));
+
+		m_sql.CloseDatabase();
+		RemoveDatabaseFiles(szDatabase);
+		RemoveDir(szStore, szErrorPath);
+		return true;
+	}
+} // namespace
+
+bool RunBenchmark(const std::string &szName, const std::string &szFolder)
+{
+	if (szName == "sqlwrite")
+		return BenchmarkSQLWrite(szFolder);
+	if (szName == "rfxnames")
+		return BenchmarkRFXNames();
+	if (szName == "shortlog")
+		return BenchmarkShortLog(szFolder);
+	_log.Log(LOG_ERROR, "Benchmark: Unknown benchmark '%s' (sqlwrite, rfxnames, shortlog)", szName.c_str());
+	return false;
+}
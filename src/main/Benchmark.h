@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Benchmarks that are run with "-benchmark name" instead of starting the server.
+// They only use temporary files in szFolder and log their results, returns false for an unknown name.
+bool RunBenchmark(const std::string &szName, const std::string &szFolder);
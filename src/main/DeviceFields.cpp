@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "DeviceFields.h"
+#include "main/json_helper.h"
+#include <cstring>
+
+void CDeviceFields::SetValue(const char *szName, _tValue &&value)
+{
+	for (auto &field : m_fields)
+	{
+		if (strcmp(field.first, szName) == 0)
+		{
+			field.second = std::move(value);
+			return;
+		}
+	}
+	m_fields.emplace_back(szName, std::move(value));
+}
+
+const CDeviceFields::_tValue *CDeviceFields::Get(const char *szName) const
+{
+	for (const auto &field : m_fields)
+	{
+		if (strcmp(field.first, szName) == 0)
+			return &field.second;
+	}
+	return nullptr;
+}
+
+int CDeviceFields::GetInt(const char *szName) const
+{
+	int value = 0;
+	GetInt(szName, value);
+	return value;
+}
+
+bool CDeviceFields::GetString(const char *szName, std::string &szValue) const
+{
+	const _tValue *pValue = Get(szName);
+	if (pValue == nullptr)
+		return false;
+	if (const auto *pString = std::get_if<std::string>(pValue))
+		szValue = *pString;
+	else if (const auto *pBool = std::get_if<bool>(pValue))
+		szValue = (*pBool) ? "true" : "false";
+	else if (const auto *pInt = std::get_if<int64_t>(pValue))
+		szValue = std::to_string(*pInt);
+	else if (const auto *pUInt = std::get_if<uint64_t>(pValue))
+		szValue = std::to_string(*pUInt);
+	else
+		szValue = Json::Value(std::get<double>(*pValue)).asString();
+	return true;
+}
+
+bool CDeviceFields::GetFloat(const char *szName, float &value) const
+{
+	const _tValue *pValue = Get(szName);
+	if (pValue == nullptr)
+		return false;
+	if (const auto *pString = std::get_if<std::string>(pValue))
+		value = static_cast<float>(atof(pString->c_str()));
+	else if (std::holds_alternative<bool>(*pValue))
+		value = 0; // "true" and "false" are no numbers
+	else if (const auto *pInt = std::get_if<int64_t>(pValue))
+		value = static_cast<float>(*pInt);
+	else if (const auto *pUInt = std::get_if<uint64_t>(pValue))
+		value = static_cast<float>(*pUInt);
+	else
+		value = static_cast<float>(std::get<double>(*pValue));
+	return true;
+}
+
+bool CDeviceFields::GetInt(const char *szName, int &value) const
+{
+	const _tValue *pValue = Get(szName);
+	if (pValue == nullptr)
+		return false;
+	if (const auto *pString = std::get_if<std::string>(pValue))
+		value = atoi(pString->c_str());
+	else if (std::holds_alternative<bool>(*pValue))
+		value = 0;
+	else if (const auto *pInt = std::get_if<int64_t>(pValue))
+		value = static_cast<int>(*pInt);
+	else if (const auto *pUInt = std::get_if<uint64_t>(pValue))
+		value = static_cast<int>(*pUInt);
+	else
+		value = static_cast<int>(std::get<double>(*pValue));
+	return true;
+}
+
+bool CDeviceFields::GetBool(const char *szName, bool &value) const
+{
+	const _tValue *pValue = Get(szName);
+	if (pValue == nullptr)
+		return false;
+	if (const auto *pBool = std::get_if<bool>(pValue))
+		value = *pBool;
+	else if (const auto *pString = std::get_if<std::string>(pValue))
+		value = (*pString == "true");
+	else
+		value = false;
+	return true;
+}
+
+void CDeviceFields::ToJson(Json::Value &root) const
+{
+	for (const auto &field : m_fields)
+	{
+		Json::Value &value = root[field.first];
+		if (const auto *pString = std::get_if<std::string>(&field.second))
+			value = *pString;
+		else if (const auto *pBool = std::get_if<bool>(&field.second))
+			value = *pBool;
+		else if (const auto *pInt = std::get_if<int64_t>(&field.second))
+			value = static_cast<Json::Int64>(*pInt);
+		else if (const auto *pUInt = std::get_if<uint64_t>(&field.second))
+			value = static_cast<Json::UInt64>(*pUInt);
+		else
+			value = std::get<double>(field.second);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Json
+{
+	class Value;
+} // namespace Json
+
+// The derived fields of one device (Data, CounterToday, Usage, levels...) as computed for the device list.
+// This is a bag of named variant values, not a typed struct: the field names are the json keys of the
+// device list. The webserver turns them into the json result, the event system reads the typed values directly.
+class CDeviceFields
+{
+public:
+	typedef std::variant<bool, int64_t, uint64_t, double, std::string> _tValue;
+
+	// szName must be a string literal, setting a field again replaces its value
+	template <typename T> void Set(const char *szName, const T &value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+			SetValue(szName, _tValue(value));
+		else if constexpr (std::is_enum_v<T>)
+			SetValue(szName, _tValue(static_cast<int64_t>(value)));
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			SetValue(szName, _tValue(static_cast<int64_t>(value)));
+		else if constexpr (std::is_integral_v<T>)
+			SetValue(szName, _tValue(static_cast<uint64_t>(value)));
+		else if constexpr (std::is_floating_point_v<T>)
+			SetValue(szName, _tValue(static_cast<double>(value)));
+		else
+			SetValue(szName, _tValue(std::string(value)));
+	}
+
+	const _tValue *Get(const char *szName) const;
+	// Conversions as done by Json::Value
+	int GetInt(const char *szName) const;
+	bool GetString(const char *szName, std::string &szValue) const;
+	bool GetFloat(const char *szName, float &value) const;
+	bool GetInt(const char *szName, int &value) const;
+	bool GetBool(const char *szName, bool &value) const;
+
+	void ToJson(Json::Value &root) const;
+
+private:
+	void SetValue(const char *szName, _tValue &&value);
+
+	std::vector<std::pair<const char *, _tValue>> m_fields;
+};
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "DeviceStatusCache.h"
+
+size_t CDeviceStatusCache::_tKeyHash::operator()(const _tKey &key) const
+{
+	size_t seed = std::hash<std::string>()(key.DeviceID);
+	seed ^= std::hash<int>()(key.HardwareID) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	seed ^= std::hash<int>()((key.Unit << 16) | (key.Type << 8) | key.SubType) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	return seed;
+}
+
+CDeviceStatusCache::_tShard &CDeviceStatusCache::GetShard(const _tKey &key)
+{
+	return m_shards[_tKeyHash()(key) % NUM_SHARDS];
+}
+
+bool CDeviceStatusCache::Get(const _tKey &key, _tDeviceStatusEntry &entry)
+{
+	_tShard &shard = GetShard(key);
+	std::lock_guard<std::mutex> l(shard.mutex);
+	auto itt = shard.entries.find(key);
+	if (itt == shard.entries.end())
+		return false;
+	entry = itt->second;
+	return true;
+}
+
+bool CDeviceStatusCache::GetByRowID(const uint64_t ID, _tDeviceStatusEntry &entry)
+{
+	for (auto &shard : m_shards)
+	{
+		std::lock_guard<std::mutex> l(shard.mutex);
+		auto itt = shard.rowids.find(ID);
+		if (itt == shard.rowids.end())
+			continue;
+		auto ittEntry = shard.entries.find(itt->second);
+		if (ittEntry == shard.entries.end())
+			return false;
+		entry = ittEntry->second;
+		return true;
+	}
+	return false;
+}
+
+void CDeviceStatusCache::Insert(const _tKey &key, const _tDeviceStatusEntry &entry, const uint64_t generation)
+{
+	_tShard &shard = GetShard(key);
+	std::lock_guard<std::mutex> l(shard.mutex);
+	if (m_generation.load() != generation)
+		return; // a row changed while the entry was loaded, it might be stale
+	shard.entries[key] = entry;
+	shard.rowids[entry.ID] = key;
+}
+
+void CDeviceStatusCache::UpdateValue(const uint64_t ID, const int nValue, const std::string &sValue, const std::string &LastUpdate)
+{
+	m_generation++;
+	for (auto &shard : m_shards)
+	{
+		std::lock_guard<std::mutex> l(shard.mutex);
+		auto itt = shard.rowids.find(ID);
+		if (itt == shard.rowids.end())
+			continue;
+		auto ittEntry = shard.entries.find(itt->second);
+		if (ittEntry != shard.entries.end())
+		{
+			ittEntry->second.nValue = nValue;
+			ittEntry->second.sValue = sValue;
+			ittEntry->second.LastUpdate = LastUpdate;
+		}
+		return;
+	}
+}
+
+void CDeviceStatusCache::Invalidate(const uint64_t ID)
+{
+	m_generation++;
+	for (auto &shard : m_shards)
+	{
+		std::lock_guard<std::mutex> l(shard.mutex);
+		auto itt = shard.rowids.find(ID);
+		if (itt == shard.rowids.end())
+			continue;
+		shard.entries.erase(itt->second);
+		shard.rowids.erase(itt);
+		return;
+	}
+}
+
+void CDeviceStatusCache::Clear()
+{
+	m_generation++;
+	for (auto &shard : m_shards)
+	{
+		std::lock_guard<std::mutex> l(shard.mutex);
+		shard.entries.clear();
+		shard.rowids.clear();
+	}
+}
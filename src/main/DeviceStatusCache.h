@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Cached copy of the DeviceStatus columns that are read on every incoming sensor message
+struct _tDeviceStatusEntry
+{
+	uint64_t ID = 0;
+	int OrgHardwareID = 0;
+	std::string Name;
+	bool Used = false;
+	int SwitchType = 0;
+	int nValue = 0;
+	std::string sValue;
+	std::string LastUpdate;
+	std::map<std::string, std::string> Options;
+	float AddjValue = 0.0F;
+	float AddjMulti = 1.0F;
+	float AddjValue2 = 0.0F;
+	float AddjMulti2 = 1.0F;
+};
+
+// Sharded in-memory table of DeviceStatus rows keyed by (HardwareID, DeviceID, Unit, Type, SubType)
+// and by row ID.
+// The database stays the owner of the data: every change to a DeviceStatus row is reported through
+// Invalidate() (sqlite update hook), except for writes that are applied to the cache directly with
+// UpdateValue().
+// A generation counter is bumped on every change so that an entry loaded from the database while
+// a concurrent write was in progress is never stored.
+class CDeviceStatusCache
+{
+public:
+	struct _tKey
+	{
+		int HardwareID;
+		std::string DeviceID;
+		int Unit;
+		int Type;
+		int SubType;
+
+		bool operator==(const _tKey &other) const
+		{
+			return (HardwareID == other.HardwareID) && (Unit == other.Unit) && (Type == other.Type) && (SubType == other.SubType) && (DeviceID == other.DeviceID);
+		}
+	};
+
+	bool Get(const _tKey &key, _tDeviceStatusEntry &entry);
+	bool GetByRowID(uint64_t ID, _tDeviceStatusEntry &entry);
+	uint64_t GetGeneration() const
+	{
+		return m_generation.load();
+	}
+	// Stores the entry only when no DeviceStatus row changed since 'generation' was read
+	void Insert(const _tKey &key, const _tDeviceStatusEntry &entry, uint64_t generation);
+	void UpdateValue(uint64_t ID, int nValue, const std::string &sValue, const std::string &LastUpdate);
+	void Invalidate(uint64_t ID);
+	void Clear();
+
+private:
+	struct _tKeyHash
+	{
+		size_t operator()(const _tKey &key) const;
+	};
+	struct _tShard
+	{
+		std::mutex mutex;
+		std::unordered_map<_tKey, _tDeviceStatusEntry, _tKeyHash> entries;
+		std::unordered_map<uint64_t, _tKey> rowids;
+	};
+	static constexpr size_t NUM_SHARDS = 16;
+
+	_tShard &GetShard(const _tKey &key);
+
+	std::array<_tShard, NUM_SHARDS> m_shards;
+	std::atomic<uint64_t> m_generation{ 0 };
+};
@@ -21,8 +21,11 @@
 #include "main/json_helper.h"
 #include "main/NotificationSystem.h"
 #include "main/LuaTable.h"
+#include "main/Metrics.h"
+#include "main/DeviceFields.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <sys/stat.h>
 
 extern "C" {
 #include <lua.h>
@@ -129,6 +132,7 @@ CEventSystem::CEventSystem()
 CEventSystem::~CEventSystem()
 {
 	StopEventSystem();
+	ClearLuaStatePool();
 }
 
 void CEventSystem::StartEventSystem()
@@ -176,6 +180,7 @@ void CEventSystem::StopEventSystem()
 		m_thread->join();
 		m_thread.reset();
 	}
+	StopLuaWorker();
 
 #ifdef ENABLE_PYTHON
 	Plugins::PythonEventsStop();
@@ -198,6 +203,11 @@ void CEventSystem::LoadEvents()
 	CdzVents* dzvents = CdzVents::GetInstance();
 	dzvents->m_bdzVentsExist = false;
 
+	{
+		std::lock_guard<std::mutex> l(m_luaChunksMutex);
+		m_luaChunks.clear();
+	}
+
 #ifdef WIN32
 	m_lua_Dir = szUserDataFolder + "scripts\\lua\\";
 	dzv_Dir = szUserDataFolder + "scripts\\dzVents\\generated_scripts\\";
@@ -386,36 +396,29 @@ void CEventSystem::UpdateJsonMap(_tDeviceStatus &item, const uint64_t ulDevID)
 	item.JsonMapInt.clear();
 	item.JsonMapBool.clear();
 
-	Json::Value tempjson;
-	m_webservers.GetJSonDevices(tempjson, "", "", "", std::to_string(ulDevID), "", "", true, false, false, 0, "");
-	Json::ArrayIndex rsize = tempjson["result"].size();
-
-	if (rsize > 0)
+	CDeviceFields fields;
+	if (m_webservers.GetDeviceFields(ulDevID, fields))
 	{
 		uint8_t index = 0;
 
 		while (JsonMap[index].szOriginal != nullptr)
 		{
-			if (tempjson["result"][0][JsonMap[index].szOriginal] != Json::Value::null)
+			const char *szName = JsonMap[index].szOriginal;
+			if (fields.Get(szName) != nullptr)
 			{
-				std::string value = tempjson["result"][0][JsonMap[index].szOriginal].asString();
-
 				switch (JsonMap[index].eType)
 				{
 				case JTYPE_STRING:
-					item.JsonMapString[index] = value;
+					fields.GetString(szName, item.JsonMapString[index]);
 					break;
 				case JTYPE_FLOAT:
-					item.JsonMapFloat[index] = static_cast<float>(atof(value.c_str()));
+					fields.GetFloat(szName, item.JsonMapFloat[index]);
 					break;
 				case JTYPE_INT:
-					item.JsonMapInt[index] = atoi(value.c_str());
+					fields.GetInt(szName, item.JsonMapInt[index]);
 					break;
 				case JTYPE_BOOL:
-					if (value == "true")
-						item.JsonMapBool[index] = true;
-					else
-						item.JsonMapBool[index] = false;
+					fields.GetBool(szName, item.JsonMapBool[index]);
 					break;
 				default:
 					item.JsonMapString[index] = "unknown_type";
@@ -507,6 +510,7 @@ void CEventSystem::GetCurrentStates()
 			{
 				UpdateJsonMap(sitem, sitem.ID);
 			}
+			sitem.version = ++m_stateVersion;
 			m_devicestates_temp[sitem.ID] = sitem;
 		}
 		m_devicestates = m_devicestates_temp;
@@ -532,6 +536,7 @@ void CEventSystem::GetCurrentUserVariables()
 			uvitem.variableValue = sd[2];
 			uvitem.variableType = atoi(sd[3].c_str());
 			uvitem.lastUpdate = sd[4];
+			uvitem.version = ++m_stateVersion;
 			m_uservariables[uvitem.ID] = uvitem;
 		}
 	}
@@ -574,6 +579,7 @@ void CEventSystem::GetCurrentScenesGroups()
 					sgitem.memberID.push_back(std::stoull(sd2[0]));
 				}
 			}
+			sgitem.version = ++m_stateVersion;
 			m_scenesgroups[sgitem.ID] = sgitem;
 		}
 	}
@@ -1095,6 +1101,7 @@ void CEventSystem::WWWUpdateSingleState(const uint64_t ulDevID, const std::strin
 		{
 			_tDeviceStatus replaceitem = itt->second;
 			replaceitem.deviceName = l_deviceName;
+			replaceitem.version = ++m_stateVersion;
 			itt->second = replaceitem;
 		}
 	}
@@ -1106,6 +1113,7 @@ void CEventSystem::WWWUpdateSingleState(const uint64_t ulDevID, const std::strin
 		{
 			_tScenesGroups replaceitem = itt->second;
 			replaceitem.scenesgroupName = l_deviceName;
+			replaceitem.version = ++m_stateVersion;
 			itt->second = replaceitem;
 		}
 	}
@@ -1121,7 +1129,7 @@ void CEventSystem::WWWUpdateSecurityState(int securityStatus)
 	item.reason = REASON_SECURITY;
 	item.id = 0;
 	item.nValue = m_SecStatus;
-	m_eventqueue.push(item);
+	QueueEvent(item);
 }
 
 bool CEventSystem::GetEventTrigger(const uint64_t ulDevID, const _eReason reason, const bool bEventTrigger)
@@ -1158,7 +1166,7 @@ bool CEventSystem::Update(const Notification::_eType type, const Notification::_
 	item.sValue = eventdata;
 	item.lastLevel = static_cast<uint8_t>(status);
 	if (type != Notification::DZ_STOP)
-		m_eventqueue.push(item);
+		QueueEvent(item);
 	else // blocking call on application shutdown
 	{
 		std::vector<_tEventQueue> items;
@@ -1176,7 +1184,7 @@ void CEventSystem::TriggerURL(const std::string &result, const std::vector<std::
 	item.sValue = result;
 	item.nValueWording = callback;
 	item.vData = headerData;
-	m_eventqueue.push(item);
+	QueueEvent(item);
 }
 
 void CEventSystem::TriggerShellCommand(const std::string &result, const std::string &scriptstderr, const std::string &callback, int exitcode, bool timeoutOccurred)
@@ -1189,7 +1197,7 @@ void CEventSystem::TriggerShellCommand(const std::string &result, const std::str
 	item.nValueWording = callback;
 	item.errorText = scriptstderr;
 	item.timeoutOccurred = timeoutOccurred;
-	m_eventqueue.push(item);
+	QueueEvent(item);
 }
 
 void CEventSystem::SetEventTrigger(const uint64_t ulDevID, const _eReason reason, const float fDelayTime)
@@ -1244,9 +1252,10 @@ bool CEventSystem::UpdateSceneGroup(const uint64_t ulDevID, const int nValue, co
 			item.devname = replaceitem.scenesgroupName;
 			item.sValue = replaceitem.scenesgroupValue;
 			item.lastUpdate = itt->second.lastUpdate;
-			m_eventqueue.push(item);
+			QueueEvent(item);
 		}
 		replaceitem.lastUpdate = lastUpdate;
+		replaceitem.version = ++m_stateVersion;
 		itt->second = replaceitem;
 	}
 	return bEventTrigger;
@@ -1284,10 +1293,11 @@ void CEventSystem::UpdateUserVariable(const uint64_t ulDevID, const std::string&
 		item.id = ulDevID;
 		item.sValue = varValue;
 		item.lastUpdate = itt->second.lastUpdate;
-		m_eventqueue.push(item);
+		QueueEvent(item);
 	}
 
 	replaceitem.lastUpdate = lastUpdate;
+	replaceitem.version = ++m_stateVersion;
 	itt->second = replaceitem;
 }
 
@@ -1303,6 +1313,7 @@ void CEventSystem::UpdateBatteryLevel(const uint64_t ulDevID, const unsigned cha
 	{
 		_tDeviceStatus replaceitem = itt->second;
 		replaceitem.batteryLevel = batteryLevel;
+		replaceitem.version = ++m_stateVersion;
 		itt->second = replaceitem;
 	}
 }
@@ -1351,6 +1362,7 @@ std::string CEventSystem::UpdateSingleState(
 		{
 			UpdateJsonMap(replaceitem, ulDevID);
 		}
+		replaceitem.version = ++m_stateVersion;
 		itt->second = replaceitem;
 	}
 	else
@@ -1372,6 +1384,7 @@ std::string CEventSystem::UpdateSingleState(
 		{
 			UpdateJsonMap(newitem, ulDevID);
 		}
+		newitem.version = ++m_stateVersion;
 		m_devicestates[newitem.ID] = newitem;
 	}
 	return nValueWording;
@@ -1385,6 +1398,36 @@ void CEventSystem::UnlockEventQueueThread()
 	m_eventqueue.push(item);
 }
 
+thread_local int CEventSystem::t_EventQueueHold = 0;
+thread_local std::vector<CEventSystem::_tEventQueue> CEventSystem::t_HeldEvents;
+
+void CEventSystem::HoldEventQueue()
+{
+	t_EventQueueHold++;
+}
+
+void CEventSystem::ReleaseEventQueue()
+{
+	if ((t_EventQueueHold <= 0) || (--t_EventQueueHold > 0))
+		return;
+	if (t_HeldEvents.empty())
+		return;
+	// pushed at once, so the queue thread evaluates them in one pass
+	m_eventqueue.push_all(t_HeldEvents);
+	t_HeldEvents.clear();
+}
+
+// Events of a thread that holds the queue wait until it is released, the events of other threads do not
+void CEventSystem::QueueEvent(const _tEventQueue &item)
+{
+	if (t_EventQueueHold > 0)
+	{
+		t_HeldEvents.push_back(item);
+		return;
+	}
+	m_eventqueue.push(item);
+}
+
 void CEventSystem::EventQueueThread()
 {
 	_log.Log(LOG_STATUS, "EventSystem: Queue thread started...");
@@ -1501,9 +1544,10 @@ void CEventSystem::ProcessDevice(
 			_tDeviceStatus replaceitem = itt->second;
 			replaceitem.lastUpdate = lastUpdate;
 			replaceitem.lastLevel = lastLevel;
+			replaceitem.version = ++m_stateVersion;
 			itt->second = replaceitem;
 		}
-		m_eventqueue.push(item);
+		QueueEvent(item);
 	}
 	else
 		UpdateSingleState(ulDevID, devname, nValue, osValue, devType, subType, switchType, lastUpdate, lastLevel, batterylevel, options);
@@ -1514,7 +1558,7 @@ void CEventSystem::ProcessMinute()
 	_tEventQueue item;
 	item.reason = REASON_TIME;
 	item.id = 0;
-	m_eventqueue.push(item);
+	QueueEvent(item);
 }
 
 void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
@@ -2575,6 +2619,7 @@ bool CEventSystem::PythonScheduleEvent(const std::string &ID, const std::string
 
 void CEventSystem::EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString)
 {
+	CMetrics::CTimer timer("oikomaticz_event_script_seconds", CMetrics::Label("engine", "python"));
 	Plugins::PythonEventsProcessPython(m_szReason[item.reason], filename, PyString, item.id, m_devicestates, m_uservariables, getSunRiseSunSetMinutes("Sunrise"),
 		getSunRiseSunSetMinutes("Sunset"));
 
@@ -2964,28 +3009,13 @@ void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std
 {
 	std::lock_guard<std::mutex> l(luaMutex);
 
-	lua_State *lua_state;
-	lua_state = luaL_newstate();
-
-	// load Lua libraries
-	static const luaL_Reg lualibs[] = {
-		{ "base", luaopen_base },     { "io", luaopen_io },	{ "table", luaopen_table },
-		{ "string", luaopen_string }, { "math", luaopen_math }, { nullptr, nullptr },
-	};
-
-	const luaL_Reg *lib = lualibs;
-	for (; lib->func != nullptr; lib++)
+	lua_State *lua_state = AcquireLuaState();
+	if (lua_state == nullptr)
 	{
-		lib->func(lua_state);
-		lua_settop(lua_state, 0);
+		_log.Log(LOG_ERROR, "EventSystem: Could not create Lua state for %s", filename.c_str());
+		return;
 	}
 
-	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
-	lua_setglobal(lua_state, "domoticz_applyJsonPath");
-
-	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
-	lua_setglobal(lua_state, "domoticz_applyXPath");
-
 	_log.Debug(DEBUG_EVENTSYSTEM, "EventSystem: script %s trigger (%s)", m_szReason[items[0].reason].c_str(), filename.c_str());
 
 	int sunTimers[10];
@@ -3050,34 +3080,239 @@ void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std
 	else
 		EvaluateLuaClassic(lua_state, items[0], secstatus);
 
-	int status = 0;
-	if (LuaString.length() == 0)
-		status = luaL_loadfile(lua_state, filename.c_str());
-	else
-		status = luaL_loadstring(lua_state, LuaString.c_str());
-
+	int status = LoadLuaChunk(lua_state, filename, LuaString);
 	if (status == 0)
 	{
 		lua_sethook(lua_state, luaStop, LUA_MASKCOUNT, 10000000);
+		RunOnLuaWorker([this, lua_state, filename] { luaThread(lua_state, filename); }, filename);
+	}
+	else
+	{
+		report_errors(lua_state, status, filename);
+		ReleaseLuaState(lua_state);
+		return;
+	}
+}
 
-		boost::thread aluaThread([this, lua_state, filename] { luaThread(lua_state, filename); });
-		SetThreadName(aluaThread.native_handle(), "luaThread");
-
-		if (!aluaThread.timed_join(boost::posix_time::seconds(10)))
+// Runs in a freshly created state: records its globals, installs the cached module loader
+// and returns the function that puts the state back in this initial condition
+static const char *szLuaStateReset =
+	"local cachedSearcher = ...\n"
+	"table.insert(package.searchers, 2, cachedSearcher)\n"
+	"local pairs, rawset, setmetatable = pairs, rawset, setmetatable\n"
+	"local function snapshot(t) local c = {} for k, v in pairs(t) do c[k] = v end return c end\n"
+	"local tables = {}\n"
+	"for _, v in pairs(_G) do if type(v) == 'table' then tables[v] = snapshot(v) end end\n"
+	"tables[package.loaded] = snapshot(package.loaded)\n"
+	"tables[package.searchers] = snapshot(package.searchers)\n"
+	"return function()\n"
+	"  setmetatable(_G, nil)\n"
+	"  for t, c in pairs(tables) do\n"
+	"    for k in pairs(t) do if c[k] == nil then rawset(t, k, nil) end end\n"
+	"    for k, v in pairs(c) do rawset(t, k, v) end\n"
+	"  end\n"
+	"end\n";
+
+lua_State *CEventSystem::AcquireLuaState()
+{
+	{
+		std::lock_guard<std::mutex> l(m_luaStatePoolMutex);
+		if (!m_luaStatePool.empty())
 		{
-			_log.Log(LOG_ERROR, "EventSystem: Warning!, lua script %s has been running for more than 10 seconds", filename.c_str());
+			lua_State *lua_state = m_luaStatePool.back();
+			m_luaStatePool.pop_back();
+			return lua_state;
 		}
 	}
-	else
+
+	lua_State *lua_state = luaL_newstate();
+	if (lua_state == nullptr)
+		return nullptr;
+
+	luaL_openlibs(lua_state);
+
+	// reroute print library to Oikomaticz logger
+	lua_pushcfunction(lua_state, l_domoticz_print);
+	lua_setglobal(lua_state, "print");
+
+	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
+	lua_setglobal(lua_state, "domoticz_applyJsonPath");
+
+	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
+	lua_setglobal(lua_state, "domoticz_applyXPath");
+
+	int status = luaL_loadstring(lua_state, szLuaStateReset);
+	if (status == 0)
 	{
-		report_errors(lua_state, status, filename);
+		lua_pushcfunction(lua_state, l_domoticz_loadCachedModule);
+		status = lua_pcall(lua_state, 1, 1, 0);
+	}
+	if (status != 0)
+	{
+		report_errors(lua_state, status, "state reset");
 		lua_close(lua_state);
+		return nullptr;
+	}
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, "oikomaticz_reset");
+	return lua_state;
+}
+
+void CEventSystem::ReleaseLuaState(lua_State *lua_state)
+{
+	lua_sethook(lua_state, nullptr, 0, 0);
+	lua_settop(lua_state, 0);
+
+	lua_getfield(lua_state, LUA_REGISTRYINDEX, "oikomaticz_reset");
+	if (lua_pcall(lua_state, 0, 0, 0) != 0)
+	{
+		report_errors(lua_state, 1, "state reset");
+		lua_close(lua_state);
+		return;
+	}
+
+	std::lock_guard<std::mutex> l(m_luaStatePoolMutex);
+	if (m_luaStatePool.size() < MAX_IDLE_LUA_STATES)
+		m_luaStatePool.push_back(lua_state);
+	else
+		lua_close(lua_state);
+}
+
+void CEventSystem::ClearLuaStatePool()
+{
+	std::lock_guard<std::mutex> l(m_luaStatePoolMutex);
+	for (auto lua_state : m_luaStatePool)
+		lua_close(lua_state);
+	m_luaStatePool.clear();
+}
+
+static int WriteLuaChunk(lua_State * /*L*/, const void *p, size_t sz, void *ud)
+{
+	static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+	return 0;
+}
+
+// Same as luaL_loadfile/luaL_loadstring, but only parses a script again when it has changed
+int CEventSystem::LoadLuaChunk(lua_State *lua_state, const std::string &filename, const std::string &LuaString)
+{
+	_tLuaChunk chunk;
+	if (LuaString.empty())
+	{
+		struct stat st;
+		if (stat(filename.c_str(), &st) != 0)
+			return luaL_loadfile(lua_state, filename.c_str()); // let Lua report the error
+		chunk.mtime = st.st_mtime;
+		chunk.size = st.st_size;
+	}
+	else
+		chunk.source = LuaString;
+
+	{
+		std::lock_guard<std::mutex> l(m_luaChunksMutex);
+		auto itt = m_luaChunks.find(filename);
+		if ((itt != m_luaChunks.end()) && (itt->second.mtime == chunk.mtime) && (itt->second.size == chunk.size) && (itt->second.source == chunk.source))
+			return luaL_loadbufferx(lua_state, itt->second.bytecode.data(), itt->second.bytecode.size(), filename.c_str(), "b");
+	}
+
+	int status;
+	if (LuaString.empty())
+		status = luaL_loadfile(lua_state, filename.c_str());
+	else
+		status = luaL_loadstring(lua_state, LuaString.c_str());
+	if (status != 0)
+		return status;
+
+	lua_dump(lua_state, WriteLuaChunk, &chunk.bytecode, 0);
+
+	std::lock_guard<std::mutex> l(m_luaChunksMutex);
+	m_luaChunks[filename] = std::move(chunk);
+	return status;
+}
+
+// package.searchers entry that loads modules (dzVents runtime and scripts) through the chunk cache
+int CEventSystem::l_domoticz_loadCachedModule(lua_State *lua_state)
+{
+	const char *name = luaL_checkstring(lua_state, 1);
+	lua_getglobal(lua_state, "package");
+	lua_getfield(lua_state, -1, "searchpath");
+	lua_pushstring(lua_state, name);
+	lua_getfield(lua_state, -3, "path");
+	lua_call(lua_state, 2, 2);
+	if (lua_isnil(lua_state, -2))
+		return 1; // not found, searchpath explains why
+
+	int status;
+	{
+		std::string filename = lua_tostring(lua_state, -2);
+		status = m_mainworker.m_eventsystem.LoadLuaChunk(lua_state, filename, "");
+	}
+	if (status != 0)
+		return luaL_error(lua_state, "error loading module '%s' from file '%s':\n\t%s", name, lua_tostring(lua_state, -3), lua_tostring(lua_state, -1));
+	lua_pushvalue(lua_state, -3);
+	return 2;
+}
+
+bool CEventSystem::RunOnLuaWorker(std::function<void()> job, const std::string &filename)
+{
+	if (!m_luaWorker)
+	{
+		std::shared_ptr<_tLuaWorker> worker = std::make_shared<_tLuaWorker>();
+		worker->thread = std::thread([worker] { LuaWorkerThread(worker); });
+		SetThreadName(worker->thread.native_handle(), "luaThread");
+		m_luaWorker = worker;
+	}
+
+	std::shared_ptr<_tLuaWorker> worker = m_luaWorker;
+	std::unique_lock<std::mutex> l(worker->mutex);
+	worker->job = std::move(job);
+	worker->busy = true;
+	worker->cond.notify_all();
+	if (worker->cond.wait_for(l, std::chrono::seconds(10), [&worker] { return !worker->busy; }))
+		return true;
+
+	_log.Log(LOG_ERROR, "EventSystem: Warning!, lua script %s has been running for more than 10 seconds", filename.c_str());
+
+	// let the script finish on its own, the next one gets a new worker
+	worker->stop = true;
+	worker->thread.detach();
+	m_luaWorker.reset();
+	return false;
+}
+
+void CEventSystem::LuaWorkerThread(const std::shared_ptr<_tLuaWorker> &worker)
+{
+	std::unique_lock<std::mutex> l(worker->mutex);
+	while (true)
+	{
+		worker->cond.wait(l, [&worker] { return (worker->job != nullptr) || worker->stop; });
+		if (worker->job == nullptr)
+			break;
+		std::function<void()> job = std::move(worker->job);
+		worker->job = nullptr;
+		l.unlock();
+		job();
+		l.lock();
+		worker->busy = false;
+		worker->cond.notify_all();
+	}
+}
+
+void CEventSystem::StopLuaWorker()
+{
+	std::lock_guard<std::mutex> l(luaMutex);
+	if (!m_luaWorker)
 		return;
+	{
+		std::lock_guard<std::mutex> lWorker(m_luaWorker->mutex);
+		m_luaWorker->stop = true;
+		m_luaWorker->cond.notify_all();
 	}
+	m_luaWorker->thread.join();
+	m_luaWorker.reset();
 }
 
 void CEventSystem::luaThread(lua_State *lua_state, const std::string &filename)
 {
+	CMetrics::CTimer timer("oikomaticz_event_script_seconds", CMetrics::Label("engine", (filename == CdzVents::GetInstance()->m_runtimeDir + "dzVents.lua") ? "dzvents" : "lua"));
 	int status;
 	status = lua_pcall(lua_state, 0, LUA_MULTRET, 0);
 	report_errors(lua_state, status, filename);
@@ -3103,8 +3338,7 @@ void CEventSystem::luaThread(lua_State *lua_state, const std::string &filename)
 			_log.Log(LOG_STATUS, "EventSystem: Script event triggered: %s", filename.c_str());
 	}
 
-	lua_close(lua_state);
-
+	ReleaseLuaState(lua_state);
 }
 
 void CEventSystem::luaStop(lua_State *L, lua_Debug *ar)
@@ -3114,7 +3348,6 @@ void CEventSystem::luaStop(lua_State *L, lua_Debug *ar)
 		(void)ar;  /* unused arg. */
 		lua_sethook(L, nullptr, 0, 0);
 		luaL_error(L, "Lua script execution exceeds maximum number of lines");
-		lua_close(L);
 	}
 }
 
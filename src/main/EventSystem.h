@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <string>
 #include <boost/thread/shared_mutex.hpp>
 
@@ -79,6 +83,7 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 		std::map<uint8_t, float> JsonMapFloat;
 		std::map<uint8_t, bool> JsonMapBool;
 		std::map<uint8_t, std::string> JsonMapString;
+		uint64_t version = 0;
 	};
 
 	struct _tUserVariable
@@ -88,6 +93,7 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 		std::string variableValue;
 		int variableType;
 		std::string lastUpdate;
+		uint64_t version = 0;
 	};
 
 	struct _tScenesGroups
@@ -100,6 +106,7 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 		std::string lastUpdate;
 		std::string description;
 		std::vector<uint64_t> memberID;
+		uint64_t version = 0;
 	};
 
 	CEventSystem();
@@ -112,6 +119,9 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 	void ProcessDevice(int HardwareID, uint64_t ulDevID, unsigned char unit, unsigned char devType, unsigned char subType, unsigned char signallevel, unsigned char batterylevel, int nValue,
 			   const char *sValue);
 	void UpdateBatteryLevel(uint64_t ulDevID, unsigned char batteryLevel);
+	// While the current thread holds the queue its events are collected, and evaluated together once it releases the queue
+	void HoldEventQueue();
+	void ReleaseEventQueue();
 
 	void RemoveSingleState(uint64_t ulDevID, _eReason reason);
 	void WWWUpdateSingleState(uint64_t ulDevID, const std::string &devname, _eReason reason);
@@ -175,6 +185,9 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 		queue_element_trigger* trigger = nullptr;
 	};
 	concurrent_queue<_tEventQueue> m_eventqueue;
+	static thread_local int t_EventQueueHold;
+	static thread_local std::vector<_tEventQueue> t_HeldEvents;
+	void QueueEvent(const _tEventQueue &item);
 
 	std::vector<_tEventTrigger> m_eventtrigger;
 	bool m_bEnabled;
@@ -183,8 +196,39 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 	boost::shared_mutex m_uservariablesMutex;
 	boost::shared_mutex m_scenesgroupsMutex;
 	boost::shared_mutex m_eventtriggerMutex;
+	// Bumped on every change to m_devicestates, m_uservariables or m_scenesgroups, the new value
+	// is stored in the version field of the changed entry
+	std::atomic<uint64_t> m_stateVersion{ 0 };
 	std::mutex m_measurementStatesMutex;
 	std::mutex luaMutex;
+
+	// Compiled Lua chunk, keyed by script path (or event name for scripts stored in the database)
+	struct _tLuaChunk
+	{
+		time_t mtime = 0;
+		int64_t size = 0;
+		std::string source;
+		std::string bytecode;
+	};
+	std::mutex m_luaChunksMutex;
+	std::map<std::string, _tLuaChunk> m_luaChunks;
+
+	// Long-lived lua_States, reset to their initial globals between scripts
+	static constexpr size_t MAX_IDLE_LUA_STATES = 4;
+	std::mutex m_luaStatePoolMutex;
+	std::vector<lua_State *> m_luaStatePool;
+
+	// Thread that runs the scripts, replaced when a script overruns its time limit
+	struct _tLuaWorker
+	{
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::function<void()> job;
+		bool busy = false;
+		bool stop = false;
+		std::thread thread;
+	};
+	std::shared_ptr<_tLuaWorker> m_luaWorker;
 	std::shared_ptr<std::thread> m_thread;
 	std::shared_ptr<std::thread> m_eventqueuethread;
 	StoppableTask m_TaskQueue;
@@ -214,6 +258,14 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 	void EvaluateLua(const std::vector<_tEventQueue> &items, const std::string &filename, const std::string &LuaString);
 	void luaThread(lua_State *lua_state, const std::string &filename);
 	static void luaStop(lua_State *L, lua_Debug *ar);
+	lua_State *AcquireLuaState();
+	void ReleaseLuaState(lua_State *lua_state);
+	void ClearLuaStatePool();
+	int LoadLuaChunk(lua_State *lua_state, const std::string &filename, const std::string &LuaString);
+	static int l_domoticz_loadCachedModule(lua_State *lua_state);
+	bool RunOnLuaWorker(std::function<void()> job, const std::string &filename);
+	static void LuaWorkerThread(const std::shared_ptr<_tLuaWorker> &worker);
+	void StopLuaWorker();
 	std::string nValueToWording(uint8_t dType, uint8_t dSubType, device::tswitch::type::value switchtype, int nValue, const std::string &sValue, const std::map<std::string, std::string> &options);
 	static int l_domoticz_print(lua_State* lua_state);
 	void OpenURL(float delay, const std::string &URL);
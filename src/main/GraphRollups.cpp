@@ -0,0 +1,197 @@
+#include "stdafx.h"
+#include "GraphRollups.h"
+#include "SQLHelper.h"
+#include <cstring>
+
+namespace
+{
+	struct _tRollupTable
+	{
+		const char *szName;
+		size_t nColumns;
+		// Date, the value columns and Price of all rows of one device
+		const char *szQuery;
+	};
+
+	constexpr std::array<_tRollupTable, CGraphRollups::TABLE_COUNT> RollupTables = { {
+		{ "Temperature", 6, "SELECT Date, Temperature, Chill, Humidity, Barometer, SetPoint, DewPoint, 0 FROM Temperature WHERE (DeviceRowID==?) ORDER BY Date ASC, ROWID ASC" },
+		{ "Meter", 2, "SELECT Date, Value, Usage, Price FROM Meter WHERE (DeviceRowID==?) ORDER BY Date ASC, ROWID ASC" },
+		{ "MultiMeter", 6, "SELECT Date, Value1, Value2, Value3, Value4, Value5, Value6, Price FROM MultiMeter WHERE (DeviceRowID==?) ORDER BY Date ASC, ROWID ASC" },
+	} };
+
+	std::string GetHour(const std::string_view &szDate)
+	{
+		return std::string(szDate.substr(0, 13)) + ":00:00";
+	}
+
+	void AddToHours(std::vector<CGraphRollups::_tBucket> &hours, const std::string &hour, const CGraphRollups::_tValues &values, const double price)
+	{
+		if (hours.empty() || (hours.back().Hour != hour))
+		{
+			hours.emplace_back();
+			hours.back().Hour = hour;
+		}
+		hours.back().Add(values, price);
+	}
+
+	bool CopyRange(const std::vector<CGraphRollups::_tBucket> &all, const std::string &szFrom, const std::string &szTo, std::vector<CGraphRollups::_tBucket> &hours)
+	{
+		for (const auto &bucket : all)
+		{
+			if ((bucket.Hour >= szFrom) && (bucket.Hour <= szTo))
+				hours.push_back(bucket);
+		}
+		return !hours.empty();
+	}
+} // namespace
+
+void CGraphRollups::_tBucket::Add(const _tValues &values, const double price)
+{
+	if (Count == 0)
+	{
+		Min = values;
+		Max = values;
+		Price = price;
+	}
+	for (size_t ii = 0; ii < MAX_COLUMNS; ii++)
+	{
+		Min[ii] = std::min(Min[ii], values[ii]);
+		Max[ii] = std::max(Max[ii], values[ii]);
+		Sum[ii] += values[ii];
+	}
+	Last = values;
+	Count++;
+}
+
+void CGraphRollups::_tBucket::Merge(const _tBucket &other)
+{
+	if (other.Count == 0)
+		return;
+	if (Count == 0)
+	{
+		*this = other;
+		return;
+	}
+	for (size_t ii = 0; ii < MAX_COLUMNS; ii++)
+	{
+		Min[ii] = std::min(Min[ii], other.Min[ii]);
+		Max[ii] = std::max(Max[ii], other.Max[ii]);
+		Sum[ii] += other.Sum[ii];
+	}
+	Last = other.Last;
+	Count += other.Count;
+}
+
+CGraphRollups::_eTable CGraphRollups::GetTable(const char *szTable)
+{
+	for (size_t ii = 0; ii < RollupTables.size(); ii++)
+	{
+		if (strcmp(szTable, RollupTables[ii].szName) == 0)
+			return static_cast<_eTable>(ii);
+	}
+	return TABLE_COUNT;
+}
+
+bool CGraphRollups::GetHours(const _eTable table, const uint64_t idx, const std::string &szFrom, const std::string &szTo, std::vector<_tBucket> &hours)
+{
+	hours.clear();
+	uint64_t generation;
+	bool bRowPending;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto itt = m_devices[table].find(idx);
+		if (itt != m_devices[table].end())
+			return CopyRange(itt->second, szFrom, szTo, hours);
+		generation = m_generation.load();
+		bRowPending = (m_rowsPending != 0);
+	}
+
+	_tHours all;
+	if (!Load(table, idx, all))
+		return false;
+	{
+		// a row inserted while loading may be in the result and still be added by AddRow()
+		std::lock_guard<std::mutex> l(m_mutex);
+		if ((!bRowPending) && (m_rowsPending == 0) && (m_generation.load() == generation))
+			m_devices[table][idx] = all;
+	}
+	return CopyRange(all, szFrom, szTo, hours);
+}
+
+bool CGraphRollups::GetTotal(const _eTable table, const uint64_t idx, const std::string &szFrom, const std::string &szTo, _tBucket &total)
+{
+	std::vector<_tBucket> hours;
+	if (!GetHours(table, idx, szFrom, szTo, hours))
+		return false;
+	total = _tBucket();
+	for (const auto &bucket : hours)
+		total.Merge(bucket);
+	return true;
+}
+
+void CGraphRollups::BeginRow()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_rowsPending++;
+}
+
+void CGraphRollups::AddRow(const _eTable table, const uint64_t idx, const std::string &szDate, const _tValues &values, const double price)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_rowsPending > 0)
+		m_rowsPending--;
+	auto itt = m_devices[table].find(idx);
+	if (itt == m_devices[table].end())
+	{
+		m_generation++; // a load that is in progress might not have seen this row
+		return;
+	}
+	std::string hour = GetHour(szDate);
+	if ((!itt->second.empty()) && (itt->second.back().Hour > hour))
+	{
+		// the clock went back, rows are no longer in order
+		m_devices[table].erase(itt);
+		m_generation++;
+		return;
+	}
+	AddToHours(itt->second, hour, values, price);
+}
+
+void CGraphRollups::Invalidate(const _eTable table)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_generation++;
+	m_devices[table].clear();
+}
+
+void CGraphRollups::Invalidate(const _eTable table, const uint64_t idx)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_generation++;
+	m_devices[table].erase(idx);
+}
+
+void CGraphRollups::Clear()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_generation++;
+	for (auto &devices : m_devices)
+		devices.clear();
+}
+
+bool CGraphRollups::Load(const _eTable table, const uint64_t idx, _tHours &hours)
+{
+	// The writer connection also sees the rows of a group transaction that is not committed yet
+	const _tRollupTable &rtable = RollupTables[table];
+	auto stmt = m_sql.prepared_query(rtable.szQuery, idx);
+	if (!stmt.IsValid())
+		return false;
+	while (stmt.Step())
+	{
+		_tValues values{};
+		for (size_t ii = 0; ii < rtable.nColumns; ii++)
+			values[ii] = stmt.GetDouble(static_cast<int>(ii + 1));
+		AddToHours(hours, GetHour(stmt.GetText(0)), values, stmt.GetDouble(static_cast<int>(rtable.nColumns + 1)));
+	}
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hourly aggregates of the 5 minute short log tables (Temperature, Meter and MultiMeter) per device,
+// so graphs and price calculations read one bucket per hour instead of every row.
+// A device is loaded from the database on first use, after that the writer adds its new rows with AddRow().
+// Any other change to these tables is reported through Invalidate() (sqlite update hook) and drops the device,
+// or the whole table when the changed device is not known.
+// A generation counter is bumped on every change the cache did not follow, and the writer announces a row
+// with BeginRow() before its INSERT, so that an entry loaded from the database meanwhile is never stored
+// (it could already hold a row that AddRow() then adds again).
+class CGraphRollups
+{
+public:
+	enum _eTable
+	{
+		TABLE_TEMPERATURE = 0,
+		TABLE_METER,
+		TABLE_MULTIMETER,
+		TABLE_COUNT
+	};
+	static constexpr size_t MAX_COLUMNS = 6;
+	typedef std::array<double, MAX_COLUMNS> _tValues;
+
+	// Aggregate of the rows in one hour (or of several hours after Merge)
+	// Columns: Temperature, Chill, Humidity, Barometer, SetPoint, DewPoint / Value, Usage / Value1..Value6
+	struct _tBucket
+	{
+		std::string Hour; // "YYYY-MM-DD HH:00:00" of the first row
+		int Count = 0;
+		double Price = 0; // of the first row
+		_tValues Min{};
+		_tValues Max{};
+		_tValues Sum{};
+		_tValues Last{};
+
+		void Add(const _tValues &values, double price);
+		void Merge(const _tBucket &other);
+		double Avg(const size_t col) const
+		{
+			return (Count > 0) ? Sum[col] / Count : 0;
+		}
+	};
+
+	// TABLE_COUNT for tables that are not rolled up
+	static _eTable GetTable(const char *szTable);
+
+	// Buckets of the device with szFrom <= Hour <= szTo (compared as text), false when it has no rows in that range
+	bool GetHours(_eTable table, uint64_t idx, const std::string &szFrom, const std::string &szTo, std::vector<_tBucket> &hours);
+	// The same range merged into one bucket
+	bool GetTotal(_eTable table, uint64_t idx, const std::string &szFrom, const std::string &szTo, _tBucket &total);
+
+	// Called by the writer before it inserts a row, every BeginRow() must be followed by AddRow()
+	void BeginRow();
+	// Row that was just inserted by the writer, szDate as stored ("YYYY-MM-DD HH:MM:SS")
+	void AddRow(_eTable table, uint64_t idx, const std::string &szDate, const _tValues &values, double price);
+	void Invalidate(_eTable table);
+	void Invalidate(_eTable table, uint64_t idx);
+	void Clear();
+
+private:
+	typedef std::vector<_tBucket> _tHours;
+
+	static bool Load(_eTable table, uint64_t idx, _tHours &hours);
+
+	std::mutex m_mutex;
+	std::array<std::map<uint64_t, _tHours>, TABLE_COUNT> m_devices;
+	std::atomic<uint64_t> m_generation{ 0 };
+	size_t m_rowsPending = 0; // between BeginRow() and AddRow(), guarded by m_mutex
+};
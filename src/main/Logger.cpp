@@ -33,7 +33,11 @@ CLogger::_tLogLineStruct::_tLogLineStruct(const _eLogLevel nlevel, const std::st
 }
 
 CLogger::CLogger()
+	: m_notification_log(MAX_LOG_LINE_BUFFER)
+	, m_queue(new _tLogQueueSlot[LOG_QUEUE_SIZE])
 {
+	for (size_t ii = 0; ii < LOG_QUEUE_SIZE; ii++)
+		m_queue[ii].sequence.store(ii, std::memory_order_relaxed);
 	m_bInSequenceMode = false;
 	m_bEnableLogThreadIDs = false;
 	m_bEnableLogTimestamps = true;
@@ -45,6 +49,7 @@ CLogger::CLogger()
 
 CLogger::~CLogger()
 {
+	StopWriterThread();
 	if (m_outputfile.is_open())
 		m_outputfile.close();
 }
@@ -176,7 +181,7 @@ bool CLogger::IsACLFlogEnabled()
 
 void CLogger::SetOutputFile(const char *OutputFile)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
+	std::unique_lock<std::mutex> lock(m_outputMutex);
 	if (m_outputfile.is_open())
 		m_outputfile.close();
 
@@ -276,41 +281,42 @@ void CLogger::Log(const _eLogLevel level, const char *logline, ...)
 	}
 #endif
 
-	std::stringstream sstr;
+	std::string szIntLog;
+	szIntLog.reserve(strlen(cbuffer) + 48);
 
 	if (m_bEnableLogTimestamps)
-		sstr << TimeToString(nullptr, TF_DateTimeMs) << "  ";
+	{
+		szIntLog += TimeToString(nullptr, TF_DateTimeMs);
+		szIntLog += "  ";
+	}
 
 	if ((m_log_flags & LOG_DEBUG_INT) && (m_debug_flags & DEBUG_THREADIDS))
 	{
+		char szThreadID[32];
 #ifdef WIN32
-		sstr << "[" << std::setfill('0') << std::setw(4) << std::hex << ::GetCurrentThreadId() << "] ";
+		snprintf(szThreadID, sizeof(szThreadID), "[%04lx] ", (unsigned long)::GetCurrentThreadId());
 #else
-		sstr << "[" << std::setfill('0') << std::setw(4) << std::hex << pthread_self() << "] ";
+		snprintf(szThreadID, sizeof(szThreadID), "[%04lx] ", (unsigned long)pthread_self());
 #endif
+		szIntLog += szThreadID;
 	}
 
 	if (level & LOG_STATUS)
-		sstr << "Status: " << cbuffer;
+		szIntLog += "Status: ";
 	else if (level & LOG_ERROR)
-		sstr << "Error: " << cbuffer;
+		szIntLog += "Error: ";
 	else if (level & LOG_DEBUG_INT)
-		sstr << "Debug: " << cbuffer;
-	else
-		sstr << cbuffer;
-
-	std::string szIntLog = sstr.str();
+		szIntLog += "Debug: ";
+	szIntLog += cbuffer;
 
 	sOnLogMessage(level, szIntLog);
 
 	{
-		// Locked region to allow multiple threads to print at the same time
+		// Locked region for the in-memory logs only, output is done below without holding it
 		std::unique_lock<std::mutex> lock(m_mutex);
 
 		if ((level & LOG_ERROR) && (m_bEnableErrorsToNotificationSystem))
 		{
-			if (m_notification_log.size() >= MAX_LOG_LINE_BUFFER)
-				m_notification_log.erase(m_notification_log.begin());
 			m_notification_log.push_back(_tLogLineStruct(level, szIntLog));
 			if ((m_notification_log.size() == 1) && (mytime(nullptr) - m_LastLogNotificationsSend >= 5))
 			{
@@ -318,33 +324,189 @@ void CLogger::Log(const _eLogLevel level, const char *logline, ...)
 			}
 		}
 
-		if (!g_bRunAsDaemon)
-		{
-			// output to console
+		auto itt = m_lastlog.find(level);
+		if (itt == m_lastlog.end())
+			itt = m_lastlog.emplace(level, boost::circular_buffer<_tLogLineStruct>(MAX_LOG_LINE_BUFFER)).first;
+		itt->second.push_back(_tLogLineStruct(level, szIntLog));
+	}
+
+	if (!m_bWriterRunning)
+	{
+		std::unique_lock<std::mutex> lock(m_outputMutex);
+		WriteLogLine(level, szIntLog);
+		if (m_outputfile.is_open())
+			m_outputfile.flush();
+		return;
+	}
+	if (!QueueLogLine(level, szIntLog))
+	{
+		m_droppedLines++;
+		return;
+	}
+	// the writer may have stopped (and done its last drain) since the check above
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!m_bWriterRunning)
+	{
+		std::unique_lock<std::mutex> lock(m_outputMutex);
+		WriteQueuedLines();
+		return;
+	}
+	if (level & LOG_ERROR)
+	{
+		// errors are written (and flushed) right away
+		m_bWakeWriter = true;
+		m_writerCond.notify_one();
+	}
+}
+
+// Called with m_outputMutex held, does not flush the log file
+void CLogger::WriteLogLine(const _eLogLevel level, const std::string &sLogline)
+{
+	if (!g_bRunAsDaemon)
+	{
+		// output to console
 #ifndef WIN32
-			if (level != LOG_ERROR)
+		if (level != LOG_ERROR)
 #endif
-				std::cout << szIntLog << std::endl;
+			std::cout << sLogline << '\n';
 #ifndef WIN32
-			else // print text in red color
-				std::cout << szIntLog.substr(0, 25) << "\033[1;31m" << szIntLog.substr(25) << "\033[0;0m" << std::endl;
+		else // print text in red color
+			std::cout << sLogline.substr(0, 25) << "\033[1;31m" << sLogline.substr(25) << "\033[0;0m" << '\n';
 #endif
-		}
+	}
 
-		if (m_outputfile.is_open())
+	if (m_outputfile.is_open())
+	{
+		// output to file
+		m_outputfile << sLogline << '\n';
+	}
+}
+
+bool CLogger::QueueLogLine(const _eLogLevel level, const std::string &sLogline)
+{
+	_tLogQueueSlot *pSlot;
+	size_t pos = m_queueHead.load(std::memory_order_relaxed);
+	while (true)
+	{
+		pSlot = &m_queue[pos & (LOG_QUEUE_SIZE - 1)];
+		size_t seq = pSlot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0)
 		{
-			// output to file
-			m_outputfile << szIntLog << std::endl;
-			m_outputfile.flush();
+			// slot is free, claim it
+			if (m_queueHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
 		}
+		else if (diff < 0)
+			return false; // queue is full
+		else
+			pos = m_queueHead.load(std::memory_order_relaxed);
+	}
+	pSlot->level = level;
+	pSlot->logline = sLogline;
+	pSlot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
 
-		auto itt = m_lastlog.find(level);
-		if (itt != m_lastlog.end())
+bool CLogger::PopLogLine(_eLogLevel &level, std::string &sLogline)
+{
+	_tLogQueueSlot &slot = m_queue[m_queueTail & (LOG_QUEUE_SIZE - 1)];
+	if (slot.sequence.load(std::memory_order_acquire) != m_queueTail + 1)
+		return false; // empty, or the producer is still filling the slot
+	level = slot.level;
+	sLogline.swap(slot.logline);
+	slot.sequence.store(m_queueTail + LOG_QUEUE_SIZE, std::memory_order_release);
+	m_queueTail++;
+	return true;
+}
+
+void CLogger::StartWriterThread()
+{
+	if (m_writerThread)
+		return;
+	m_bStopWriter = false;
+	m_bWriterRunning = true;
+	m_writerThread = std::make_shared<std::thread>([this] { Do_Work(); });
+	SetThreadName(m_writerThread->native_handle(), "Logger");
+}
+
+void CLogger::StopWriterThread()
+{
+	if (!m_writerThread)
+		return;
+	m_bStopWriter = true;
+	m_writerCond.notify_one();
+	m_writerThread->join();
+	m_writerThread.reset();
+
+	// pick up lines queued while the writer was stopping
+	std::unique_lock<std::mutex> lock(m_outputMutex);
+	WriteQueuedLines();
+}
+
+// Called with m_outputMutex held
+void CLogger::WriteQueuedLines()
+{
+	_eLogLevel level;
+	std::string sLogline;
+	while (PopLogLine(level, sLogline))
+		WriteLogLine(level, sLogline);
+	if (m_outputfile.is_open())
+		m_outputfile.flush();
+}
+
+void CLogger::SetSynchronousOutput()
+{
+	// lines already queued are still written by the writer thread
+	m_bWriterRunning = false;
+}
+
+uint64_t CLogger::GetDroppedLines()
+{
+	return m_droppedLines;
+}
+
+void CLogger::Do_Work()
+{
+	_eLogLevel level;
+	std::string sLogline;
+	uint64_t reportedDrops = 0;
+	while (true)
+	{
+		// lines logged after the stop request are written directly, drain what is left in the queue
+		bool bStop = m_bStopWriter;
+		if (bStop)
 		{
-			if (m_lastlog[level].size() >= MAX_LOG_LINE_BUFFER)
-				m_lastlog[level].erase(m_lastlog[level].begin());
+			m_bWriterRunning = false;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
 		}
-		m_lastlog[level].push_back(_tLogLineStruct(level, szIntLog));
+		{
+			std::unique_lock<std::mutex> lock(m_outputMutex);
+			bool bWritten = false;
+			while (PopLogLine(level, sLogline))
+			{
+				WriteLogLine(level, sLogline);
+				bWritten = true;
+			}
+			uint64_t drops = m_droppedLines;
+			if (drops != reportedDrops)
+			{
+				WriteLogLine(LOG_ERROR, TimeToString(nullptr, TF_DateTimeMs) + "  Error: Logger: " + std::to_string(drops - reportedDrops) + " log line(s) dropped (queue full)");
+				reportedDrops = drops;
+				bWritten = true;
+			}
+			if (bWritten)
+			{
+				std::cout.flush();
+				if (m_outputfile.is_open())
+					m_outputfile.flush();
+			}
+		}
+		if (bStop)
+			break;
+		std::unique_lock<std::mutex> lock(m_writerMutex);
+		m_writerCond.wait_for(lock, std::chrono::milliseconds(250), [this] { return m_bWakeWriter || m_bStopWriter; });
+		m_bWakeWriter = false;
 	}
 }
 
@@ -480,10 +642,11 @@ std::list<CLogger::_tLogLineStruct> CLogger::GetLog(const _eLogLevel level, cons
 
 	if (level != LOG_ALL)
 	{
-		if (m_lastlog.find(level) == m_lastlog.end())
+		auto itt = m_lastlog.find(level);
+		if (itt == m_lastlog.end())
 			return mlist;
 
-		std::copy_if(std::begin(m_lastlog[level]), std::end(m_lastlog[level]), std::back_inserter(mlist), [lastlogtime](const _tLogLineStruct& l) { return l.logtime > lastlogtime; });
+		std::copy_if(itt->second.begin(), itt->second.end(), std::back_inserter(mlist), [lastlogtime](const _tLogLineStruct& l) { return l.logtime > lastlogtime; });
 	}
 	else
 		for (const auto& l : m_lastlog)
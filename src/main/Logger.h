@@ -1,9 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <list>
+#include <memory>
 #include <string>
 #include <fstream>
+#include <boost/circular_buffer.hpp>
 #include "lsignal.h"
 
 enum _eLogLevel : uint32_t
@@ -99,6 +103,13 @@ class CLogger
 	std::list<_tLogLineStruct> GetNotificationLogs();
 	bool NotificationLogsEnabled();
 
+	// Console and log file output is done by a writer thread once started (until then it is written directly)
+	void StartWriterThread();
+	void StopWriterThread();
+	// Write directly from the calling thread from now on (fatal error handling)
+	void SetSynchronousOutput();
+	uint64_t GetDroppedLines();
+
 private:
 	uint32_t m_log_flags = 0;
 	uint32_t m_debug_flags = 0;
@@ -106,11 +117,37 @@ class CLogger
 	uint32_t m_aclf_loggedlinescnt = 0;
 
 	std::mutex m_mutex;
+	std::mutex m_outputMutex;
 	std::ofstream m_outputfile;
 	const char* m_aclflogfile = nullptr;
 	std::ofstream m_aclfoutputfile;
-	std::map<_eLogLevel, std::deque<_tLogLineStruct>> m_lastlog;
-	std::deque<_tLogLineStruct> m_notification_log;
+	std::map<_eLogLevel, boost::circular_buffer<_tLogLineStruct>> m_lastlog;
+	boost::circular_buffer<_tLogLineStruct> m_notification_log;
+
+	// bounded multi-producer/single-consumer ring of lines waiting for the writer thread
+	struct _tLogQueueSlot
+	{
+		std::atomic<size_t> sequence{ 0 };
+		_eLogLevel level = LOG_NORM;
+		std::string logline;
+	};
+	static constexpr size_t LOG_QUEUE_SIZE = 8192; // must be a power of two
+	std::unique_ptr<_tLogQueueSlot[]> m_queue;
+	std::atomic<size_t> m_queueHead{ 0 };
+	size_t m_queueTail = 0;
+	std::atomic<uint64_t> m_droppedLines{ 0 };
+	std::atomic<bool> m_bWriterRunning{ false };
+	std::atomic<bool> m_bStopWriter{ false };
+	std::atomic<bool> m_bWakeWriter{ false };
+	std::mutex m_writerMutex;
+	std::condition_variable m_writerCond;
+	std::shared_ptr<std::thread> m_writerThread;
+
+	bool QueueLogLine(_eLogLevel level, const std::string &sLogline);
+	bool PopLogLine(_eLogLevel &level, std::string &sLogline);
+	void WriteLogLine(_eLogLevel level, const std::string &sLogline);
+	void WriteQueuedLines();
+	void Do_Work();
 	bool m_bInSequenceMode;
 	bool m_bEnableLogTimestamps;
 	bool m_bEnableLogThreadIDs;
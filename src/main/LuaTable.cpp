@@ -179,39 +179,44 @@ void CLuaTable::PushRow(std::vector<_tEntry>::iterator itt)
 
 void CLuaTable::Publish()
 {
-	if ((m_subtable_level == 0) && (!m_luatable.empty()))
+	if (Push())
+		lua_setglobal(m_lua_state, m_name.c_str());
+}
+
+bool CLuaTable::Push()
+{
+	if ((m_subtable_level != 0) || (m_luatable.empty()))
+	{
+		_log.Log(LOG_ERROR, "Lua table %s is not published. Not all sub tables are closed!", m_name.c_str());
+		return false;
+	}
+
+	for (auto itt = m_luatable.begin(); itt != m_luatable.end(); itt++)
 	{
-		for (auto itt = m_luatable.begin(); itt != m_luatable.end(); itt++)
+		switch (itt->label_type)
 		{
-			switch (itt->label_type)
-			{
-			case TYPE_TABLE:
-				lua_createtable(m_lua_state, itt->nrCols, itt->nrRows);
-				break;
-			case TYPE_SUBTABLE_OPEN_LABEL:
-				lua_pushstring(m_lua_state, itt->label.c_str());
-				lua_createtable(m_lua_state, itt->nrCols, itt->nrRows);
-				break;
-			case TYPE_SUBTABLE_OPEN_INDEX:
-				lua_pushinteger(m_lua_state, (lua_Integer)itt->index);
-				lua_createtable(m_lua_state, itt->nrCols, itt->nrRows);
-				break;
-			case TYPE_SUBTABLE_CLOSE:
-				lua_settable(m_lua_state, -3);
-				break;
-			case TYPE_VALUE_LABEL:
-			case TYPE_VALUE_INDEX:
-				PushRow(itt);
-				break;
-			default:
-				_log.Log(LOG_ERROR, "Unsupported label type in LuaTable!");
-			}
+		case TYPE_TABLE:
+			lua_createtable(m_lua_state, itt->nrCols, itt->nrRows);
+			break;
+		case TYPE_SUBTABLE_OPEN_LABEL:
+			lua_pushstring(m_lua_state, itt->label.c_str());
+			lua_createtable(m_lua_state, itt->nrCols, itt->nrRows);
+			break;
+		case TYPE_SUBTABLE_OPEN_INDEX:
+			lua_pushinteger(m_lua_state, (lua_Integer)itt->index);
+			lua_createtable(m_lua_state, itt->nrCols, itt->nrRows);
+			break;
+		case TYPE_SUBTABLE_CLOSE:
+			lua_settable(m_lua_state, -3);
+			break;
+		case TYPE_VALUE_LABEL:
+		case TYPE_VALUE_INDEX:
+			PushRow(itt);
+			break;
+		default:
+			_log.Log(LOG_ERROR, "Unsupported label type in LuaTable!");
 		}
-		lua_setglobal(m_lua_state, m_name.c_str());
-		m_luatable.clear();
 	}
-	else
-		_log.Log(LOG_ERROR, "Lua table %s is not published. Not all sub tables are closed!", m_name.c_str());
+	m_luatable.clear();
+	return true;
 }
-
-
@@ -8,6 +8,8 @@ class CLuaTable
 public:
 
 	void Publish();
+	// Builds the table like Publish(), but leaves it on the Lua stack instead of storing it in a global
+	bool Push();
 
 	// constructors
 	CLuaTable(lua_State *lua_state, const std::string &Name, int NrCols, int NrRows);
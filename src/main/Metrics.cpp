@@ -0,0 +1,149 @@
+#include "stdafx.h"
+#include "Metrics.h"
+#include <mutex>
+
+namespace
+{
+	constexpr uint64_t FIRST_BUCKET_US = 16;
+
+	std::string FormatValue(const double value)
+	{
+		char szTmp[40];
+		snprintf(szTmp, sizeof(szTmp), "%.15g", value);
+		return szTmp;
+	}
+
+	std::string FormatSeries(const std::string &szName, const std::string &szLabels, const std::string &szExtraLabel = "")
+	{
+		std::string szSeries = szName;
+		if (szLabels.empty() && szExtraLabel.empty())
+			return szSeries;
+		szSeries += '{';
+		szSeries += szLabels;
+		if ((!szLabels.empty()) && (!szExtraLabel.empty()))
+			szSeries += ',';
+		szSeries += szExtraLabel;
+		szSeries += '}';
+		return szSeries;
+	}
+
+	void AddType(std::string &szText, std::string &szLastName, const std::string &szName, const char *szType)
+	{
+		if (szName == szLastName)
+			return;
+		szText += "# TYPE " + szName + " " + szType + "\n";
+		szLastName = szName;
+	}
+} // namespace
+
+void CMetrics::CHistogram::Record(const std::chrono::steady_clock::duration duration)
+{
+	auto us = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+	size_t ii = 0;
+	while ((ii < HISTOGRAM_BUCKETS) && (us > (FIRST_BUCKET_US << ii)))
+		ii++;
+	m_buckets[ii]++;
+	m_sumUs += us;
+}
+
+CMetrics::CTimer::CTimer(const char *szName, const std::string &szLabels)
+	: m_histogram(m_metrics.GetHistogram(szName, szLabels))
+	, m_tStart(std::chrono::steady_clock::now())
+{
+}
+
+CMetrics::CTimer::CTimer(CHistogram &histogram)
+	: m_histogram(histogram)
+	, m_tStart(std::chrono::steady_clock::now())
+{
+}
+
+CMetrics::CTimer::~CTimer()
+{
+	m_histogram.Record(std::chrono::steady_clock::now() - m_tStart);
+}
+
+std::string CMetrics::Label(const char *szName, const std::string &szValue)
+{
+	std::string szLabel = szName;
+	szLabel += "=\"";
+	for (const char c : szValue)
+	{
+		if (c == '\\')
+			szLabel += "\\\\";
+		else if (c == '"')
+			szLabel += "\\\"";
+		else if (c == '\n')
+			szLabel += "\\n";
+		else
+			szLabel += c;
+	}
+	szLabel += '"';
+	return szLabel;
+}
+
+CMetrics::CHistogram &CMetrics::GetHistogram(const char *szName, const std::string &szLabels)
+{
+	_tSeries series(szName, szLabels);
+	{
+		std::shared_lock<std::shared_mutex> l(m_mutex);
+		auto itt = m_histograms.find(series);
+		if (itt != m_histograms.end())
+			return itt->second;
+	}
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	return m_histograms[series];
+}
+
+void CMetrics::AddCounter(const char *szName, const std::string &szLabels, const uint64_t nValue)
+{
+	_tSeries series(szName, szLabels);
+	{
+		std::shared_lock<std::shared_mutex> l(m_mutex);
+		auto itt = m_counters.find(series);
+		if (itt != m_counters.end())
+		{
+			itt->second += nValue;
+			return;
+		}
+	}
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	m_counters[series] += nValue;
+}
+
+std::string CMetrics::GetPrometheusText()
+{
+	std::string szText;
+	std::string szLastName;
+	std::shared_lock<std::shared_mutex> l(m_mutex);
+	for (const auto &itt : m_histograms)
+	{
+		const std::string &szName = itt.first.first;
+		const std::string &szLabels = itt.first.second;
+		const CHistogram &histogram = itt.second;
+		AddType(szText, szLastName, szName, "histogram");
+		uint64_t nCount = 0;
+		for (size_t ii = 0; ii <= HISTOGRAM_BUCKETS; ii++)
+		{
+			nCount += histogram.m_buckets[ii];
+			std::string szLe = (ii < HISTOGRAM_BUCKETS) ? FormatValue((FIRST_BUCKET_US << ii) / 1000000.0) : "+Inf";
+			szText += FormatSeries(szName + "_bucket", szLabels, Label("le", szLe)) + " " + std::to_string(nCount) + "\n";
+		}
+		szText += FormatSeries(szName + "_sum", szLabels) + " " + FormatValue(histogram.m_sumUs / 1000000.0) + "\n";
+		szText += FormatSeries(szName + "_count", szLabels) + " " + std::to_string(nCount) + "\n";
+	}
+	for (const auto &itt : m_counters)
+	{
+		AddType(szText, szLastName, itt.first.first, "counter");
+		szText += FormatSeries(itt.first.first, itt.first.second) + " " + std::to_string(itt.second.load()) + "\n";
+	}
+	return szText;
+}
+
+void CMetrics::AddGauge(std::string &szText, const char *szName, const std::string &szLabels, const double value)
+{
+	std::string szType = std::string("# TYPE ") + szName + " gauge\n";
+	if (szText.find(szType) == std::string::npos)
+		szText += szType;
+	szText += FormatSeries(szName, szLabels) + " " + FormatValue(value) + "\n";
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+
+// Latency histograms and counters of the processing stages, exported in the Prometheus text format on /metrics.
+// A series is named by its metric name and labels ("name=\"value\",..."), it is created on first use and
+// recording into an existing series only takes a shared lock and a few atomic increments.
+// Histogram buckets are powers of two from 16us up to 64s, so the relative error is at most a factor of two.
+class CMetrics
+{
+public:
+	static constexpr size_t HISTOGRAM_BUCKETS = 23;
+
+	class CHistogram
+	{
+	public:
+		void Record(std::chrono::steady_clock::duration duration);
+
+	private:
+		friend class CMetrics;
+		std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS + 1> m_buckets{}; // the last one is +Inf
+		std::atomic<uint64_t> m_sumUs{ 0 };
+	};
+
+	// Records the time it is in scope
+	class CTimer
+	{
+	public:
+		CTimer(const char *szName, const std::string &szLabels = "");
+		explicit CTimer(CHistogram &histogram);
+		~CTimer();
+		CTimer(const CTimer &) = delete;
+		CTimer &operator=(const CTimer &) = delete;
+
+	private:
+		CHistogram &m_histogram;
+		std::chrono::steady_clock::time_point m_tStart;
+	};
+
+	// name="value" with the value escaped
+	static std::string Label(const char *szName, const std::string &szValue);
+
+	CHistogram &GetHistogram(const char *szName, const std::string &szLabels = "");
+	void AddCounter(const char *szName, const std::string &szLabels = "", uint64_t nValue = 1);
+
+	// All histograms and counters, followed by the gauges that are added by the caller with AddGauge
+	std::string GetPrometheusText();
+	// Appends a gauge sample to szText, with its type line the first time
+	static void AddGauge(std::string &szText, const char *szName, const std::string &szLabels, double value);
+
+private:
+	typedef std::pair<std::string, std::string> _tSeries; // name, labels
+
+	std::shared_mutex m_mutex;
+	std::map<_tSeries, CHistogram> m_histograms;
+	std::map<_tSeries, std::atomic<uint64_t>> m_counters;
+};
+extern CMetrics m_metrics;
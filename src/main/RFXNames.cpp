@@ -28,16 +28,6 @@ const char* findTableIDSingle2(const STR_TABLE_SINGLE* t, const unsigned long id
 	return "Unknown";
 }
 
-const char* findTableID1ID2(const _STR_TABLE_ID1_ID2* t, const unsigned long id1, const unsigned long id2)
-{
-	while (t->str1) {
-		if ((t->id1 == id1) && (t->id2 == id2))
-			return t->str1;
-		t++;
-	}
-	return "Unknown";
-}
-
 const char* RFX_Humidity_Status_Desc(const unsigned char status)
 {
 	static const STR_TABLE_SINGLE Table[] = {
@@ -137,7 +127,7 @@ const char* BMP_Forecast_Desc(const unsigned char Forecast)
 
 const char* RFX_Type_Desc(const unsigned char i, const unsigned char snum)
 {
-	static const STR_TABLE_SINGLE Table[] = {
+	static constexpr STR_TABLE_SINGLE Table[] = {
 		{ pTypeInterfaceControl, "Interface Control", "unknown" },
 		{ pTypeInterfaceMessage, "Interface Message", "unknown" },
 		{ pTypeRecXmitMessage, "Receiver/Transmitter Message", "unknown" },
@@ -208,15 +198,13 @@ const char* RFX_Type_Desc(const unsigned char i, const unsigned char snum)
 		{ pTypeHoneywell_AL, "Honeywell", "doorbell" },
 		{ 0, nullptr, nullptr },
 	};
-	if (snum == 1)
-		return findTableIDSingle1(Table, i);
-
-	return findTableIDSingle2(Table, i);
+	static constexpr auto Index = BuildTableIndex(Table);
+	return findTableIndexed(Table, Index, i, (snum != 1));
 }
 
 const char* RFX_Type_SubType_Desc(const unsigned char dType, const unsigned char sType)
 {
-	static const STR_TABLE_ID1_ID2 Table[] = {
+	static constexpr STR_TABLE_ID1_ID2 Table[] = {
 		{ pTypeTEMP, sTypeTEMP1, "THR128/138, THC138" },
 		{ pTypeTEMP, sTypeTEMP2, "THC238/268, THN132, THWR288, THRN122, THN122, AW129/131" },
 		{ pTypeTEMP, sTypeTEMP3, "THWR800" },
@@ -639,7 +627,8 @@ const char* RFX_Type_SubType_Desc(const unsigned char dType, const unsigned char
 
 		{ 0, 0, nullptr },
 	};
-	return findTableID1ID2(Table, dType, sType);
+	static constexpr auto Index = BuildTableIndex(Table);
+	return findTableIndexed(Table, Index, dType, sType);
 }
 
 void GetLightStatus(
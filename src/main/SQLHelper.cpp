@@ -9,13 +9,17 @@
 #endif
 #include <sys/types.h>
 #include <iomanip>
+#include <fstream>
 #include "RFXtrx.h"
 #include "RFXNames.h"
 #include "Helper.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "WorkerPool.h"
 #include "mainworker.h"
 #include "main/json_helper.h"
 #include <sqlite3.h>
+#include "zlib.h"
 #include "hardware/hardwaretypes.h"
 #include "hardware/DomoticzTCP.h"
 #include "protocols/SMTPClient.h"
@@ -50,9 +54,16 @@
 #define DEFAULT_ADMINUSER "admin"
 #define DEFAULT_ADMINPWD "domoticz"
 
+// A held group transaction is committed anyway when it has been open this long, holds of other threads may overlap
+#define GROUP_COMMIT_MAX_HOLD_MS 1000
+
+// Rows read per statement when the short log store is rebuilt, the database is not locked between them
+#define SHORTLOG_REBUILD_ROWS 1000
+
 extern http::server::CWebServerHelper m_webservers;
 extern std::string szWWWFolder;
 extern std::string szAppVersion;
+extern bool g_bStopApplication;
 
 constexpr auto sqlCreateDeviceStatus =
 "CREATE TABLE IF NOT EXISTS [DeviceStatus] ("
@@ -647,7 +658,6 @@ CSQLHelper::CSQLHelper()
 	m_weightunit = WEIGHTUNIT_KG;
 	SetUnitsAndScale();
 	m_bAcceptHardwareTimerActive = false;
-	m_iAcceptHardwareTimerCounter = 0;
 	m_bEnableEventSystem = true;
 	m_bEnableEventSystemFullURLLog = true;
 	m_bDisableDzVentsSystem = false;
@@ -655,6 +665,13 @@ CSQLHelper::CSQLHelper()
 	m_bShortLogAddOnlyNewValues = false;
 	m_bPreviousAcceptNewHardware = false;
 	m_bLogEventScriptTrigger = false;
+	m_GroupCommitWindowMs = 50;
+	m_GroupCommitMaxRows = 200;
+	m_bShortLogStore = false;
+	m_bGroupCommitActive = false;
+	m_bGroupTransactionOpen = false;
+	m_GroupCommitHold = 0;
+	m_GroupTransactionRows = 0;
 
 	SetDatabaseName("domoticz.db");
 }
@@ -680,6 +697,9 @@ bool CSQLHelper::OpenDatabase()
 	sqlite3_exec(m_dbase, "PRAGMA synchronous = NORMAL", nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA foreign_keys = ON", nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA busy_timeout = 1000", nullptr, nullptr, nullptr);
+	m_devicecache.Clear();
+	m_graphrollups.Clear();
+	sqlite3_update_hook(m_dbase, OnDatabaseUpdate, this);
 
 	std::vector<std::vector<std::string> > result = query("SELECT name FROM sqlite_master WHERE type='table' AND name='DeviceStatus'");
 	bool bNewInstall = (result.empty());
@@ -3811,6 +3831,16 @@ bool CSQLHelper::OpenDatabase()
 
 	RefreshActualPrices();
 
+	OpenReaderConnections();
+	m_bGroupCommitActive = true;
+
+	if (m_bShortLogStore)
+	{
+		// filled from the database by the first short log cleanup
+		if (m_shortlogstore.Open(m_dbase_name + "-shortlog"))
+			_log.Log(LOG_STATUS, "ShortLogStore: Using %s-shortlog", m_dbase_name.c_str());
+	}
+
 	//Start background thread
 	if (!StartThread())
 		return false;
@@ -3819,9 +3849,16 @@ bool CSQLHelper::OpenDatabase()
 
 void CSQLHelper::CloseDatabase()
 {
+	CloseReaderConnections();
 	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 	if (m_dbase != nullptr)
 	{
+		CommitGroupTransaction();
+		m_bGroupCommitActive = false;
+		ClearStatementCache();
+		m_devicecache.Clear();
+		m_graphrollups.Clear();
+		m_shortlogstore.Close();
 		OptimizeDatabase(m_dbase);
 		sqlite3_close(m_dbase);
 		m_dbase = nullptr;
@@ -3833,6 +3870,7 @@ void CSQLHelper::StopThread()
 	if (m_thread)
 	{
 		RequestStop();
+		WakeBackgroundTask();
 		m_thread->join();
 		m_thread.reset();
 	}
@@ -4146,55 +4184,6 @@ void CSQLHelper::PerformThreadedAction(const _tTaskItem &tItem)
 			}
 		}
 	}
-	else if (tItem._ItemType == TITEM_GETURL)
-	{
-		std::vector<std::string> extraHeaders;
-		std::string postData = tItem._command;
-		std::string callback = tItem._ID;
-		std::string url = tItem._sValue;
-		int method = tItem._switchtype;
-
-		if (!tItem._relatedEvent.empty())
-			StringSplit(tItem._relatedEvent, "!#", extraHeaders);
-		std::string response;
-		std::vector<std::string> headerData;
-
-		connection::HTTP::method::value tmethod = static_cast<connection::HTTP::method::value>(method);
-
-		bool ret = false;
-		if (tmethod == connection::HTTP::method::GET)
-		{
-			ret = HTTPClient::GET(url, extraHeaders, response, headerData);
-		}
-		else if (tmethod == connection::HTTP::method::POST)
-		{
-			ret = HTTPClient::POST(url, postData, extraHeaders, response, headerData, true, true);
-		}
-		else if (tmethod == connection::HTTP::method::PUT)
-		{
-			ret = HTTPClient::PUT(url, postData, extraHeaders, response, headerData, true);
-		}
-		else if (tmethod == connection::HTTP::method::DELETE)
-		{
-			ret = HTTPClient::DELETE(url, postData, extraHeaders, response, headerData, true);
-		}
-		else if (tmethod == connection::HTTP::method::PATCH)
-		{
-			ret = HTTPClient::PATCH(url, postData, extraHeaders, response, headerData, true);
-		}
-		else
-			return; // unsupported method
-
-		if (m_bEnableEventSystem && !callback.empty())
-		{
-			m_mainworker.m_eventsystem.TriggerURL(response, headerData, callback);
-		}
-
-		if (!ret)
-		{
-			_log.Log(LOG_ERROR, "Error opening url: %s", url.c_str());
-		}
-	}
 	else if ((tItem._ItemType == TITEM_SEND_EMAIL) || (tItem._ItemType == TITEM_SEND_EMAIL_TO))
 	{
 		int nValue;
@@ -4255,63 +4244,137 @@ void CSQLHelper::PerformThreadedAction(const _tTaskItem &tItem)
 	}
 }
 
+void CSQLHelper::PerformURLRequest(const _tTaskItem &tItem)
+{
+	std::vector<std::string> extraHeaders;
+	const std::string &postData = tItem._command;
+	std::string callback = tItem._ID;
+	std::string url = tItem._sValue;
+	int method = tItem._switchtype;
+
+	if (!tItem._relatedEvent.empty())
+		StringSplit(tItem._relatedEvent, "!#", extraHeaders);
+
+	connection::HTTP::method::value tmethod = static_cast<connection::HTTP::method::value>(method);
+	if ((tmethod != connection::HTTP::method::GET) && (tmethod != connection::HTTP::method::POST) && (tmethod != connection::HTTP::method::PUT) && (tmethod != connection::HTTP::method::DELETE) &&
+	    (tmethod != connection::HTTP::method::PATCH))
+		return; // unsupported method
+
+	// Only GET needs data to be returned
+	bool bIgnoreNoDataReturned = (tmethod != connection::HTTP::method::GET);
+	RESTClient::ExecuteAsync((connection::HTTP::method::value)(tmethod | connection::HTTP::method::HEAD), url, postData, extraHeaders,
+		[this, url, callback, bIgnoreNoDataReturned](const RESTClient::_tResponse &response) {
+			bool ret = response.bSuccess && (bIgnoreNoDataReturned || !response.vResponse.empty());
+			std::string szResponse;
+			if (ret)
+				szResponse.insert(szResponse.begin(), response.vResponse.begin(), response.vResponse.end());
+
+			if (m_bEnableEventSystem && !callback.empty())
+			{
+				m_mainworker.m_eventsystem.TriggerURL(szResponse, response.vHeaderData, callback);
+			}
+
+			if (!ret)
+			{
+				_log.Log(LOG_ERROR, "Error opening url: %s", url.c_str());
+			}
+		});
+}
+
+// Steady clock time at which a task item is due, its delay counts from _DelayTimeBegin
+static std::chrono::steady_clock::time_point GetTaskDueTime(const _tTaskItem &tItem)
+{
+	auto tNow = std::chrono::steady_clock::now();
+	if (!tItem._DelayTime)
+		return tNow;
+	struct timeval tvDiff, tvNow, tvBegin = tItem._DelayTimeBegin;
+	getclock(&tvNow);
+	if (timeval_subtract(&tvDiff, &tvNow, &tvBegin))
+	{
+		tvDiff.tv_sec = 0;
+		tvDiff.tv_usec = 0;
+	}
+	float elapsed = ((tvDiff.tv_usec / 1000000.0F) + tvDiff.tv_sec);
+	return tNow + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(tItem._DelayTime - elapsed));
+}
+
+// Caller must hold m_background_task_mutex
+void CSQLHelper::PushTaskItem(const _tTaskItem &tItem)
+{
+	auto itt = m_background_task_queue.emplace(GetTaskDueTime(tItem), tItem);
+	m_background_task_index.emplace(std::make_pair(tItem._idx, static_cast<int>(tItem._ItemType)), itt);
+	m_bBackgroundTaskWakeup = true;
+	m_background_task_cond.notify_one();
+}
+
+// Caller must hold m_background_task_mutex
+void CSQLHelper::EraseTaskItem(const _tTaskQueue::iterator itt)
+{
+	auto range = m_background_task_index.equal_range(std::make_pair(itt->second._idx, static_cast<int>(itt->second._ItemType)));
+	for (auto ittIndex = range.first; ittIndex != range.second; ++ittIndex)
+	{
+		if (ittIndex->second == itt)
+		{
+			m_background_task_index.erase(ittIndex);
+			break;
+		}
+	}
+	m_background_task_queue.erase(itt);
+}
+
+// Lets Do_Work recalculate when it has to wake up
+void CSQLHelper::WakeBackgroundTask()
+{
+	{
+		std::lock_guard<std::mutex> l(m_background_task_mutex);
+		m_bBackgroundTaskWakeup = true;
+	}
+	m_background_task_cond.notify_one();
+}
+
 void CSQLHelper::Do_Work()
 {
-	while (!IsStopRequested(static_cast<const long>(1000.0F / timer_resolution_hz)))
+	while (!IsStopRequested(0))
 	{
 		std::vector<_tTaskItem> _items2do;
 
-		if (m_bAcceptHardwareTimerActive)
+		auto tCommitDue = CheckGroupCommit();
+		auto tNow = std::chrono::steady_clock::now();
+
+		if ((m_bAcceptHardwareTimerActive) && (tNow >= m_AcceptHardwareTimerEnd))
 		{
-			m_iAcceptHardwareTimerCounter -= static_cast<float>(1. / timer_resolution_hz);
-			if (m_iAcceptHardwareTimerCounter <= (1.0F / timer_resolution_hz / 2))
+			m_bAcceptHardwareTimerActive = false;
+			m_bAcceptNewHardware = m_bPreviousAcceptNewHardware;
+			UpdatePreferencesVar("AcceptNewHardware", (m_bAcceptNewHardware == true) ? 1 : 0);
+			if (!m_bAcceptNewHardware)
 			{
-				m_bAcceptHardwareTimerActive = false;
-				m_bAcceptNewHardware = m_bPreviousAcceptNewHardware;
-				UpdatePreferencesVar("AcceptNewHardware", (m_bAcceptNewHardware == true) ? 1 : 0);
-				if (!m_bAcceptNewHardware)
-				{
-					_log.Log(LOG_STATUS, "Receiving of new sensors disabled!...");
-				}
+				_log.Log(LOG_STATUS, "Receiving of new sensors disabled!...");
 			}
 		}
 
-		{ // additional scope for lock (accessing size should be within lock too)
-			std::lock_guard<std::mutex> l(m_background_task_mutex);
-			if (!m_background_task_queue.empty())
+		{ // additional scope for lock
+			std::unique_lock<std::mutex> l(m_background_task_mutex);
+			while ((!m_background_task_queue.empty()) && (m_background_task_queue.begin()->first <= tNow))
 			{
-				auto itt = m_background_task_queue.begin();
-				while (itt != m_background_task_queue.end())
-				{
-					if (itt->_DelayTime)
-					{
-						struct timeval tvDiff, DelayTimeEnd;
-						getclock(&DelayTimeEnd);
-						if (timeval_subtract(&tvDiff, &DelayTimeEnd, &itt->_DelayTimeBegin)) {
-							tvDiff.tv_sec = 0;
-							tvDiff.tv_usec = 0;
-						}
-						float diff = ((tvDiff.tv_usec / 1000000.0F) + tvDiff.tv_sec);
-						if ((itt->_DelayTime) <= diff)
-						{
-							_items2do.push_back(*itt);
-							itt = m_background_task_queue.erase(itt);
-						}
-						else
-							++itt;
-					}
-					else
-					{
-						_items2do.push_back(*itt);
-						itt = m_background_task_queue.erase(itt);
-					}
-				}
+				_items2do.push_back(m_background_task_queue.begin()->second);
+				EraseTaskItem(m_background_task_queue.begin());
+			}
+			if (_items2do.empty())
+			{
+				// sleep until the next task item, group commit or the end of the new hardware timer
+				auto tWakeup = tCommitDue;
+				if (!m_background_task_queue.empty())
+					tWakeup = std::min(tWakeup, m_background_task_queue.begin()->first);
+				if (m_bAcceptHardwareTimerActive)
+					tWakeup = std::min(tWakeup, m_AcceptHardwareTimerEnd);
+				auto bWakeup = [this] { return m_bBackgroundTaskWakeup || IsStopRequested(0); };
+				if (tWakeup == std::chrono::steady_clock::time_point::max())
+					m_background_task_cond.wait(l, bWakeup);
+				else
+					m_background_task_cond.wait_until(l, tWakeup, bWakeup);
+				m_bBackgroundTaskWakeup = false;
+				continue;
 			}
-		}
-
-		if (_items2do.empty())
-		{
-			continue;
 		}
 
 		for (const auto &itt : _items2do)
@@ -4491,12 +4554,24 @@ void CSQLHelper::Do_Work()
 				eventInfo["data"] = itt._sValue;
 				m_mainworker.m_notificationsystem.Notify(Notification::DZ_CUSTOM, Notification::STATUS_INFO, JSonToRawString(eventInfo));
 			}
-			else if (itt._ItemType == TITEM_EXECUTESHELLCOMMAND || itt._ItemType == TITEM_GETURL || itt._ItemType == TITEM_SEND_EMAIL || itt._ItemType == TITEM_SEND_EMAIL_TO ||
-				 itt._ItemType == TITEM_SEND_SMS || itt._ItemType == TITEM_EMAIL_CAMERA_SNAPSHOT)
+			else if (itt._ItemType == TITEM_GETURL)
+			{
+				// Runs on the HTTP transfer engine, the callback triggers the event system
+				PerformURLRequest(itt);
+			}
+			else if (itt._ItemType == TITEM_EXECUTESHELLCOMMAND)
 			{
-				// All actions which should not be on the main SQL Helper thread will get their own thread
-				std::thread ActionThread([this, itt] { PerformThreadedAction(itt); });
-				ActionThread.detach();
+				// All actions which should not be on the main SQL Helper thread go to the worker pool
+				m_workerpool.Post(CWorkerPool::CATEGORY_SHELL, [this, itt] { PerformThreadedAction(itt); });
+			}
+			else if (itt._ItemType == TITEM_SEND_EMAIL || itt._ItemType == TITEM_SEND_EMAIL_TO || itt._ItemType == TITEM_EMAIL_CAMERA_SNAPSHOT)
+			{
+				m_workerpool.Post(CWorkerPool::CATEGORY_EMAIL, [this, itt] { PerformThreadedAction(itt); });
+			}
+			else if (itt._ItemType == TITEM_SEND_SMS)
+			{
+				// SendMessage sends it on the calling thread
+				m_workerpool.Post(CWorkerPool::CATEGORY_NOTIFICATION, [this, itt] { PerformThreadedAction(itt); });
 			}
 		}
 	}
@@ -4512,6 +4587,175 @@ void CSQLHelper::SetJournalMode(const std::string& mode)
 	m_journal_mode = mode;
 }
 
+void CSQLHelper::SetGroupCommit(const int windowMs, const int maxRows)
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	m_GroupCommitWindowMs = windowMs;
+	m_GroupCommitMaxRows = maxRows;
+}
+
+void CSQLHelper::SetShortLogStore(const bool bEnabled)
+{
+	m_bShortLogStore = bEnabled;
+}
+
+// First keyword of an SQL statement, in upper case
+enum _eStatementKeyword
+{
+	KEYWORD_SELECT = 0,
+	KEYWORD_INSERT,
+	KEYWORD_UPDATE,
+	KEYWORD_DELETE,
+	KEYWORD_REPLACE,
+	KEYWORD_BEGIN,
+	KEYWORD_COMMIT,
+	KEYWORD_PRAGMA,
+	KEYWORD_CREATE,
+	KEYWORD_ALTER,
+	KEYWORD_DROP,
+	KEYWORD_VACUUM,
+	KEYWORD_OTHER,
+	KEYWORD_COUNT
+};
+
+static const char* const StatementKeywords[KEYWORD_COUNT] = { "SELECT", "INSERT", "UPDATE", "DELETE", "REPLACE", "BEGIN", "COMMIT", "PRAGMA", "CREATE", "ALTER", "DROP", "VACUUM", "OTHER" };
+
+static _eStatementKeyword GetStatementKeyword(const char* szQuery)
+{
+	while (isspace(static_cast<unsigned char>(*szQuery)))
+		szQuery++;
+	size_t len = 0;
+	while (isalpha(static_cast<unsigned char>(szQuery[len])))
+		len++;
+	for (int ii = 0; ii < KEYWORD_OTHER; ii++)
+	{
+		const char* szKeyword = StatementKeywords[ii];
+		size_t pos = 0;
+		while ((pos < len) && (szKeyword[pos] == toupper(static_cast<unsigned char>(szQuery[pos]))))
+			pos++;
+		if ((pos == len) && (szKeyword[pos] == '\0'))
+			return static_cast<_eStatementKeyword>(ii);
+	}
+	return KEYWORD_OTHER;
+}
+
+// Series of oikomaticz_sql_query_seconds per connection and statement keyword, looked up on first use
+static CMetrics::CHistogram& GetQueryHistogram(const bool bReader, const char* szQuery)
+{
+	static std::array<std::array<std::atomic<CMetrics::CHistogram*>, KEYWORD_COUNT>, 2> histograms{};
+	_eStatementKeyword keyword = GetStatementKeyword(szQuery);
+	std::atomic<CMetrics::CHistogram*>& slot = histograms[bReader ? 1 : 0][keyword];
+	CMetrics::CHistogram* pHistogram = slot.load(std::memory_order_acquire);
+	if (pHistogram == nullptr)
+	{
+		// GetHistogram returns the same series when two threads get here at once
+		pHistogram = &m_metrics.GetHistogram("oikomaticz_sql_query_seconds",
+						     CMetrics::Label("connection", bReader ? "reader" : "writer") + "," + CMetrics::Label("statement", StatementKeywords[keyword]));
+		slot.store(pHistogram, std::memory_order_release);
+	}
+	return *pHistogram;
+}
+
+// Caller must hold m_sqlQueryMutex
+void CSQLHelper::PrepareWrite(const char* szQuery)
+{
+	if (!m_bGroupCommitActive)
+		return;
+	if (m_bGroupTransactionOpen && sqlite3_get_autocommit(m_dbase))
+	{
+		m_bGroupTransactionOpen = false; // rolled back by an error, nothing left to commit
+		m_devicecache.Clear();
+		m_graphrollups.Clear();
+		m_shortlogstore.InvalidateAll();
+	}
+	_eStatementKeyword keyword = GetStatementKeyword(szQuery);
+	if (keyword == KEYWORD_SELECT)
+		return;
+	if ((keyword != KEYWORD_INSERT) && (keyword != KEYWORD_UPDATE) && (keyword != KEYWORD_DELETE) && (keyword != KEYWORD_REPLACE))
+	{
+		// Transaction control, schema changes, VACUUM, PRAGMA... can not be part of our transaction
+		CommitGroupTransaction();
+		return;
+	}
+	if ((m_GroupCommitWindowMs <= 0) && (m_GroupCommitHold == 0))
+		return;
+	if (!m_bGroupTransactionOpen)
+	{
+		if (!sqlite3_get_autocommit(m_dbase))
+			return; // inside an explicit transaction
+		if (sqlite3_exec(m_dbase, "BEGIN TRANSACTION", nullptr, nullptr, nullptr) != SQLITE_OK)
+			return;
+		m_bGroupTransactionOpen = true;
+		m_GroupTransactionRows = 0;
+		m_GroupTransactionStart = std::chrono::steady_clock::now();
+		// Do_Work commits it when the window has passed
+		WakeBackgroundTask();
+	}
+	m_GroupTransactionRows++;
+}
+
+// Caller must hold m_sqlQueryMutex
+void CSQLHelper::FinishWrite()
+{
+	// also when held, so a held transaction does not grow without bound
+	if ((m_bGroupTransactionOpen) && (m_GroupTransactionRows >= m_GroupCommitMaxRows))
+		CommitGroupTransaction();
+}
+
+// Caller must hold m_sqlQueryMutex
+void CSQLHelper::CommitGroupTransaction()
+{
+	if (!m_bGroupTransactionOpen)
+		return;
+	char* errorMessage = nullptr;
+	if (sqlite3_exec(m_dbase, "COMMIT TRANSACTION", nullptr, nullptr, &errorMessage) != SQLITE_OK)
+	{
+		_log.Log(LOG_ERROR, "SQL: Group commit of %d statements failed: %s", m_GroupTransactionRows, (errorMessage != nullptr) ? errorMessage : "");
+		sqlite3_free(errorMessage);
+		// they may hold rows that were rolled back
+		m_devicecache.Clear();
+		m_graphrollups.Clear();
+		m_shortlogstore.InvalidateAll();
+	}
+	_log.Debug(DEBUG_SQL, "Group commit: %d statements", m_GroupTransactionRows);
+	m_bGroupTransactionOpen = !sqlite3_get_autocommit(m_dbase);
+	if (!m_bGroupTransactionOpen)
+		m_GroupTransactionRows = 0;
+}
+
+// Commits the group transaction when its window has passed, returns when it has to be checked again
+std::chrono::steady_clock::time_point CSQLHelper::CheckGroupCommit()
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (!m_bGroupTransactionOpen)
+		return std::chrono::steady_clock::time_point::max();
+	// a held transaction is committed by ReleaseGroupCommit, unless it stays open for too long
+	auto tNow = std::chrono::steady_clock::now();
+	auto tDue = m_GroupTransactionStart + std::chrono::milliseconds((m_GroupCommitHold != 0) ? std::max(m_GroupCommitWindowMs, GROUP_COMMIT_MAX_HOLD_MS) : m_GroupCommitWindowMs);
+	if (tNow < tDue)
+		return tDue;
+	CommitGroupTransaction();
+	if (m_bGroupTransactionOpen)
+		return tNow + std::chrono::milliseconds(std::max(m_GroupCommitWindowMs, 1)); // the commit failed, try again
+	return std::chrono::steady_clock::time_point::max();
+}
+
+// Collects all writes in one transaction until ReleaseGroupCommit (used by the shortlog/day passes)
+void CSQLHelper::HoldGroupCommit()
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	m_GroupCommitHold++;
+}
+
+void CSQLHelper::ReleaseGroupCommit()
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (m_GroupCommitHold > 0)
+		m_GroupCommitHold--;
+	if (m_GroupCommitHold == 0)
+		CommitGroupTransaction();
+}
+
 bool CSQLHelper::DoesColumnExistsInTable(const std::string& columnname, const std::string& tablename)
 {
 	if (!m_dbase)
@@ -4536,13 +4780,35 @@ void CSQLHelper::safe_exec_no_return(const char* fmt, ...)
 	if (!m_dbase)
 		return;
 
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 	va_list args;
 	va_start(args, fmt);
-	char* zQuery = sqlite3_vmprintf(fmt, args);
+	exec_no_return_v(fmt, args);
+	va_end(args);
+}
+
+// Caller must hold m_sqlQueryMutex
+void CSQLHelper::exec_no_return(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	exec_no_return_v(fmt, args);
 	va_end(args);
+}
+
+// Caller must hold m_sqlQueryMutex
+void CSQLHelper::exec_no_return_v(const char* fmt, va_list args)
+{
+	char* zQuery = sqlite3_vmprintf(fmt, args);
 	if (!zQuery)
+	{
+		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
 		return;
-	sqlite3_exec(m_dbase, zQuery, nullptr, nullptr, nullptr);
+	}
+	PrepareWrite(zQuery);
+	if (sqlite3_exec(m_dbase, zQuery, nullptr, nullptr, nullptr) != SQLITE_OK)
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", zQuery, sqlite3_errmsg(m_dbase));
+	FinishWrite();
 	sqlite3_free(zQuery);
 }
 
@@ -4560,22 +4826,18 @@ bool CSQLHelper::safe_UpdateBlobInTableWithID(const std::string& Table, const st
 		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
 		return false;
 	}
+	PrepareWrite(zQuery);
 	int rc = sqlite3_prepare_v2(m_dbase, zQuery, -1, &stmt, nullptr);
 	sqlite3_free(zQuery);
-	if (rc != SQLITE_OK) {
-		return false;
-	}
-	rc = sqlite3_bind_blob(stmt, 1, BlobData.c_str(), static_cast<int>(BlobData.size()), SQLITE_STATIC);
-	if (rc != SQLITE_OK) {
-		return false;
-	}
-	rc = sqlite3_step(stmt);
-	if (rc != SQLITE_DONE)
-	{
-		return false;
-	}
+	if (rc == SQLITE_OK)
+		rc = sqlite3_bind_blob(stmt, 1, BlobData.c_str(), static_cast<int>(BlobData.size()), SQLITE_STATIC);
+	if (rc == SQLITE_OK)
+		rc = sqlite3_step(stmt);
+	if ((rc != SQLITE_OK) && (rc != SQLITE_DONE))
+		_log.Log(LOG_ERROR, "SQL: Could not update %s.%s of %s: %s", Table.c_str(), Column.c_str(), sID.c_str(), sqlite3_errmsg(m_dbase));
 	sqlite3_finalize(stmt);
-	return true;
+	FinishWrite();
+	return (rc == SQLITE_DONE);
 }
 
 std::vector<std::vector<std::string>> CSQLHelper::safe_query(const char *fmt, ...)
@@ -4613,6 +4875,35 @@ std::vector<std::vector<std::string>> CSQLHelper::unsafe_query(const std::string
 	return query(szQuery);
 }
 
+static void FetchTextRows(sqlite3_stmt* statement, std::vector<std::vector<std::string> >& results)
+{
+	int cols = sqlite3_column_count(statement);
+	while (true)
+	{
+		int result = sqlite3_step(statement);
+		if (result == SQLITE_ROW)
+		{
+			std::vector<std::string> values;
+			for (int col = 0; col < cols; col++)
+			{
+				char* value = (char*)sqlite3_column_text(statement, col);
+				if ((value == nullptr) && (col == 0))
+					break;
+				if (value == nullptr)
+					values.push_back(std::string("")); //insert empty string
+				else
+					values.push_back(value);
+			}
+			if (!values.empty())
+				results.push_back(values);
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
 std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQuery)
 {
 	if (!m_dbase)
@@ -4621,11 +4912,151 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
+	CMetrics::CTimer timer(GetQueryHistogram(false, szQuery.c_str()));
 	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 
 	sqlite3_stmt* statement;
 	std::vector<std::vector<std::string> > results;
     _log.Debug(DEBUG_SQL, "Query:%s", szQuery.c_str());
+	PrepareWrite(szQuery.c_str());
+	if (sqlite3_prepare_v2(m_dbase, szQuery.c_str(), -1, &statement, nullptr) == SQLITE_OK)
+	{
+		FetchTextRows(statement, results);
+		sqlite3_finalize(statement);
+	}
+
+	std::string error = sqlite3_errmsg(m_dbase);
+	if (error != "not an error")
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+	FinishWrite();
+	return results;
+}
+
+std::vector<std::vector<std::string> > CSQLHelper::safe_readonly_query(const char* fmt, ...)
+{
+	va_list args;
+	std::vector<std::vector<std::string> > results;
+	va_start(args, fmt);
+	char* zQuery = sqlite3_vmprintf(fmt, args);
+	va_end(args);
+	if (!zQuery)
+	{
+		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
+		return results;
+	}
+	results = readonly_query(zQuery);
+	sqlite3_free(zQuery);
+	return results;
+}
+
+std::vector<std::vector<std::string> > CSQLHelper::readonly_query(const std::string& szQuery)
+{
+	// Take the first idle reader, or wait for the next one in line when all are busy
+	CMetrics::CTimer timer(GetQueryHistogram(true, szQuery.c_str()));
+	size_t start = m_nextReader++;
+	_tReaderConnection* pReader = nullptr;
+	std::unique_lock<std::mutex> l;
+	for (size_t ii = 0; ii < NUM_READER_CONNECTIONS; ii++)
+	{
+		_tReaderConnection& reader = m_readers[(start + ii) % NUM_READER_CONNECTIONS];
+		std::unique_lock<std::mutex> lr(reader.mutex, std::try_to_lock);
+		if (lr.owns_lock())
+		{
+			pReader = &reader;
+			l = std::move(lr);
+			break;
+		}
+	}
+	if (pReader == nullptr)
+	{
+		pReader = &m_readers[start % NUM_READER_CONNECTIONS];
+		l = std::unique_lock<std::mutex>(pReader->mutex);
+	}
+	if (pReader->dbase == nullptr)
+	{
+		l.unlock();
+		return query(szQuery);
+	}
+
+	sqlite3_stmt* statement;
+	std::vector<std::vector<std::string> > results;
+	_log.Debug(DEBUG_SQL, "Query(ro):%s", szQuery.c_str());
+	if (sqlite3_prepare_v2(pReader->dbase, szQuery.c_str(), -1, &statement, nullptr) == SQLITE_OK)
+	{
+		FetchTextRows(statement, results);
+		sqlite3_finalize(statement);
+	}
+
+	std::string error = sqlite3_errmsg(pReader->dbase);
+	if (error != "not an error")
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+	return results;
+}
+
+void CSQLHelper::OpenReaderConnections()
+{
+	// Readers only run next to the writer without blocking it in WAL mode
+	if (m_journal_mode != "WAL")
+		return;
+	for (auto& reader : m_readers)
+	{
+		std::lock_guard<std::mutex> l(reader.mutex);
+		if (sqlite3_open_v2(m_dbase_name.c_str(), &reader.dbase, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+		{
+			_log.Log(LOG_ERROR, "SQL: Could not open read-only database connection: %s", sqlite3_errmsg(reader.dbase));
+			sqlite3_close(reader.dbase);
+			reader.dbase = nullptr;
+			continue;
+		}
+		sqlite3_busy_timeout(reader.dbase, 1000);
+	}
+}
+
+void CSQLHelper::CloseReaderConnections()
+{
+	for (auto& reader : m_readers)
+	{
+		std::lock_guard<std::mutex> l(reader.mutex);
+		if (reader.dbase != nullptr)
+		{
+			sqlite3_close(reader.dbase);
+			reader.dbase = nullptr;
+		}
+	}
+}
+
+std::vector<std::vector<std::string> > CSQLHelper::safe_queryBlob(const char* fmt, ...)
+{
+	va_list args;
+	std::vector<std::vector<std::string> > results;
+	va_start(args, fmt);
+	char* zQuery = sqlite3_vmprintf(fmt, args);
+	va_end(args);
+	if (!zQuery)
+	{
+		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
+		std::vector<std::vector<std::string> > results;
+		return results;
+	}
+	results = queryBlob(zQuery);
+	sqlite3_free(zQuery);
+	return results;
+}
+
+std::vector<std::vector<std::string> > CSQLHelper::queryBlob(const std::string& szQuery)
+{
+	if (!m_dbase)
+	{
+		_log.Log(LOG_ERROR, "Database not open!!...Check your user rights!..");
+		std::vector<std::vector<std::string> > results;
+		return results;
+	}
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+
+	sqlite3_stmt* statement;
+	std::vector<std::vector<std::string> > results;
+
+	PrepareWrite(szQuery.c_str());
 	if (sqlite3_prepare_v2(m_dbase, szQuery.c_str(), -1, &statement, nullptr) == SQLITE_OK)
 	{
 		int cols = sqlite3_column_count(statement);
@@ -4637,13 +5068,14 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 				std::vector<std::string> values;
 				for (int col = 0; col < cols; col++)
 				{
-					char* value = (char*)sqlite3_column_text(statement, col);
-					if ((value == nullptr) && (col == 0))
+					int blobSize = sqlite3_column_bytes(statement, col);
+					char* value = (char*)sqlite3_column_blob(statement, col);
+					if ((blobSize == 0) && (col == 0))
 						break;
 					if (value == nullptr)
 						values.push_back(std::string("")); //insert empty string
 					else
-						values.push_back(value);
+						values.push_back(std::string(value, value + blobSize));
 				}
 				if (!values.empty())
 					results.push_back(values);
@@ -4659,75 +5091,289 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 	std::string error = sqlite3_errmsg(m_dbase);
 	if (error != "not an error")
 		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+	FinishWrite();
 	return results;
 }
 
-std::vector<std::vector<std::string> > CSQLHelper::safe_queryBlob(const char* fmt, ...)
+CSQLStatement CSQLHelper::PrepareCached(const char* szQuery)
 {
-	va_list args;
-	std::vector<std::vector<std::string> > results;
-	va_start(args, fmt);
-	char* zQuery = sqlite3_vmprintf(fmt, args);
-	va_end(args);
-	if (!zQuery)
+	std::unique_lock<std::mutex> l(m_sqlQueryMutex);
+	if (!m_dbase)
 	{
-		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
-		std::vector<std::vector<std::string> > results;
-		return results;
+		_log.Log(LOG_ERROR, "Database not open!!...Check your user rights!..");
+		return CSQLStatement(std::move(l), nullptr, nullptr);
 	}
-	results = queryBlob(zQuery);
-	sqlite3_free(zQuery);
-	return results;
+	_log.Debug(DEBUG_SQL, "Query:%s", szQuery);
+	PrepareWrite(szQuery);
+
+	auto itt = m_statement_cache.find(szQuery);
+	if (itt != m_statement_cache.end())
+		return CSQLStatement(std::move(l), m_dbase, itt->second);
+
+	sqlite3_stmt* statement = nullptr;
+	if (sqlite3_prepare_v2(m_dbase, szQuery, -1, &statement, nullptr) != SQLITE_OK)
+	{
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery, sqlite3_errmsg(m_dbase));
+		return CSQLStatement(std::move(l), m_dbase, nullptr);
+	}
+	m_statement_cache[szQuery] = statement;
+	return CSQLStatement(std::move(l), m_dbase, statement);
 }
 
-std::vector<std::vector<std::string> > CSQLHelper::queryBlob(const std::string& szQuery)
+// Caller must hold m_sqlQueryMutex (or be the only user of the database)
+void CSQLHelper::ClearStatementCache()
 {
-	if (!m_dbase)
+	for (auto& itt : m_statement_cache)
+		sqlite3_finalize(itt.second);
+	m_statement_cache.clear();
+}
+
+// Row that the current thread is writing through to m_devicecache (no need to invalidate it)
+static thread_local uint64_t t_DeviceStatusWriteThroughID = 0;
+// Set while the current thread changes short log rows that it applies to m_graphrollups and m_shortlogstore itself
+static thread_local bool t_ShortLogWriteThrough = false;
+// Devices whose short log rows the current thread changes otherwise, only these are invalidated by the update hook
+static thread_local uint64_t t_ShortLogDevices[2] = { 0, 0 };
+
+// Sets t_ShortLogDevices for its lifetime
+class CShortLogDeviceChange
+{
+public:
+	explicit CShortLogDeviceChange(const uint64_t idx1, const uint64_t idx2 = 0)
+		: m_prev{ t_ShortLogDevices[0], t_ShortLogDevices[1] }
 	{
-		_log.Log(LOG_ERROR, "Database not open!!...Check your user rights!..");
-		std::vector<std::vector<std::string> > results;
-		return results;
+		t_ShortLogDevices[0] = idx1;
+		t_ShortLogDevices[1] = idx2;
 	}
-	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	~CShortLogDeviceChange()
+	{
+		t_ShortLogDevices[0] = m_prev[0];
+		t_ShortLogDevices[1] = m_prev[1];
+	}
+
+private:
+	uint64_t m_prev[2];
+};
+
+// A value as the database stores it after formatting it with szFormat
+static double AsStored(const char* szFormat, const double value)
+{
+	char szTmp[40];
+	snprintf(szTmp, sizeof(szTmp), szFormat, value);
+	return atof(szTmp);
+}
+
+void CSQLHelper::OnDatabaseUpdate(void* pUser, int /*operation*/, const char* /*szDatabase*/, const char* szTable, long long rowid)
+{
+	CSQLHelper* pThis = static_cast<CSQLHelper*>(pUser);
+	if (strcmp(szTable, "DeviceStatus") != 0)
+	{
+		if (t_ShortLogWriteThrough)
+			return;
+		CGraphRollups::_eTable table = CGraphRollups::GetTable(szTable);
+		CTimeSeriesStore::_eTable stable = CTimeSeriesStore::GetTable(szTable);
+		if (t_ShortLogDevices[0] == 0)
+		{
+			// the changed device is not known
+			if (table != CGraphRollups::TABLE_COUNT)
+				pThis->m_graphrollups.Invalidate(table);
+			if (stable != CTimeSeriesStore::TABLE_COUNT)
+				pThis->m_shortlogstore.Invalidate(stable);
+			return;
+		}
+		for (const auto idx : t_ShortLogDevices)
+		{
+			if (idx == 0)
+				continue;
+			if (table != CGraphRollups::TABLE_COUNT)
+				pThis->m_graphrollups.Invalidate(table, idx);
+			if (stable != CTimeSeriesStore::TABLE_COUNT)
+				pThis->m_shortlogstore.InvalidateDevice(stable, idx);
+		}
+		return;
+	}
+	if (static_cast<uint64_t>(rowid) == t_DeviceStatusWriteThroughID)
+		return;
+	pThis->m_devicecache.Invalidate(static_cast<uint64_t>(rowid));
+}
+
+bool CSQLHelper::GetCachedDeviceStatus(const int HardwareID, const char* ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, _tDeviceStatusEntry& entry)
+{
+	CDeviceStatusCache::_tKey key{ HardwareID, ID, unit, devType, subType };
+	if (m_devicecache.Get(key, entry))
+		return true;
+
+	uint64_t generation = m_devicecache.GetGeneration();
+	int rows = 0;
+	{
+		auto stmt = prepared_query("SELECT ID, OrgHardwareID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options, AddjValue, AddjMulti, AddjValue2, AddjMulti2 "
+					   "FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?) LIMIT 2",
+					   HardwareID, ID, unit, devType, subType);
+		while (stmt.Step())
+		{
+			if (++rows > 1)
+				break;
+			entry.ID = static_cast<uint64_t>(stmt.GetInt64(0));
+			entry.OrgHardwareID = stmt.GetInt(1);
+			entry.Name = stmt.GetString(2);
+			entry.Used = (stmt.GetInt(3) != 0);
+			entry.SwitchType = stmt.GetInt(4);
+			entry.nValue = stmt.GetInt(5);
+			entry.sValue = stmt.GetString(6);
+			entry.LastUpdate = stmt.GetString(7);
+			entry.Options = BuildDeviceOptions(stmt.GetString(8));
+			entry.AddjValue = static_cast<float>(stmt.GetDouble(9));
+			entry.AddjMulti = static_cast<float>(stmt.GetDouble(10));
+			entry.AddjValue2 = static_cast<float>(stmt.GetDouble(11));
+			entry.AddjMulti2 = static_cast<float>(stmt.GetDouble(12));
+		}
+	}
+	// Devices that only differ in OrgHardwareID are left to the callers' own queries
+	if (rows != 1)
+		return false;
+	m_devicecache.Insert(key, entry, generation);
+	return true;
+}
+
+bool CSQLHelper::GetDeviceValue(const uint64_t ID, std::string& Name, int& nValue, std::string& sValue, std::string& LastUpdate)
+{
+	_tDeviceStatusEntry entry;
+	if (m_devicecache.GetByRowID(ID, entry))
+	{
+		Name = entry.Name;
+		nValue = entry.nValue;
+		sValue = entry.sValue;
+		LastUpdate = entry.LastUpdate;
+		return true;
+	}
+	auto stmt = prepared_query("SELECT Name, nValue, sValue, LastUpdate FROM DeviceStatus WHERE (ID=?)", ID);
+	if (!stmt.Step())
+		return false;
+	Name = stmt.GetString(0);
+	nValue = stmt.GetInt(1);
+	sValue = stmt.GetString(2);
+	LastUpdate = stmt.GetString(3);
+	return true;
+}
+
+CSQLStatement::CSQLStatement(std::unique_lock<std::mutex>&& lock, sqlite3* dbase, sqlite3_stmt* stmt)
+	: m_lock(std::move(lock))
+	, m_dbase(dbase)
+	, m_stmt(stmt)
+{
+}
+
+CSQLStatement::CSQLStatement(CSQLStatement&& other) noexcept
+	: m_lock(std::move(other.m_lock))
+	, m_dbase(other.m_dbase)
+	, m_stmt(other.m_stmt)
+	, m_bindIndex(other.m_bindIndex)
+	, m_lastResult(other.m_lastResult)
+	, m_bStepped(other.m_bStepped)
+	, m_elapsed(other.m_elapsed)
+{
+	other.m_stmt = nullptr;
+}
+
+CSQLStatement::~CSQLStatement()
+{
+	if (m_stmt == nullptr)
+		return;
+	// one observation per use of the statement, like query()
+	if (m_bStepped)
+		GetQueryHistogram(false, sqlite3_sql(m_stmt)).Record(m_elapsed);
+	// Statement stays in the cache, make it ready for the next user
+	sqlite3_reset(m_stmt);
+	sqlite3_clear_bindings(m_stmt);
+}
+
+void CSQLStatement::Bind(const int nValue)
+{
+	sqlite3_bind_int(m_stmt, ++m_bindIndex, nValue);
+}
+
+void CSQLStatement::Bind(const int64_t nValue)
+{
+	sqlite3_bind_int64(m_stmt, ++m_bindIndex, nValue);
+}
+
+void CSQLStatement::Bind(const uint64_t nValue)
+{
+	sqlite3_bind_int64(m_stmt, ++m_bindIndex, static_cast<sqlite3_int64>(nValue));
+}
+
+void CSQLStatement::Bind(const double dValue)
+{
+	sqlite3_bind_double(m_stmt, ++m_bindIndex, dValue);
+}
+
+void CSQLStatement::Bind(const char* szValue)
+{
+	sqlite3_bind_text(m_stmt, ++m_bindIndex, szValue, -1, SQLITE_TRANSIENT);
+}
+
+void CSQLStatement::Bind(const std::string& sValue)
+{
+	sqlite3_bind_text(m_stmt, ++m_bindIndex, sValue.c_str(), static_cast<int>(sValue.size()), SQLITE_TRANSIENT);
+}
+
+bool CSQLStatement::Step()
+{
+	if (m_stmt == nullptr)
+		return false;
+	auto tStart = std::chrono::steady_clock::now();
+	m_lastResult = sqlite3_step(m_stmt);
+	m_elapsed += std::chrono::steady_clock::now() - tStart;
+	m_bStepped = true;
+	if (m_lastResult == SQLITE_ROW)
+		return true;
+	if (m_lastResult != SQLITE_DONE)
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", sqlite3_sql(m_stmt), sqlite3_errmsg(m_dbase));
+	return false;
+}
+
+int CSQLStatement::Execute()
+{
+	if (m_stmt == nullptr)
+		return -1;
+	while (Step())
+		;
+	if (m_lastResult != SQLITE_DONE)
+		return -1;
+	return sqlite3_changes(m_dbase);
+}
+
+int CSQLStatement::ColumnCount() const
+{
+	return (m_stmt != nullptr) ? sqlite3_column_count(m_stmt) : 0;
+}
+
+bool CSQLStatement::IsNull(const int col) const
+{
+	return (sqlite3_column_type(m_stmt, col) == SQLITE_NULL);
+}
+
+int CSQLStatement::GetInt(const int col) const
+{
+	return sqlite3_column_int(m_stmt, col);
+}
 
-	sqlite3_stmt* statement;
-	std::vector<std::vector<std::string> > results;
+int64_t CSQLStatement::GetInt64(const int col) const
+{
+	return sqlite3_column_int64(m_stmt, col);
+}
 
-	if (sqlite3_prepare_v2(m_dbase, szQuery.c_str(), -1, &statement, nullptr) == SQLITE_OK)
-	{
-		int cols = sqlite3_column_count(statement);
-		while (true)
-		{
-			int result = sqlite3_step(statement);
-			if (result == SQLITE_ROW)
-			{
-				std::vector<std::string> values;
-				for (int col = 0; col < cols; col++)
-				{
-					int blobSize = sqlite3_column_bytes(statement, col);
-					char* value = (char*)sqlite3_column_blob(statement, col);
-					if ((blobSize == 0) && (col == 0))
-						break;
-					if (value == nullptr)
-						values.push_back(std::string("")); //insert empty string
-					else
-						values.push_back(std::string(value, value + blobSize));
-				}
-				if (!values.empty())
-					results.push_back(values);
-			}
-			else
-			{
-				break;
-			}
-		}
-		sqlite3_finalize(statement);
-	}
+double CSQLStatement::GetDouble(const int col) const
+{
+	return sqlite3_column_double(m_stmt, col);
+}
 
-	std::string error = sqlite3_errmsg(m_dbase);
-	if (error != "not an error")
-		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
-	return results;
+std::string_view CSQLStatement::GetText(const int col) const
+{
+	const char* value = reinterpret_cast<const char*>(sqlite3_column_text(m_stmt, col));
+	if (value == nullptr)
+		return std::string_view();
+	return std::string_view(value, sqlite3_column_bytes(m_stmt, col));
 }
 
 uint64_t CSQLHelper::CreateDevice(const int HardwareID, const int SensorType, const int SensorSubType, std::string &devname, const unsigned long nid, const std::string &soptions,
@@ -5287,12 +5933,11 @@ uint64_t CSQLHelper::InsertDevice(const int HardwareID, const int OrgHardwareID,
 }
 
 uint64_t CSQLHelper::GetDeviceIndex(const int HardwareID, const int OrgHardwareID, const std::string& ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, std::string& devname) {
-	std::vector<std::vector<std::string> > result;
-	result = safe_query("SELECT ID, Name FROM DeviceStatus WHERE (HardwareID=%d AND OrgHardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)", HardwareID, OrgHardwareID, ID.c_str(), unit, devType, subType);
-	if (result.empty())
+	auto stmt = prepared_query("SELECT ID, Name FROM DeviceStatus WHERE (HardwareID=? AND OrgHardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)", HardwareID, OrgHardwareID, ID, unit, devType, subType);
+	if (!stmt.Step())
 		return -1;
-	devname = result[0].at(1);
-	return std::stoull(result[0].at(0));
+	devname = stmt.GetString(1);
+	return static_cast<uint64_t>(stmt.GetInt64(0));
 }
 
 uint64_t CSQLHelper::UpdateManagedValueInt(
@@ -5439,14 +6084,46 @@ uint64_t CSQLHelper::UpdateValueInt(
 
 	bool bIsManagedCounter = (devType == pTypeGeneral && subType == sTypeManagedCounter);
 
-	std::vector<std::vector<std::string> > result;
-	result = safe_query("SELECT ID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options FROM DeviceStatus WHERE (HardwareID=%d AND OrgHardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)", HardwareID, OrgHardwareID, ID, unit, devType, subType);
-
-	if (!result.empty())
+	bool bDeviceExists = false;
+	bool bDeviceUsed = false;
+	bool bSameDeviceStatusValue = false;
+	int nValueBeforeUpdate = -1;
+	std::string sValueBeforeUpdate;
+	std::string sLastUpdateBeforeUpdate;
+	device::tswitch::type::value stype = device::tswitch::type::OnOff;
+	_tDeviceStatusEntry cached;
+	if (GetCachedDeviceStatus(HardwareID, ID, unit, devType, subType, cached) && (cached.OrgHardwareID == OrgHardwareID))
+	{
+		bDeviceExists = true;
+		ulID = cached.ID;
+		devname = cached.Name;
+		bDeviceUsed = cached.Used;
+		stype = (device::tswitch::type::value)cached.SwitchType;
+		nValueBeforeUpdate = cached.nValue;
+		sValueBeforeUpdate = cached.sValue;
+		sLastUpdateBeforeUpdate = cached.LastUpdate;
+		options = cached.Options;
+	}
+	else
 	{
-		std::string sOption = result[0][7];
-		options = BuildDeviceOptions(sOption);
+		auto stmt = prepared_query("SELECT ID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options FROM DeviceStatus WHERE (HardwareID=? AND OrgHardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)",
+					   HardwareID, OrgHardwareID, ID, unit, devType, subType);
+		if (stmt.Step())
+		{
+			bDeviceExists = true;
+			ulID = static_cast<uint64_t>(stmt.GetInt64(0));
+			devname = stmt.GetString(1);
+			bDeviceUsed = (stmt.GetInt(2) != 0);
+			stype = (device::tswitch::type::value)stmt.GetInt(3);
+			nValueBeforeUpdate = stmt.GetInt(4);
+			sValueBeforeUpdate = stmt.GetString(5);
+			sLastUpdateBeforeUpdate = stmt.GetString(6);
+			options = BuildDeviceOptions(stmt.GetString(7));
+		}
+	}
 
+	if (bDeviceExists)
+	{
 		if (options["AddDBLogEntry"] == "true")
 		{
 			bIsManagedCounter = true;
@@ -5455,14 +6132,9 @@ uint64_t CSQLHelper::UpdateValueInt(
 	if (bIsManagedCounter)
 		return UpdateManagedValueInt(HardwareID, OrgHardwareID, ID, unit, devType, subType, signallevel, batterylevel, nValue, sValue, devname, bUseOnOffAction, User);
 
+	std::vector<std::vector<std::string> > result;
 
-	bool bDeviceUsed = false;
-	bool bSameDeviceStatusValue = false;
-	int nValueBeforeUpdate = -1;
-	std::string sValueBeforeUpdate;
-	device::tswitch::type::value stype = device::tswitch::type::OnOff;
-
-	if (result.empty())
+	if (!bDeviceExists)
 	{
 		//Insert
 		ulID = InsertDevice(HardwareID, OrgHardwareID, ID, unit, devType, subType, 0, nValue, sValue, devname, signallevel, batterylevel);
@@ -5485,13 +6157,6 @@ uint64_t CSQLHelper::UpdateValueInt(
 	else
 	{
 		//Update
-		ulID = std::stoull(result[0][0]);
-		devname = result[0][1];
-		bDeviceUsed = atoi(result[0][2].c_str()) != 0;
-		stype = (device::tswitch::type::value)atoi(result[0][3].c_str());
-		nValueBeforeUpdate = atoi(result[0][4].c_str());
-		sValueBeforeUpdate = result[0][5];
-
 		std::string sLastUpdate = TimeToString(nullptr, TF_DateTime);
 
 		//Commit: If Option 1: energy is computed as usage*time
@@ -5500,7 +6165,7 @@ uint64_t CSQLHelper::UpdateValueInt(
 		{
             double intervalSeconds;
             struct tm ntime;
-			std::string sLastUpdate = result[0][6];
+			std::string sLastUpdate = sLastUpdateBeforeUpdate;
 
 			time_t now = time(nullptr);
 			struct tm ltime;
@@ -5569,6 +6234,7 @@ uint64_t CSQLHelper::UpdateValueInt(
 					);
 			}
 
+			t_DeviceStatusWriteThroughID = ulID;
 			result = safe_query(
 				"UPDATE DeviceStatus SET SignalLevel=%d, BatteryLevel=%d, nValue=%d, sValue='%q', LastUpdate='%q' "
 				"WHERE (ID = %" PRIu64 ")",
@@ -5576,6 +6242,8 @@ uint64_t CSQLHelper::UpdateValueInt(
 				nValue, sValue,
 				sLastUpdate.c_str(),
 				ulID);
+			t_DeviceStatusWriteThroughID = 0;
+			m_devicecache.UpdateValue(ulID, nValue, sValue, sLastUpdate);
 		}
 	}
 
@@ -5623,8 +6291,11 @@ uint64_t CSQLHelper::UpdateValueInt(
 	case pTypeHoneywell_AL:
 		if ((devType == pTypeRadiator1) && (subType != sTypeSmartwaresSwitchRadiator))
 			break;
-		m_LastSwitchID = ID;
-		m_LastSwitchRowID = ulID;
+		{
+			std::lock_guard<std::mutex> l(m_LastSwitchMutex);
+			m_LastSwitchID = ID;
+			m_LastSwitchRowID = ulID;
+		}
 
 		//Add Lighting log (Skip duplicates)
 		if (
@@ -5764,7 +6435,7 @@ uint64_t CSQLHelper::UpdateValueInt(
 					s_scriptparams << nszUserDataFolder << " " << HardwareID << " " << ulID << " " << (bIsLightSwitchOn ? "On" : "Off") << " \"" << lstatus << "\"" << " \"" << devname << "\"";
 					//add script to background worker
 					std::lock_guard<std::mutex> l(m_background_task_mutex);
-					m_background_task_queue.push_back(_tTaskItem::ExecuteScript(1, scriptname, s_scriptparams.str()));
+					PushTaskItem(_tTaskItem::ExecuteScript(1, scriptname, s_scriptparams.str()));
 				}
 			}
 
@@ -5864,23 +6535,21 @@ uint64_t CSQLHelper::UpdateValueInt(
 						_tTaskItem tItem = _tTaskItem::SwitchLight(AddjValue, ulID, HardwareID, ID, unit, devType, subType, switchtype, signallevel, batterylevel, cmd, sValue, (User != nullptr) ? std::string(User) : "");
 						//Remove all instances with this device from the queue first
 						//otherwise command will be send twice, and first one will be to soon as it is currently counting
-						auto itt = m_background_task_queue.begin();
-						while (itt != m_background_task_queue.end())
+						auto range = m_background_task_index.equal_range(std::make_pair(ulID, static_cast<int>(TITEM_SWITCHCMD)));
+						auto ittIndex = range.first;
+						while (ittIndex != range.second)
 						{
+							auto itt = (ittIndex++)->second;
 							if (
-								(itt->_ItemType == TITEM_SWITCHCMD) &&
-								(itt->_idx == ulID) &&
-								(itt->_HardwareID == HardwareID) &&
-								(itt->_nValue == cmd)
+								(itt->second._HardwareID == HardwareID) &&
+								(itt->second._nValue == cmd)
 								)
 							{
-								itt = m_background_task_queue.erase(itt);
+								EraseTaskItem(itt);
 							}
-							else
-								++itt;
 						}
 						//finally add it to the queue
-						m_background_task_queue.push_back(tItem);
+						PushTaskItem(tItem);
 					}
 				}
 			}
@@ -5927,24 +6596,33 @@ bool CSQLHelper::UpdateLastUpdate(const int64_t idx)
 bool CSQLHelper::GetLastValue(const int HardwareID, const char* DeviceID, const unsigned char unit, const unsigned char devType, const unsigned char subType, int& nValue, std::string& sValue, struct tm& LastUpdateTime)
 {
 	bool result = false;
-	std::vector<std::vector<std::string> > sqlresult;
 	std::string sLastUpdate;
-	//std::string sValue;
-	//struct tm LastUpdateTime;
-	sqlresult = safe_query(
-		"SELECT nValue,sValue,LastUpdate FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d) order by LastUpdate desc limit 1",
-		HardwareID, DeviceID, unit, devType, subType);
-
-	if (!sqlresult.empty())
+	_tDeviceStatusEntry cached;
+	if (GetCachedDeviceStatus(HardwareID, DeviceID, unit, devType, subType, cached))
+	{
+		nValue = cached.nValue;
+		sValue = cached.sValue;
+		sLastUpdate = cached.LastUpdate;
+		result = true;
+	}
+	else
 	{
-		nValue = (int)atoi(sqlresult[0][0].c_str());
-		sValue = sqlresult[0][1];
-		sLastUpdate = sqlresult[0][2];
+		auto stmt = prepared_query(
+			"SELECT nValue,sValue,LastUpdate FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?) order by LastUpdate desc limit 1",
+			HardwareID, DeviceID, unit, devType, subType);
+		if (stmt.Step())
+		{
+			nValue = stmt.GetInt(0);
+			sValue = stmt.GetString(1);
+			sLastUpdate = stmt.GetString(2);
+			result = true;
+		}
+	}
 
+	if (result)
+	{
 		time_t lutime;
 		ParseSQLdatetime(lutime, LastUpdateTime, sLastUpdate);
-
-		result = true;
 	}
 
 	return result;
@@ -5954,27 +6632,38 @@ void CSQLHelper::GetAddjustment(const int HardwareID, const char* ID, const unsi
 {
 	AddjValue = 0.0F;
 	AddjMulti = 1.0F;
-	std::vector<std::vector<std::string> > result;
-	result = safe_query(
-		"SELECT AddjValue,AddjMulti FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)",
+	_tDeviceStatusEntry cached;
+	if (GetCachedDeviceStatus(HardwareID, ID, unit, devType, subType, cached))
+	{
+		AddjValue = cached.AddjValue;
+		AddjMulti = cached.AddjMulti;
+		return;
+	}
+	auto stmt = prepared_query(
+		"SELECT AddjValue,AddjMulti FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)",
 		HardwareID, ID, unit, devType, subType);
-	if (!result.empty())
+	if (stmt.Step())
 	{
-		AddjValue = static_cast<float>(atof(result[0][0].c_str()));
-		AddjMulti = static_cast<float>(atof(result[0][1].c_str()));
+		AddjValue = static_cast<float>(stmt.GetDouble(0));
+		AddjMulti = static_cast<float>(stmt.GetDouble(1));
 	}
 }
 
 void CSQLHelper::GetMeterType(const int HardwareID, const char* ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, int& meterType)
 {
 	meterType = 0;
-	std::vector<std::vector<std::string> > result;
-	result = safe_query(
-		"SELECT SwitchType FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)",
+	_tDeviceStatusEntry cached;
+	if (GetCachedDeviceStatus(HardwareID, ID, unit, devType, subType, cached))
+	{
+		meterType = cached.SwitchType;
+		return;
+	}
+	auto stmt = prepared_query(
+		"SELECT SwitchType FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)",
 		HardwareID, ID, unit, devType, subType);
-	if (!result.empty())
+	if (stmt.Step())
 	{
-		meterType = atoi(result[0][0].c_str());
+		meterType = stmt.GetInt(0);
 	}
 }
 
@@ -5982,14 +6671,20 @@ void CSQLHelper::GetAddjustment2(const int HardwareID, const char* ID, const uns
 {
 	AddjValue = 0.0F;
 	AddjMulti = 1.0F;
-	std::vector<std::vector<std::string> > result;
-	result = safe_query(
-		"SELECT AddjValue2,AddjMulti2 FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)",
+	_tDeviceStatusEntry cached;
+	if (GetCachedDeviceStatus(HardwareID, ID, unit, devType, subType, cached))
+	{
+		AddjValue = cached.AddjValue2;
+		AddjMulti = cached.AddjMulti2;
+		return;
+	}
+	auto stmt = prepared_query(
+		"SELECT AddjValue2,AddjMulti2 FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)",
 		HardwareID, ID, unit, devType, subType);
-	if (!result.empty())
+	if (stmt.Step())
 	{
-		AddjValue = static_cast<float>(atof(result[0][0].c_str()));
-		AddjMulti = static_cast<float>(atof(result[0][1].c_str()));
+		AddjValue = static_cast<float>(stmt.GetDouble(0));
+		AddjMulti = static_cast<float>(stmt.GetDouble(1));
 	}
 }
 
@@ -6201,6 +6896,11 @@ void CSQLHelper::ScheduleShortlog()
 	if (!m_dbase)
 		return;
 
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+	}
+	HoldGroupCommit();
 	try
 	{
 		//Force WAL flush
@@ -6228,8 +6928,8 @@ void CSQLHelper::ScheduleShortlog()
 #else
 		(void)e;
 #endif
-		return;
 	}
+	ReleaseGroupCommit();
 }
 
 void CSQLHelper::ScheduleDay()
@@ -6237,6 +6937,11 @@ void CSQLHelper::ScheduleDay()
 	if (!m_dbase)
 		return;
 
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+	}
+	HoldGroupCommit();
 	try
 	{
 		//Force WAL flush
@@ -6262,8 +6967,8 @@ void CSQLHelper::ScheduleDay()
 #else
 		(void)e;
 #endif
-		return;
 	}
+	ReleaseGroupCommit();
 }
 
 void CSQLHelper::UpdateTemperatureLog()
@@ -6273,6 +6978,7 @@ void CSQLHelper::UpdateTemperatureLog()
 		return;
 	struct tm tm1;
 	localtime_r(&now, &tm1);
+	std::string szDateNow = TimeToString(&now, TF_DateTime);
 
 	int SensorTimeOut = 60;
 	GetPreferencesVar("SensorTimeout", SensorTimeOut);
@@ -6436,17 +7142,26 @@ void CSQLHelper::UpdateTemperatureLog()
 				break;
 			}
 			//insert record
+			m_graphrollups.BeginRow();
+			t_ShortLogWriteThrough = true;
 			safe_query(
-				"INSERT INTO Temperature (DeviceRowID, Temperature, Chill, Humidity, Barometer, DewPoint, SetPoint) "
-				"VALUES ('%" PRIu64 "', '%.2f', '%.2f', '%d', '%d', '%.2f', '%.2f')",
+				"INSERT INTO Temperature (DeviceRowID, Temperature, Chill, Humidity, Barometer, DewPoint, SetPoint, Date) "
+				"VALUES ('%" PRIu64 "', '%.2f', '%.2f', '%d', '%d', '%.2f', '%.2f', '%q')",
 				ID,
 				temp,
 				chill,
 				humidity,
 				barometer,
 				dewpoint,
-				setpoint
+				setpoint,
+				szDateNow.c_str()
 			);
+			t_ShortLogWriteThrough = false;
+			m_graphrollups.AddRow(CGraphRollups::TABLE_TEMPERATURE, ID, szDateNow,
+				{ std::round(temp * 100.0) / 100.0, std::round(chill * 100.0) / 100.0, double(humidity), double(barometer), std::round(setpoint * 100.0) / 100.0,
+				  std::round(dewpoint * 100.0) / 100.0 }, 0);
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_TEMPERATURE, ID, now,
+				{ AsStored("%.2f", temp), AsStored("%.2f", chill), double(humidity), double(barometer), AsStored("%.2f", dewpoint), AsStored("%.2f", setpoint) });
 		}
 	}
 }
@@ -6497,6 +7212,7 @@ void CSQLHelper::UpdateRainLog()
 			float total = static_cast<float>(atof(splitresults[1].c_str()));
 
 			//insert record
+			t_ShortLogWriteThrough = true;
 			safe_query(
 				"INSERT INTO Rain (DeviceRowID, Total, Rate) "
 				"VALUES ('%" PRIu64 "', '%.2f', '%d')",
@@ -6504,6 +7220,8 @@ void CSQLHelper::UpdateRainLog()
 				total,
 				rate
 			);
+			t_ShortLogWriteThrough = false;
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_RAIN, ID, now, { AsStored("%.2f", total), double(rate) });
 		}
 	}
 }
@@ -6560,6 +7278,7 @@ void CSQLHelper::UpdateWindLog()
 			int speed = atoi(splitresults[2].c_str());
 			int gust = atoi(splitresults[3].c_str());
 
+			std::unique_lock<std::mutex> lCalc(m_mainworker.m_calculatormutex);
 			auto ittWC = m_mainworker.m_wind_calculator.find(DeviceID);
 			if (ittWC != m_mainworker.m_wind_calculator.end())
 			{
@@ -6570,8 +7289,10 @@ void CSQLHelper::UpdateWindLog()
 				if (gust_max != -1)
 					gust = gust_max;
 			}
+			lCalc.unlock();
 
 			//insert record
+			t_ShortLogWriteThrough = true;
 			safe_query(
 				"INSERT INTO Wind (DeviceRowID, Direction, Speed, Gust) "
 				"VALUES ('%" PRIu64 "', '%.2f', '%d', '%d')",
@@ -6580,6 +7301,8 @@ void CSQLHelper::UpdateWindLog()
 				speed,
 				gust
 			);
+			t_ShortLogWriteThrough = false;
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_WIND, ID, now, { AsStored("%.2f", direction), double(speed), double(gust) });
 		}
 	}
 }
@@ -6632,12 +7355,15 @@ void CSQLHelper::UpdateUVLog()
 			float level = static_cast<float>(atof(splitresults[0].c_str()));
 
 			//insert record
+			t_ShortLogWriteThrough = true;
 			safe_query(
 				"INSERT INTO UV (DeviceRowID, Level) "
 				"VALUES ('%" PRIu64 "', '%g')",
 				ID,
 				level
 			);
+			t_ShortLogWriteThrough = false;
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_UV, ID, now, { AsStored("%g", level) });
 		}
 	}
 }
@@ -6698,6 +7424,7 @@ bool CSQLHelper::UpdateCalendarMeter(
 			_log.Log(LOG_ERROR, "UpdateCalendarMeter(): incorrect date time format received, YYYY-MM-DD HH:mm:ss expected!");
 			return false;
 		}
+		CShortLogDeviceChange change(DeviceRowID);
 
 		//insert or replace record
 		if (multiMeter) {
@@ -6870,6 +7597,7 @@ void CSQLHelper::UpdateMeter()
 		return;
 	struct tm tm1;
 	localtime_r(&now, &tm1);
+	std::string szDateNow = TimeToString(&now, TF_DateTime);
 
 	char szDateStart[40], szDateEnd[40];
 	sprintf(szDateStart, "%04d-%02d-%02d", tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday);
@@ -7187,14 +7915,20 @@ void CSQLHelper::UpdateMeter()
 			}
 
 			//insert record
+			m_graphrollups.BeginRow();
+			t_ShortLogWriteThrough = true;
 			safe_query(
-				"INSERT INTO Meter (DeviceRowID, Value, [Usage], Price) "
-				"VALUES ('%" PRIu64 "', '%" PRId64 "', '%" PRId64 "', '%.4f')",
+				"INSERT INTO Meter (DeviceRowID, Value, [Usage], Price, Date) "
+				"VALUES ('%" PRIu64 "', '%" PRId64 "', '%" PRId64 "', '%.4f', '%q')",
 				ID,
 				MeterValue,
 				MeterUsage,
-				price
+				price,
+				szDateNow.c_str()
 			);
+			t_ShortLogWriteThrough = false;
+			m_graphrollups.AddRow(CGraphRollups::TABLE_METER, ID, szDateNow, { double(MeterValue), double(MeterUsage) }, std::round(price * 10000.0) / 10000.0);
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_METER, ID, now, { double(MeterValue), double(MeterUsage), AsStored("%.4f", price) });
 
 			if (
 				(dType != pTypeAirQuality) &&
@@ -7236,6 +7970,7 @@ void CSQLHelper::UpdateMultiMeter()
 		return;
 	struct tm tm1;
 	localtime_r(&now, &tm1);
+	std::string szDateNow = TimeToString(&now, TF_DateTime);
 
 	char szDateStart[40], szDateEnd[40];
 	sprintf(szDateStart, "%04d-%02d-%02d", tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday);
@@ -7358,9 +8093,11 @@ void CSQLHelper::UpdateMultiMeter()
 				continue;//don't know you (yet)
 
 			//insert record
+			m_graphrollups.BeginRow();
+			t_ShortLogWriteThrough = true;
 			safe_query(
-				"INSERT INTO MultiMeter (DeviceRowID, Value1, Value2, Value3, Value4, Value5, Value6, Price) "
-				"VALUES ('%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%.4f')",
+				"INSERT INTO MultiMeter (DeviceRowID, Value1, Value2, Value3, Value4, Value5, Value6, Price, Date) "
+				"VALUES ('%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%" PRIu64 "', '%.4f', '%q')",
 				ID,
 				value1,
 				value2,
@@ -7368,8 +8105,14 @@ void CSQLHelper::UpdateMultiMeter()
 				value4,
 				value5,
 				value6,
-				price
+				price,
+				szDateNow.c_str()
 			);
+			t_ShortLogWriteThrough = false;
+			m_graphrollups.AddRow(CGraphRollups::TABLE_MULTIMETER, ID, szDateNow,
+				{ double(value1), double(value2), double(value3), double(value4), double(value5), double(value6) }, std::round(price * 10000.0) / 10000.0);
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_MULTIMETER, ID, now,
+				{ double(value1), double(value2), double(value3), double(value4), double(value5), double(value6), AsStored("%.4f", price) });
 
 			if (dType == pTypeP1Power)
 			{
@@ -7433,12 +8176,15 @@ void CSQLHelper::UpdatePercentageLog()
 			float percentage = static_cast<float>(atof(sValue.c_str()));
 
 			//insert record
+			t_ShortLogWriteThrough = true;
 			safe_query(
 				"INSERT INTO Percentage (DeviceRowID, Percentage) "
 				"VALUES ('%" PRIu64 "', '%g')",
 				ID,
 				percentage
 			);
+			t_ShortLogWriteThrough = false;
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_PERCENTAGE, ID, now, { AsStored("%g", percentage) });
 		}
 	}
 }
@@ -7491,12 +8237,15 @@ void CSQLHelper::UpdateFanLog()
 			int speed = (int)atoi(sValue.c_str());
 
 			//insert record
+			t_ShortLogWriteThrough = true;
 			safe_query(
 				"INSERT INTO Fan (DeviceRowID, Speed) "
 				"VALUES ('%" PRIu64 "', '%d')",
 				ID,
 				speed
 			);
+			t_ShortLogWriteThrough = false;
+			m_shortlogstore.Append(CTimeSeriesStore::TABLE_FAN, ID, now, { double(speed) });
 		}
 	}
 }
@@ -8293,6 +9042,9 @@ void CSQLHelper::CleanupShortLog()
 		char szQuery[250];
 		std::string szQueryFilter = "strftime('%s',datetime('now','localtime')) - strftime('%s',Date) > (SELECT p.nValue * 86400 From Preferences AS p WHERE p.Key='5MinuteHistoryDays')";
 
+		// the store is trimmed below
+		t_ShortLogWriteThrough = true;
+
 		sprintf(szQuery, "DELETE FROM Temperature WHERE %s", szQueryFilter.c_str());
 		query(szQuery);
 
@@ -8316,7 +9068,120 @@ void CSQLHelper::CleanupShortLog()
 
 		sprintf(szQuery, "DELETE FROM Fan WHERE %s", szQueryFilter.c_str());
 		query(szQuery);
+		t_ShortLogWriteThrough = false;
+
+		m_graphrollups.Clear();
+		m_shortlogstore.Trim(mytime(nullptr) - (n5MinuteHistoryDays * 86400));
+		SyncShortLogStore();
+	}
+}
+
+// Rebuilds the tables and devices of the store that were changed behind it, the first time this is the migration of all short log rows
+void CSQLHelper::SyncShortLogStore()
+{
+	if (!m_shortlogstore.IsOpen())
+		return;
+	for (int ii = 0; ii < CTimeSeriesStore::TABLE_COUNT; ii++)
+	{
+		CTimeSeriesStore::_eTable table = static_cast<CTimeSeriesStore::_eTable>(ii);
+		bool bAllDevices = !m_shortlogstore.IsValid(table);
+		std::vector<uint64_t> devices;
+		if (!bAllDevices)
+		{
+			devices = m_shortlogstore.GetInvalidDevices(table);
+			if (devices.empty())
+				continue;
+		}
+		auto tstart = std::chrono::steady_clock::now();
+		int64_t nRows = RebuildShortLogStore(table, bAllDevices, devices);
+		if (nRows < 0)
+			continue;
+		auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tstart).count();
+		if (!bAllDevices)
+		{
+			_log.Debug(DEBUG_NORM, "ShortLogStore: %d device(s) of %s rebuilt from %" PRId64 " rows in %d ms", static_cast<int>(devices.size()), CTimeSeriesStore::GetTableName(table), nRows,
+				   static_cast<int>(msec));
+			continue;
+		}
+		uint64_t nBytes, nSamples;
+		m_shortlogstore.GetStatistics(nBytes, nSamples);
+		_log.Log(LOG_STATUS, "ShortLogStore: %s rebuilt from %" PRId64 " rows in %d ms, the store now holds %" PRIu64 " samples in %" PRIu64 " bytes (%.1f bytes per sample)",
+			 CTimeSeriesStore::GetTableName(table), nRows, static_cast<int>(msec), nSamples, nBytes, (nSamples > 0) ? double(nBytes) / nSamples : 0.0);
+	}
+}
+
+// Appends the rows of a short log table (or of the given devices) to the store again, returns the number of rows or -1 on error.
+// Rows are read per device in date order, SHORTLOG_REBUILD_ROWS at a time, so the writer is not stalled while this runs.
+int64_t CSQLHelper::RebuildShortLogStore(const CTimeSeriesStore::_eTable table, const bool bAllDevices, std::vector<uint64_t> devices)
+{
+	const std::vector<std::string>& columns = CTimeSeriesStore::GetColumns(table);
+	const std::string szTable = CTimeSeriesStore::GetTableName(table);
+	m_shortlogstore.BeginRebuild(table, bAllDevices, devices);
+	if (bAllDevices)
+	{
+		// the devices one by one through the DeviceRowID index, devices added meanwhile are appended by the writer
+		devices.clear();
+		std::string szQuery = "SELECT DeviceRowID FROM " + szTable + " WHERE (DeviceRowID>?) ORDER BY DeviceRowID ASC LIMIT 1";
+		uint64_t idx = 0;
+		while (true)
+		{
+			auto stmt = prepared_query(szQuery.c_str(), idx);
+			if (!stmt.IsValid())
+			{
+				m_shortlogstore.EndRebuild(table, false);
+				return -1;
+			}
+			if (!stmt.Step())
+				break;
+			idx = static_cast<uint64_t>(stmt.GetInt64(0));
+			devices.push_back(idx);
+		}
+	}
+
+	std::string szQuery = "SELECT ROWID, Date";
+	for (const auto& column : columns)
+		szQuery += ", [" + column + "]";
+	szQuery += " FROM " + szTable + " WHERE (DeviceRowID==?) AND (Date>=?) AND ((Date>?) OR (ROWID>?)) ORDER BY Date ASC, ROWID ASC LIMIT " + std::to_string(SHORTLOG_REBUILD_ROWS);
+	std::vector<double> values(columns.size());
+	int64_t nRows = 0;
+	for (const auto idx : devices)
+	{
+		std::string szLastDate;
+		int64_t lastRowID = 0;
+		int nChunkRows = SHORTLOG_REBUILD_ROWS;
+		while (nChunkRows == SHORTLOG_REBUILD_ROWS)
+		{
+			if (g_bStopApplication)
+			{
+				m_shortlogstore.EndRebuild(table, false);
+				return -1;
+			}
+			// The statement holds the database lock until the end of the chunk
+			auto stmt = prepared_query(szQuery.c_str(), idx, szLastDate, szLastDate, lastRowID);
+			if (!stmt.IsValid())
+			{
+				m_shortlogstore.EndRebuild(table, false);
+				return -1;
+			}
+			nChunkRows = 0;
+			while (stmt.Step())
+			{
+				nChunkRows++;
+				lastRowID = stmt.GetInt64(0);
+				szLastDate = stmt.GetText(1);
+				time_t tDate;
+				struct tm ltime;
+				if (!ParseSQLdatetime(tDate, ltime, szLastDate, -1))
+					continue;
+				for (size_t ii = 0; ii < columns.size(); ii++)
+					values[ii] = stmt.GetDouble(static_cast<int>(ii + 2));
+				m_shortlogstore.AppendRebuilt(table, idx, tDate, values);
+				nRows++;
+			}
+		}
 	}
+	m_shortlogstore.EndRebuild(table, true);
+	return nRows;
 }
 
 void CSQLHelper::ClearShortLog()
@@ -8329,6 +9194,9 @@ void CSQLHelper::ClearShortLog()
 	query("DELETE FROM MultiMeter");
 	query("DELETE FROM Percentage");
 	query("DELETE FROM Fan");
+	// a DELETE without WHERE does not call the update hook
+	m_graphrollups.Clear();
+	m_shortlogstore.Clear();
 	VacuumDatabase();
 }
 
@@ -8344,6 +9212,13 @@ void CSQLHelper::OptimizeDatabase(sqlite3* dbase)
 	sqlite3_exec(dbase, "PRAGMA optimize;", nullptr, nullptr, nullptr);
 }
 
+void CSQLHelper::OptimizeDatabase()
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	CommitGroupTransaction();
+	OptimizeDatabase(m_dbase);
+}
+
 void CSQLHelper::DeleteHardware(const std::string& idx)
 {
 	safe_query("DELETE FROM Hardware WHERE (ID == '%q')", idx.c_str());
@@ -8418,43 +9293,45 @@ void CSQLHelper::DeleteDevices(const std::string& idx)
 		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 
 		char* errorMessage;
+		CommitGroupTransaction();
 		sqlite3_exec(m_dbase, "BEGIN TRANSACTION", nullptr, nullptr, &errorMessage);
 
 		for (const auto &str : _idx)
 		{
-			safe_exec_no_return("DELETE FROM LightingLog WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM LightSubDevices WHERE (ParentID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM LightSubDevices WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Notifications WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Rain WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Rain_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Temperature WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Temperature_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Timers WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM SetpointTimers WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM UV WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM UV_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Wind WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Wind_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Meter WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Meter_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM MultiMeter WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM MultiMeter_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Percentage WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Percentage_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Fan WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM Fan_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM SceneDevices WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM DeviceToPlansMap WHERE (DeviceRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM CamerasActiveDevices WHERE (DevSceneType==0) AND (DevSceneRowID == '%q')",
-						str.c_str());
-			safe_exec_no_return("DELETE FROM SharedDevices WHERE (DeviceRowID== '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM PushLink WHERE (DeviceRowID== '%q')", str.c_str());
+			CShortLogDeviceChange change(std::strtoull(str.c_str(), nullptr, 10));
+			exec_no_return("DELETE FROM LightingLog WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM LightSubDevices WHERE (ParentID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM LightSubDevices WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Notifications WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Rain WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Rain_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Temperature WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Temperature_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Timers WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM SetpointTimers WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM UV WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM UV_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Wind WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Wind_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Meter WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Meter_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM MultiMeter WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM MultiMeter_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Percentage WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Percentage_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Fan WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM Fan_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM SceneDevices WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM DeviceToPlansMap WHERE (DeviceRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM CamerasActiveDevices WHERE (DevSceneType==0) AND (DevSceneRowID == '%q')",
+				       str.c_str());
+			exec_no_return("DELETE FROM SharedDevices WHERE (DeviceRowID== '%q')", str.c_str());
+			exec_no_return("DELETE FROM PushLink WHERE (DeviceRowID== '%q')", str.c_str());
 			//notify eventsystem device is no longer present
 			uint64_t ullidx = std::stoull(str);
 			m_mainworker.m_eventsystem.RemoveSingleState(ullidx, m_mainworker.m_eventsystem.REASON_DEVICE);
 			//and now delete all records in the DeviceStatus table itself
-			safe_exec_no_return("DELETE FROM DeviceStatus WHERE (ID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM DeviceStatus WHERE (ID == '%q')", str.c_str());
 		}
 		sqlite3_exec(m_dbase, "COMMIT TRANSACTION", nullptr, nullptr, &errorMessage);
 	}
@@ -8490,14 +9367,15 @@ void CSQLHelper::DeleteScenes(const std::string& idx)
 		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 
 		char* errorMessage;
+		CommitGroupTransaction();
 		sqlite3_exec(m_dbase, "BEGIN TRANSACTION", nullptr, nullptr, &errorMessage);
 
 		for (const auto &str : _idx)
 		{
-			safe_exec_no_return("DELETE FROM Scenes WHERE (ID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM SceneDevices WHERE (SceneRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM SceneTimers WHERE (SceneRowID == '%q')", str.c_str());
-			safe_exec_no_return("DELETE FROM SceneLog WHERE (SceneRowID=='%q')", str.c_str());
+			exec_no_return("DELETE FROM Scenes WHERE (ID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM SceneDevices WHERE (SceneRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM SceneTimers WHERE (SceneRowID == '%q')", str.c_str());
+			exec_no_return("DELETE FROM SceneLog WHERE (SceneRowID=='%q')", str.c_str());
 			uint64_t ullidx = std::stoull(str);
 			m_mainworker.m_eventsystem.RemoveSingleState(ullidx, m_mainworker.m_eventsystem.REASON_SCENEGROUP);
 		}
@@ -8677,6 +9555,7 @@ void CSQLHelper::DeleteDateRange(const char *ID, const std::string &fromDate, co
 		"Rain_Calendar", "Wind_Calendar", "UV_Calendar", "Temperature_Calendar", "Meter_Calendar", "MultiMeter_Calendar", "Percentage_Calendar", "Fan_Calendar"
 	};
 
+	CShortLogDeviceChange change(std::strtoull(ID, nullptr, 10));
 	for (const auto &historyTable : historyTables)
 	{
 		safe_query("DELETE FROM %q WHERE (DeviceRowID=='%q') AND (Date>='%q') AND (Date<='%q')", historyTable.c_str(), ID, fromDate.c_str(), toDate.c_str() );
@@ -8716,28 +9595,24 @@ void CSQLHelper::AddTaskItem(const _tTaskItem& tItem, const bool cancelItem)
 		(tItem._ItemType == TITEM_SET_VARIABLE)
 		)
 	{
-		auto itt = m_background_task_queue.begin();
-		while (itt != m_background_task_queue.end())
+		auto range = m_background_task_index.equal_range(std::make_pair(tItem._idx, static_cast<int>(tItem._ItemType)));
+		auto ittIndex = range.first;
+		while (ittIndex != range.second)
 		{
-			_log.Debug(DEBUG_NORM, "SQLH AddTask: Comparing with item in queue: idx=%" PRIu64 ", DelayTime=%f, Command='%s', Level=%d, Color='%s', RelatedEvent='%s'", itt->_idx, itt->_DelayTime, itt->_command.c_str(), itt->_level, itt->_Color.toString().c_str(), itt->_relatedEvent.c_str());
-			if (itt->_idx == tItem._idx && itt->_ItemType == tItem._ItemType)
+			auto itt = (ittIndex++)->second;
+			const _tTaskItem &tQueued = itt->second;
+			_log.Debug(DEBUG_NORM, "SQLH AddTask: Comparing with item in queue: idx=%" PRIu64 ", DelayTime=%f, Command='%s', Level=%d, Color='%s', RelatedEvent='%s'", tQueued._idx, tQueued._DelayTime, tQueued._command.c_str(), tQueued._level, tQueued._Color.toString().c_str(), tQueued._relatedEvent.c_str());
+			float iDelayDiff = tItem._DelayTime - tQueued._DelayTime;
+			if (iDelayDiff < (1. / timer_resolution_hz / 2))
 			{
-				float iDelayDiff = tItem._DelayTime - itt->_DelayTime;
-				if (iDelayDiff < (1. / timer_resolution_hz / 2))
-				{
-					_log.Debug(DEBUG_NORM, "SQLH AddTask: => Already present. Cancelling previous task item");
-					itt = m_background_task_queue.erase(itt);
-				}
-				else
-					++itt;
+				_log.Debug(DEBUG_NORM, "SQLH AddTask: => Already present. Cancelling previous task item");
+				EraseTaskItem(itt);
 			}
-			else
-				++itt;
 		}
 	}
 	// _log.Log(LOG_NORM, "=> Adding new task item");
 	if (!cancelItem)
-		m_background_task_queue.push_back(tItem);
+		PushTaskItem(tItem);
 }
 
 void CSQLHelper::EventsGetTaskItems(std::vector<_tTaskItem>& currentTasks)
@@ -8746,7 +9621,8 @@ void CSQLHelper::EventsGetTaskItems(std::vector<_tTaskItem>& currentTasks)
 
 	currentTasks.clear();
 
-	std::copy(m_background_task_queue.begin(), m_background_task_queue.end(), std::back_inserter(currentTasks));
+	for (const auto &itt : m_background_task_queue)
+		currentTasks.push_back(itt.second);
 }
 
 bool CSQLHelper::RestoreDatabase(const std::string& dbase)
@@ -8805,6 +9681,16 @@ bool CSQLHelper::RestoreDatabase(const std::string& dbase)
 	StopThread();
 
 	//stop database
+	CloseReaderConnections();
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+		m_bGroupCommitActive = false;
+		ClearStatementCache();
+	}
+	m_devicecache.Clear();
+	m_graphrollups.Clear();
+	m_shortlogstore.InvalidateAll();
 	sqlite3_close(m_dbase);
 	m_dbase = nullptr;
 	std::ofstream outfile2;
@@ -8841,17 +9727,163 @@ bool CSQLHelper::RestoreDatabase(const std::string& dbase)
 	return true;
 }
 
-bool CSQLHelper::BackupDatabase(const std::string& OutputFile)
+// Stops a running backup when the application stops
+static int BackupProgressHandler(void* /*pUserData*/)
+{
+	return (g_bStopApplication) ? 1 : 0;
+}
+
+// Streams (the first nBytes of) szSource into the gzip file szDest
+static bool GZipFile(const std::string& szSource, const std::string& szDest, uint64_t nBytes = UINT64_MAX)
+{
+	std::ifstream infile(szSource.c_str(), std::ios::in | std::ios::binary);
+	if (!infile.is_open())
+		return false;
+	gzFile gz = gzopen(szDest.c_str(), "wb6");
+	if (gz == nullptr)
+		return false;
+	const bool bLimited = (nBytes != UINT64_MAX);
+	bool bRet = true;
+	std::vector<char> buffer(64 * 1024);
+	while ((bRet) && (infile) && (nBytes > 0))
+	{
+		if (BackupProgressHandler(nullptr))
+			bRet = false;
+		infile.read(buffer.data(), static_cast<std::streamsize>(std::min<uint64_t>(buffer.size(), nBytes)));
+		int nRead = static_cast<int>(infile.gcount());
+		nBytes -= nRead;
+		if ((nRead > 0) && (gzwrite(gz, buffer.data(), static_cast<unsigned>(nRead)) != nRead))
+			bRet = false;
+	}
+	if ((infile.bad()) || ((bLimited) && (nBytes > 0)))
+		bRet = false; // read error, or the file is shorter
+	if (gzclose(gz) != Z_OK)
+		bRet = false;
+	return bRet;
+}
+
+bool CSQLHelper::BackupDatabase(const std::string& OutputFile, const bool bCompress)
 {
 	if (!m_dbase)
 		return false; //database not open!
 
-	//First cleanup the database
-	OptimizeDatabase(m_dbase);
-	VacuumDatabase();
+	{
+		// the backup connection only sees committed rows
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+	}
 
-	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	// Written next to the output and renamed when complete, so a failure leaves the previous backup intact
+	std::string szTmpFile = OutputFile + ".tmp";
+	std::remove(szTmpFile.c_str());
+
+	bool bRet = false;
+	if ((bCompress) && (m_journal_mode == "WAL"))
+	{
+		// the database file is compressed as it is read, there is no uncompressed copy on disk
+		bRet = BackupDatabaseGZip(szTmpFile);
+		if (!bRet)
+			std::remove(szTmpFile.c_str());
+	}
+	if (!bRet)
+	{
+		std::string szCopyFile = (bCompress) ? szTmpFile + ".db" : szTmpFile;
+		std::remove(szCopyFile.c_str());
+		// In WAL mode a separate connection can copy the database without blocking the writer,
+		// with other journal modes its read lock would block all writes until the copy is done
+		bRet = (m_journal_mode == "WAL") && (BackupDatabaseVacuumInto(szCopyFile));
+		if (!bRet)
+		{
+			std::remove(szCopyFile.c_str());
+			bRet = BackupDatabaseStepped(szCopyFile);
+		}
+		if (bCompress)
+		{
+			bRet = (bRet) && (GZipFile(szCopyFile, szTmpFile));
+			std::remove(szCopyFile.c_str());
+		}
+	}
+	if (bRet)
+	{
+#ifdef WIN32
+		std::remove(OutputFile.c_str());
+#endif
+		bRet = (std::rename(szTmpFile.c_str(), OutputFile.c_str()) == 0);
+	}
+	if (!bRet)
+		std::remove(szTmpFile.c_str());
+	return bRet;
+}
+
+// Compresses the database file into a gzip file (WAL mode only). The WAL is checkpointed first (without waiting for readers)
+// and a read transaction on a separate connection is opened right after, while the writer waits. A checkpoint never changes pages of the file
+// that an open read transaction still uses, so the file stays a consistent copy until the transaction ends.
+bool CSQLHelper::BackupDatabaseGZip(const std::string& OutputFile)
+{
+	sqlite3* dbase = nullptr;
+	if (sqlite3_open_v2(m_dbase_name.c_str(), &dbase, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+	{
+		sqlite3_close(dbase);
+		return false;
+	}
+	sqlite3_busy_timeout(dbase, 1000);
+	uint64_t nBytes = 0;
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+		int nLog = -1;
+		int nCheckpointed = -1;
+		if ((sqlite3_wal_checkpoint_v2(m_dbase, nullptr, SQLITE_CHECKPOINT_PASSIVE, &nLog, &nCheckpointed) == SQLITE_OK) && (nLog == nCheckpointed)
+			&& (sqlite3_exec(dbase, "BEGIN TRANSACTION", nullptr, nullptr, nullptr) == SQLITE_OK))
+		{
+			// the first read starts the transaction, the size is the one of this snapshot
+			sqlite3_stmt* stmt = nullptr;
+			if (sqlite3_prepare_v2(dbase, "SELECT page_count * page_size FROM pragma_page_count(), pragma_page_size()", -1, &stmt, nullptr) == SQLITE_OK)
+			{
+				if (sqlite3_step(stmt) == SQLITE_ROW)
+					nBytes = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+			}
+			sqlite3_finalize(stmt);
+		}
+	}
+	bool bRet = (nBytes > 0) && (GZipFile(m_dbase_name, OutputFile, nBytes));
+	if (nBytes == 0)
+		_log.Log(LOG_ERROR, "SQLHelper: Could not checkpoint the database for a compressed backup, making a copy first");
+	sqlite3_exec(dbase, "COMMIT TRANSACTION", nullptr, nullptr, nullptr);
+	sqlite3_close(dbase);
+	return bRet;
+}
 
+// Copies the database with VACUUM INTO on its own read-only connection, the copy is compacted as well
+bool CSQLHelper::BackupDatabaseVacuumInto(const std::string& OutputFile)
+{
+#if SQLITE_VERSION_NUMBER >= 3027000
+	sqlite3* dbase = nullptr;
+	if (sqlite3_open_v2(m_dbase_name.c_str(), &dbase, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+	{
+		sqlite3_close(dbase);
+		return false;
+	}
+	sqlite3_busy_timeout(dbase, 1000);
+	sqlite3_progress_handler(dbase, 1000, BackupProgressHandler, nullptr);
+	char* zQuery = sqlite3_mprintf("VACUUM INTO '%q'", OutputFile.c_str());
+	char* errorMessage = nullptr;
+	int rc = sqlite3_exec(dbase, zQuery, nullptr, nullptr, &errorMessage);
+	sqlite3_free(zQuery);
+	if (rc != SQLITE_OK)
+		_log.Log(LOG_ERROR, "SQLHelper: Backup with VACUUM INTO failed (%s), using the backup API", (errorMessage != nullptr) ? errorMessage : "");
+	sqlite3_free(errorMessage);
+	sqlite3_close(dbase);
+	return (rc == SQLITE_OK);
+#else
+	return false;
+#endif
+}
+
+// Copies the database with the backup API a few pages at a time, the query lock is released between the steps.
+// Writes through m_dbase during the backup are copied to the backup by sqlite itself.
+bool CSQLHelper::BackupDatabaseStepped(const std::string& OutputFile)
+{
 	int rc;					 // Function return code
 	sqlite3* pFile;			 // Database connection opened on zFilename
 	sqlite3_backup* pBackup;	// Backup handle used to copy data
@@ -8859,35 +9891,70 @@ bool CSQLHelper::BackupDatabase(const std::string& OutputFile)
 	// Open the database file identified by zFilename.
 	rc = sqlite3_open(OutputFile.c_str(), &pFile);
 	if (rc != SQLITE_OK)
+	{
+		sqlite3_close(pFile);
 		return false;
+	}
 
 	// Open the sqlite3_backup object used to accomplish the transfer
-	pBackup = sqlite3_backup_init(pFile, "main", m_dbase, "main");
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		pBackup = sqlite3_backup_init(pFile, "main", m_dbase, "main");
+	}
 
-	time_t startTime = time(nullptr);
+	time_t busyTime = 0;
+	bool bDone = false;
 
 	if (pBackup)
 	{
-		// Each iteration of this loop copies 5 database pages from database
-		// pDb to the backup database.
 		do {
-			rc = sqlite3_backup_step(pBackup, 256);
-			//xProgress(  sqlite3_backup_remaining(pBackup), sqlite3_backup_pagecount(pBackup) );
-			if( rc==SQLITE_BUSY || rc==SQLITE_LOCKED ){
-			  sqlite3_sleep(250);
+			if (BackupProgressHandler(nullptr))
+				break;
+			bool bWriting;
+			{
+				std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+				// sqlite does not step a backup while its source connection is in a write transaction,
+				// wait for the group commit and only commit a transaction that should have been committed already
+				bWriting = m_bGroupTransactionOpen;
+				if ((bWriting) && (std::chrono::steady_clock::now() - m_GroupTransactionStart > std::chrono::milliseconds(std::max(m_GroupCommitWindowMs, GROUP_COMMIT_MAX_HOLD_MS))))
+				{
+					_log.Debug(DEBUG_SQL, "SQLHelper: Backup commits a group transaction of %d statements that is overdue", m_GroupTransactionRows);
+					CommitGroupTransaction();
+					bWriting = m_bGroupTransactionOpen;
+				}
+				if (!bWriting)
+					rc = sqlite3_backup_step(pBackup, 64);
+			}
+			if (bWriting)
+			{
+				rc = SQLITE_OK;
+				sqlite3_sleep(std::max(m_GroupCommitWindowMs, 1));
+				continue;
 			}
-			if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+			if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+			{
 				time_t actTime = time(nullptr);
-				if (actTime - startTime > 2 * 60)
+				if (busyTime == 0)
+					busyTime = actTime;
+				else if (actTime - busyTime > 2 * 60)
 				{
-					//Backup should be done in 2 minutes
+					//Should not be busy for 2 minutes
 					_log.Log(LOG_ERROR, "SQLHelper: Problem making backup! Check destination folder/rights. Process timeout!");
 					break;
 				}
+				sqlite3_sleep(250);
+			}
+			else
+			{
+				busyTime = 0;
+				// let the waiting queries go first
+				sqlite3_sleep(1);
 			}
 		} while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+		bDone = (rc == SQLITE_DONE);
 
 		/* Release resources allocated by backup_init(). */
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 		sqlite3_backup_finish(pBackup);
 	}
 	rc = sqlite3_errcode(pFile);
@@ -8895,7 +9962,7 @@ bool CSQLHelper::BackupDatabase(const std::string& OutputFile)
 	// and return the result of this function.
 	sqlite3_close(pFile);
 
-	return (rc == SQLITE_OK);
+	return (bDone) && (rc == SQLITE_OK);
 }
 
 uint64_t CSQLHelper::UpdateValueLighting2GroupCmd(const int HardwareID, const char* ID, const unsigned char unit,
@@ -9783,16 +10850,34 @@ bool CSQLHelper::CheckTime(const std::string& sTime)
 
 void CSQLHelper::AllowNewHardwareTimer(const int iTotMinutes)
 {
-	m_iAcceptHardwareTimerCounter = iTotMinutes * 60.0F;
+	m_AcceptHardwareTimerEnd = std::chrono::steady_clock::now() + std::chrono::minutes(iTotMinutes);
 	if (m_bAcceptHardwareTimerActive == false)
 	{
 		m_bPreviousAcceptNewHardware = m_bAcceptNewHardware;
 	}
 	m_bAcceptNewHardware = true;
 	m_bAcceptHardwareTimerActive = true;
+	WakeBackgroundTask();
 	_log.Log(LOG_STATUS, "New sensors allowed for %d minutes...", iTotMinutes);
 }
 
+void CSQLHelper::ClearLastSwitch()
+{
+	std::lock_guard<std::mutex> l(m_LastSwitchMutex);
+	m_LastSwitchID.clear();
+	m_LastSwitchRowID = 0;
+}
+
+bool CSQLHelper::GetLastSwitch(std::string &ID, uint64_t &RowID)
+{
+	std::lock_guard<std::mutex> l(m_LastSwitchMutex);
+	if (m_LastSwitchID.empty())
+		return false;
+	ID = m_LastSwitchID;
+	RowID = m_LastSwitchRowID;
+	return true;
+}
+
 /*
 std::string CSQLHelper::GetDeviceValue(const char * FieldName, const char *Idx)
 {
@@ -10222,29 +11307,21 @@ bool CSQLHelper::CalcMeterPrice(const uint64_t idx, const float divider, const c
 {
 	if (divider == 0)
 		return false;
-	//Calculate the total price for today
-	auto result = safe_query("SELECT strftime('%%Y-%%m-%%d %%H:00:00', Date) as ymd, MIN(Value) as Cntr, Price FROM Meter WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00') GROUP BY ymd",
-		idx, szDateStart, szDateEnd);
-	if (result.empty())
+	//Calculate the total price for today, from the lowest counter value and price of every hour plus the last value
+	std::vector<CGraphRollups::_tBucket> hours;
+	if (!m_graphrollups.GetHours(CGraphRollups::TABLE_METER, idx, szDateStart, std::string(szDateEnd) + " 00:00:00", hours))
 		return false;
 
-	//Add last value
-	auto result2 = m_sql.safe_query("SELECT Date, Value, Price FROM Meter WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q' AND Date<='%q 00:00:00') ORDER BY ROWID DESC LIMIT 1",
-		idx, szDateStart, szDateEnd);
-	if (!result2.empty())
-	{
-		result.push_back(result2.at(0));
-	}
-
 	bool bResult = false;
 
 	int64_t last_cntr = INT64_MAX;
 	float last_price = 0;
 	float total_price = 0;
-	for (const auto& itt : result)
+	for (size_t ii = 0; ii <= hours.size(); ii++)
 	{
-		const int64_t cntr = std::stoull(itt.at(1));
-		const float price = std::stof(itt.at(2));
+		const bool bLastValue = (ii == hours.size());
+		const int64_t cntr = static_cast<int64_t>(bLastValue ? hours.back().Last[0] : hours[ii].Min[0]);
+		const float price = bLastValue ? 0 : static_cast<float>(hours[ii].Price);
 
 		if (last_cntr != INT64_MAX)
 		{
@@ -10266,33 +11343,26 @@ bool CSQLHelper::CalcMultiMeterPrice(const uint64_t idx, const float divider, co
 	if (divider == 0)
 		return false;
 
-	//Calculate the total price for today
-	auto result = safe_query("SELECT strftime('%%Y-%%m-%%d %%H:00:00', Date) as ymd, MIN(Value1), MIN(Value2), MIN(Value3), MIN(Value4), MIN(Value5), MIN(Value6), Price FROM MultiMeter WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00') GROUP BY ymd",
-		idx, szDateStart, szDateEnd);
-	if (result.empty())
+	//Calculate the total price for today, from the lowest counter values and price of every hour plus the last values
+	std::vector<CGraphRollups::_tBucket> hours;
+	if (!m_graphrollups.GetHours(CGraphRollups::TABLE_MULTIMETER, idx, szDateStart, std::string(szDateEnd) + " 00:00:00", hours))
 		return false;
 
-	//Add last value
-	auto result2 = m_sql.safe_query("SELECT Date, Value1, Value2, Value3, Value4, Value5, Value6, Price FROM MultiMeter WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q' AND Date<='%q 00:00:00') ORDER BY ROWID DESC LIMIT 1",
-		idx, szDateStart, szDateEnd);
-	if (!result2.empty())
-	{
-		result.push_back(result2.at(0));
-	}
-
 	bool bResult = false;
 
 	uint64_t last_cntrs[6] = { (uint64_t)-1,(uint64_t)-1,(uint64_t)-1,(uint64_t)-1,(uint64_t)-1,(uint64_t)-1 };
 	float last_price = 0;
 	float total_price[6] = { 0,0,0,0,0,0 };
-	for (const auto& itt : result)
+	for (size_t jj = 0; jj <= hours.size(); jj++)
 	{
-		float price = std::stof(itt[7]);
+		const bool bLastValue = (jj == hours.size());
+		const CGraphRollups::_tValues& values = bLastValue ? hours.back().Last : hours[jj].Min;
+		float price = bLastValue ? 0 : static_cast<float>(hours[jj].Price);
 
 		uint64_t cntrs[6];
 		for (int ii = 0; ii < 6; ii++)
 		{
-			cntrs[ii] = std::stoull(itt[1 + ii]);
+			cntrs[ii] = static_cast<uint64_t>(values[ii]);
 			if (last_cntrs[ii] != (uint64_t)-1)
 			{
 				uint64_t total = cntrs[ii] - last_cntrs[ii];
@@ -10459,6 +11529,7 @@ bool CSQLHelper::TransferDevice(const std::string& sOldIdx, const std::string& s
 		newHardwareID, newOrgHardwareID, newDeviceID.c_str(), newUnit, devType, subType, sOldIdx.c_str());
 
 	//new device could already have some logging, so let's keep this data
+	CShortLogDeviceChange change(std::strtoull(sOldIdx.c_str(), nullptr, 10), std::strtoull(sNewIdx.c_str(), nullptr, 10));
 	//Rain
 	m_sql.safe_query("UPDATE Rain SET DeviceRowID='%q' WHERE (DeviceRowID == '%q') AND (Date>'%q')", sOldIdx.c_str(), sNewIdx.c_str(), szLastOldDate.c_str());
 	m_sql.safe_query("UPDATE Rain_Calendar SET DeviceRowID='%q' WHERE (DeviceRowID == '%q') AND (Date>'%q')", sOldIdx.c_str(), sNewIdx.c_str(), szLastOldDate.c_str());
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <map>
 #include <string>
+#include <string_view>
 #include "RFXNames.h"
 #include "hardware/hardwaretypes.h"
 #include "Helper.h"
+#include "DeviceStatusCache.h"
+#include "GraphRollups.h"
+#include "TimeSeriesStore.h"
 #include "protocols/UrlEncode.h"
 #include "protocols/HTTPClient.h"
 
@@ -315,6 +325,60 @@ struct _tTaskItem
 	}
 };
 
+// Typed, forward-only cursor on a cached prepared statement (see CSQLHelper::prepared_query)
+// The cursor holds the query lock while it is alive, so copy out what you need and let it
+// go out of scope before issuing another query from the same thread.
+// Text returned by GetText is only valid until the next Step()
+class CSQLStatement
+{
+public:
+	CSQLStatement(CSQLStatement &&other) noexcept;
+	CSQLStatement(const CSQLStatement &) = delete;
+	CSQLStatement &operator=(const CSQLStatement &) = delete;
+	~CSQLStatement();
+
+	bool IsValid() const
+	{
+		return (m_stmt != nullptr);
+	}
+
+	void Bind(int nValue);
+	void Bind(int64_t nValue);
+	void Bind(uint64_t nValue);
+	void Bind(double dValue);
+	void Bind(const char *szValue);
+	void Bind(const std::string &sValue);
+
+	// Returns true while there is a row to read
+	bool Step();
+	// Runs a statement that does not return rows, returns the number of changed rows (or -1 on error)
+	int Execute();
+
+	int ColumnCount() const;
+	bool IsNull(int col) const;
+	int GetInt(int col) const;
+	int64_t GetInt64(int col) const;
+	double GetDouble(int col) const;
+	std::string_view GetText(int col) const;
+	std::string GetString(int col) const
+	{
+		return std::string(GetText(col));
+	}
+
+private:
+	friend class CSQLHelper;
+	CSQLStatement(std::unique_lock<std::mutex> &&lock, sqlite3 *dbase, sqlite3_stmt *stmt);
+
+	std::unique_lock<std::mutex> m_lock;
+	sqlite3 *m_dbase;
+	sqlite3_stmt *m_stmt;
+	int m_bindIndex = 0;
+	int m_lastResult = 0;
+	// time spent in sqlite3_step, recorded in the query histogram when the statement is released
+	bool m_bStepped = false;
+	std::chrono::steady_clock::duration m_elapsed{};
+};
+
 class CSQLHelper : public StoppableTask
 {
 public:
@@ -323,11 +387,14 @@ class CSQLHelper : public StoppableTask
 
 	void SetDatabaseName(const std::string &DBName);
 	void SetJournalMode(const std::string &mode);
+	void SetGroupCommit(int windowMs, int maxRows);
+	void SetShortLogStore(bool bEnabled);
 
 	bool OpenDatabase();
 	void CloseDatabase();
 
-	bool BackupDatabase(const std::string &OutputFile);
+	// bCompress writes OutputFile gzip compressed
+	bool BackupDatabase(const std::string &OutputFile, bool bCompress = false);
 	bool RestoreDatabase(const std::string &dbase);
 
 	// Returns DeviceRowID
@@ -390,8 +457,11 @@ class CSQLHelper : public StoppableTask
 	void ScheduleDay();
 
 	void ClearShortLog();
+	// Rebuilds what changed behind the short log store, the first run copies all short log rows into it
+	void SyncShortLogStore();
 	void VacuumDatabase();
 	void OptimizeDatabase(sqlite3 *dbase);
+	void OptimizeDatabase();
 	void DeleteHardware(const std::string &idx);
 
 	void DeleteCamera(const std::string &idx);
@@ -419,6 +489,17 @@ class CSQLHelper : public StoppableTask
 	std::vector<std::vector<std::string>> safe_query(const char *fmt, ...);
 	std::vector<std::vector<std::string>> safe_queryBlob(const char *fmt, ...);
 	std::vector<std::vector<std::string>> unsafe_query(const std::string& szQuery);
+	// Runs a SELECT on one of the read-only connections, it does not wait for writes and does not see uncommitted ones
+	std::vector<std::vector<std::string>> safe_readonly_query(const char *fmt, ...);
+
+	// Runs szQuery (with ? placeholders) through the prepared statement cache and binds args in order
+	template <typename... Args> CSQLStatement prepared_query(const char *szQuery, const Args &...args)
+	{
+		CSQLStatement stmt = PrepareCached(szQuery);
+		if (stmt.IsValid())
+			(stmt.Bind(args), ...);
+		return stmt;
+	}
 
 	void safe_exec_no_return(const char *fmt, ...);
 	bool safe_UpdateBlobInTableWithID(const std::string &Table, const std::string &Column, const std::string &sID, const std::string &BlobData);
@@ -430,6 +511,8 @@ class CSQLHelper : public StoppableTask
 	bool UpdateUserVariable(const std::string& varname, _eUsrVariableType eVartype, const std::string& varvalue, bool eventtrigger, std::string& errorMessage);
 	void DeleteUserVariable(const std::string &idx);
 	bool GetUserVariable(const std::string &varname, _eUsrVariableType eVartype, std::string &varvalue);
+	// Current name and value of a device, served from the DeviceStatus cache when possible
+	bool GetDeviceValue(uint64_t ID, std::string &Name, int &nValue, std::string &sValue, std::string &LastUpdate);
 	bool CheckUserVariable(_eUsrVariableType eVartype, const std::string &varvalue, std::string &errorMessage);
 
 	uint64_t CreateDevice(int HardwareID, int SensorType, int SensorSubType, std::string &devname, unsigned long nid, const std::string &soptions, const std::string &userName);
@@ -457,10 +540,14 @@ class CSQLHelper : public StoppableTask
 	bool CalcMeterPrice(const uint64_t idx, const float divider, const char* szDateStart, const char* szDateEnd, float &price);
 	bool CalcMultiMeterPrice(const uint64_t idx, const float divider, const char* szDateStart, const char* szDateEnd, float& price);
 	bool TransferDevice(const std::string& sOldIdx, const std::string&  sNewIdx);
+	// Writes stay in one transaction until the last holder releases it, or for at most GROUP_COMMIT_MAX_HOLD_MS or m_GroupCommitMaxRows statements
+	void HoldGroupCommit();
+	void ReleaseGroupCommit();
+	// Last switch seen by UpdateValue, for the learning command
+	void ClearLastSwitch();
+	bool GetLastSwitch(std::string &ID, uint64_t &RowID);
 public:
-	std::string m_LastSwitchID; // for learning command
 	std::string m_UniqueID;
-	uint64_t m_LastSwitchRowID;
 	_eWindUnit m_windunit;
 	std::string m_windsign;
 	float m_windscale;
@@ -482,30 +569,72 @@ class CSQLHelper : public StoppableTask
 	bool m_bDisableDzVentsSystem;
 	double m_max_kwh_usage;
 	std::map<uint64_t, float> m_actual_prices;
+	// Hourly aggregates of the Temperature, Meter and MultiMeter short logs
+	CGraphRollups m_graphrollups;
+	// Read cache of the short log tables for the day graphs, only open when enabled with SetShortLogStore()
+	CTimeSeriesStore m_shortlogstore;
 
 private:
 	std::mutex m_executeThreadMutex;
 	std::mutex m_sqlQueryMutex;
 	sqlite3 *m_dbase;
+	std::map<std::string, sqlite3_stmt *> m_statement_cache; // keyed by SQL text, guarded by m_sqlQueryMutex
+	CDeviceStatusCache m_devicecache;
+
+	// Read-only connections (WAL mode only), each with its own lock
+	struct _tReaderConnection
+	{
+		std::mutex mutex;
+		sqlite3 *dbase = nullptr;
+	};
+	static constexpr size_t NUM_READER_CONNECTIONS = 3;
+	std::array<_tReaderConnection, NUM_READER_CONNECTIONS> m_readers;
+	std::atomic<size_t> m_nextReader{ 0 };
+
+	// Group commit: INSERT/UPDATE/DELETE statements are collected in one transaction that is committed
+	// after m_GroupCommitWindowMs or m_GroupCommitMaxRows statements (all guarded by m_sqlQueryMutex)
+	int m_GroupCommitWindowMs;
+	int m_GroupCommitMaxRows;
+	bool m_bShortLogStore;
+	bool m_bGroupCommitActive;
+	bool m_bGroupTransactionOpen;
+	int m_GroupCommitHold;
+	int m_GroupTransactionRows;
+	std::chrono::steady_clock::time_point m_GroupTransactionStart;
 	std::string m_dbase_name;
 	std::string m_journal_mode;
 	unsigned char m_sensortimeoutcounter;
 	std::map<uint64_t, int> m_timeoutlastsend;
 	std::map<uint64_t, int> m_batterylowlastsend;
 	bool m_bAcceptHardwareTimerActive;
-	float m_iAcceptHardwareTimerCounter;
+	std::chrono::steady_clock::time_point m_AcceptHardwareTimerEnd;
 	bool m_bPreviousAcceptNewHardware;
+	std::mutex m_LastSwitchMutex;
+	std::string m_LastSwitchID; // guarded by m_LastSwitchMutex
+	uint64_t m_LastSwitchRowID;
 
-	std::vector<_tTaskItem> m_background_task_queue;
+	// Task items by due time, with an index by (idx, item type) to cancel or replace them (all guarded by m_background_task_mutex)
+	typedef std::multimap<std::chrono::steady_clock::time_point, _tTaskItem> _tTaskQueue;
+	_tTaskQueue m_background_task_queue;
+	std::multimap<std::pair<uint64_t, int>, _tTaskQueue::iterator> m_background_task_index;
+	std::condition_variable m_background_task_cond;
+	bool m_bBackgroundTaskWakeup = false; // the next deadline may have changed
 	std::shared_ptr<std::thread> m_thread;
 	std::mutex m_background_task_mutex;
+	void PushTaskItem(const _tTaskItem &tItem);
+	void EraseTaskItem(_tTaskQueue::iterator itt);
+	void WakeBackgroundTask();
 	bool StartThread();
 	void StopThread();
 	void Do_Work();
 #ifndef WIN32
 	void ManageExecuteScriptTimeout(std::string szCommand, int pid, int timeout, bool *stillRunning, bool *timeoutOccurred);
 #endif
+	bool BackupDatabaseGZip(const std::string &OutputFile);
+	bool BackupDatabaseVacuumInto(const std::string &OutputFile);
+	bool BackupDatabaseStepped(const std::string &OutputFile);
 	void PerformThreadedAction(const _tTaskItem &tItem);
+	void PerformURLRequest(const _tTaskItem &tItem);
 	bool SwitchLightFromTasker(const std::string &idx, const std::string &switchcmd, const std::string &level, const std::string &color, const std::string &User);
 	bool SwitchLightFromTasker(uint64_t idx, const std::string &switchcmd, int level, _tColor color, const std::string &User);
 
@@ -547,6 +676,7 @@ class CSQLHelper : public StoppableTask
 	void AddCalendarUpdatePercentage();
 	void AddCalendarUpdateFan();
 	void CleanupShortLog();
+	int64_t RebuildShortLogStore(CTimeSeriesStore::_eTable table, bool bAllDevices, std::vector<uint64_t> devices);
 	bool CheckDate(const std::string &sDate, int &d, int &m, int &y);
 	bool CheckDateSQL(const std::string &sDate);
 	bool CheckDateTimeSQL(const std::string &sDateTime);
@@ -557,6 +687,24 @@ class CSQLHelper : public StoppableTask
 
 	std::vector<std::vector<std::string>> query(const std::string &szQuery);
 	std::vector<std::vector<std::string>> queryBlob(const std::string &szQuery);
+
+	void exec_no_return(const char *fmt, ...);
+	void exec_no_return_v(const char *fmt, va_list args);
+
+	void PrepareWrite(const char *szQuery);
+	void FinishWrite();
+	void CommitGroupTransaction();
+	std::chrono::steady_clock::time_point CheckGroupCommit();
+
+	void OpenReaderConnections();
+	void CloseReaderConnections();
+	std::vector<std::vector<std::string>> readonly_query(const std::string &szQuery);
+
+	CSQLStatement PrepareCached(const char *szQuery);
+	void ClearStatementCache();
+
+	bool GetCachedDeviceStatus(int HardwareID, const char *ID, unsigned char unit, unsigned char devType, unsigned char subType, _tDeviceStatusEntry &entry);
+	static void OnDatabaseUpdate(void *pUser, int operation, const char *szDatabase, const char *szTable, long long rowid);
 };
 
 extern CSQLHelper m_sql;
@@ -38,6 +38,11 @@ void CScheduler::StopScheduler()
 	if (m_thread)
 	{
 		RequestStop();
+		{
+			// make sure the thread is waiting (or has seen the stop request) before waking it up
+			std::lock_guard<std::mutex> l(m_mutex);
+		}
+		m_cond.notify_all();
 		m_thread->join();
 		m_thread.reset();
 	}
@@ -329,6 +334,7 @@ void CScheduler::ReloadSchedules()
 				m_scheduleitems.push_back(titem);
 		}
 	}
+	RebuildScheduleQueue();
 }
 
 void CScheduler::SetSunRiseSetTimes(const std::string& sSunRise, const std::string& sSunSet, const std::string& sSunAtSouth, const std::string& sCivTwStart, const std::string& sCivTwEnd, const std::string& sNautTwStart, const std::string& sNautTwEnd, const std::string& sAstTwStart, const std::string& sAstTwEnd)
@@ -368,7 +374,23 @@ void CScheduler::SetSunRiseSetTimes(const std::string& sSunRise, const std::stri
 	if (bReloadSchedules)
 		ReloadSchedules();
 	else if (bReloadSunRiseSet)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
 		AdjustSunRiseSetSchedules();
+		RebuildScheduleQueue();
+	}
+}
+
+void CScheduler::RebuildScheduleQueue()
+{
+	m_scheduleQueue = decltype(m_scheduleQueue)();
+	for (size_t ii = 0; ii < m_scheduleitems.size(); ii++)
+	{
+		if (m_scheduleitems[ii].bEnabled)
+			m_scheduleQueue.emplace(m_scheduleitems[ii].startTime, ii);
+	}
+	m_bScheduleChanged = true;
+	m_cond.notify_all();
 }
 
 void CScheduler::AdjustSunRiseSetSchedules()
@@ -715,22 +737,30 @@ bool CScheduler::AdjustScheduleItem(tScheduleItem* pItem, bool bForceAddDay)
 
 void CScheduler::Do_Work()
 {
-	while (!IsStopRequested(1000))
+	int lastExpiryCheckMin = -1;
+	while (!IsStopRequested(0))
 	{
 		time_t atime = mytime(nullptr);
 		struct tm ltime;
 		localtime_r(&atime, &ltime);
 
-
-		if (ltime.tm_sec % 12 == 0) {
-			m_mainworker.HeartbeatUpdate("Scheduler");
-		}
+		m_mainworker.HeartbeatUpdate("Scheduler");
 
 		CheckSchedules();
 
-		if (ltime.tm_sec == 0) {
+		if (ltime.tm_min != lastExpiryCheckMin) {
+			lastExpiryCheckMin = ltime.tm_min;
 			DeleteExpiredTimers();
 		}
+
+		// sleep until the next item is due, but wake up at least every 12 seconds for the heartbeat
+		// and when the schedules are reloaded or the sunrise/sunset times change
+		std::unique_lock<std::mutex> l(m_mutex);
+		time_t tNextWake = atime + 12 - (ltime.tm_sec % 12);
+		if ((!m_scheduleQueue.empty()) && (m_scheduleQueue.top().first + 1 < tNextWake))
+			tNextWake = std::max(m_scheduleQueue.top().first + 1, atime + 1);
+		m_cond.wait_until(l, std::chrono::system_clock::from_time_t(tNextWake), [this] { return m_bScheduleChanged || IsStopRequested(0); });
+		m_bScheduleChanged = false;
 	}
 	_log.Log(LOG_STATUS, "Scheduler stopped...");
 }
@@ -743,9 +773,13 @@ void CScheduler::CheckSchedules()
 	struct tm ltime;
 	localtime_r(&atime, &ltime);
 
-	for (auto& item : m_scheduleitems)
+	std::vector<size_t> vRescheduled;
+	while ((!m_scheduleQueue.empty()) && (m_scheduleQueue.top().first < atime))
 	{
-		if ((item.bEnabled) && (atime > item.startTime))
+		const tScheduleQueueEntry due = m_scheduleQueue.top();
+		m_scheduleQueue.pop();
+		tScheduleItem &item = m_scheduleitems[due.second];
+		if ((item.bEnabled) && (item.startTime == due.first))
 		{
 			//check if we are on a valid day
 			bool bOkToFire = false;
@@ -962,8 +996,12 @@ void CScheduler::CheckSchedules()
 					item.bEnabled = false;
 				}
 			}
+			if (item.bEnabled)
+				vRescheduled.push_back(due.second);
 		}
 	}
+	for (const auto idx : vRescheduled)
+		m_scheduleQueue.emplace(m_scheduleitems[idx].startTime, idx);
 }
 
 void CScheduler::DeleteExpiredTimers()
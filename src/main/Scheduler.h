@@ -2,6 +2,8 @@
 
 #include "RFXNames.h"
 #include "hardware/hardwaretypes.h"
+#include <condition_variable>
+#include <queue>
 #include <string>
 
 struct tScheduleItem
@@ -67,8 +69,14 @@ class CScheduler : public StoppableTask
 	time_t m_tAstTwStart;
 	time_t m_tAstTwEnd;
 	std::mutex m_mutex;
+	std::condition_variable m_cond;
 	std::shared_ptr<std::thread> m_thread;
 	std::vector<tScheduleItem> m_scheduleitems;
+	// min-heap of (startTime, index in m_scheduleitems) for the enabled items, entries whose startTime
+	// no longer matches the item are outdated and skipped
+	typedef std::pair<time_t, size_t> tScheduleQueueEntry;
+	std::priority_queue<tScheduleQueueEntry, std::vector<tScheduleQueueEntry>, std::greater<tScheduleQueueEntry>> m_scheduleQueue;
+	bool m_bScheduleChanged = false;
 
 	//our thread
 	void Do_Work();
@@ -77,6 +85,8 @@ class CScheduler : public StoppableTask
 	//returns false if timer is invalid (like no sunset/sunrise known yet)
 	bool AdjustScheduleItem(tScheduleItem *pItem, bool bForceAddDay);
 	void AdjustSunRiseSetSchedules();
+	//rebuilds m_scheduleQueue and wakes up the scheduler thread (m_mutex must be held)
+	void RebuildScheduleQueue();
 	//will check if anything needs to be scheduled
 	void CheckSchedules();
 	void DeleteExpiredTimers();
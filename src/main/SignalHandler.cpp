@@ -458,6 +458,7 @@ void signal_handler(int sig_num
 #ifndef WIN32
 		fatal_handling_thread = pthread_self();
 #endif
+		_log.SetSynchronousOutput();
 		_log.Log(LOG_ERROR, "Oikomaticz(pid:%d, tid:%ld('%s')) received fatal signal %d (%s)", getpid(), tid, thread_name, sig_num
 #ifndef WIN32
 			, strsignal(sig_num));
@@ -476,6 +477,7 @@ void signal_handler(int sig_num
 	case SIGUSR1:
 		fatal_handling = 1;
 		fatal_handling_thread = pthread_self();
+		_log.SetSynchronousOutput();
 		_log.Log(LOG_ERROR, "Oikomaticz(%d) is exiting due to watchdog triggered...", getpid());
 		// Print call stack of all threads to aid debugging of deadlock
 		dumpstack_gdb(true);
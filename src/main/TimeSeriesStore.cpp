@@ -0,0 +1,900 @@
+#include "stdafx.h"
+#include "TimeSeriesStore.h"
+#include "Helper.h"
+#include "Logger.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <fstream>
+
+// Samples per block, a block is decoded as a whole
+#define TSS_BLOCK_SAMPLES 120
+#define TSS_FILE_EXTENSION ".tss"
+// Marks a device that has to be rebuilt from the database
+#define TSS_INVALID_EXTENSION ".invalid"
+
+namespace
+{
+	constexpr char TSS_MAGIC[4] = { 'O', 'T', 'S', '1' };
+	constexpr size_t TSS_FILE_HEADER_SIZE = 8; // magic, number of columns, 3 reserved bytes
+
+	struct _tBlockHeader
+	{
+		uint16_t Count;
+		uint16_t Reserved;
+		uint32_t Bytes; // of the bit stream that follows the header
+		int64_t First;
+		int64_t Last;
+	};
+	static_assert(sizeof(_tBlockHeader) == 24, "block header is stored as is");
+
+	struct _tStoreTable
+	{
+		const char *szName;
+		std::vector<std::string> Columns;
+	};
+
+	const std::array<_tStoreTable, CTimeSeriesStore::TABLE_COUNT> StoreTables = { {
+		{ "Temperature", { "Temperature", "Chill", "Humidity", "Barometer", "DewPoint", "SetPoint" } },
+		{ "Rain", { "Total", "Rate" } },
+		{ "Wind", { "Direction", "Speed", "Gust" } },
+		{ "UV", { "Level" } },
+		{ "Meter", { "Value", "Usage", "Price" } },
+		{ "MultiMeter", { "Value1", "Value2", "Value3", "Value4", "Value5", "Value6", "Price" } },
+		{ "Percentage", { "Percentage" } },
+		{ "Fan", { "Speed" } },
+	} };
+
+	int LeadingZeros(uint64_t value)
+	{
+		int n = 0;
+		for (uint64_t mask = 0x8000000000000000ULL; (mask != 0) && ((value & mask) == 0); mask >>= 1)
+			n++;
+		return n;
+	}
+
+	int TrailingZeros(uint64_t value)
+	{
+		int n = 0;
+		for (uint64_t mask = 1; (mask != 0) && ((value & mask) == 0); mask <<= 1)
+			n++;
+		return n;
+	}
+
+	uint64_t DoubleBits(const double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	double BitsDouble(const uint64_t bits)
+	{
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	class CBitWriter
+	{
+	public:
+		void Write(const uint64_t value, const int nBits)
+		{
+			for (int ii = nBits - 1; ii >= 0; ii--)
+				WriteBit(((value >> ii) & 1) != 0);
+		}
+		void WriteBit(const bool bit)
+		{
+			if ((m_nBits % 8) == 0)
+				m_bytes.push_back(0);
+			if (bit)
+				m_bytes.back() |= static_cast<uint8_t>(0x80 >> (m_nBits % 8));
+			m_nBits++;
+		}
+		const std::vector<uint8_t> &GetBytes() const
+		{
+			return m_bytes;
+		}
+
+	private:
+		std::vector<uint8_t> m_bytes;
+		size_t m_nBits = 0;
+	};
+
+	class CBitReader
+	{
+	public:
+		CBitReader(const uint8_t *pData, const size_t nBytes)
+			: m_pData(pData)
+			, m_nBits(nBytes * 8)
+		{
+		}
+		uint64_t Read(const int nBits)
+		{
+			uint64_t value = 0;
+			for (int ii = 0; ii < nBits; ii++)
+				value = (value << 1) | (ReadBit() ? 1 : 0);
+			return value;
+		}
+		bool ReadBit()
+		{
+			if (m_nPos >= m_nBits)
+			{
+				m_bOverrun = true;
+				return false;
+			}
+			bool bit = (m_pData[m_nPos / 8] & (0x80 >> (m_nPos % 8))) != 0;
+			m_nPos++;
+			return bit;
+		}
+		bool IsOverrun() const
+		{
+			return m_bOverrun;
+		}
+
+	private:
+		const uint8_t *m_pData;
+		size_t m_nBits;
+		size_t m_nPos = 0;
+		bool m_bOverrun = false;
+	};
+
+	// Timestamps first, then the values column by column. Adding a sample never makes a block shorter.
+	std::vector<uint8_t> EncodeBlock(const std::vector<time_t> &times, const std::vector<double> &values, const size_t nColumns)
+	{
+		CBitWriter writer;
+		int64_t prevDelta = 0;
+		for (size_t ii = 1; ii < times.size(); ii++)
+		{
+			int64_t delta = static_cast<int64_t>(times[ii] - times[ii - 1]);
+			int64_t dod = delta - prevDelta;
+			prevDelta = delta;
+			if (dod == 0)
+				writer.WriteBit(false);
+			else if ((dod >= -63) && (dod <= 64))
+			{
+				writer.Write(0x2, 2);
+				writer.Write(static_cast<uint64_t>(dod + 63), 7);
+			}
+			else if ((dod >= -255) && (dod <= 256))
+			{
+				writer.Write(0x6, 3);
+				writer.Write(static_cast<uint64_t>(dod + 255), 9);
+			}
+			else if ((dod >= -2047) && (dod <= 2048))
+			{
+				writer.Write(0xE, 4);
+				writer.Write(static_cast<uint64_t>(dod + 2047), 12);
+			}
+			else
+			{
+				writer.Write(0xF, 4);
+				writer.Write(static_cast<uint64_t>(dod), 64);
+			}
+		}
+		for (size_t col = 0; col < nColumns; col++)
+		{
+			uint64_t prev = DoubleBits(values[col]);
+			writer.Write(prev, 64);
+			int prevLeading = -1;
+			int prevTrailing = 0;
+			for (size_t ii = 1; ii < times.size(); ii++)
+			{
+				uint64_t bits = DoubleBits(values[ii * nColumns + col]);
+				uint64_t xored = bits ^ prev;
+				prev = bits;
+				if (xored == 0)
+				{
+					writer.WriteBit(false);
+					continue;
+				}
+				writer.WriteBit(true);
+				int leading = std::min(LeadingZeros(xored), 31);
+				int trailing = TrailingZeros(xored);
+				if ((prevLeading >= 0) && (leading >= prevLeading) && (trailing >= prevTrailing))
+				{
+					// fits in the window of the previous value
+					writer.WriteBit(false);
+					writer.Write(xored >> prevTrailing, 64 - prevLeading - prevTrailing);
+					continue;
+				}
+				int meaningful = 64 - leading - trailing;
+				writer.WriteBit(true);
+				writer.Write(static_cast<uint64_t>(leading), 5);
+				writer.Write(static_cast<uint64_t>(meaningful - 1), 6);
+				writer.Write(xored >> trailing, meaningful);
+				prevLeading = leading;
+				prevTrailing = trailing;
+			}
+		}
+		return writer.GetBytes();
+	}
+
+	bool DecodeBlock(const _tBlockHeader &header, const uint8_t *pData, const size_t nColumns, std::vector<time_t> &times, std::vector<double> &values)
+	{
+		CBitReader reader(pData, header.Bytes);
+		times.resize(header.Count);
+		values.resize(header.Count * nColumns);
+		if (header.Count == 0)
+			return true;
+		times[0] = static_cast<time_t>(header.First);
+		int64_t prevDelta = 0;
+		for (size_t ii = 1; ii < header.Count; ii++)
+		{
+			int64_t dod = 0;
+			if (!reader.ReadBit())
+				dod = 0;
+			else if (!reader.ReadBit())
+				dod = static_cast<int64_t>(reader.Read(7)) - 63;
+			else if (!reader.ReadBit())
+				dod = static_cast<int64_t>(reader.Read(9)) - 255;
+			else if (!reader.ReadBit())
+				dod = static_cast<int64_t>(reader.Read(12)) - 2047;
+			else
+				dod = static_cast<int64_t>(reader.Read(64));
+			prevDelta += dod;
+			times[ii] = times[ii - 1] + static_cast<time_t>(prevDelta);
+		}
+		for (size_t col = 0; col < nColumns; col++)
+		{
+			uint64_t prev = reader.Read(64);
+			values[col] = BitsDouble(prev);
+			int leading = 0;
+			int trailing = 0;
+			for (size_t ii = 1; ii < header.Count; ii++)
+			{
+				if (reader.ReadBit())
+				{
+					if (reader.ReadBit())
+					{
+						leading = static_cast<int>(reader.Read(5));
+						int meaningful = static_cast<int>(reader.Read(6)) + 1;
+						trailing = 64 - leading - meaningful;
+						if (trailing < 0)
+							return false;
+					}
+					prev ^= reader.Read(64 - leading - trailing) << trailing;
+				}
+				values[ii * nColumns + col] = BitsDouble(prev);
+			}
+		}
+		return !reader.IsOverrun();
+	}
+
+	// "<Table>_<idx>.tss" (or the given extension)
+	bool ParseFileName(const std::string &szName, CTimeSeriesStore::_eTable &table, uint64_t &idx, const char *szExtension = TSS_FILE_EXTENSION)
+	{
+		size_t pos = szName.rfind('_');
+		size_t ext = szName.rfind(szExtension);
+		if ((pos == std::string::npos) || (ext == std::string::npos) || (ext + strlen(szExtension) != szName.size()) || (ext <= pos + 1))
+			return false;
+		table = CTimeSeriesStore::GetTable(szName.substr(0, pos).c_str());
+		if (table == CTimeSeriesStore::TABLE_COUNT)
+			return false;
+		std::string szIdx = szName.substr(pos + 1, ext - pos - 1);
+		if (!is_number(szIdx))
+			return false;
+		idx = std::stoull(szIdx);
+		return true;
+	}
+
+	bool WriteFile(const std::string &szFile, const uint8_t *pData, const size_t nSize)
+	{
+		// written next to the file and renamed, so it is never left half written
+		std::string szTmpFile = szFile + ".tmp";
+		{
+			std::ofstream outfile(szTmpFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!outfile.is_open())
+				return false;
+			outfile.write(reinterpret_cast<const char *>(pData), nSize);
+			if (!outfile.good())
+				return false;
+		}
+		std::remove(szFile.c_str());
+		return std::rename(szTmpFile.c_str(), szFile.c_str()) == 0;
+	}
+
+	bool ReadFile(const std::string &szFile, std::vector<uint8_t> &data)
+	{
+		std::ifstream infile(szFile.c_str(), std::ios::in | std::ios::binary);
+		if (!infile.is_open())
+			return false;
+		data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	// Calls fn for every complete block of the file data, returns the size of the valid part
+	size_t ForEachBlock(const uint8_t *pData, const size_t nSize, const std::function<bool(size_t offset, const _tBlockHeader &header)> &fn)
+	{
+		if ((nSize < TSS_FILE_HEADER_SIZE) || (memcmp(pData, TSS_MAGIC, sizeof(TSS_MAGIC)) != 0))
+			return 0;
+		size_t offset = TSS_FILE_HEADER_SIZE;
+		while (offset + sizeof(_tBlockHeader) <= nSize)
+		{
+			_tBlockHeader header;
+			memcpy(&header, pData + offset, sizeof(header));
+			if ((header.Count == 0) || (header.Count > TSS_BLOCK_SAMPLES) || (offset + sizeof(header) + header.Bytes > nSize))
+				break; // the tail of a block that was not written completely
+			if (!fn(offset, header))
+				return nSize;
+			offset += sizeof(header) + header.Bytes;
+		}
+		return offset;
+	}
+} // namespace
+
+CTimeSeriesStore::~CTimeSeriesStore()
+{
+	Close();
+}
+
+bool CTimeSeriesStore::Open(const std::string &szPath)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	m_szPath = szPath;
+	if ((!m_szPath.empty()) && (m_szPath.back() != '/') && (m_szPath.back() != '\\'))
+		m_szPath += "/";
+	mkdir_deep(m_szPath.c_str(), 0755);
+	if (!file_exist(m_szPath.c_str()))
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: Could not create %s", m_szPath.c_str());
+		m_szPath.clear();
+		return false;
+	}
+	// the last blocks of the devices are only written on Close, after a crash they are missing
+	bool bClean = file_exist(GetCleanFileName().c_str());
+	std::remove(GetCleanFileName().c_str());
+	for (size_t ii = 0; ii < TABLE_COUNT; ii++)
+	{
+		m_valid[ii] = bClean && file_exist(GetValidFileName(static_cast<_eTable>(ii)).c_str());
+		if (!m_valid[ii])
+			std::remove(GetValidFileName(static_cast<_eTable>(ii)).c_str());
+		m_invalid_devices[ii].clear();
+		m_rebuild[ii] = _tRebuild();
+	}
+	std::vector<std::string> entries;
+	DirectoryListing(entries, m_szPath, false, true);
+	for (const auto &szName : entries)
+	{
+		_eTable table;
+		uint64_t idx;
+		if (ParseFileName(szName, table, idx, TSS_INVALID_EXTENSION))
+			m_invalid_devices[table][idx] = ++m_generation;
+	}
+	m_open_blocks.clear();
+	return true;
+}
+
+void CTimeSeriesStore::Close()
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	if ((!m_szPath.empty()) && FlushOpenBlocks())
+	{
+		std::ofstream outfile(GetCleanFileName().c_str(), std::ios::out | std::ios::trunc);
+	}
+	m_szPath.clear();
+	m_valid.fill(false);
+	m_tKeepFrom = 0;
+	m_open_blocks.clear();
+	for (size_t ii = 0; ii < TABLE_COUNT; ii++)
+	{
+		m_invalid_devices[ii].clear();
+		m_rebuild[ii] = _tRebuild();
+	}
+}
+
+bool CTimeSeriesStore::IsOpen()
+{
+	std::shared_lock<std::shared_mutex> l(m_mutex);
+	return !m_szPath.empty();
+}
+
+CTimeSeriesStore::_eTable CTimeSeriesStore::GetTable(const char *szTable)
+{
+	for (size_t ii = 0; ii < StoreTables.size(); ii++)
+	{
+		if (strcmp(szTable, StoreTables[ii].szName) == 0)
+			return static_cast<_eTable>(ii);
+	}
+	return TABLE_COUNT;
+}
+
+const char *CTimeSeriesStore::GetTableName(const _eTable table)
+{
+	return StoreTables[table].szName;
+}
+
+const std::vector<std::string> &CTimeSeriesStore::GetColumns(const _eTable table)
+{
+	return StoreTables[table].Columns;
+}
+
+int CTimeSeriesStore::GetColumn(const _eTable table, const std::string &szColumn)
+{
+	const auto &columns = StoreTables[table].Columns;
+	auto itt = std::find(columns.begin(), columns.end(), szColumn);
+	return (itt != columns.end()) ? static_cast<int>(itt - columns.begin()) : -1;
+}
+
+bool CTimeSeriesStore::IsValid(const _eTable table)
+{
+	std::shared_lock<std::shared_mutex> l(m_mutex);
+	return (!m_szPath.empty()) && m_valid[table];
+}
+
+void CTimeSeriesStore::Invalidate(const _eTable table)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	InvalidateLocked(table);
+}
+
+// Caller holds m_mutex
+void CTimeSeriesStore::InvalidateLocked(const _eTable table)
+{
+	if (m_szPath.empty())
+		return;
+	m_table_generation[table] = ++m_generation;
+	if (!m_valid[table])
+		return;
+	m_valid[table] = false;
+	std::remove(GetValidFileName(table).c_str());
+}
+
+void CTimeSeriesStore::InvalidateDevice(const _eTable table, const uint64_t idx)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	auto itt = m_invalid_devices[table].find(idx);
+	if (itt != m_invalid_devices[table].end())
+	{
+		itt->second = ++m_generation;
+		return;
+	}
+	// the marker keeps the device invalid after a restart
+	std::ofstream outfile(GetInvalidFileName(table, idx).c_str(), std::ios::out | std::ios::trunc);
+	if (!outfile.is_open())
+	{
+		InvalidateLocked(table);
+		return;
+	}
+	m_invalid_devices[table][idx] = ++m_generation;
+}
+
+std::vector<uint64_t> CTimeSeriesStore::GetInvalidDevices(const _eTable table)
+{
+	std::vector<uint64_t> devices;
+	std::shared_lock<std::shared_mutex> l(m_mutex);
+	for (const auto &itt : m_invalid_devices[table])
+		devices.push_back(itt.first);
+	return devices;
+}
+
+void CTimeSeriesStore::InvalidateAll()
+{
+	for (size_t ii = 0; ii < TABLE_COUNT; ii++)
+		Invalidate(static_cast<_eTable>(ii));
+}
+
+void CTimeSeriesStore::BeginRebuild(const _eTable table, const bool bAllDevices, const std::vector<uint64_t> &devices)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	_tRebuild &rebuild = m_rebuild[table];
+	rebuild = _tRebuild();
+	rebuild.bActive = true;
+	rebuild.bAllDevices = bAllDevices;
+	if (bAllDevices)
+	{
+		InvalidateLocked(table);
+		rebuild.TableGeneration = m_table_generation[table];
+		rebuild.Devices = m_invalid_devices[table];
+		RemoveFilesLocked([table](const _eTable ftable, uint64_t /*idx*/) { return ftable == table; });
+		return;
+	}
+	for (const auto idx : devices)
+	{
+		auto itt = m_invalid_devices[table].find(idx);
+		if (itt == m_invalid_devices[table].end())
+			continue;
+		rebuild.Devices[idx] = itt->second;
+		m_open_blocks.erase(std::make_pair(static_cast<int>(table), idx));
+		std::remove(GetFileName(table, idx).c_str());
+	}
+}
+
+void CTimeSeriesStore::AppendRebuilt(const _eTable table, const uint64_t idx, const time_t tDate, const std::vector<double> &values)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty() || (!m_rebuild[table].bActive) || (values.size() != StoreTables[table].Columns.size()))
+		return;
+	AppendSample(table, idx, tDate, values);
+}
+
+void CTimeSeriesStore::EndRebuild(const _eTable table, const bool bSuccess)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	_tRebuild rebuild;
+	std::swap(rebuild, m_rebuild[table]);
+	if (m_szPath.empty() || (!rebuild.bActive) || (!bSuccess))
+		return;
+	// newer than the rows of the database that were read, samples that were read as well are ignored as duplicates
+	for (const auto &sample : rebuild.Pending)
+		AppendSample(table, sample.idx, sample.tDate, sample.Values);
+	for (const auto &itt : rebuild.Devices)
+	{
+		auto ittInvalid = m_invalid_devices[table].find(itt.first);
+		if ((ittInvalid == m_invalid_devices[table].end()) || (ittInvalid->second != itt.second))
+			continue; // changed again during the rebuild
+		m_invalid_devices[table].erase(ittInvalid);
+		std::remove(GetInvalidFileName(table, itt.first).c_str());
+	}
+	if ((rebuild.bAllDevices) && (m_table_generation[table] == rebuild.TableGeneration))
+	{
+		std::ofstream outfile(GetValidFileName(table).c_str(), std::ios::out | std::ios::trunc);
+		m_valid[table] = outfile.is_open();
+	}
+}
+
+void CTimeSeriesStore::Append(const _eTable table, const uint64_t idx, const time_t tDate, const std::vector<double> &values)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty() || (values.size() != StoreTables[table].Columns.size()))
+		return;
+	_tRebuild &rebuild = m_rebuild[table];
+	if ((rebuild.bActive) && ((rebuild.bAllDevices) || (rebuild.Devices.find(idx) != rebuild.Devices.end())))
+	{
+		// the rebuild may not have read this row, it is appended when the rebuild is done
+		rebuild.Pending.push_back({ idx, tDate, values });
+		return;
+	}
+	if (m_invalid_devices[table].find(idx) != m_invalid_devices[table].end())
+		return; // rebuilt from the database later
+	AppendSample(table, idx, tDate, values);
+}
+
+// Caller holds m_mutex. The sample is added to the block in memory, the block is written when it is full.
+void CTimeSeriesStore::AppendSample(const _eTable table, const uint64_t idx, const time_t tDate, const std::vector<double> &values)
+{
+	auto key = std::make_pair(static_cast<int>(table), idx);
+	auto itt = m_open_blocks.find(key);
+	if (itt == m_open_blocks.end())
+	{
+		_tOpenBlock block;
+		if (!LoadOpenBlock(table, idx, block))
+			return;
+		itt = m_open_blocks.emplace(key, block).first;
+	}
+	_tOpenBlock &block = itt->second;
+	if ((block.LastTime != 0) && (tDate <= block.LastTime))
+		return;
+	block.Times.push_back(tDate);
+	block.Values.insert(block.Values.end(), values.begin(), values.end());
+	block.LastTime = tDate;
+	block.bDirty = true;
+	if (block.Times.size() < TSS_BLOCK_SAMPLES)
+		return;
+	if (!WriteOpenBlock(table, idx, block))
+	{
+		// the samples of the block are lost, the device has to be read from the database again
+		m_open_blocks.erase(itt);
+		InvalidateLocked(table);
+		return;
+	}
+	block.Offset += sizeof(_tBlockHeader) + block.Bytes;
+	block.Times.clear();
+	block.Values.clear();
+	block.Bytes = 0;
+}
+
+bool CTimeSeriesStore::Read(const _eTable table, const uint64_t idx, const time_t tFrom, const std::function<bool(time_t tDate, const double *values)> &fn)
+{
+	std::shared_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty() || (!m_valid[table]))
+		return false;
+	if (m_invalid_devices[table].find(idx) != m_invalid_devices[table].end())
+		return false;
+	const time_t tStart = std::max(tFrom, m_tKeepFrom);
+	const size_t nColumns = StoreTables[table].Columns.size();
+	// the file holds the blocks before the open block (and maybe an older copy of it)
+	auto ittOpen = m_open_blocks.find(std::make_pair(static_cast<int>(table), idx));
+	const _tOpenBlock *pOpen = (ittOpen != m_open_blocks.end()) ? &ittOpen->second : nullptr;
+	bool bStopped = false;
+	std::string szFile = GetFileName(table, idx);
+	if (file_exist(szFile.c_str()))
+	{
+		try
+		{
+			boost::interprocess::file_mapping mapping(szFile.c_str(), boost::interprocess::read_only);
+			boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+			const uint8_t *pData = static_cast<const uint8_t *>(region.get_address());
+			std::vector<time_t> times;
+			std::vector<double> values;
+			bool bCorrupt = false;
+			ForEachBlock(pData, region.get_size(), [&](const size_t offset, const _tBlockHeader &header) {
+				if ((pOpen != nullptr) && (offset >= pOpen->Offset))
+					return false;
+				if (header.Last < static_cast<int64_t>(tStart))
+					return true;
+				if (!DecodeBlock(header, pData + offset + sizeof(header), nColumns, times, values))
+				{
+					_log.Log(LOG_ERROR, "TimeSeriesStore: Corrupt block in %s", szFile.c_str());
+					bCorrupt = true;
+					return false;
+				}
+				for (size_t ii = 0; ii < times.size(); ii++)
+				{
+					if ((times[ii] >= tStart) && (!fn(times[ii], &values[ii * nColumns])))
+					{
+						bStopped = true;
+						return false;
+					}
+				}
+				return true;
+			});
+			if (bCorrupt)
+			{
+				// the next CleanupShortLog rebuilds it from the database
+				l.unlock();
+				InvalidateDevice(table, idx);
+				return false;
+			}
+		}
+		catch (const boost::interprocess::interprocess_exception &e)
+		{
+			// an empty file can not be mapped
+			std::ifstream infile(szFile.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+			if ((!infile.is_open()) || (infile.tellg() != 0))
+			{
+				_log.Log(LOG_ERROR, "TimeSeriesStore: Could not map %s (%s)", szFile.c_str(), e.what());
+				return false;
+			}
+		}
+	}
+	if ((pOpen == nullptr) || bStopped)
+		return true;
+	for (size_t ii = 0; ii < pOpen->Times.size(); ii++)
+	{
+		if ((pOpen->Times[ii] >= tStart) && (!fn(pOpen->Times[ii], &pOpen->Values[ii * nColumns])))
+			break;
+	}
+	return true;
+}
+
+void CTimeSeriesStore::Trim(const time_t tBefore)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	m_tKeepFrom = tBefore;
+	// the files are rewritten below, the open blocks are loaded from them again
+	FlushOpenBlocks();
+	std::vector<std::string> entries;
+	DirectoryListing(entries, m_szPath, false, true);
+	for (const auto &szName : entries)
+	{
+		_eTable table;
+		uint64_t idx;
+		if (!ParseFileName(szName, table, idx))
+			continue;
+		std::string szFile = m_szPath + szName;
+		std::vector<uint8_t> data;
+		if (!ReadFile(szFile, data))
+			continue;
+		size_t keep = 0;
+		size_t valid = ForEachBlock(data.data(), data.size(), [&keep, tBefore](const size_t offset, const _tBlockHeader &header) {
+			if (header.Last < static_cast<int64_t>(tBefore))
+				return true;
+			keep = offset; // the first block that is still needed
+			return false;
+		});
+		if (valid == 0)
+			continue; // not a store file
+		if (keep == 0)
+		{
+			// all blocks are older
+			m_open_blocks.erase(std::make_pair(static_cast<int>(table), idx));
+			std::remove(szFile.c_str());
+			continue;
+		}
+		if (keep == TSS_FILE_HEADER_SIZE)
+			continue;
+		std::vector<uint8_t> kept(data.begin(), data.begin() + TSS_FILE_HEADER_SIZE);
+		kept.insert(kept.end(), data.begin() + keep, data.end());
+		m_open_blocks.erase(std::make_pair(static_cast<int>(table), idx));
+		if (!WriteFile(szFile, kept.data(), kept.size()))
+			_log.Log(LOG_ERROR, "TimeSeriesStore: Could not write %s", szFile.c_str());
+	}
+}
+
+void CTimeSeriesStore::Clear()
+{
+	RemoveFiles([](_eTable /*table*/, uint64_t /*idx*/) { return true; });
+}
+
+void CTimeSeriesStore::GetStatistics(uint64_t &nBytes, uint64_t &nSamples)
+{
+	nBytes = 0;
+	nSamples = 0;
+	std::shared_lock<std::shared_mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	std::vector<std::string> entries;
+	DirectoryListing(entries, m_szPath, false, true);
+	for (const auto &szName : entries)
+	{
+		_eTable table;
+		uint64_t idx;
+		std::vector<uint8_t> data;
+		if ((!ParseFileName(szName, table, idx)) || (!ReadFile(m_szPath + szName, data)))
+			continue;
+		nBytes += data.size();
+		auto itt = m_open_blocks.find(std::make_pair(static_cast<int>(table), idx));
+		const uint64_t openOffset = (itt != m_open_blocks.end()) ? itt->second.Offset : data.size();
+		ForEachBlock(data.data(), data.size(), [&nSamples, openOffset](size_t offset, const _tBlockHeader &header) {
+			if (offset >= openOffset)
+				return false;
+			nSamples += header.Count;
+			return true;
+		});
+	}
+	for (const auto &itt : m_open_blocks)
+		nSamples += itt.second.Times.size();
+}
+
+std::string CTimeSeriesStore::GetFileName(const _eTable table, const uint64_t idx) const
+{
+	return m_szPath + StoreTables[table].szName + "_" + std::to_string(idx) + TSS_FILE_EXTENSION;
+}
+
+std::string CTimeSeriesStore::GetValidFileName(const _eTable table) const
+{
+	return m_szPath + StoreTables[table].szName + ".valid";
+}
+
+std::string CTimeSeriesStore::GetInvalidFileName(const _eTable table, const uint64_t idx) const
+{
+	return m_szPath + StoreTables[table].szName + "_" + std::to_string(idx) + TSS_INVALID_EXTENSION;
+}
+
+std::string CTimeSeriesStore::GetCleanFileName() const
+{
+	return m_szPath + "clean";
+}
+
+// Caller holds m_mutex
+bool CTimeSeriesStore::LoadOpenBlock(const _eTable table, const uint64_t idx, _tOpenBlock &block)
+{
+	std::string szFile = GetFileName(table, idx);
+	std::vector<uint8_t> data;
+	if (!ReadFile(szFile, data))
+	{
+		// new file
+		block.Offset = TSS_FILE_HEADER_SIZE;
+		return true;
+	}
+	const size_t nColumns = StoreTables[table].Columns.size();
+	size_t lastOffset = 0;
+	_tBlockHeader lastHeader{};
+	size_t valid = ForEachBlock(data.data(), data.size(), [&](const size_t offset, const _tBlockHeader &header) {
+		lastOffset = offset;
+		lastHeader = header;
+		return true;
+	});
+	if ((valid < TSS_FILE_HEADER_SIZE) || (data[4] != nColumns))
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: %s is not a store file of this table, starting a new one", szFile.c_str());
+		std::remove(szFile.c_str());
+		block.Offset = TSS_FILE_HEADER_SIZE;
+		return true;
+	}
+	if ((valid < data.size()) && (!WriteFile(szFile, data.data(), valid)))
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: Could not truncate %s", szFile.c_str());
+		return false;
+	}
+	if (lastOffset == 0)
+	{
+		block.Offset = valid;
+		return true;
+	}
+	block.LastTime = static_cast<time_t>(lastHeader.Last);
+	if (lastHeader.Count >= TSS_BLOCK_SAMPLES)
+	{
+		block.Offset = valid;
+		return true;
+	}
+	if (!DecodeBlock(lastHeader, data.data() + lastOffset + sizeof(lastHeader), nColumns, block.Times, block.Values))
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: Corrupt block in %s", szFile.c_str());
+		return false;
+	}
+	block.Offset = lastOffset;
+	block.Bytes = lastHeader.Bytes;
+	return true;
+}
+
+// Caller holds m_mutex. Writes the block over its previous version, which is never longer.
+bool CTimeSeriesStore::WriteOpenBlock(const _eTable table, const uint64_t idx, _tOpenBlock &block)
+{
+	std::string szFile = GetFileName(table, idx);
+	const size_t nColumns = StoreTables[table].Columns.size();
+	std::vector<uint8_t> bytes = EncodeBlock(block.Times, block.Values, nColumns);
+	_tBlockHeader header{};
+	header.Count = static_cast<uint16_t>(block.Times.size());
+	header.Bytes = static_cast<uint32_t>(bytes.size());
+	header.First = static_cast<int64_t>(block.Times.front());
+	header.Last = static_cast<int64_t>(block.Times.back());
+
+	std::fstream file(szFile.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		file.open(szFile.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			_log.Log(LOG_ERROR, "TimeSeriesStore: Could not create %s", szFile.c_str());
+			return false;
+		}
+		uint8_t fileHeader[TSS_FILE_HEADER_SIZE] = { 0 };
+		memcpy(fileHeader, TSS_MAGIC, sizeof(TSS_MAGIC));
+		fileHeader[4] = static_cast<uint8_t>(nColumns);
+		file.write(reinterpret_cast<const char *>(fileHeader), sizeof(fileHeader));
+	}
+	file.seekp(block.Offset);
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+	if (!file.good())
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: Could not write %s", szFile.c_str());
+		return false;
+	}
+	block.Bytes = bytes.size();
+	block.bDirty = false;
+	return true;
+}
+
+// Caller holds m_mutex. Writes the samples that are only held in memory, false when one of the files could not be written.
+bool CTimeSeriesStore::FlushOpenBlocks()
+{
+	bool bResult = true;
+	for (auto &itt : m_open_blocks)
+	{
+		_tOpenBlock &block = itt.second;
+		if ((!block.bDirty) || block.Times.empty())
+			continue;
+		if (!WriteOpenBlock(static_cast<_eTable>(itt.first.first), itt.first.second, block))
+			bResult = false;
+	}
+	return bResult;
+}
+
+void CTimeSeriesStore::RemoveFiles(const std::function<bool(_eTable table, uint64_t idx)> &Match)
+{
+	std::unique_lock<std::shared_mutex> l(m_mutex);
+	RemoveFilesLocked(Match);
+}
+
+// Caller holds m_mutex
+void CTimeSeriesStore::RemoveFilesLocked(const std::function<bool(_eTable table, uint64_t idx)> &Match)
+{
+	if (m_szPath.empty())
+		return;
+	std::vector<std::string> entries;
+	DirectoryListing(entries, m_szPath, false, true);
+	for (const auto &szName : entries)
+	{
+		_eTable table;
+		uint64_t idx;
+		if (ParseFileName(szName, table, idx) && Match(table, idx))
+			std::remove((m_szPath + szName).c_str());
+	}
+	// also the blocks that were not written yet
+	for (auto itt = m_open_blocks.begin(); itt != m_open_blocks.end();)
+	{
+		if (Match(static_cast<_eTable>(itt->first.first), itt->first.second))
+			itt = m_open_blocks.erase(itt);
+		else
+			++itt;
+	}
+}
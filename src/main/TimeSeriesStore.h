@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Read cache of the 5 minute short log tables (Temperature, Rain, Wind, UV, Meter, MultiMeter, Percentage and Fan),
+// so the day graphs read a device's samples sequentially from one file instead of through the database.
+// It is not the storage of these tables: every row is still written to the database, so the store adds to the disk
+// space used. Every device of a table has its own append-only file of blocks of up to TSS_BLOCK_SAMPLES samples.
+// Timestamps are stored as delta-of-delta and the values with the XOR scheme of Facebook's Gorilla, which keeps the
+// copy small. Files are memory mapped for reading. The last block of a device is kept in memory and only written
+// when it is full or when the store is closed; a store that was not closed cleanly is rebuilt.
+//
+// A table or device is only read from the store while it is valid: changes to the table that were not appended here
+// (the sqlite update hook calls Invalidate or InvalidateDevice) make it invalid until it is rebuilt from the database.
+class CTimeSeriesStore
+{
+public:
+	enum _eTable
+	{
+		TABLE_TEMPERATURE = 0,
+		TABLE_RAIN,
+		TABLE_WIND,
+		TABLE_UV,
+		TABLE_METER,
+		TABLE_MULTIMETER,
+		TABLE_PERCENTAGE,
+		TABLE_FAN,
+		TABLE_COUNT
+	};
+
+	~CTimeSeriesStore();
+
+	// szPath is the directory of the store, it is created when needed
+	bool Open(const std::string &szPath);
+	void Close();
+	bool IsOpen();
+
+	// TABLE_COUNT for tables that are not stored
+	static _eTable GetTable(const char *szTable);
+	static const char *GetTableName(_eTable table);
+	// The stored columns of a table in database order, without DeviceRowID and Date
+	static const std::vector<std::string> &GetColumns(_eTable table);
+	// -1 when the column is not stored
+	static int GetColumn(_eTable table, const std::string &szColumn);
+
+	bool IsValid(_eTable table);
+	void Invalidate(_eTable table);
+	void InvalidateDevice(_eTable table, uint64_t idx);
+	void InvalidateAll();
+	std::vector<uint64_t> GetInvalidDevices(_eTable table);
+
+	// Rebuild of the whole table (bAllDevices) or of the given devices: BeginRebuild drops their samples,
+	// AppendRebuilt adds the rows read from the database, EndRebuild makes them valid again unless they were
+	// invalidated meanwhile. Samples appended by the writer during the rebuild are held back until EndRebuild.
+	void BeginRebuild(_eTable table, bool bAllDevices, const std::vector<uint64_t> &devices);
+	void AppendRebuilt(_eTable table, uint64_t idx, time_t tDate, const std::vector<double> &values);
+	void EndRebuild(_eTable table, bool bSuccess);
+
+	// values holds GetColumns(table).size() values, samples older than the last one of the device are ignored
+	void Append(_eTable table, uint64_t idx, time_t tDate, const std::vector<double> &values);
+	// Calls fn for the samples with a date of tFrom or later in time order, until it returns false
+	bool Read(_eTable table, uint64_t idx, time_t tFrom, const std::function<bool(time_t tDate, const double *values)> &fn);
+	// Removes the blocks that only hold samples older than tBefore, the older samples of the other blocks are no longer read
+	void Trim(time_t tBefore);
+	void Clear();
+
+	// Size of all files of the store in bytes and the number of samples they hold
+	void GetStatistics(uint64_t &nBytes, uint64_t &nSamples);
+
+private:
+	struct _tOpenBlock
+	{
+		uint64_t Offset = 0; // of the block header in the file
+		size_t Bytes = 0;    // of the bit stream as written
+		time_t LastTime = 0; // of the device, also when the block is still empty
+		bool bDirty = false; // holds samples that are not in the file yet
+		std::vector<time_t> Times;
+		std::vector<double> Values; // Times.size() rows of all columns
+	};
+
+	struct _tSample
+	{
+		uint64_t idx;
+		time_t tDate;
+		std::vector<double> Values;
+	};
+
+	struct _tRebuild
+	{
+		bool bActive = false;
+		bool bAllDevices = false;
+		uint64_t TableGeneration = 0;
+		std::map<uint64_t, uint64_t> Devices; // device and its generation at the start
+		std::vector<_tSample> Pending;	      // appended by the writer meanwhile
+	};
+
+	std::string GetFileName(_eTable table, uint64_t idx) const;
+	std::string GetValidFileName(_eTable table) const;
+	std::string GetInvalidFileName(_eTable table, uint64_t idx) const;
+	std::string GetCleanFileName() const;
+	void AppendSample(_eTable table, uint64_t idx, time_t tDate, const std::vector<double> &values);
+	bool LoadOpenBlock(_eTable table, uint64_t idx, _tOpenBlock &block);
+	bool WriteOpenBlock(_eTable table, uint64_t idx, _tOpenBlock &block);
+	bool FlushOpenBlocks();
+	void InvalidateLocked(_eTable table);
+	void RemoveFiles(const std::function<bool(_eTable table, uint64_t idx)> &Match);
+	void RemoveFilesLocked(const std::function<bool(_eTable table, uint64_t idx)> &Match);
+
+	std::shared_mutex m_mutex;
+	std::string m_szPath;
+	std::array<bool, TABLE_COUNT> m_valid{};
+	time_t m_tKeepFrom = 0;
+	std::map<std::pair<int, uint64_t>, _tOpenBlock> m_open_blocks;
+	// Changes the store did not follow bump a generation, so a rebuild that ran meanwhile does not mark them valid
+	uint64_t m_generation = 0;
+	std::array<uint64_t, TABLE_COUNT> m_table_generation{};
+	std::array<std::map<uint64_t, uint64_t>, TABLE_COUNT> m_invalid_devices; // device and its generation
+	std::array<_tRebuild, TABLE_COUNT> m_rebuild;
+};
@@ -14,12 +14,16 @@
 #include "main/json_helper.h"
 #include "LuaHandler.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "DeviceFields.h"
+#include "WorkerPool.h"
 #include "SQLHelper.h"
 #include "protocols/HTTPClient.h"
 #include "hardware/hardwaretypes.h"
 #include "webserver/Base64.h"
 #include "protocols/SMTPClient.h"
 #include "push/BasePush.h"
+#include "push/InfluxPush.h"
 #include "notifications/NotificationHelper.h"
 
 #ifdef ENABLE_PYTHON
@@ -232,8 +236,9 @@ namespace http
 			m_pWebEm->RegisterPageCode("/raspberry.cgi", [this](auto&& session, auto&& req, auto&& rep) { GetInternalCameraSnapshot(session, req, rep); });
 			m_pWebEm->RegisterPageCode("/uvccapture.cgi", [this](auto&& session, auto&& req, auto&& rep) { GetInternalCameraSnapshot(session, req, rep); });
 			// Maybe handle these differently? (Or remove)
-			m_pWebEm->RegisterPageCode("/images/floorplans/plan", [this](auto&& session, auto&& req, auto&& rep) { GetFloorplanImage(session, req, rep); });
-			m_pWebEm->RegisterPageCode("/service-worker.js", [this](auto&& session, auto&& req, auto&& rep) { GetServiceWorker(session, req, rep); });
+			m_pWebEm->RegisterPageCode("/images/floorplans/plan", [this](auto&& session, auto&& req, auto&& rep) { GetFloorplanImage(session, req, rep); }, false, true);
+			m_pWebEm->RegisterPageCode("/service-worker.js", [this](auto&& session, auto&& req, auto&& rep) { GetServiceWorker(session, req, rep); }, false, true);
+			m_pWebEm->RegisterPageCode("/metrics", [this](auto&& session, auto&& req, auto&& rep) { GetMetrics(session, req, rep); }, false, true);
 
 			// End of 'Pages' to be moved...
 
@@ -268,8 +273,9 @@ namespace http
 			RegisterCommandCode("sendopenthermcommand", [this](auto&& session, auto&& req, auto&& root) { Cmd_SendOpenThermCommand(session, req, root); });
 
 			RegisterCommandCode("storesettings", [this](auto&& session, auto&& req, auto&& root) { Cmd_PostSettings(session, req, root); });
-			RegisterCommandCode("getlog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetLog(session, req, root); });
+			RegisterStreamCommandCode("getlog", [this](auto&& session, auto&& req, auto&& rep) { return Cmd_StreamLog(session, req, rep); });
 			RegisterCommandCode("clearlog", [this](auto&& session, auto&& req, auto&& root) { Cmd_ClearLog(session, req, root); });
+			RegisterCommandCode("getrxqueuestatus", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetRxQueueStatus(session, req, root); });
 			RegisterCommandCode("gethardwaretypes", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetHardwareTypes(session, req, root); });
 			RegisterCommandCode("addhardware", [this](auto&& session, auto&& req, auto&& root) { Cmd_AddHardware(session, req, root); });
 			RegisterCommandCode("updatehardware", [this](auto&& session, auto&& req, auto&& root) { Cmd_UpdateHardware(session, req, root); });
@@ -483,7 +489,7 @@ namespace http
 			// Migrated RTypes to regular commands
 			RegisterCommandCode("getusers", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetUsers(session, req, root); });
 			RegisterCommandCode("getsettings", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetSettings(session, req, root); });
-			RegisterCommandCode("getdevices", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetDevices(session, req, root); });
+			RegisterStreamCommandCode("getdevices", [this](auto&& session, auto&& req, auto&& rep) { return Cmd_StreamDevices(session, req, rep); });
 			RegisterCommandCode("gethardware", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetHardware(session, req, root); });
 			RegisterCommandCode("events", [this](auto&& session, auto&& req, auto&& root) { Cmd_Events(session, req, root); });
 
@@ -495,7 +501,7 @@ namespace http
 			RegisterCommandCode("createvirtualsensor", [this](auto&& session, auto&& req, auto&& root) { Cmd_CreateMappedSensor(session, req, root); });
 			RegisterCommandCode("createdevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_CreateDevice(session, req, root); });
 
-			RegisterCommandCode("getscenelog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetSceneLog(session, req, root); });
+			RegisterStreamCommandCode("getscenelog", [this](auto&& session, auto&& req, auto&& rep) { return Cmd_StreamSceneLog(session, req, rep); });
 			RegisterCommandCode("getscenes", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetScenes(session, req, root); });
 			RegisterCommandCode("addscene", [this](auto&& session, auto&& req, auto&& root) { Cmd_AddScene(session, req, root); });
 			RegisterCommandCode("deletescene", [this](auto&& session, auto&& req, auto&& root) { Cmd_DeleteScene(session, req, root); });
@@ -509,8 +515,8 @@ namespace http
 			RegisterCommandCode("getsetpointtimers", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetSetpointTimers(session, req, root); });
 			RegisterCommandCode("getplans", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetPlans(session, req, root); });
 			RegisterCommandCode("getfloorplans", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetFloorPlans(session, req, root); });
-			RegisterCommandCode("getlightlog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetLightLog(session, req, root); });
-			RegisterCommandCode("gettextlog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetTextLog(session, req, root); });
+			RegisterStreamCommandCode("getlightlog", [this](auto&& session, auto&& req, auto&& rep) { return Cmd_StreamLightLog(session, req, rep); });
+			RegisterStreamCommandCode("gettextlog", [this](auto&& session, auto&& req, auto&& rep) { return Cmd_StreamTextLog(session, req, rep); });
 			RegisterCommandCode("gettransfers", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetTransfers(session, req, root); });
 			RegisterCommandCode("dotransferdevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_DoTransferDevice(session, req, root); });
 			RegisterCommandCode("createrflinkdevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_CreateRFLinkDevice(session, req, root); });
@@ -519,6 +525,7 @@ namespace http
 			RegisterCommandCode("custom_light_icons", [this](auto&& session, auto&& req, auto&& root) { Cmd_CustomLightIcons(session, req, root); });
 			RegisterCommandCode("deletedevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_DeleteDevice(session, req, root); });
 			RegisterCommandCode("graph", [this](auto&& session, auto&& req, auto&& root) { Cmd_HandleGraph(session, req, root); });
+			RegisterStreamCommandCode("graph", [this](auto&& session, auto&& req, auto&& rep) { return Cmd_StreamGraph(session, req, rep); });
 			RegisterCommandCode("rclientslog", [this](auto&& session, auto&& req, auto&& root) { Cmd_RemoteWebClientsLog(session, req, root); });
 			RegisterCommandCode("setused", [this](auto&& session, auto&& req, auto&& root) { Cmd_SetUsed(session, req, root); });
 
@@ -620,6 +627,22 @@ namespace http
 			//Whitelist
 			m_pWebEm->RegisterWhitelistURLString("/images/floorplans/plan");
 
+			// JSON commands that only read, these run at the same time as other read-only requests
+			// (getgpio, getsysfsgpio and getopenzwavenodes talk to hardware and run exclusively)
+			for (const char* idname : { "getapplications", "getauth", "getcameras", "getcameras_user", "getcamactivedevices", "getconfig", "getcosts",
+						    "getcustomiconset", "getdevices", "getdevicevalueoptions", "getdevicevalueoptionwording", "getdynamicpricedevices",
+						    "getenergydashboarddevices", "getfibarolinkconfig", "getfibarolinks", "getfloorplanimages", "getfloorplanplans",
+						    "getfloorplans", "getforecastconfig", "getgooglepubsublinkconfig", "getgooglepubsublinks", "gethardware",
+						    "gethardwaretypes", "gethttplinkconfig", "gethttplinks", "getinfluxlinkconfig", "getinfluxlinks", "getlanguages",
+						    "getlightlog", "getlightswitches", "getlightswitchesscenes", "getlog", "getmanualhardware", "getmetertypes",
+						    "getmobiles", "getmqttlinkconfig", "getmqttlinks", "getmyprofile", "getnotifications", "getnotificationtypes",
+						    "getplandevices", "getplans", "getrxqueuestatus", "getsceneactivations", "getscenedevices", "getscenelog",
+						    "getscenes", "getscenetimers", "getschedules", "getsecstatus", "getServerTime", "getsetpointtimers", "getsettings",
+						    "getsharedmqttdevices", "getshareduserdevices", "getsubdevices", "getSunRiseSet", "getswitchtypes", "gettextlog",
+						    "getthemes", "gettimerplans", "gettimers", "gettimertypes", "gettitle", "gettransfers", "getunusedfloorplanplans",
+						    "getunusedplandevices", "getuptime", "getusers", "getuservariable", "getuservariables", "getversion", "graph" })
+				m_pWebEm->RegisterReadOnlyCommandString(idname);
+
 			_log.Debug(DEBUG_WEBSERVER, "WebServer(%s) started with %d Registered Commands", m_server_alias.c_str(), (int)m_webcommands.size());
 			m_pWebEm->DebugRegistrations();
 
@@ -699,6 +722,11 @@ namespace http
 			}
 		}
 
+		void CWebServer::RegisterStreamCommandCode(const char* idname, const webserver_stream_function& StreamFunction)
+		{
+			m_webstreamcommands[idname] = StreamFunction;
+		}
+
 		bool CWebServer::IsIdxForUser(const WebEmSession* pSession, const int Idx)
 		{
 			if (pSession->rights == 2)
@@ -915,9 +943,91 @@ namespace http
 			return iAdmins;
 		}
 
+		// szWhere selects the hardware, all hardware when empty
+		std::map<int, _tHardwareListInt> CWebServer::GetHardwareNames(const std::string& szWhere)
+		{
+			std::map<int, _tHardwareListInt> _hardwareNames;
+			auto result = m_sql.safe_query("SELECT ID, Name, Enabled, Type, Mode1, Mode2 FROM Hardware%s", szWhere.c_str());
+			for (const auto& sd : result)
+			{
+				_tHardwareListInt tlist;
+				int ID = atoi(sd[0].c_str());
+				tlist.Name = sd[1];
+				tlist.Enabled = (atoi(sd[2].c_str()) != 0);
+				tlist.HardwareTypeVal = atoi(sd[3].c_str());
+#ifndef ENABLE_PYTHON
+				tlist.HardwareType = hardware::type::Long_Desc(tlist.HardwareTypeVal);
+#else
+				if (tlist.HardwareTypeVal != hardware::type::PythonPlugin)
+				{
+					tlist.HardwareType = hardware::type::Long_Desc(tlist.HardwareTypeVal);
+				}
+				else
+				{
+					tlist.HardwareType = PluginHardwareDesc(ID);
+				}
+#endif
+				tlist.Mode1 = sd[4];
+				tlist.Mode2 = sd[5];
+				_hardwareNames[ID] = tlist;
+			}
+			return _hardwareNames;
+		}
+
+		bool CWebServer::GetDeviceFields(const uint64_t idx, CDeviceFields& fields)
+		{
+			// Same row as GetJSonDevices returns for rowid=idx without a user, with hidden devices shown and disabled hardware left out
+			auto result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used, A.Type, A.SubType,"
+				" A.SignalLevel, A.BatteryLevel, A.nValue, A.sValue,"
+				" A.LastUpdate, A.Favorite, A.SwitchType, A.HardwareID,"
+				" A.AddjValue, A.AddjMulti, A.AddjValue2, A.AddjMulti2,"
+				" A.LastLevel, A.CustomImage, A.StrParam1, A.StrParam2,"
+				" A.Protected, IFNULL(B.XOffset,0), IFNULL(B.YOffset,0), IFNULL(B.PlanID,0), A.Description,"
+				" A.Options, A.Color "
+				"FROM DeviceStatus A LEFT OUTER JOIN DeviceToPlansMap as B ON (B.DeviceRowID==a.ID) "
+				"WHERE (A.ID == %" PRIu64 ") LIMIT 1",
+				idx);
+			if (result.empty())
+				return false;
+			const std::vector<std::string>& sd = result[0];
+			if (atoi(sd[5].c_str()) == pTypeTEMP_RAIN)
+				return false;
+
+			std::map<int, _tHardwareListInt> _hardwareNames = GetHardwareNames(" WHERE (ID == " + sd[14] + ")");
+			auto hItt = _hardwareNames.find(atoi(sd[14].c_str()));
+			if ((hItt != _hardwareNames.end()) && (!(*hItt).second.Enabled))
+				return false;
+
+			_tDeviceFieldsContext ctx;
+			ctx.now = mytime(nullptr);
+			localtime_r(&ctx.now, &ctx.tm1);
+			ctx.SensorTimeOut = 60;
+			m_sql.GetPreferencesVar("SensorTimeout", ctx.SensorTimeOut);
+			ctx.pHardwareNames = &_hardwareNames;
+			try
+			{
+				return ComputeDeviceFields(sd, sd[3], ctx, fields);
+			}
+			catch (const std::exception& e)
+			{
+				_log.Log(LOG_ERROR, "GetDeviceFields: exception occurred : '%s'", e.what());
+			}
+			return false;
+		}
+
 		void CWebServer::GetJSonDevices(Json::Value& root, const std::string& rused, const std::string& rfilter, const std::string& order, const std::string& rowid, const std::string& planID,
 			const std::string& floorID, const bool bDisplayHidden, const bool bDisplayDisabled, const bool bFetchFavorites, const time_t LastUpdate,
 			const std::string& username, const std::string& hardwareid)
+		{
+			Json::ArrayIndex ii = 0;
+			GetJSonDevices(
+				root, [&root, &ii](Json::Value& item) { root["result"][ii++].swap(item); }, rused, rfilter, order, rowid, planID, floorID, bDisplayHidden, bDisplayDisabled,
+				bFetchFavorites, LastUpdate, username, hardwareid);
+		}
+
+		void CWebServer::GetJSonDevices(Json::Value& root, const std::function<void(Json::Value& item)>& AddResult, const std::string& rused, const std::string& rfilter,
+			const std::string& order, const std::string& rowid, const std::string& planID, const std::string& floorID, const bool bDisplayHidden,
+			const bool bDisplayDisabled, const bool bFetchFavorites, const time_t LastUpdate, const std::string& username, const std::string& hardwareid)
 		{
 			std::vector<std::vector<std::string>> result;
 
@@ -933,34 +1043,7 @@ namespace http
 			m_sql.GetPreferencesVar("SensorTimeout", SensorTimeOut);
 
 			// Get All Hardware ID's/Names, need them later
-			std::map<int, _tHardwareListInt> _hardwareNames;
-			result = m_sql.safe_query("SELECT ID, Name, Enabled, Type, Mode1, Mode2 FROM Hardware");
-			if (!result.empty())
-			{
-				for (const auto& sd : result)
-				{
-					_tHardwareListInt tlist;
-					int ID = atoi(sd[0].c_str());
-					tlist.Name = sd[1];
-					tlist.Enabled = (atoi(sd[2].c_str()) != 0);
-					tlist.HardwareTypeVal = atoi(sd[3].c_str());
-#ifndef ENABLE_PYTHON
-					tlist.HardwareType = hardware::type::Long_Desc(tlist.HardwareTypeVal);
-#else
-					if (tlist.HardwareTypeVal != hardware::type::PythonPlugin)
-					{
-						tlist.HardwareType = hardware::type::Long_Desc(tlist.HardwareTypeVal);
-					}
-					else
-					{
-						tlist.HardwareType = PluginHardwareDesc(ID);
-					}
-#endif
-					tlist.Mode1 = sd[4];
-					tlist.Mode2 = sd[5];
-					_hardwareNames[ID] = tlist;
-				}
-			}
+			std::map<int, _tHardwareListInt> _hardwareNames = GetHardwareNames("");
 
 			root["ActTime"] = static_cast<int>(now);
 
@@ -1008,8 +1091,6 @@ namespace http
 				sprintf(szOrderBy, "A.[Order],A.%s ASC", order.c_str());
 			}
 
-			unsigned char tempsign = m_sql.m_tempsign[0];
-
 			bool bHaveUser = false;
 			int iUser = -1;
 			unsigned int totUserDevices = 0;
@@ -1044,7 +1125,19 @@ namespace http
 			std::set<std::string> _HiddenDevices;
 			bool bAllowDeviceToBeHidden = false;
 
-			int ii = 0;
+			// The last result is held back, the next row can be the same device on another plan
+			Json::Value pending;
+			auto AddPending = [&pending, &AddResult](Json::Value& item) {
+				if (!pending.isNull())
+					AddResult(pending);
+				pending.swap(item);
+			};
+			auto FlushPending = [&pending, &AddResult]() {
+				if (!pending.isNull())
+					AddResult(pending);
+				pending = Json::Value();
+			};
+
 			if (rfilter == "all")
 			{
 				if ((bShowScenes) && ((rused == "all") || (rused == "true")))
@@ -1111,16 +1204,17 @@ namespace http
 								continue;
 							}
 
+							Json::Value item;
 							if (scenetype == 0)
 							{
-								root["result"][ii]["Type"] = "Scene";
-								root["result"][ii]["TypeImg"] = "scene";
-								root["result"][ii]["Image"] = "Push";
+								item["Type"] = "Scene";
+								item["TypeImg"] = "scene";
+								item["Image"] = "Push";
 							}
 							else
 							{
-								root["result"][ii]["Type"] = "Group";
-								root["result"][ii]["TypeImg"] = "group";
+								item["Type"] = "Group";
+								item["TypeImg"] = "group";
 							}
 
 							// has this scene/group already been seen, now with different plan?
@@ -1128,52 +1222,51 @@ namespace http
 							// if the idx and the Type are equal (type to prevent matching against Scene with same idx)
 							std::string thisIdx = sd[0];
 
-							if ((ii > 0) && thisIdx == root["result"][ii - 1]["idx"].asString())
+							if ((!pending.isNull()) && thisIdx == pending["idx"].asString())
 							{
-								std::string typeOfThisOne = root["result"][ii]["Type"].asString();
-								if (typeOfThisOne == root["result"][ii - 1]["Type"].asString())
+								std::string typeOfThisOne = item["Type"].asString();
+								if (typeOfThisOne == pending["Type"].asString())
 								{
-									root["result"][ii - 1]["PlanIDs"].append(atoi(sd[9].c_str()));
+									pending["PlanIDs"].append(atoi(sd[9].c_str()));
 									continue;
 								}
 							}
 
-							root["result"][ii]["idx"] = sd[0];
-							root["result"][ii]["Name"] = sSceneName;
-							root["result"][ii]["Description"] = sd[10];
-							root["result"][ii]["Favorite"] = favorite;
-							root["result"][ii]["Protected"] = (iProtected != 0);
-							root["result"][ii]["LastUpdate"] = sLastUpdate;
-							root["result"][ii]["PlanID"] = sd[9].c_str();
+							item["idx"] = sd[0];
+							item["Name"] = sSceneName;
+							item["Description"] = sd[10];
+							item["Favorite"] = favorite;
+							item["Protected"] = (iProtected != 0);
+							item["LastUpdate"] = sLastUpdate;
+							item["PlanID"] = sd[9].c_str();
 							Json::Value jsonArray;
 							jsonArray.append(atoi(sd[9].c_str()));
-							root["result"][ii]["PlanIDs"] = jsonArray;
+							item["PlanIDs"] = jsonArray;
 
 							if (nValue == 0)
-								root["result"][ii]["Status"] = "Off";
+								item["Status"] = "Off";
 							else if (nValue == 1)
-								root["result"][ii]["Status"] = "On";
+								item["Status"] = "On";
 							else
-								root["result"][ii]["Status"] = "Mixed";
-							root["result"][ii]["Data"] = root["result"][ii]["Status"];
+								item["Status"] = "Mixed";
+							item["Data"] = item["Status"];
 							uint64_t camIDX = m_mainworker.m_cameras.IsDevSceneInCamera(1, sd[0]);
-							root["result"][ii]["UsedByCamera"] = (camIDX != 0) ? true : false;
+							item["UsedByCamera"] = (camIDX != 0) ? true : false;
 							if (camIDX != 0)
 							{
 								std::stringstream scidx;
 								scidx << camIDX;
-								root["result"][ii]["CameraIdx"] = scidx.str();
-								root["result"][ii]["CameraAspect"] = m_mainworker.m_cameras.GetCameraAspectRatio(scidx.str());
+								item["CameraIdx"] = scidx.str();
+								item["CameraAspect"] = m_mainworker.m_cameras.GetCameraAspectRatio(scidx.str());
 							}
-							root["result"][ii]["XOffset"] = atoi(sd[7].c_str());
-							root["result"][ii]["YOffset"] = atoi(sd[8].c_str());
-							ii++;
+							item["XOffset"] = atoi(sd[7].c_str());
+							item["YOffset"] = atoi(sd[8].c_str());
+							AddPending(item);
 						}
 					}
 				}
 			}
 
-			char szData[320];
 			if (totUserDevices == 0)
 			{
 				// All
@@ -1286,6 +1379,7 @@ namespace http
 			{
 				if (iUser == -1)
 				{
+					FlushPending();
 					return;
 				}
 				// Specific devices
@@ -1387,7 +1481,16 @@ namespace http
 			}
 
 			if (result.empty())
+			{
+				FlushPending();
 				return;
+			}
+
+			_tDeviceFieldsContext ctx;
+			ctx.now = now;
+			ctx.tm1 = tm1;
+			ctx.SensorTimeOut = SensorTimeOut;
+			ctx.pHardwareNames = &_hardwareNames;
 
 			for (const auto& sd : result)
 			{
@@ -1405,8 +1508,6 @@ namespace http
 
 					std::string sDeviceName = sd[3];
 
-					uint64_t devIDX = std::stoull(sd[0]);
-
 					if (!bDisplayHidden)
 					{
 						if (_HiddenDevices.find(sd[0]) != _HiddenDevices.end())
@@ -1419,56 +1520,23 @@ namespace http
 								sDeviceName = sDeviceName.substr(1);
 						}
 					}
-					int hardwareID = atoi(sd[14].c_str());
-					auto hItt = _hardwareNames.find(hardwareID);
-					bool bIsHardwareDisabled = true;
-					if (hItt != _hardwareNames.end())
-					{
-						// ignore sensors where the hardware is disabled
-						if ((!bDisplayDisabled) && (!(*hItt).second.Enabled))
-							continue;
-						bIsHardwareDisabled = !(*hItt).second.Enabled;
-					}
+					// ignore sensors where the hardware is disabled
+					auto hItt = _hardwareNames.find(atoi(sd[14].c_str()));
+					if ((!bDisplayDisabled) && (hItt != _hardwareNames.end()) && (!(*hItt).second.Enabled))
+						continue;
 
 					unsigned int dType = atoi(sd[5].c_str());
 					unsigned int dSubType = atoi(sd[6].c_str());
 					unsigned int used = atoi(sd[4].c_str());
-					int nValue = atoi(sd[9].c_str());
-					std::string sValue = sd[10];
-					std::string sLastUpdate = sd[11];
-					if (sLastUpdate.size() > 19)
-						sLastUpdate = sLastUpdate.substr(0, 19);
 
 					if (iLastUpdate != 0)
 					{
 						time_t cLastUpdate;
-						ParseSQLdatetime(cLastUpdate, tLastUpdate, sLastUpdate, tm1.tm_isdst);
+						ParseSQLdatetime(cLastUpdate, tLastUpdate, sd[11].substr(0, 19), tm1.tm_isdst);
 						if (cLastUpdate <= iLastUpdate)
 							continue;
 					}
 
-					device::tswitch::type::value switchtype = (device::tswitch::type::value)atoi(sd[13].c_str());
-					device::tmeter::type::value metertype = (device::tmeter::type::value)switchtype;
-					double AddjValue = atof(sd[15].c_str());
-					double AddjMulti = atof(sd[16].c_str());
-					double AddjValue2 = atof(sd[17].c_str());
-					double AddjMulti2 = atof(sd[18].c_str());
-					int LastLevel = atoi(sd[19].c_str());
-					int CustomImage = atoi(sd[20].c_str());
-					std::string strParam1 = base64_encode(sd[21]);
-					std::string strParam2 = base64_encode(sd[22]);
-					int iProtected = atoi(sd[23].c_str());
-
-					std::string Description = sd[27];
-					std::string sOptions = sd[28];
-					std::string sColor = sd[29];
-					std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sOptions);
-
-					struct tm ntime;
-					time_t checktime;
-					ParseSQLdatetime(checktime, ntime, sLastUpdate, tm1.tm_isdst);
-					bool bHaveTimeout = (now - checktime >= SensorTimeOut * 60);
-
 					if (dType == pTypeTEMP_RAIN)
 						continue; // dont want you for now
 
@@ -1532,2293 +1600,2364 @@ namespace http
 					// assume results are ordered such that same device is adjacent
 					// if the idx and the Type are equal (type to prevent matching against Scene with same idx)
 					std::string thisIdx = sd[0];
-					const int devIdx = atoi(thisIdx.c_str());
-
-					if ((ii > 0) && thisIdx == root["result"][ii - 1]["idx"].asString())
+					if ((!pending.isNull()) && thisIdx == pending["idx"].asString())
 					{
 						std::string typeOfThisOne = RFX_Type_Desc(dType, 1);
-						if (typeOfThisOne == root["result"][ii - 1]["Type"].asString())
+						if (typeOfThisOne == pending["Type"].asString())
 						{
-							root["result"][ii - 1]["PlanIDs"].append(atoi(sd[26].c_str()));
+							pending["PlanIDs"].append(atoi(sd[26].c_str()));
 							continue;
 						}
 					}
 
-					root["result"][ii]["HardwareID"] = hardwareID;
-					if (_hardwareNames.find(hardwareID) == _hardwareNames.end())
+					CDeviceFields fields;
+					if (!ComputeDeviceFields(sd, sDeviceName, ctx, fields))
+						continue;
+					Json::Value item;
+					fields.ToJson(item);
+					Json::Value jsonArray;
+					jsonArray.append(atoi(sd[26].c_str()));
+					item["PlanIDs"] = jsonArray;
+					AddPending(item);
+				}
+				catch (const std::exception& e)
+				{
+					_log.Log(LOG_ERROR, "GetJSonDevices: exception occurred : '%s'", e.what());
+					continue;
+				}
+			}
+			FlushPending();
+		}
+
+		// Computes the fields of one row of the device query of GetJSonDevices, false to leave the device out
+		bool CWebServer::ComputeDeviceFields(const std::vector<std::string>& sd, const std::string& sDeviceName, const _tDeviceFieldsContext& ctx, CDeviceFields& fields)
+		{
+			const time_t now = ctx.now;
+			std::map<int, _tHardwareListInt>& _hardwareNames = *ctx.pHardwareNames;
+			unsigned char tempsign = m_sql.m_tempsign[0];
+			char szData[320];
+			char szTmp[300];
+
+			uint64_t devIDX = std::stoull(sd[0]);
+			int hardwareID = atoi(sd[14].c_str());
+			auto hItt = _hardwareNames.find(hardwareID);
+			bool bIsHardwareDisabled = (hItt == _hardwareNames.end()) || (!(*hItt).second.Enabled);
+
+			unsigned char favorite = atoi(sd[12].c_str());
+			unsigned int dType = atoi(sd[5].c_str());
+			unsigned int dSubType = atoi(sd[6].c_str());
+			unsigned int used = atoi(sd[4].c_str());
+			int nValue = atoi(sd[9].c_str());
+			std::string sValue = sd[10];
+			std::string sLastUpdate = sd[11];
+			if (sLastUpdate.size() > 19)
+				sLastUpdate = sLastUpdate.substr(0, 19);
+
+			device::tswitch::type::value switchtype = (device::tswitch::type::value)atoi(sd[13].c_str());
+			device::tmeter::type::value metertype = (device::tmeter::type::value)switchtype;
+			double AddjValue = atof(sd[15].c_str());
+			double AddjMulti = atof(sd[16].c_str());
+			double AddjValue2 = atof(sd[17].c_str());
+			double AddjMulti2 = atof(sd[18].c_str());
+			int LastLevel = atoi(sd[19].c_str());
+			int CustomImage = atoi(sd[20].c_str());
+			std::string strParam1 = base64_encode(sd[21]);
+			std::string strParam2 = base64_encode(sd[22]);
+			int iProtected = atoi(sd[23].c_str());
+
+			std::string Description = sd[27];
+			std::string sOptions = sd[28];
+			std::string sColor = sd[29];
+			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sOptions);
+
+			struct tm ntime;
+			time_t checktime;
+			ParseSQLdatetime(checktime, ntime, sLastUpdate, ctx.tm1.tm_isdst);
+			bool bHaveTimeout = (now - checktime >= ctx.SensorTimeOut * 60);
+
+			const int devIdx = atoi(sd[0].c_str());
+
+			fields.Set("HardwareID", hardwareID);
+			if (_hardwareNames.find(hardwareID) == _hardwareNames.end())
+			{
+				fields.Set("HardwareName", "Unknown?");
+				fields.Set("HardwareTypeVal", 0);
+				fields.Set("HardwareType", "Unknown?");
+			}
+			else
+			{
+				fields.Set("HardwareName", _hardwareNames[hardwareID].Name);
+				fields.Set("HardwareTypeVal", _hardwareNames[hardwareID].HardwareTypeVal);
+				fields.Set("HardwareType", _hardwareNames[hardwareID].HardwareType);
+			}
+			fields.Set("HardwareDisabled", bIsHardwareDisabled);
+
+			fields.Set("idx", sd[0]);
+			fields.Set("Protected", (iProtected != 0));
+
+			CDomoticzHardwareBase* pHardware = m_mainworker.GetHardware(hardwareID);
+			if (pHardware != nullptr)
+			{
+				if (pHardware->HwdType == hardware::type::SolarEdgeAPI)
+				{
+					int seSensorTimeOut = 60 * 24 * 60;
+					bHaveTimeout = (now - checktime >= seSensorTimeOut * 60);
+				}
+				else if (pHardware->HwdType == hardware::type::Wunderground)
+				{
+					CWunderground* pWHardware = dynamic_cast<CWunderground*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
 					{
-						root["result"][ii]["HardwareName"] = "Unknown?";
-						root["result"][ii]["HardwareTypeVal"] = 0;
-						root["result"][ii]["HardwareType"] = "Unknown?";
+						fields.Set("forecast_url", base64_encode(forecast_url));
 					}
-					else
+				}
+				else if (pHardware->HwdType == hardware::type::DarkSky)
+				{
+					CDarkSky* pWHardware = dynamic_cast<CDarkSky*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
 					{
-						root["result"][ii]["HardwareName"] = _hardwareNames[hardwareID].Name;
-						root["result"][ii]["HardwareTypeVal"] = _hardwareNames[hardwareID].HardwareTypeVal;
-						root["result"][ii]["HardwareType"] = _hardwareNames[hardwareID].HardwareType;
+						fields.Set("forecast_url", base64_encode(forecast_url));
 					}
-					root["result"][ii]["HardwareDisabled"] = bIsHardwareDisabled;
-
-					root["result"][ii]["idx"] = sd[0];
-					root["result"][ii]["Protected"] = (iProtected != 0);
-
-					CDomoticzHardwareBase* pHardware = m_mainworker.GetHardware(hardwareID);
-					if (pHardware != nullptr)
+				}
+				else if (pHardware->HwdType == hardware::type::VisualCrossing)
+				{
+					CVisualCrossing* pWHardware = dynamic_cast<CVisualCrossing*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
 					{
-						if (pHardware->HwdType == hardware::type::SolarEdgeAPI)
-						{
-							int seSensorTimeOut = 60 * 24 * 60;
-							bHaveTimeout = (now - checktime >= seSensorTimeOut * 60);
-						}
-						else if (pHardware->HwdType == hardware::type::Wunderground)
-						{
-							CWunderground* pWHardware = dynamic_cast<CWunderground*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
-						else if (pHardware->HwdType == hardware::type::DarkSky)
-						{
-							CDarkSky* pWHardware = dynamic_cast<CDarkSky*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
-						else if (pHardware->HwdType == hardware::type::VisualCrossing)
-						{
-							CVisualCrossing* pWHardware = dynamic_cast<CVisualCrossing*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
-						else if (pHardware->HwdType == hardware::type::AccuWeather)
-						{
-							CAccuWeather* pWHardware = dynamic_cast<CAccuWeather*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
-						else if (pHardware->HwdType == hardware::type::OpenWeatherMap)
-						{
-							COpenWeatherMap* pWHardware = dynamic_cast<COpenWeatherMap*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
-						else if (pHardware->HwdType == hardware::type::BuienRadar)
-						{
-							CBuienRadar* pWHardware = dynamic_cast<CBuienRadar*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
-						else if (pHardware->HwdType == hardware::type::Meteorologisk)
-						{
-							CMeteorologisk* pWHardware = dynamic_cast<CMeteorologisk*>(pHardware);
-							std::string forecast_url = pWHardware->GetForecastURL();
-							if (!forecast_url.empty())
-							{
-								root["result"][ii]["forecast_url"] = base64_encode(forecast_url);
-							}
-						}
+						fields.Set("forecast_url", base64_encode(forecast_url));
 					}
-
-					if ((pHardware != nullptr) && (pHardware->HwdType == hardware::type::PythonPlugin))
+				}
+				else if (pHardware->HwdType == hardware::type::AccuWeather)
+				{
+					CAccuWeather* pWHardware = dynamic_cast<CAccuWeather*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
 					{
-						// Device ID special formatting should not be applied to Python plugins
-						root["result"][ii]["ID"] = sd[1];
+						fields.Set("forecast_url", base64_encode(forecast_url));
 					}
-					else
+				}
+				else if (pHardware->HwdType == hardware::type::OpenWeatherMap)
+				{
+					COpenWeatherMap* pWHardware = dynamic_cast<COpenWeatherMap*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
 					{
-						if ((dType == pTypeTEMP) || (dType == pTypeTEMP_BARO) || (dType == pTypeTEMP_HUM) || (dType == pTypeTEMP_HUM_BARO) || (dType == pTypeBARO) ||
-							(dType == pTypeHUM) || (dType == pTypeWIND) || (dType == pTypeRAIN) || (dType == pTypeUV) || (dType == pTypeCURRENT) ||
-							(dType == pTypeCURRENTENERGY) || (dType == pTypeENERGY) || (dType == pTypeRFXMeter) || (dType == pTypeAirQuality) || (dType == pTypeRFXSensor) ||
-							(dType == pTypeP1Power) || (dType == pTypeP1BusDevice))
-						{
-							root["result"][ii]["ID"] = is_number(sd[1]) ? std_format("%04X", (unsigned int)atoi(sd[1].c_str())) : sd[1];
-						}
-						else
-						{
-							root["result"][ii]["ID"] = sd[1];
-						}
+						fields.Set("forecast_url", base64_encode(forecast_url));
 					}
-
-					root["result"][ii]["Unit"] = atoi(sd[2].c_str());
-					root["result"][ii]["Type"] = RFX_Type_Desc(dType, 1);
-					root["result"][ii]["SubType"] = RFX_Type_SubType_Desc(dType, dSubType);
-					root["result"][ii]["TypeImg"] = RFX_Type_Desc(dType, 2);
-					root["result"][ii]["Name"] = sDeviceName;
-					root["result"][ii]["Description"] = Description;
-					root["result"][ii]["Used"] = used;
-					root["result"][ii]["Favorite"] = favorite;
-
-					int iSignalLevel = atoi(sd[7].c_str());
-					if (iSignalLevel < 12)
-						root["result"][ii]["SignalLevel"] = iSignalLevel;
-					else
-						root["result"][ii]["SignalLevel"] = "-";
-					root["result"][ii]["BatteryLevel"] = atoi(sd[8].c_str());
-					root["result"][ii]["LastUpdate"] = sLastUpdate;
-
-					root["result"][ii]["CustomImage"] = CustomImage;
-
-					if (CustomImage != 0)
+				}
+				else if (pHardware->HwdType == hardware::type::BuienRadar)
+				{
+					CBuienRadar* pWHardware = dynamic_cast<CBuienRadar*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
 					{
-						auto ittIcon = m_custom_light_icons_lookup.find(CustomImage);
-						if (ittIcon != m_custom_light_icons_lookup.end())
-						{
-							root["result"][ii]["CustomImage"] = CustomImage;
-							root["result"][ii]["Image"] = m_custom_light_icons[ittIcon->second].RootFile;
-						}
-						else
-						{
-							CustomImage = 0;
-							root["result"][ii]["CustomImage"] = CustomImage;
-						}
+						fields.Set("forecast_url", base64_encode(forecast_url));
+					}
+				}
+				else if (pHardware->HwdType == hardware::type::Meteorologisk)
+				{
+					CMeteorologisk* pWHardware = dynamic_cast<CMeteorologisk*>(pHardware);
+					std::string forecast_url = pWHardware->GetForecastURL();
+					if (!forecast_url.empty())
+					{
+						fields.Set("forecast_url", base64_encode(forecast_url));
 					}
+				}
+			}
 
-					root["result"][ii]["XOffset"] = sd[24].c_str();
-					root["result"][ii]["YOffset"] = sd[25].c_str();
-					root["result"][ii]["PlanID"] = sd[26].c_str();
-					Json::Value jsonArray;
-					jsonArray.append(atoi(sd[26].c_str()));
-					root["result"][ii]["PlanIDs"] = jsonArray;
-					root["result"][ii]["AddjValue"] = AddjValue;
-					root["result"][ii]["AddjMulti"] = AddjMulti;
-					root["result"][ii]["AddjValue2"] = AddjValue2;
-					root["result"][ii]["AddjMulti2"] = AddjMulti2;
+			if ((pHardware != nullptr) && (pHardware->HwdType == hardware::type::PythonPlugin))
+			{
+				// Device ID special formatting should not be applied to Python plugins
+				fields.Set("ID", sd[1]);
+			}
+			else
+			{
+				if ((dType == pTypeTEMP) || (dType == pTypeTEMP_BARO) || (dType == pTypeTEMP_HUM) || (dType == pTypeTEMP_HUM_BARO) || (dType == pTypeBARO) ||
+					(dType == pTypeHUM) || (dType == pTypeWIND) || (dType == pTypeRAIN) || (dType == pTypeUV) || (dType == pTypeCURRENT) ||
+					(dType == pTypeCURRENTENERGY) || (dType == pTypeENERGY) || (dType == pTypeRFXMeter) || (dType == pTypeAirQuality) || (dType == pTypeRFXSensor) ||
+					(dType == pTypeP1Power) || (dType == pTypeP1BusDevice))
+				{
+					fields.Set("ID", is_number(sd[1]) ? std_format("%04X", (unsigned int)atoi(sd[1].c_str())) : sd[1]);
+				}
+				else
+				{
+					fields.Set("ID", sd[1]);
+				}
+			}
 
-					std::stringstream s_data;
-					s_data << int(nValue) << ", " << sValue;
-					root["result"][ii]["Data"] = s_data.str();
+			fields.Set("Unit", atoi(sd[2].c_str()));
+			fields.Set("Type", RFX_Type_Desc(dType, 1));
+			fields.Set("SubType", RFX_Type_SubType_Desc(dType, dSubType));
+			fields.Set("TypeImg", RFX_Type_Desc(dType, 2));
+			fields.Set("Name", sDeviceName);
+			fields.Set("Description", Description);
+			fields.Set("Used", used);
+			fields.Set("Favorite", favorite);
+
+			int iSignalLevel = atoi(sd[7].c_str());
+			if (iSignalLevel < 12)
+				fields.Set("SignalLevel", iSignalLevel);
+			else
+				fields.Set("SignalLevel", "-");
+			fields.Set("BatteryLevel", atoi(sd[8].c_str()));
+			fields.Set("LastUpdate", sLastUpdate);
 
-					root["result"][ii]["Notifications"] = (m_notifications.HasNotifications(sd[0]) == true) ? "true" : "false";
-					root["result"][ii]["ShowNotifications"] = true;
+			fields.Set("CustomImage", CustomImage);
 
-					bool bHasTimers = false;
+			if (CustomImage != 0)
+			{
+				auto ittIcon = m_custom_light_icons_lookup.find(CustomImage);
+				if (ittIcon != m_custom_light_icons_lookup.end())
+				{
+					fields.Set("CustomImage", CustomImage);
+					fields.Set("Image", m_custom_light_icons[ittIcon->second].RootFile);
+				}
+				else
+				{
+					CustomImage = 0;
+					fields.Set("CustomImage", CustomImage);
+				}
+			}
 
-					if (
-						(dType == pTypeLighting1)
-						|| (dType == pTypeLighting2)
-						|| (dType == pTypeLighting3)
-						|| (dType == pTypeLighting4)
-						|| (dType == pTypeLighting5)
-						|| (dType == pTypeLighting6)
-						|| (dType == pTypeFan)
-						|| (dType == pTypeColorSwitch)
-						|| (dType == pTypeCurtain)
-						|| (dType == pTypeBlinds)
-						|| (dType == pTypeRFY)
-						|| (dType == pTypeChime)
-						|| (dType == pTypeThermostat2)
-						|| (dType == pTypeThermostat3)
-						|| (dType == pTypeThermostat4)
-						|| (dType == pTypeRemote)
-						|| (dType == pTypeGeneralSwitch)
-						|| (dType == pTypeHomeConfort)
-						|| (dType == pTypeFS20)
-						|| ((dType == pTypeRadiator1) && (dSubType == sTypeSmartwaresSwitchRadiator))
-						|| ((dType == pTypeRego6XXValue) && (dSubType == sTypeRego6XXStatus))
-						|| (dType == pTypeHunter)
-						|| (dType == pTypeDDxxxx)
-						)
-					{
-						// add light details
-						bHasTimers = m_sql.HasTimers(sd[0]);
+			fields.Set("XOffset", sd[24].c_str());
+			fields.Set("YOffset", sd[25].c_str());
+			fields.Set("PlanID", sd[26].c_str());
+			fields.Set("AddjValue", AddjValue);
+			fields.Set("AddjMulti", AddjMulti);
+			fields.Set("AddjValue2", AddjValue2);
+			fields.Set("AddjMulti2", AddjMulti2);
+
+			std::stringstream s_data;
+			s_data << int(nValue) << ", " << sValue;
+			fields.Set("Data", s_data.str());
+
+			fields.Set("Notifications", (m_notifications.HasNotifications(sd[0]) == true) ? "true" : "false");
+			fields.Set("ShowNotifications", true);
+
+			bool bHasTimers = false;
+
+			if (
+				(dType == pTypeLighting1)
+				|| (dType == pTypeLighting2)
+				|| (dType == pTypeLighting3)
+				|| (dType == pTypeLighting4)
+				|| (dType == pTypeLighting5)
+				|| (dType == pTypeLighting6)
+				|| (dType == pTypeFan)
+				|| (dType == pTypeColorSwitch)
+				|| (dType == pTypeCurtain)
+				|| (dType == pTypeBlinds)
+				|| (dType == pTypeRFY)
+				|| (dType == pTypeChime)
+				|| (dType == pTypeThermostat2)
+				|| (dType == pTypeThermostat3)
+				|| (dType == pTypeThermostat4)
+				|| (dType == pTypeRemote)
+				|| (dType == pTypeGeneralSwitch)
+				|| (dType == pTypeHomeConfort)
+				|| (dType == pTypeFS20)
+				|| ((dType == pTypeRadiator1) && (dSubType == sTypeSmartwaresSwitchRadiator))
+				|| ((dType == pTypeRego6XXValue) && (dSubType == sTypeRego6XXStatus))
+				|| (dType == pTypeHunter)
+				|| (dType == pTypeDDxxxx)
+				)
+			{
+				// add light details
+				bHasTimers = m_sql.HasTimers(sd[0]);
 
-						bHaveTimeout = false;
+				bHaveTimeout = false;
 #ifdef WITH_OPENZWAVE
-						if (pHardware != nullptr)
-						{
-							if (pHardware->HwdType == hardware::type::OpenZWave)
-							{
-								COpenZWave* pZWave = dynamic_cast<COpenZWave*>(pHardware);
-								unsigned long ID;
-								std::stringstream s_strid;
-								s_strid << std::hex << sd[1];
-								s_strid >> ID;
-								int nodeID = (ID & 0x0000FF00) >> 8;
-								bHaveTimeout = pZWave->HasNodeFailed(nodeID);
-							}
-						}
+				if (pHardware != nullptr)
+				{
+					if (pHardware->HwdType == hardware::type::OpenZWave)
+					{
+						COpenZWave* pZWave = dynamic_cast<COpenZWave*>(pHardware);
+						unsigned long ID;
+						std::stringstream s_strid;
+						s_strid << std::hex << sd[1];
+						s_strid >> ID;
+						int nodeID = (ID & 0x0000FF00) >> 8;
+						bHaveTimeout = pZWave->HasNodeFailed(nodeID);
+					}
+				}
 #endif
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+				fields.Set("HaveTimeout", bHaveTimeout);
 
-						std::string lstatus;
-						int llevel = 0;
-						bool bHaveDimmer = false;
-						bool bHaveGroupCmd = false;
-						int maxDimLevel = 0;
+				std::string lstatus;
+				int llevel = 0;
+				bool bHaveDimmer = false;
+				bool bHaveGroupCmd = false;
+				int maxDimLevel = 0;
 
-						GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+				GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
 
-						root["result"][ii]["Status"] = lstatus;
-						root["result"][ii]["StrParam1"] = strParam1;
-						root["result"][ii]["StrParam2"] = strParam2;
+				fields.Set("Status", lstatus);
+				fields.Set("StrParam1", strParam1);
+				fields.Set("StrParam2", strParam2);
 
-						if (!CustomImage)
-							root["result"][ii]["Image"] = "Light";
+				if (!CustomImage)
+					fields.Set("Image", "Light");
 
-						if (switchtype == device::tswitch::type::Dimmer)
-						{
-							root["result"][ii]["Level"] = LastLevel;
-							int iLevel = ground((float(maxDimLevel) / 100.0F) * LastLevel);
-							root["result"][ii]["LevelInt"] = iLevel;
-							if ((dType == pTypeColorSwitch) || (dType == pTypeLighting5 && dSubType == sTypeTRC02) ||
-								(dType == pTypeLighting5 && dSubType == sTypeTRC02_2) || (dType == pTypeGeneralSwitch && dSubType == sSwitchTypeTRC02) ||
-								(dType == pTypeGeneralSwitch && dSubType == sSwitchTypeTRC02_2))
-							{
-								_tColor color(sColor);
-								std::string jsonColor = color.toJSONString();
-								root["result"][ii]["Color"] = jsonColor;
-								llevel = LastLevel;
-								if (lstatus == "Set Level" || lstatus == "Set Color")
-								{
-									sprintf(szTmp, "Set Level: %d %%", LastLevel);
-									root["result"][ii]["Status"] = szTmp;
-								}
-							}
-						}
-						else
-						{
-							root["result"][ii]["Level"] = llevel;
-							root["result"][ii]["LevelInt"] = atoi(sValue.c_str());
-						}
-						root["result"][ii]["HaveDimmer"] = bHaveDimmer;
-						std::string DimmerType = "none";
-						if (switchtype == device::tswitch::type::Dimmer)
+				if (switchtype == device::tswitch::type::Dimmer)
+				{
+					fields.Set("Level", LastLevel);
+					int iLevel = ground((float(maxDimLevel) / 100.0F) * LastLevel);
+					fields.Set("LevelInt", iLevel);
+					if ((dType == pTypeColorSwitch) || (dType == pTypeLighting5 && dSubType == sTypeTRC02) ||
+						(dType == pTypeLighting5 && dSubType == sTypeTRC02_2) || (dType == pTypeGeneralSwitch && dSubType == sSwitchTypeTRC02) ||
+						(dType == pTypeGeneralSwitch && dSubType == sSwitchTypeTRC02_2))
+					{
+						_tColor color(sColor);
+						std::string jsonColor = color.toJSONString();
+						fields.Set("Color", jsonColor);
+						llevel = LastLevel;
+						if (lstatus == "Set Level" || lstatus == "Set Color")
 						{
-							DimmerType = "abs";
-							if (_hardwareNames.find(hardwareID) != _hardwareNames.end())
-							{
-								// Milight V4/V5 bridges do not support absolute dimming for RGB or CW_WW lights
-								if (_hardwareNames[hardwareID].HardwareTypeVal == hardware::type::LimitlessLights &&
-									atoi(_hardwareNames[hardwareID].Mode2.c_str()) != CLimitLess::LBTYPE_V6 &&
-									(atoi(_hardwareNames[hardwareID].Mode1.c_str()) == sTypeColor_RGB ||
-										atoi(_hardwareNames[hardwareID].Mode1.c_str()) == sTypeColor_White ||
-										atoi(_hardwareNames[hardwareID].Mode1.c_str()) == sTypeColor_CW_WW))
-								{
-									DimmerType = "rel";
-								}
-							}
+							sprintf(szTmp, "Set Level: %d %%", LastLevel);
+							fields.Set("Status", szTmp);
 						}
-						root["result"][ii]["DimmerType"] = DimmerType;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["result"][ii]["HaveGroupCmd"] = bHaveGroupCmd;
-						root["result"][ii]["SwitchType"] = device::tswitch::type::Description(switchtype);
-						root["result"][ii]["SwitchTypeVal"] = switchtype;
-						uint64_t camIDX = m_mainworker.m_cameras.IsDevSceneInCamera(0, sd[0]);
-						root["result"][ii]["UsedByCamera"] = (camIDX != 0) ? true : false;
-						if (camIDX != 0)
+					}
+				}
+				else
+				{
+					fields.Set("Level", llevel);
+					fields.Set("LevelInt", atoi(sValue.c_str()));
+				}
+				fields.Set("HaveDimmer", bHaveDimmer);
+				std::string DimmerType = "none";
+				if (switchtype == device::tswitch::type::Dimmer)
+				{
+					DimmerType = "abs";
+					if (_hardwareNames.find(hardwareID) != _hardwareNames.end())
+					{
+						// Milight V4/V5 bridges do not support absolute dimming for RGB or CW_WW lights
+						if (_hardwareNames[hardwareID].HardwareTypeVal == hardware::type::LimitlessLights &&
+							atoi(_hardwareNames[hardwareID].Mode2.c_str()) != CLimitLess::LBTYPE_V6 &&
+							(atoi(_hardwareNames[hardwareID].Mode1.c_str()) == sTypeColor_RGB ||
+								atoi(_hardwareNames[hardwareID].Mode1.c_str()) == sTypeColor_White ||
+								atoi(_hardwareNames[hardwareID].Mode1.c_str()) == sTypeColor_CW_WW))
 						{
-							std::stringstream scidx;
-							scidx << camIDX;
-							root["result"][ii]["CameraIdx"] = scidx.str();
-							root["result"][ii]["CameraAspect"] = m_mainworker.m_cameras.GetCameraAspectRatio(scidx.str());
+							DimmerType = "rel";
 						}
+					}
+				}
+				fields.Set("DimmerType", DimmerType);
+				fields.Set("MaxDimLevel", maxDimLevel);
+				fields.Set("HaveGroupCmd", bHaveGroupCmd);
+				fields.Set("SwitchType", device::tswitch::type::Description(switchtype));
+				fields.Set("SwitchTypeVal", switchtype);
+				uint64_t camIDX = m_mainworker.m_cameras.IsDevSceneInCamera(0, sd[0]);
+				fields.Set("UsedByCamera", (camIDX != 0) ? true : false);
+				if (camIDX != 0)
+				{
+					std::stringstream scidx;
+					scidx << camIDX;
+					fields.Set("CameraIdx", scidx.str());
+					fields.Set("CameraAspect", m_mainworker.m_cameras.GetCameraAspectRatio(scidx.str()));
+				}
 
-						bool bIsSubDevice = false;
-						std::vector<std::vector<std::string>> resultSD;
-						resultSD = m_sql.safe_query("SELECT ID FROM LightSubDevices WHERE (DeviceRowID=='%q')", sd[0].c_str());
-						bIsSubDevice = (!resultSD.empty());
+				bool bIsSubDevice = false;
+				std::vector<std::vector<std::string>> resultSD;
+				resultSD = m_sql.safe_query("SELECT ID FROM LightSubDevices WHERE (DeviceRowID=='%q')", sd[0].c_str());
+				bIsSubDevice = (!resultSD.empty());
 
-						root["result"][ii]["IsSubDevice"] = bIsSubDevice;
+				fields.Set("IsSubDevice", bIsSubDevice);
 
-						std::string openStatus = "Open";
-						std::string closedStatus = "Closed";
-						if (switchtype == device::tswitch::type::Doorbell)
-						{
-							root["result"][ii]["TypeImg"] = "doorbell";
-							root["result"][ii]["Status"] = ""; //"Pressed";
-						}
-						else if (switchtype == device::tswitch::type::DoorContact)
-						{
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Door";
-							root["result"][ii]["TypeImg"] = "door";
-							bool bIsOn = IsLightSwitchOn(lstatus);
-							root["result"][ii]["InternalState"] = (bIsOn == true) ? "Open" : "Closed";
-							if (bIsOn)
-							{
-								lstatus = "Open";
-							}
-							else
-							{
-								lstatus = "Closed";
-							}
-							root["result"][ii]["Status"] = lstatus;
-						}
-						else if (switchtype == device::tswitch::type::DoorLock)
-						{
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Door";
-							root["result"][ii]["TypeImg"] = "door";
-							bool bIsOn = IsLightSwitchOn(lstatus);
-							root["result"][ii]["InternalState"] = (bIsOn == true) ? "Locked" : "Unlocked";
-							if (bIsOn)
-							{
-								lstatus = "Locked";
-							}
-							else
-							{
-								lstatus = "Unlocked";
-							}
-							root["result"][ii]["Status"] = lstatus;
-						}
-						else if (switchtype == device::tswitch::type::DoorLockInverted)
-						{
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Door";
-							root["result"][ii]["TypeImg"] = "door";
-							bool bIsOn = IsLightSwitchOn(lstatus);
-							root["result"][ii]["InternalState"] = (bIsOn == true) ? "Unlocked" : "Locked";
-							if (bIsOn)
-							{
-								lstatus = "Unlocked";
-							}
-							else
-							{
-								lstatus = "Locked";
-							}
-							root["result"][ii]["Status"] = lstatus;
-						}
-						else if (switchtype == device::tswitch::type::PushOn)
-						{
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Push";
-							root["result"][ii]["TypeImg"] = "push";
-							root["result"][ii]["Status"] = "";
-							root["result"][ii]["InternalState"] = (IsLightSwitchOn(lstatus) == true) ? "On" : "Off";
-						}
-						else if (switchtype == device::tswitch::type::PushOff)
-						{
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Push";
-							root["result"][ii]["TypeImg"] = "push";
-							root["result"][ii]["Status"] = "";
-							root["result"][ii]["TypeImg"] = "pushoff";
-						}
-						else if (switchtype == device::tswitch::type::X10Siren)
-							root["result"][ii]["TypeImg"] = "siren";
-						else if (switchtype == device::tswitch::type::SMOKEDETECTOR)
-						{
-							root["result"][ii]["TypeImg"] = "smoke";
-							root["result"][ii]["SwitchTypeVal"] = device::tswitch::type::SMOKEDETECTOR;
-							root["result"][ii]["SwitchType"] = device::tswitch::type::Description(device::tswitch::type::SMOKEDETECTOR);
-						}
-						else if (switchtype == device::tswitch::type::Contact)
-						{
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Contact";
-							root["result"][ii]["TypeImg"] = "contact";
-							bool bIsOn = IsLightSwitchOn(lstatus);
-							if (bIsOn)
-							{
-								lstatus = "Open";
-							}
-							else
-							{
-								lstatus = "Closed";
-							}
-							root["result"][ii]["Status"] = lstatus;
-						}
-						else if (switchtype == device::tswitch::type::Media)
-						{
-							if ((pHardware != nullptr) && (pHardware->HwdType == hardware::type::LogitechMediaServer))
-								root["result"][ii]["TypeImg"] = "LogitechMediaServer";
-							else
-								root["result"][ii]["TypeImg"] = "Media";
-							root["result"][ii]["Status"] = device::tmedia::status::Description((device::tmedia::status::value)nValue);
-							lstatus = sValue;
-						}
-						else if (
-							(switchtype == device::tswitch::type::Blinds)
-							|| (switchtype == device::tswitch::type::BlindsPercentage)
-							|| (switchtype == device::tswitch::type::BlindsPercentageWithStop)
-							|| (switchtype == device::tswitch::type::VenetianBlindsUS)
-							|| (switchtype == device::tswitch::type::VenetianBlindsEU)
-							)
-						{
-							root["result"][ii]["Image"] = "blinds";
-							root["result"][ii]["TypeImg"] = "blinds";
+				std::string openStatus = "Open";
+				std::string closedStatus = "Closed";
+				if (switchtype == device::tswitch::type::Doorbell)
+				{
+					fields.Set("TypeImg", "doorbell");
+					fields.Set("Status", ""); //"Pressed";
+				}
+				else if (switchtype == device::tswitch::type::DoorContact)
+				{
+					if (!CustomImage)
+						fields.Set("Image", "Door");
+					fields.Set("TypeImg", "door");
+					bool bIsOn = IsLightSwitchOn(lstatus);
+					fields.Set("InternalState", (bIsOn == true) ? "Open" : "Closed");
+					if (bIsOn)
+					{
+						lstatus = "Open";
+					}
+					else
+					{
+						lstatus = "Closed";
+					}
+					fields.Set("Status", lstatus);
+				}
+				else if (switchtype == device::tswitch::type::DoorLock)
+				{
+					if (!CustomImage)
+						fields.Set("Image", "Door");
+					fields.Set("TypeImg", "door");
+					bool bIsOn = IsLightSwitchOn(lstatus);
+					fields.Set("InternalState", (bIsOn == true) ? "Locked" : "Unlocked");
+					if (bIsOn)
+					{
+						lstatus = "Locked";
+					}
+					else
+					{
+						lstatus = "Unlocked";
+					}
+					fields.Set("Status", lstatus);
+				}
+				else if (switchtype == device::tswitch::type::DoorLockInverted)
+				{
+					if (!CustomImage)
+						fields.Set("Image", "Door");
+					fields.Set("TypeImg", "door");
+					bool bIsOn = IsLightSwitchOn(lstatus);
+					fields.Set("InternalState", (bIsOn == true) ? "Unlocked" : "Locked");
+					if (bIsOn)
+					{
+						lstatus = "Unlocked";
+					}
+					else
+					{
+						lstatus = "Locked";
+					}
+					fields.Set("Status", lstatus);
+				}
+				else if (switchtype == device::tswitch::type::PushOn)
+				{
+					if (!CustomImage)
+						fields.Set("Image", "Push");
+					fields.Set("TypeImg", "push");
+					fields.Set("Status", "");
+					fields.Set("InternalState", (IsLightSwitchOn(lstatus) == true) ? "On" : "Off");
+				}
+				else if (switchtype == device::tswitch::type::PushOff)
+				{
+					if (!CustomImage)
+						fields.Set("Image", "Push");
+					fields.Set("TypeImg", "push");
+					fields.Set("Status", "");
+					fields.Set("TypeImg", "pushoff");
+				}
+				else if (switchtype == device::tswitch::type::X10Siren)
+					fields.Set("TypeImg", "siren");
+				else if (switchtype == device::tswitch::type::SMOKEDETECTOR)
+				{
+					fields.Set("TypeImg", "smoke");
+					fields.Set("SwitchTypeVal", device::tswitch::type::SMOKEDETECTOR);
+					fields.Set("SwitchType", device::tswitch::type::Description(device::tswitch::type::SMOKEDETECTOR));
+				}
+				else if (switchtype == device::tswitch::type::Contact)
+				{
+					if (!CustomImage)
+						fields.Set("Image", "Contact");
+					fields.Set("TypeImg", "contact");
+					bool bIsOn = IsLightSwitchOn(lstatus);
+					if (bIsOn)
+					{
+						lstatus = "Open";
+					}
+					else
+					{
+						lstatus = "Closed";
+					}
+					fields.Set("Status", lstatus);
+				}
+				else if (switchtype == device::tswitch::type::Media)
+				{
+					if ((pHardware != nullptr) && (pHardware->HwdType == hardware::type::LogitechMediaServer))
+						fields.Set("TypeImg", "LogitechMediaServer");
+					else
+						fields.Set("TypeImg", "Media");
+					fields.Set("Status", device::tmedia::status::Description((device::tmedia::status::value)nValue));
+					lstatus = sValue;
+				}
+				else if (
+					(switchtype == device::tswitch::type::Blinds)
+					|| (switchtype == device::tswitch::type::BlindsPercentage)
+					|| (switchtype == device::tswitch::type::BlindsPercentageWithStop)
+					|| (switchtype == device::tswitch::type::VenetianBlindsUS)
+					|| (switchtype == device::tswitch::type::VenetianBlindsEU)
+					)
+				{
+					fields.Set("Image", "blinds");
+					fields.Set("TypeImg", "blinds");
 
-							if (lstatus == "Close inline relay")
-							{
-								lstatus = "Close";
-							}
-							else if (lstatus == "Open inline relay")
-							{
-								lstatus = "Open";
-							}
-							else if (lstatus == "Stop inline relay")
-							{
-								lstatus = "Stop";
-							}
+					if (lstatus == "Close inline relay")
+					{
+						lstatus = "Close";
+					}
+					else if (lstatus == "Open inline relay")
+					{
+						lstatus = "Open";
+					}
+					else if (lstatus == "Stop inline relay")
+					{
+						lstatus = "Stop";
+					}
 
-							bool bReverseState = false;
-							bool bReversePosition = false;
+					bool bReverseState = false;
+					bool bReversePosition = false;
 
-							auto itt = options.find("ReverseState");
-							if (itt != options.end())
-								bReverseState = (itt->second == "true");
-							itt = options.find("ReversePosition");
-							if (itt != options.end())
-								bReversePosition = (itt->second == "true");
+					auto itt = options.find("ReverseState");
+					if (itt != options.end())
+						bReverseState = (itt->second == "true");
+					itt = options.find("ReversePosition");
+					if (itt != options.end())
+						bReversePosition = (itt->second == "true");
 
-							if (bReversePosition)
-							{
-								LastLevel = 100 - LastLevel;
-								if (lstatus.find("Set Level") == 0)
-									lstatus = std_format("Set Level: %d %%", LastLevel);
-							}
+					if (bReversePosition)
+					{
+						LastLevel = 100 - LastLevel;
+						if (lstatus.find("Set Level") == 0)
+							lstatus = std_format("Set Level: %d %%", LastLevel);
+					}
 
-							if (bReverseState)
-							{
-								if (lstatus == "Open")
-									lstatus = "Close";
-								else if (lstatus == "Close")
-									lstatus = "Open";
-							}
+					if (bReverseState)
+					{
+						if (lstatus == "Open")
+							lstatus = "Close";
+						else if (lstatus == "Close")
+							lstatus = "Open";
+					}
 
 
-							if (lstatus == "Close")
-							{
-								lstatus = closedStatus;
-							}
-							else if (lstatus == "Open")
-							{
-								lstatus = openStatus;
-							}
-							else if (lstatus == "Stop")
-							{
-								lstatus = "Stopped";
-							}
-							root["result"][ii]["Status"] = lstatus;
+					if (lstatus == "Close")
+					{
+						lstatus = closedStatus;
+					}
+					else if (lstatus == "Open")
+					{
+						lstatus = openStatus;
+					}
+					else if (lstatus == "Stop")
+					{
+						lstatus = "Stopped";
+					}
+					fields.Set("Status", lstatus);
 
-							root["result"][ii]["Level"] = LastLevel;
-							int iLevel = ground((float(maxDimLevel) / 100.0F) * LastLevel);
-							root["result"][ii]["LevelInt"] = iLevel;
+					fields.Set("Level", LastLevel);
+					int iLevel = ground((float(maxDimLevel) / 100.0F) * LastLevel);
+					fields.Set("LevelInt", iLevel);
 
-							root["result"][ii]["ReverseState"] = bReverseState;
-							root["result"][ii]["ReversePosition"] = bReversePosition;
-						}
-						else if (switchtype == device::tswitch::type::Dimmer)
-						{
-							root["result"][ii]["TypeImg"] = "dimmer";
-						}
-						else if (switchtype == device::tswitch::type::Motion)
-						{
-							root["result"][ii]["TypeImg"] = "motion";
-						}
-						else if (switchtype == device::tswitch::type::Selector)
-						{
-							std::string selectorStyle = options["SelectorStyle"];
-							std::string levelOffHidden = options["LevelOffHidden"];
-							std::string levelNames = options["LevelNames"];
-							std::string levelActions = options["LevelActions"];
-							if (selectorStyle.empty())
-							{
-								selectorStyle = "0"; // default is 'button set'
-							}
-							if (levelOffHidden.empty())
-							{
-								levelOffHidden = "false"; // default is 'not hidden'
-							}
-							if (levelNames.empty())
-							{
-								levelNames = "Off"; // default is Off only
-							}
-							root["result"][ii]["TypeImg"] = "Light";
-							root["result"][ii]["SelectorStyle"] = atoi(selectorStyle.c_str());
-							root["result"][ii]["LevelOffHidden"] = (levelOffHidden == "true");
-							root["result"][ii]["LevelNames"] = base64_encode(levelNames);
-							root["result"][ii]["LevelActions"] = base64_encode(levelActions);
-
-							std::vector<std::string> strarray;
-							StringSplit(levelNames, "|", strarray);
-							const size_t isLevel = llevel / 10;
-							if (isLevel < strarray.size())
-							{
-								lstatus = strarray.at(isLevel);
-							}
-							else
-							{
-								lstatus = "Invalid?";
-							}
-						}
-						root["result"][ii]["Data"] = lstatus;
-					}
-					else if (dType == pTypeSecurity1)
+					fields.Set("ReverseState", bReverseState);
+					fields.Set("ReversePosition", bReversePosition);
+				}
+				else if (switchtype == device::tswitch::type::Dimmer)
+				{
+					fields.Set("TypeImg", "dimmer");
+				}
+				else if (switchtype == device::tswitch::type::Motion)
+				{
+					fields.Set("TypeImg", "motion");
+				}
+				else if (switchtype == device::tswitch::type::Selector)
+				{
+					std::string selectorStyle = options["SelectorStyle"];
+					std::string levelOffHidden = options["LevelOffHidden"];
+					std::string levelNames = options["LevelNames"];
+					std::string levelActions = options["LevelActions"];
+					if (selectorStyle.empty())
 					{
-						std::string lstatus;
-						int llevel = 0;
-						bool bHaveDimmer = false;
-						bool bHaveGroupCmd = false;
-						int maxDimLevel = 0;
-
-						GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
-
-						root["result"][ii]["Status"] = lstatus;
-						root["result"][ii]["HaveDimmer"] = bHaveDimmer;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["result"][ii]["HaveGroupCmd"] = bHaveGroupCmd;
-						root["result"][ii]["SwitchType"] = "Security";
-						root["result"][ii]["SwitchTypeVal"] = switchtype; // was 0?;
-						root["result"][ii]["TypeImg"] = "security";
-						root["result"][ii]["StrParam1"] = strParam1;
-						root["result"][ii]["StrParam2"] = strParam2;
-						root["result"][ii]["Protected"] = (iProtected != 0);
-
-						if ((dSubType == sTypeKD101) || (dSubType == sTypeSA30) || (dSubType == sTypeRM174RF) || (switchtype == device::tswitch::type::SMOKEDETECTOR))
-						{
-							root["result"][ii]["SwitchTypeVal"] = device::tswitch::type::SMOKEDETECTOR;
-							root["result"][ii]["TypeImg"] = "smoke";
-							root["result"][ii]["SwitchType"] = device::tswitch::type::Description(device::tswitch::type::SMOKEDETECTOR);
-						}
-						root["result"][ii]["Data"] = lstatus;
-						root["result"][ii]["HaveTimeout"] = false;
+						selectorStyle = "0"; // default is 'button set'
 					}
-					else if (dType == pTypeSecurity2)
+					if (levelOffHidden.empty())
 					{
-						std::string lstatus;
-						int llevel = 0;
-						bool bHaveDimmer = false;
-						bool bHaveGroupCmd = false;
-						int maxDimLevel = 0;
-
-						GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
-
-						root["result"][ii]["Status"] = lstatus;
-						root["result"][ii]["HaveDimmer"] = bHaveDimmer;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["result"][ii]["HaveGroupCmd"] = bHaveGroupCmd;
-						root["result"][ii]["SwitchType"] = "Security";
-						root["result"][ii]["SwitchTypeVal"] = switchtype; // was 0?;
-						root["result"][ii]["TypeImg"] = "security";
-						root["result"][ii]["StrParam1"] = strParam1;
-						root["result"][ii]["StrParam2"] = strParam2;
-						root["result"][ii]["Protected"] = (iProtected != 0);
-						root["result"][ii]["Data"] = lstatus;
-						root["result"][ii]["HaveTimeout"] = false;
+						levelOffHidden = "false"; // default is 'not hidden'
 					}
-					else if (dType == pTypeEvohome || dType == pTypeEvohomeRelay)
+					if (levelNames.empty())
 					{
-						std::string lstatus;
-						int llevel = 0;
-						bool bHaveDimmer = false;
-						bool bHaveGroupCmd = false;
-						int maxDimLevel = 0;
-
-						GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
-
-						root["result"][ii]["Status"] = lstatus;
-						root["result"][ii]["HaveDimmer"] = bHaveDimmer;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["result"][ii]["HaveGroupCmd"] = bHaveGroupCmd;
-						root["result"][ii]["SwitchType"] = "evohome";
-						root["result"][ii]["SwitchTypeVal"] = switchtype; // was 0?;
-						root["result"][ii]["TypeImg"] = "override_mini";
-						root["result"][ii]["StrParam1"] = strParam1;
-						root["result"][ii]["StrParam2"] = strParam2;
-						root["result"][ii]["Protected"] = (iProtected != 0);
-
-						root["result"][ii]["Data"] = lstatus;
-						root["result"][ii]["HaveTimeout"] = false;
-
-						if (dType == pTypeEvohomeRelay)
-						{
-							root["result"][ii]["SwitchType"] = "TPI";
-							root["result"][ii]["Level"] = llevel;
-							root["result"][ii]["LevelInt"] = atoi(sValue.c_str());
-							if (root["result"][ii]["Unit"].asInt() > 100)
-								root["result"][ii]["Protected"] = true;
-
-							sprintf(szData, "%s: %d", lstatus.c_str(), atoi(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-						}
+						levelNames = "Off"; // default is Off only
 					}
-					else if ((dType == pTypeEvohomeZone) || (dType == pTypeEvohomeWater))
+					fields.Set("TypeImg", "Light");
+					fields.Set("SelectorStyle", atoi(selectorStyle.c_str()));
+					fields.Set("LevelOffHidden", (levelOffHidden == "true"));
+					fields.Set("LevelNames", base64_encode(levelNames));
+					fields.Set("LevelActions", base64_encode(levelActions));
+
+					std::vector<std::string> strarray;
+					StringSplit(levelNames, "|", strarray);
+					const size_t isLevel = llevel / 10;
+					if (isLevel < strarray.size())
 					{
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						root["result"][ii]["TypeImg"] = "override_mini";
-
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() >= 3)
-						{
-							int i = 0;
-							double tempCelcius = atof(strarray[i++].c_str());
-							double temp = ConvertTemperature(tempCelcius, tempsign);
-							double tempSetPoint;
-							root["result"][ii]["Temp"] = temp;
-							if (dType == pTypeEvohomeWater && (strarray[i] == "Off" || strarray[i] == "On"))
-							{
-								root["result"][ii]["State"] = strarray[i++];
-							}
-							else
-							{
-								tempCelcius = atof(strarray[i++].c_str());
-								tempSetPoint = ConvertTemperature(tempCelcius, tempsign);
-								root["result"][ii]["SetPoint"] = tempSetPoint;
-							}
-
-							std::string strstatus = strarray[i++];
-							root["result"][ii]["Status"] = strstatus;
-
-							if ((dType == pTypeEvohomeZone || dType == pTypeEvohomeWater) && strarray.size() >= 4)
-							{
-								root["result"][ii]["Until"] = strarray[i++];
-							}
-							if (dType == pTypeEvohomeZone)
-							{
-								if (tempCelcius == 325.1)
-									sprintf(szTmp, "Off");
-								else
-									sprintf(szTmp, "%.1f %c", tempSetPoint, tempsign);
-								if (strarray.size() >= 4)
-									sprintf(szData, "%.1f %c, (%s), %s until %s", temp, tempsign, szTmp, strstatus.c_str(), strarray[3].c_str());
-								else
-									sprintf(szData, "%.1f %c, (%s), %s", temp, tempsign, szTmp, strstatus.c_str());
-							}
-							else if (strarray.size() >= 4)
-								sprintf(szData, "%.1f %c, %s, %s until %s", temp, tempsign, strarray[1].c_str(), strstatus.c_str(), strarray[3].c_str());
-							else
-								sprintf(szData, "%.1f %c, %s, %s", temp, tempsign, strarray[1].c_str(), strstatus.c_str());
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
+						lstatus = strarray.at(isLevel);
 					}
-					else if ((dType == pTypeTEMP) || (dType == pTypeRego6XXTemp))
+					else
 					{
-						double tvalue = ConvertTemperature(atof(sValue.c_str()), tempsign);
-						root["result"][ii]["Temp"] = tvalue;
-						sprintf(szData, "%.1f %c", tvalue, tempsign);
-						root["result"][ii]["Data"] = szData;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-
-						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-						if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-						{
-							tstate = m_mainworker.m_trend_calculator[tID].m_state;
-						}
-						root["result"][ii]["trend"] = (int)tstate;
+						lstatus = "Invalid?";
 					}
-					else if (dType == pTypeThermostat1)
+				}
+				fields.Set("Data", lstatus);
+			}
+			else if (dType == pTypeSecurity1)
+			{
+				std::string lstatus;
+				int llevel = 0;
+				bool bHaveDimmer = false;
+				bool bHaveGroupCmd = false;
+				int maxDimLevel = 0;
+
+				GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+
+				fields.Set("Status", lstatus);
+				fields.Set("HaveDimmer", bHaveDimmer);
+				fields.Set("MaxDimLevel", maxDimLevel);
+				fields.Set("HaveGroupCmd", bHaveGroupCmd);
+				fields.Set("SwitchType", "Security");
+				fields.Set("SwitchTypeVal", switchtype); // was 0?;
+				fields.Set("TypeImg", "security");
+				fields.Set("StrParam1", strParam1);
+				fields.Set("StrParam2", strParam2);
+				fields.Set("Protected", (iProtected != 0));
+
+				if ((dSubType == sTypeKD101) || (dSubType == sTypeSA30) || (dSubType == sTypeRM174RF) || (switchtype == device::tswitch::type::SMOKEDETECTOR))
+				{
+					fields.Set("SwitchTypeVal", device::tswitch::type::SMOKEDETECTOR);
+					fields.Set("TypeImg", "smoke");
+					fields.Set("SwitchType", device::tswitch::type::Description(device::tswitch::type::SMOKEDETECTOR));
+				}
+				fields.Set("Data", lstatus);
+				fields.Set("HaveTimeout", false);
+			}
+			else if (dType == pTypeSecurity2)
+			{
+				std::string lstatus;
+				int llevel = 0;
+				bool bHaveDimmer = false;
+				bool bHaveGroupCmd = false;
+				int maxDimLevel = 0;
+
+				GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+
+				fields.Set("Status", lstatus);
+				fields.Set("HaveDimmer", bHaveDimmer);
+				fields.Set("MaxDimLevel", maxDimLevel);
+				fields.Set("HaveGroupCmd", bHaveGroupCmd);
+				fields.Set("SwitchType", "Security");
+				fields.Set("SwitchTypeVal", switchtype); // was 0?;
+				fields.Set("TypeImg", "security");
+				fields.Set("StrParam1", strParam1);
+				fields.Set("StrParam2", strParam2);
+				fields.Set("Protected", (iProtected != 0));
+				fields.Set("Data", lstatus);
+				fields.Set("HaveTimeout", false);
+			}
+			else if (dType == pTypeEvohome || dType == pTypeEvohomeRelay)
+			{
+				std::string lstatus;
+				int llevel = 0;
+				bool bHaveDimmer = false;
+				bool bHaveGroupCmd = false;
+				int maxDimLevel = 0;
+
+				GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+
+				fields.Set("Status", lstatus);
+				fields.Set("HaveDimmer", bHaveDimmer);
+				fields.Set("MaxDimLevel", maxDimLevel);
+				fields.Set("HaveGroupCmd", bHaveGroupCmd);
+				fields.Set("SwitchType", "evohome");
+				fields.Set("SwitchTypeVal", switchtype); // was 0?;
+				fields.Set("TypeImg", "override_mini");
+				fields.Set("StrParam1", strParam1);
+				fields.Set("StrParam2", strParam2);
+				fields.Set("Protected", (iProtected != 0));
+
+				fields.Set("Data", lstatus);
+				fields.Set("HaveTimeout", false);
+
+				if (dType == pTypeEvohomeRelay)
+				{
+					fields.Set("SwitchType", "TPI");
+					fields.Set("Level", llevel);
+					fields.Set("LevelInt", atoi(sValue.c_str()));
+					if (fields.GetInt("Unit") > 100)
+						fields.Set("Protected", true);
+
+					sprintf(szData, "%s: %d", lstatus.c_str(), atoi(sValue.c_str()));
+					fields.Set("Data", szData);
+				}
+			}
+			else if ((dType == pTypeEvohomeZone) || (dType == pTypeEvohomeWater))
+			{
+				fields.Set("HaveTimeout", bHaveTimeout);
+				fields.Set("TypeImg", "override_mini");
+
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() >= 3)
+				{
+					int i = 0;
+					double tempCelcius = atof(strarray[i++].c_str());
+					double temp = ConvertTemperature(tempCelcius, tempsign);
+					double tempSetPoint;
+					fields.Set("Temp", temp);
+					if (dType == pTypeEvohomeWater && (strarray[i] == "Off" || strarray[i] == "On"))
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 4)
-						{
-							double tvalue = ConvertTemperature(atof(strarray[0].c_str()), tempsign);
-							root["result"][ii]["Temp"] = tvalue;
-							sprintf(szData, "%.1f %c", tvalue, tempsign);
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
+						fields.Set("State", strarray[i++]);
 					}
-					else if ((dType == pTypeRFXSensor) && (dSubType == sTypeRFXSensorTemp))
+					else
 					{
-						double tvalue = ConvertTemperature(atof(sValue.c_str()), tempsign);
-						root["result"][ii]["Temp"] = tvalue;
-						sprintf(szData, "%.1f %c", tvalue, tempsign);
-						root["result"][ii]["Data"] = szData;
-						root["result"][ii]["TypeImg"] = "temperature";
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-						if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-						{
-							tstate = m_mainworker.m_trend_calculator[tID].m_state;
-						}
-						root["result"][ii]["trend"] = (int)tstate;
+						tempCelcius = atof(strarray[i++].c_str());
+						tempSetPoint = ConvertTemperature(tempCelcius, tempsign);
+						fields.Set("SetPoint", tempSetPoint);
 					}
-					else if (dType == pTypeHUM)
+
+					std::string strstatus = strarray[i++];
+					fields.Set("Status", strstatus);
+
+					if ((dType == pTypeEvohomeZone || dType == pTypeEvohomeWater) && strarray.size() >= 4)
 					{
-						root["result"][ii]["Humidity"] = nValue;
-						root["result"][ii]["HumidityStatus"] = RFX_Humidity_Status_Desc(atoi(sValue.c_str()));
-						sprintf(szData, "Humidity %d %%", nValue);
-						root["result"][ii]["Data"] = szData;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+						fields.Set("Until", strarray[i++]);
 					}
-					else if (dType == pTypeTEMP_HUM)
+					if (dType == pTypeEvohomeZone)
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 3)
-						{
-							double tempCelcius = atof(strarray[0].c_str());
-							double temp = ConvertTemperature(tempCelcius, tempsign);
-							double humidity = atoi(strarray[1].c_str());
+						if (tempCelcius == 325.1)
+							sprintf(szTmp, "Off");
+						else
+							sprintf(szTmp, "%.1f %c", tempSetPoint, tempsign);
+						if (strarray.size() >= 4)
+							sprintf(szData, "%.1f %c, (%s), %s until %s", temp, tempsign, szTmp, strstatus.c_str(), strarray[3].c_str());
+						else
+							sprintf(szData, "%.1f %c, (%s), %s", temp, tempsign, szTmp, strstatus.c_str());
+					}
+					else if (strarray.size() >= 4)
+						sprintf(szData, "%.1f %c, %s, %s until %s", temp, tempsign, strarray[1].c_str(), strstatus.c_str(), strarray[3].c_str());
+					else
+						sprintf(szData, "%.1f %c, %s, %s", temp, tempsign, strarray[1].c_str(), strstatus.c_str());
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if ((dType == pTypeTEMP) || (dType == pTypeRego6XXTemp))
+			{
+				double tvalue = ConvertTemperature(atof(sValue.c_str()), tempsign);
+				fields.Set("Temp", tvalue);
+				sprintf(szData, "%.1f %c", tvalue, tempsign);
+				fields.Set("Data", szData);
+				fields.Set("HaveTimeout", bHaveTimeout);
+
+				_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+				uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
+				{
+					std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+					auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+					if (ittTC != m_mainworker.m_trend_calculator.end())
+						tstate = ittTC->second.m_state;
+				}
+				fields.Set("trend", (int)tstate);
+			}
+			else if (dType == pTypeThermostat1)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 4)
+				{
+					double tvalue = ConvertTemperature(atof(strarray[0].c_str()), tempsign);
+					fields.Set("Temp", tvalue);
+					sprintf(szData, "%.1f %c", tvalue, tempsign);
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if ((dType == pTypeRFXSensor) && (dSubType == sTypeRFXSensorTemp))
+			{
+				double tvalue = ConvertTemperature(atof(sValue.c_str()), tempsign);
+				fields.Set("Temp", tvalue);
+				sprintf(szData, "%.1f %c", tvalue, tempsign);
+				fields.Set("Data", szData);
+				fields.Set("TypeImg", "temperature");
+				fields.Set("HaveTimeout", bHaveTimeout);
+				_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+				uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
+				{
+					std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+					auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+					if (ittTC != m_mainworker.m_trend_calculator.end())
+						tstate = ittTC->second.m_state;
+				}
+				fields.Set("trend", (int)tstate);
+			}
+			else if (dType == pTypeHUM)
+			{
+				fields.Set("Humidity", nValue);
+				fields.Set("HumidityStatus", RFX_Humidity_Status_Desc(atoi(sValue.c_str())));
+				sprintf(szData, "Humidity %d %%", nValue);
+				fields.Set("Data", szData);
+				fields.Set("HaveTimeout", bHaveTimeout);
+			}
+			else if (dType == pTypeTEMP_HUM)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 3)
+				{
+					double tempCelcius = atof(strarray[0].c_str());
+					double temp = ConvertTemperature(tempCelcius, tempsign);
+					double humidity = atoi(strarray[1].c_str());
 
-							root["result"][ii]["Temp"] = temp;
-							root["result"][ii]["Humidity"] = humidity;
-							root["result"][ii]["HumidityStatus"] = RFX_Humidity_Status_Desc(atoi(strarray[2].c_str()));
-							sprintf(szData, "%.1f %c, %d %%", temp, tempsign, atoi(strarray[1].c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+					fields.Set("Temp", temp);
+					fields.Set("Humidity", humidity);
+					fields.Set("HumidityStatus", RFX_Humidity_Status_Desc(atoi(strarray[2].c_str())));
+					sprintf(szData, "%.1f %c, %d %%", temp, tempsign, atoi(strarray[1].c_str()));
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
 
-							// Calculate dew point
+					// Calculate dew point
 
-							sprintf(szTmp, "%.2f", ConvertTemperature(CalculateDewPoint(tempCelcius, ground(humidity)), tempsign));
-							root["result"][ii]["DewPoint"] = szTmp;
+					sprintf(szTmp, "%.2f", ConvertTemperature(CalculateDewPoint(tempCelcius, ground(humidity)), tempsign));
+					fields.Set("DewPoint", szTmp);
 
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
-							root["result"][ii]["trend"] = (int)tstate;
-						}
-					}
-					else if (dType == pTypeTEMP_HUM_BARO)
+					_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+					uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 5)
-						{
-							double tempCelcius = atof(strarray[0].c_str());
-							double temp = ConvertTemperature(tempCelcius, tempsign);
-							double humidity = atof(strarray[1].c_str());
+						std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+						auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+						if (ittTC != m_mainworker.m_trend_calculator.end())
+							tstate = ittTC->second.m_state;
+					}
+					fields.Set("trend", (int)tstate);
+				}
+			}
+			else if (dType == pTypeTEMP_HUM_BARO)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 5)
+				{
+					double tempCelcius = atof(strarray[0].c_str());
+					double temp = ConvertTemperature(tempCelcius, tempsign);
+					double humidity = atof(strarray[1].c_str());
 
-							root["result"][ii]["Temp"] = temp;
-							root["result"][ii]["Humidity"] = humidity;
-							root["result"][ii]["HumidityStatus"] = RFX_Humidity_Status_Desc(atoi(strarray[2].c_str()));
-							root["result"][ii]["Forecast"] = atoi(strarray[4].c_str());
+					fields.Set("Temp", temp);
+					fields.Set("Humidity", humidity);
+					fields.Set("HumidityStatus", RFX_Humidity_Status_Desc(atoi(strarray[2].c_str())));
+					fields.Set("Forecast", atoi(strarray[4].c_str()));
 
-							sprintf(szTmp, "%.2f", ConvertTemperature(CalculateDewPoint(tempCelcius, ground(humidity)), tempsign));
-							root["result"][ii]["DewPoint"] = szTmp;
+					sprintf(szTmp, "%.2f", ConvertTemperature(CalculateDewPoint(tempCelcius, ground(humidity)), tempsign));
+					fields.Set("DewPoint", szTmp);
 
-							if (dSubType == sTypeTHBFloat)
-							{
-								root["result"][ii]["Barometer"] = atof(strarray[3].c_str());
-								root["result"][ii]["ForecastStr"] = RFX_WSForecast_Desc(atoi(strarray[4].c_str()));
-							}
-							else
-							{
-								root["result"][ii]["Barometer"] = atoi(strarray[3].c_str());
-								root["result"][ii]["ForecastStr"] = RFX_Forecast_Desc(atoi(strarray[4].c_str()));
-							}
-							if (dSubType == sTypeTHBFloat)
-							{
-								sprintf(szData, "%.1f %c, %d %%, %.1f hPa", temp, tempsign, atoi(strarray[1].c_str()), atof(strarray[3].c_str()));
-							}
-							else
-							{
-								sprintf(szData, "%.1f %c, %d %%, %d hPa", temp, tempsign, atoi(strarray[1].c_str()), atoi(strarray[3].c_str()));
-							}
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+					if (dSubType == sTypeTHBFloat)
+					{
+						fields.Set("Barometer", atof(strarray[3].c_str()));
+						fields.Set("ForecastStr", RFX_WSForecast_Desc(atoi(strarray[4].c_str())));
+					}
+					else
+					{
+						fields.Set("Barometer", atoi(strarray[3].c_str()));
+						fields.Set("ForecastStr", RFX_Forecast_Desc(atoi(strarray[4].c_str())));
+					}
+					if (dSubType == sTypeTHBFloat)
+					{
+						sprintf(szData, "%.1f %c, %d %%, %.1f hPa", temp, tempsign, atoi(strarray[1].c_str()), atof(strarray[3].c_str()));
+					}
+					else
+					{
+						sprintf(szData, "%.1f %c, %d %%, %d hPa", temp, tempsign, atoi(strarray[1].c_str()), atoi(strarray[3].c_str()));
+					}
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
 
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
-							root["result"][ii]["trend"] = (int)tstate;
-						}
+					_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+					uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
+					{
+						std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+						auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+						if (ittTC != m_mainworker.m_trend_calculator.end())
+							tstate = ittTC->second.m_state;
 					}
-					else if (dType == pTypeTEMP_BARO)
+					fields.Set("trend", (int)tstate);
+				}
+			}
+			else if (dType == pTypeTEMP_BARO)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() >= 3)
+				{
+					double tvalue = ConvertTemperature(atof(strarray[0].c_str()), tempsign);
+					fields.Set("Temp", tvalue);
+					int forecast = atoi(strarray[2].c_str());
+					fields.Set("Forecast", forecast);
+					fields.Set("ForecastStr", BMP_Forecast_Desc(forecast));
+					fields.Set("Barometer", atof(strarray[1].c_str()));
+
+					sprintf(szData, "%.1f %c, %.1f hPa", tvalue, tempsign, atof(strarray[1].c_str()));
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+
+					_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+					uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() >= 3)
-						{
-							double tvalue = ConvertTemperature(atof(strarray[0].c_str()), tempsign);
-							root["result"][ii]["Temp"] = tvalue;
-							int forecast = atoi(strarray[2].c_str());
-							root["result"][ii]["Forecast"] = forecast;
-							root["result"][ii]["ForecastStr"] = BMP_Forecast_Desc(forecast);
-							root["result"][ii]["Barometer"] = atof(strarray[1].c_str());
-
-							sprintf(szData, "%.1f %c, %.1f hPa", tvalue, tempsign, atof(strarray[1].c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
-							root["result"][ii]["trend"] = (int)tstate;
-						}
+						std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+						auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+						if (ittTC != m_mainworker.m_trend_calculator.end())
+							tstate = ittTC->second.m_state;
 					}
-					else if (dType == pTypeUV)
+					fields.Set("trend", (int)tstate);
+				}
+			}
+			else if (dType == pTypeUV)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 2)
+				{
+					float UVI = static_cast<float>(atof(strarray[0].c_str()));
+					fields.Set("UVI", strarray[0]);
+					if (dSubType == sTypeUV3)
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 2)
-						{
-							float UVI = static_cast<float>(atof(strarray[0].c_str()));
-							root["result"][ii]["UVI"] = strarray[0];
-							if (dSubType == sTypeUV3)
-							{
-								double tvalue = ConvertTemperature(atof(strarray[1].c_str()), tempsign);
+						double tvalue = ConvertTemperature(atof(strarray[1].c_str()), tempsign);
 
-								root["result"][ii]["Temp"] = tvalue;
-								sprintf(szData, "%.1f UVI, %.1f&deg; %c", UVI, tvalue, tempsign);
+						fields.Set("Temp", tvalue);
+						sprintf(szData, "%.1f UVI, %.1f&deg; %c", UVI, tvalue, tempsign);
 
-								_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-								uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-								if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-								{
-									tstate = m_mainworker.m_trend_calculator[tID].m_state;
-								}
-								root["result"][ii]["trend"] = (int)tstate;
-							}
-							else
-							{
-								sprintf(szData, "%.1f UVI", UVI);
-							}
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
+						{
+							std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+							auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+							if (ittTC != m_mainworker.m_trend_calculator.end())
+								tstate = ittTC->second.m_state;
 						}
+						fields.Set("trend", (int)tstate);
 					}
-					else if (dType == pTypeWIND)
+					else
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 6)
-						{
-							root["result"][ii]["Direction"] = atof(strarray[0].c_str());
-							root["result"][ii]["DirectionStr"] = strarray[1];
-
-							if (dSubType != sTypeWIND5)
-							{
-								int intSpeed = atoi(strarray[2].c_str());
-								if (m_sql.m_windunit != WINDUNIT_Beaufort)
-								{
-									sprintf(szTmp, "%.1f", float(intSpeed) * m_sql.m_windscale);
-								}
-								else
-								{
-									float windms = float(intSpeed) * 0.1F;
-									sprintf(szTmp, "%d", MStoBeaufort(windms));
-								}
-								root["result"][ii]["Speed"] = szTmp;
-							}
-
-							// if (dSubType!=sTypeWIND6) //problem in RFXCOM firmware? gust=speed?
-							{
-								int intGust = atoi(strarray[3].c_str());
-								if (m_sql.m_windunit != WINDUNIT_Beaufort)
-								{
-									sprintf(szTmp, "%.1f", float(intGust) * m_sql.m_windscale);
-								}
-								else
-								{
-									float gustms = float(intGust) * 0.1F;
-									sprintf(szTmp, "%d", MStoBeaufort(gustms));
-								}
-								root["result"][ii]["Gust"] = szTmp;
-							}
-							if ((dSubType == sTypeWIND4) || (dSubType == sTypeWINDNoTemp))
-							{
-								if (dSubType == sTypeWIND4)
-								{
-									double tvalue = ConvertTemperature(atof(strarray[4].c_str()), tempsign);
-									root["result"][ii]["Temp"] = tvalue;
-								}
-								double tvalue = ConvertTemperature(atof(strarray[5].c_str()), tempsign);
-								root["result"][ii]["Chill"] = tvalue;
+						sprintf(szData, "%.1f UVI", UVI);
+					}
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if (dType == pTypeWIND)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 6)
+				{
+					fields.Set("Direction", atof(strarray[0].c_str()));
+					fields.Set("DirectionStr", strarray[1]);
 
-								_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-								uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-								if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-								{
-									tstate = m_mainworker.m_trend_calculator[tID].m_state;
-								}
-								root["result"][ii]["trend"] = (int)tstate;
-							}
-							root["result"][ii]["Data"] = sValue;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+					if (dSubType != sTypeWIND5)
+					{
+						int intSpeed = atoi(strarray[2].c_str());
+						if (m_sql.m_windunit != WINDUNIT_Beaufort)
+						{
+							sprintf(szTmp, "%.1f", float(intSpeed) * m_sql.m_windscale);
 						}
+						else
+						{
+							float windms = float(intSpeed) * 0.1F;
+							sprintf(szTmp, "%d", MStoBeaufort(windms));
+						}
+						fields.Set("Speed", szTmp);
 					}
-					else if (dType == pTypeRAIN)
+
+					// if (dSubType!=sTypeWIND6) //problem in RFXCOM firmware? gust=speed?
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 2)
+						int intGust = atoi(strarray[3].c_str());
+						if (m_sql.m_windunit != WINDUNIT_Beaufort)
 						{
-							// get lowest value of today, and max rate
-							time_t now = mytime(nullptr);
-							struct tm ltime;
-							localtime_r(&now, &ltime);
-							char szDate[40];
-							sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-							std::vector<std::vector<std::string>> result2;
-
-							if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
-							{
-								result2 = m_sql.safe_query("SELECT Total, Rate FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY ROWID DESC LIMIT 1",
-									sd[0].c_str(), szDate);
-							}
-							else
-							{
-								result2 = m_sql.safe_query("SELECT MIN(Total), MAX(Total) FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
-							}
-
-							if (!result2.empty())
-							{
-								double total_real = 0;
-								float rate = 0;
-								std::vector<std::string> sd2 = result2[0];
-
-								if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
-								{
-									total_real = atof(sd2[0].c_str());
-								}
-								else
-								{
-									double total_min = atof(sd2[0].c_str());
-									double total_max = atof(strarray[1].c_str());
-									total_real = total_max - total_min;
-								}
-
-								total_real *= AddjMulti;
-								if (dSubType == sTypeRAINByRate)
-								{
-									rate = static_cast<float>(atof(sd2[1].c_str()) / 10000.0F);
-								}
-								else
-								{
-									rate = (static_cast<float>(atof(strarray[0].c_str())) / 100.0F) * float(AddjMulti);
-								}
-
-								sprintf(szTmp, "%.1f", total_real);
-								root["result"][ii]["Rain"] = szTmp;
-								sprintf(szTmp, "%g", rate);
-								root["result"][ii]["RainRate"] = szTmp;
-								root["result"][ii]["Data"] = sValue;
-								root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							}
-							else
-							{
-								root["result"][ii]["Rain"] = "0";
-								root["result"][ii]["RainRate"] = "0";
-								root["result"][ii]["Data"] = "0";
-								root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							}
+							sprintf(szTmp, "%.1f", float(intGust) * m_sql.m_windscale);
+						}
+						else
+						{
+							float gustms = float(intGust) * 0.1F;
+							sprintf(szTmp, "%d", MStoBeaufort(gustms));
 						}
+						fields.Set("Gust", szTmp);
 					}
-					else if (dType == pTypeRFXMeter)
+					if ((dSubType == sTypeWIND4) || (dSubType == sTypeWINDNoTemp))
 					{
-						std::string ValueQuantity = options["ValueQuantity"];
-						std::string ValueUnits = options["ValueUnits"];
-						float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
-
-						if (ValueQuantity.empty())
+						if (dSubType == sTypeWIND4)
 						{
-							ValueQuantity = "Custom";
+							double tvalue = ConvertTemperature(atof(strarray[4].c_str()), tempsign);
+							fields.Set("Temp", tvalue);
 						}
+						double tvalue = ConvertTemperature(atof(strarray[5].c_str()), tempsign);
+						fields.Set("Chill", tvalue);
 
-						// get value of today
-						time_t now = mytime(nullptr);
-						struct tm ltime;
-						localtime_r(&now, &ltime);
-						char szDate[40];
-						sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-						std::vector<std::vector<std::string>> result2;
-						strcpy(szTmp, "0");
-						result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
-						if (!result2.empty())
+						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
 						{
-							std::vector<std::string> sd2 = result2[0];
-							if (sd2[0].empty())
-							{
-								_log.Log(LOG_ERROR, "Empty Value in Meter table for device idx: '%q'", sd[0].c_str());
-								continue;
-							}
-							if (!is_number(sValue))
-							{
-								_log.Log(LOG_ERROR, "Invalid Number sValue: '%q' for device idx: '%q'", sValue.c_str(), sd[0].c_str());
-								continue;
-							}
-							if (!is_number(sd2[0]))
-							{
-								_log.Log(LOG_ERROR, "Invalid Number value: '%q' for device idx: '%q'", sd2[0].c_str(), sd[0].c_str());
-								continue;
-							}
-							int64_t total_first = std::stoll(sd2[0]);
-							int64_t total_last = std::stoll(sValue);
-							int64_t total_real = total_last - total_first;
-
-							sprintf(szTmp, "%" PRId64, total_real);
-
-							double musage = 0.0F;
-							switch (metertype)
-							{
-							case device::tmeter::type::ENERGY:
-							case device::tmeter::type::ENERGY_GENERATED:
-								musage = double(total_real) / divider;
-								sprintf(szTmp, "%.3f kWh", musage);
-								break;
-							case device::tmeter::type::GAS:
-								musage = double(total_real) / divider;
-								sprintf(szTmp, "%.3f m3", musage);
-								break;
-							case device::tmeter::type::WATER:
-								musage = double(total_real) / (divider / 1000.0F);
-								sprintf(szTmp, "%d Liter", ground(musage));
-								break;
-							case device::tmeter::type::COUNTER:
-								musage = double(total_real) / divider;
-								sprintf(szTmp, "%.10g", musage);
-								if (!ValueUnits.empty())
-								{
-									strcat(szTmp, " ");
-									strcat(szTmp, ValueUnits.c_str());
-								}
-								break;
-							default:
-								strcpy(szTmp, "?");
-								break;
-							}
+							std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+							auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+							if (ittTC != m_mainworker.m_trend_calculator.end())
+								tstate = ittTC->second.m_state;
 						}
-						root["result"][ii]["CounterToday"] = szTmp;
+						fields.Set("trend", (int)tstate);
+					}
+					fields.Set("Data", sValue);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if (dType == pTypeRAIN)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 2)
+				{
+					// get lowest value of today, and max rate
+					time_t now = mytime(nullptr);
+					struct tm ltime;
+					localtime_r(&now, &ltime);
+					char szDate[40];
+					sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
 
-						root["result"][ii]["SwitchTypeVal"] = metertype;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						root["result"][ii]["ValueQuantity"] = ValueQuantity;
-						root["result"][ii]["ValueUnits"] = ValueUnits;
-						root["result"][ii]["Divider"] = divider;
+					std::vector<std::vector<std::string>> result2;
 
-						double meteroffset = AddjValue;
+					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
+					{
+						result2 = m_sql.safe_query("SELECT Total, Rate FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY ROWID DESC LIMIT 1",
+							sd[0].c_str(), szDate);
+					}
+					else
+					{
+						result2 = m_sql.safe_query("SELECT MIN(Total), MAX(Total) FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+					}
 
-						double dvalue = static_cast<double>(atof(sValue.c_str()));
+					if (!result2.empty())
+					{
+						double total_real = 0;
+						float rate = 0;
+						std::vector<std::string> sd2 = result2[0];
 
-						switch (metertype)
+						if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 						{
-						case device::tmeter::type::ENERGY:
-						case device::tmeter::type::ENERGY_GENERATED:
-							sprintf(szTmp, "%.3f kWh", meteroffset + (dvalue / divider));
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Counter"] = szTmp;
-							break;
-						case device::tmeter::type::GAS:
-							sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Counter"] = szTmp;
-							break;
-						case device::tmeter::type::WATER:
-							sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Counter"] = szTmp;
-							break;
-						case device::tmeter::type::COUNTER:
-							sprintf(szTmp, "%.10g", meteroffset + (dvalue / divider));
-							if (!ValueUnits.empty())
-							{
-								strcat(szTmp, " ");
-								strcat(szTmp, ValueUnits.c_str());
-							}
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Counter"] = szTmp;
-							break;
-						default:
-							root["result"][ii]["Data"] = "?";
-							root["result"][ii]["Counter"] = "?";
-							break;
+							total_real = atof(sd2[0].c_str());
 						}
-					}
-					else if (dType == pTypeYouLess)
-					{
-						std::string ValueQuantity = options["ValueQuantity"];
-						std::string ValueUnits = options["ValueUnits"];
-						if (ValueQuantity.empty())
+						else
 						{
-							ValueQuantity = "Custom";
+							double total_min = atof(sd2[0].c_str());
+							double total_max = atof(strarray[1].c_str());
+							total_real = total_max - total_min;
 						}
 
-						double musage = 0;
-						double divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
-
-						// get value of today
-						time_t now = mytime(nullptr);
-						struct tm ltime;
-						localtime_r(&now, &ltime);
-						char szDate[40];
-						sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-						std::vector<std::vector<std::string>> result2;
-						strcpy(szTmp, "0");
-						result2 = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
-						if (!result2.empty())
+						total_real *= AddjMulti;
+						if (dSubType == sTypeRAINByRate)
 						{
-							std::vector<std::string> sd2 = result2[0];
-
-							uint64_t total_min = std::stoull(sd2[0]);
-							uint64_t total_max = std::stoull(sd2[1]);
-							uint64_t total_real = total_max - total_min;
-
-							sprintf(szTmp, "%" PRIu64, total_real);
-
-							musage = 0;
-							switch (metertype)
-							{
-							case device::tmeter::type::ENERGY:
-							case device::tmeter::type::ENERGY_GENERATED:
-								musage = double(total_real) / divider;
-								sprintf(szTmp, "%.3f kWh", musage);
-								break;
-							case device::tmeter::type::GAS:
-								musage = double(total_real) / divider;
-								sprintf(szTmp, "%.3f m3", musage);
-								break;
-							case device::tmeter::type::WATER:
-								musage = double(total_real) / divider;
-								sprintf(szTmp, "%.3f m3", musage);
-								break;
-							case device::tmeter::type::COUNTER:
-								sprintf(szTmp, "%.10g", double(total_real) / divider);
-								if (!ValueUnits.empty())
-								{
-									strcat(szTmp, " ");
-									strcat(szTmp, ValueUnits.c_str());
-								}
-								break;
-							default:
-								strcpy(szTmp, "0");
-								break;
-							}
+							rate = static_cast<float>(atof(sd2[1].c_str()) / 10000.0F);
 						}
-						root["result"][ii]["CounterToday"] = szTmp;
-
-						std::vector<std::string> splitresults;
-						StringSplit(sValue, ";", splitresults);
-						if (splitresults.size() < 2)
-							continue;
-
-						uint64_t total_actual = std::stoull(splitresults[0]);
-						musage = 0;
-						switch (metertype)
+						else
 						{
-						case device::tmeter::type::ENERGY:
-						case device::tmeter::type::ENERGY_GENERATED:
-							musage = double(total_actual) / divider;
-							sprintf(szTmp, "%.03f", musage);
-							break;
-						case device::tmeter::type::GAS:
-						case device::tmeter::type::WATER:
-							musage = double(total_actual) / divider;
-							sprintf(szTmp, "%.03f", musage);
-							break;
-						case device::tmeter::type::COUNTER:
-							sprintf(szTmp, "%.10g", double(total_actual) / divider);
-							break;
-						default:
-							strcpy(szTmp, "0");
-							break;
+							rate = (static_cast<float>(atof(strarray[0].c_str())) / 100.0F) * float(AddjMulti);
 						}
-						root["result"][ii]["Counter"] = szTmp;
 
-						root["result"][ii]["SwitchTypeVal"] = metertype;
+						sprintf(szTmp, "%.1f", total_real);
+						fields.Set("Rain", szTmp);
+						sprintf(szTmp, "%g", rate);
+						fields.Set("RainRate", szTmp);
+						fields.Set("Data", sValue);
+						fields.Set("HaveTimeout", bHaveTimeout);
+					}
+					else
+					{
+						fields.Set("Rain", "0");
+						fields.Set("RainRate", "0");
+						fields.Set("Data", "0");
+						fields.Set("HaveTimeout", bHaveTimeout);
+					}
+				}
+			}
+			else if (dType == pTypeRFXMeter)
+			{
+				std::string ValueQuantity = options["ValueQuantity"];
+				std::string ValueUnits = options["ValueUnits"];
+				float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-						uint64_t acounter = std::stoull(sValue);
-						musage = 0;
-						switch (metertype)
-						{
-						case device::tmeter::type::ENERGY:
-						case device::tmeter::type::ENERGY_GENERATED:
-							musage = double(acounter) / divider;
-							sprintf(szTmp, "%.3f kWh %s Watt", musage, splitresults[1].c_str());
-							break;
-						case device::tmeter::type::GAS:
-							musage = double(acounter) / divider;
-							sprintf(szTmp, "%.3f m3", musage);
-							break;
-						case device::tmeter::type::WATER:
-							musage = double(acounter) / divider;
-							sprintf(szTmp, "%.3f m3", musage);
-							break;
-						case device::tmeter::type::COUNTER:
-							sprintf(szTmp, "%.10g", double(acounter) / divider);
-							if (!ValueUnits.empty())
-							{
-								strcat(szTmp, " ");
-								strcat(szTmp, ValueUnits.c_str());
-							}
-							break;
-						default:
-							strcpy(szTmp, "0");
-							break;
-						}
-						root["result"][ii]["Data"] = szTmp;
-						root["result"][ii]["ValueQuantity"] = ValueQuantity;
-						root["result"][ii]["ValueUnits"] = ValueUnits;
-						root["result"][ii]["Divider"] = divider;
+				if (ValueQuantity.empty())
+				{
+					ValueQuantity = "Custom";
+				}
 
-						switch (metertype)
+				// get value of today
+				time_t now = mytime(nullptr);
+				struct tm ltime;
+				localtime_r(&now, &ltime);
+				char szDate[40];
+				sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+
+				std::vector<std::vector<std::string>> result2;
+				strcpy(szTmp, "0");
+				result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
+				if (!result2.empty())
+				{
+					std::vector<std::string> sd2 = result2[0];
+					if (sd2[0].empty())
+					{
+						_log.Log(LOG_ERROR, "Empty Value in Meter table for device idx: '%q'", sd[0].c_str());
+						return false;
+					}
+					if (!is_number(sValue))
+					{
+						_log.Log(LOG_ERROR, "Invalid Number sValue: '%q' for device idx: '%q'", sValue.c_str(), sd[0].c_str());
+						return false;
+					}
+					if (!is_number(sd2[0]))
+					{
+						_log.Log(LOG_ERROR, "Invalid Number value: '%q' for device idx: '%q'", sd2[0].c_str(), sd[0].c_str());
+						return false;
+					}
+					int64_t total_first = std::stoll(sd2[0]);
+					int64_t total_last = std::stoll(sValue);
+					int64_t total_real = total_last - total_first;
+
+					sprintf(szTmp, "%" PRId64, total_real);
+
+					double musage = 0.0F;
+					switch (metertype)
+					{
+					case device::tmeter::type::ENERGY:
+					case device::tmeter::type::ENERGY_GENERATED:
+						musage = double(total_real) / divider;
+						sprintf(szTmp, "%.3f kWh", musage);
+						break;
+					case device::tmeter::type::GAS:
+						musage = double(total_real) / divider;
+						sprintf(szTmp, "%.3f m3", musage);
+						break;
+					case device::tmeter::type::WATER:
+						musage = double(total_real) / (divider / 1000.0F);
+						sprintf(szTmp, "%d Liter", ground(musage));
+						break;
+					case device::tmeter::type::COUNTER:
+						musage = double(total_real) / divider;
+						sprintf(szTmp, "%.10g", musage);
+						if (!ValueUnits.empty())
 						{
-						case device::tmeter::type::ENERGY:
-						case device::tmeter::type::ENERGY_GENERATED:
-							sprintf(szTmp, "%s Watt", splitresults[1].c_str());
-							break;
-						case device::tmeter::type::GAS:
-							sprintf(szTmp, "%s m3", splitresults[1].c_str());
-							break;
-						case device::tmeter::type::WATER:
-							sprintf(szTmp, "%s m3", splitresults[1].c_str());
-							break;
-						case device::tmeter::type::COUNTER:
-							sprintf(szTmp, "%s", splitresults[1].c_str());
-							break;
-						default:
-							strcpy(szTmp, "0");
-							break;
+							strcat(szTmp, " ");
+							strcat(szTmp, ValueUnits.c_str());
 						}
+						break;
+					default:
+						strcpy(szTmp, "?");
+						break;
+					}
+				}
+				fields.Set("CounterToday", szTmp);
+
+				fields.Set("SwitchTypeVal", metertype);
+				fields.Set("HaveTimeout", bHaveTimeout);
+				fields.Set("ValueQuantity", ValueQuantity);
+				fields.Set("ValueUnits", ValueUnits);
+				fields.Set("Divider", divider);
 
-						root["result"][ii]["Usage"] = szTmp;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-					}
-					else if (dType == pTypeP1Power)
-					{
-						std::vector<std::string> splitresults;
-						StringSplit(sValue, ";", splitresults);
-						if (splitresults.size() != 6)
-						{
-							root["result"][ii]["SwitchTypeVal"] = device::tmeter::type::ENERGY;
-							root["result"][ii]["Counter"] = "0";
-							root["result"][ii]["CounterDeliv"] = "0";
-							root["result"][ii]["Usage"] = "Invalid";
-							root["result"][ii]["UsageDeliv"] = "Invalid";
-							root["result"][ii]["Data"] = "Invalid!: " + sValue;
-							root["result"][ii]["HaveTimeout"] = true;
-							root["result"][ii]["CounterToday"] = "Invalid";
-							root["result"][ii]["CounterDelivToday"] = "Invalid";
-						}
-						else
-						{
-							float EnergyDivider = 1000.0F;
-							int tValue;
-							if (m_sql.GetPreferencesVar("MeterDividerEnergy", tValue))
-							{
-								EnergyDivider = float(tValue);
-							}
+				double meteroffset = AddjValue;
 
-							uint64_t powerusage1 = std::stoull(splitresults[0]);
-							uint64_t powerusage2 = std::stoull(splitresults[1]);
-							uint64_t powerdeliv1 = std::stoull(splitresults[2]);
-							uint64_t powerdeliv2 = std::stoull(splitresults[3]);
-							uint64_t usagecurrent = std::stoull(splitresults[4]);
-							uint64_t delivcurrent = std::stoull(splitresults[5]);
+				double dvalue = static_cast<double>(atof(sValue.c_str()));
 
-							powerdeliv1 = (powerdeliv1 < 10) ? 0 : powerdeliv1;
-							powerdeliv2 = (powerdeliv2 < 10) ? 0 : powerdeliv2;
+				switch (metertype)
+				{
+				case device::tmeter::type::ENERGY:
+				case device::tmeter::type::ENERGY_GENERATED:
+					sprintf(szTmp, "%.3f kWh", meteroffset + (dvalue / divider));
+					fields.Set("Data", szTmp);
+					fields.Set("Counter", szTmp);
+					break;
+				case device::tmeter::type::GAS:
+					sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
+					fields.Set("Data", szTmp);
+					fields.Set("Counter", szTmp);
+					break;
+				case device::tmeter::type::WATER:
+					sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
+					fields.Set("Data", szTmp);
+					fields.Set("Counter", szTmp);
+					break;
+				case device::tmeter::type::COUNTER:
+					sprintf(szTmp, "%.10g", meteroffset + (dvalue / divider));
+					if (!ValueUnits.empty())
+					{
+						strcat(szTmp, " ");
+						strcat(szTmp, ValueUnits.c_str());
+					}
+					fields.Set("Data", szTmp);
+					fields.Set("Counter", szTmp);
+					break;
+				default:
+					fields.Set("Data", "?");
+					fields.Set("Counter", "?");
+					break;
+				}
+			}
+			else if (dType == pTypeYouLess)
+			{
+				std::string ValueQuantity = options["ValueQuantity"];
+				std::string ValueUnits = options["ValueUnits"];
+				if (ValueQuantity.empty())
+				{
+					ValueQuantity = "Custom";
+				}
 
-							uint64_t powerusage = powerusage1 + powerusage2;
-							uint64_t powerdeliv = powerdeliv1 + powerdeliv2;
-							if (powerdeliv < 2)
-								powerdeliv = 0;
+				double musage = 0;
+				double divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-							double musage = 0;
+				// get value of today
+				time_t now = mytime(nullptr);
+				struct tm ltime;
+				localtime_r(&now, &ltime);
+				char szDate[40];
+				sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
 
-							root["result"][ii]["SwitchTypeVal"] = device::tmeter::type::ENERGY;
-							musage = double(powerusage) / EnergyDivider;
-							sprintf(szTmp, "%.03f", musage);
-							root["result"][ii]["Counter"] = szTmp;
-							musage = double(powerdeliv) / EnergyDivider;
-							sprintf(szTmp, "%.03f", musage);
-							root["result"][ii]["CounterDeliv"] = szTmp;
+				std::vector<std::vector<std::string>> result2;
+				strcpy(szTmp, "0");
+				result2 = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+				if (!result2.empty())
+				{
+					std::vector<std::string> sd2 = result2[0];
 
-							if (bHaveTimeout)
-							{
-								usagecurrent = 0;
-								delivcurrent = 0;
-							}
-							sprintf(szTmp, "%" PRIu64 " Watt", usagecurrent);
-							root["result"][ii]["Usage"] = szTmp;
-							sprintf(szTmp, "%" PRIu64 " Watt", delivcurrent);
-							root["result"][ii]["UsageDeliv"] = szTmp;
-							root["result"][ii]["Data"] = sValue;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-
-							// get value of today
-							time_t now = mytime(nullptr);
-							struct tm ltime;
-							localtime_r(&now, &ltime);
-							char szDate[40];
-							sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-							char szDateEndofToday[40];
-							strcpy(szDateEndofToday, szDate);
-							strcat(szDateEndofToday, " 23:59:59");
+					uint64_t total_min = std::stoull(sd2[0]);
+					uint64_t total_max = std::stoull(sd2[1]);
+					uint64_t total_real = total_max - total_min;
 
-							std::vector<std::vector<std::string>> result2;
-							strcpy(szTmp, "0");
-							result2 = m_sql.safe_query("SELECT MIN(Value1), MIN(Value2), MIN(Value5), MIN(Value6) FROM MultiMeter WHERE (DeviceRowID='%q' AND Date>='%q')",
-								sd[0].c_str(), szDate);
-							if (!result2.empty())
-							{
-								std::vector<std::string> sd2 = result2[0];
+					sprintf(szTmp, "%" PRIu64, total_real);
 
-								uint64_t total_min_usage_1 = std::stoull(sd2[0]);
-								uint64_t total_min_deliv_1 = std::stoull(sd2[1]);
-								uint64_t total_min_usage_2 = std::stoull(sd2[2]);
-								uint64_t total_min_deliv_2 = std::stoull(sd2[3]);
-								uint64_t total_real_usage, total_real_deliv;
+					musage = 0;
+					switch (metertype)
+					{
+					case device::tmeter::type::ENERGY:
+					case device::tmeter::type::ENERGY_GENERATED:
+						musage = double(total_real) / divider;
+						sprintf(szTmp, "%.3f kWh", musage);
+						break;
+					case device::tmeter::type::GAS:
+						musage = double(total_real) / divider;
+						sprintf(szTmp, "%.3f m3", musage);
+						break;
+					case device::tmeter::type::WATER:
+						musage = double(total_real) / divider;
+						sprintf(szTmp, "%.3f m3", musage);
+						break;
+					case device::tmeter::type::COUNTER:
+						sprintf(szTmp, "%.10g", double(total_real) / divider);
+						if (!ValueUnits.empty())
+						{
+							strcat(szTmp, " ");
+							strcat(szTmp, ValueUnits.c_str());
+						}
+						break;
+					default:
+						strcpy(szTmp, "0");
+						break;
+					}
+				}
+				fields.Set("CounterToday", szTmp);
 
-								total_min_deliv_1 = (total_min_deliv_1 < 10) ? 0 : total_min_deliv_1;
-								total_min_deliv_2 = (total_min_deliv_2 < 10) ? 0 : total_min_deliv_2;
+				std::vector<std::string> splitresults;
+				StringSplit(sValue, ";", splitresults);
+				if (splitresults.size() < 2)
+					return false;
 
-								total_real_usage = powerusage - (total_min_usage_1 + total_min_usage_2);
-								total_real_deliv = powerdeliv - (total_min_deliv_1 + total_min_deliv_2);
+				uint64_t total_actual = std::stoull(splitresults[0]);
+				musage = 0;
+				switch (metertype)
+				{
+				case device::tmeter::type::ENERGY:
+				case device::tmeter::type::ENERGY_GENERATED:
+					musage = double(total_actual) / divider;
+					sprintf(szTmp, "%.03f", musage);
+					break;
+				case device::tmeter::type::GAS:
+				case device::tmeter::type::WATER:
+					musage = double(total_actual) / divider;
+					sprintf(szTmp, "%.03f", musage);
+					break;
+				case device::tmeter::type::COUNTER:
+					sprintf(szTmp, "%.10g", double(total_actual) / divider);
+					break;
+				default:
+					strcpy(szTmp, "0");
+					break;
+				}
+				fields.Set("Counter", szTmp);
 
-								if (total_real_deliv < 2)
-									total_real_deliv = 0;
+				fields.Set("SwitchTypeVal", metertype);
 
-								musage = double(total_real_usage) / EnergyDivider;
-								sprintf(szTmp, "%.3f kWh", musage);
-								root["result"][ii]["CounterToday"] = szTmp;
-								musage = double(total_real_deliv) / EnergyDivider;
-								sprintf(szTmp, "%.3f kWh", musage);
-								root["result"][ii]["CounterDelivToday"] = szTmp;
-							}
-							else
-							{
-								sprintf(szTmp, "%.3f kWh", 0.0F);
-								root["result"][ii]["CounterToday"] = szTmp;
-								root["result"][ii]["CounterDelivToday"] = szTmp;
-							}
-						}
-					}
-					else if (dType == pTypeP1BusDevice)
+				uint64_t acounter = std::stoull(sValue);
+				musage = 0;
+				switch (metertype)
+				{
+				case device::tmeter::type::ENERGY:
+				case device::tmeter::type::ENERGY_GENERATED:
+					musage = double(acounter) / divider;
+					sprintf(szTmp, "%.3f kWh %s Watt", musage, splitresults[1].c_str());
+					break;
+				case device::tmeter::type::GAS:
+					musage = double(acounter) / divider;
+					sprintf(szTmp, "%.3f m3", musage);
+					break;
+				case device::tmeter::type::WATER:
+					musage = double(acounter) / divider;
+					sprintf(szTmp, "%.3f m3", musage);
+					break;
+				case device::tmeter::type::COUNTER:
+					sprintf(szTmp, "%.10g", double(acounter) / divider);
+					if (!ValueUnits.empty())
 					{
+						strcat(szTmp, " ");
+						strcat(szTmp, ValueUnits.c_str());
+					}
+					break;
+				default:
+					strcpy(szTmp, "0");
+					break;
+				}
+				fields.Set("Data", szTmp);
+				fields.Set("ValueQuantity", ValueQuantity);
+				fields.Set("ValueUnits", ValueUnits);
+				fields.Set("Divider", divider);
 
-						if (dSubType == sTypeP1Water)
-							root["result"][ii]["SwitchTypeVal"] = device::tmeter::type::WATER;
-						else if (dSubType == sTypeP1CityHeat)
-							root["result"][ii]["SwitchTypeVal"] = device::tmeter::type::CITYHEAT;
-						else
-							root["result"][ii]["SwitchTypeVal"] = device::tmeter::type::GAS;
+				switch (metertype)
+				{
+				case device::tmeter::type::ENERGY:
+				case device::tmeter::type::ENERGY_GENERATED:
+					sprintf(szTmp, "%s Watt", splitresults[1].c_str());
+					break;
+				case device::tmeter::type::GAS:
+					sprintf(szTmp, "%s m3", splitresults[1].c_str());
+					break;
+				case device::tmeter::type::WATER:
+					sprintf(szTmp, "%s m3", splitresults[1].c_str());
+					break;
+				case device::tmeter::type::COUNTER:
+					sprintf(szTmp, "%s", splitresults[1].c_str());
+					break;
+				default:
+					strcpy(szTmp, "0");
+					break;
+				}
 
-						// get lowest value of today
-						time_t now = mytime(nullptr);
-						struct tm ltime;
-						localtime_r(&now, &ltime);
-						char szDate[40];
-						sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+				fields.Set("Usage", szTmp);
+				fields.Set("HaveTimeout", bHaveTimeout);
+			}
+			else if (dType == pTypeP1Power)
+			{
+				std::vector<std::string> splitresults;
+				StringSplit(sValue, ";", splitresults);
+				if (splitresults.size() != 6)
+				{
+					fields.Set("SwitchTypeVal", device::tmeter::type::ENERGY);
+					fields.Set("Counter", "0");
+					fields.Set("CounterDeliv", "0");
+					fields.Set("Usage", "Invalid");
+					fields.Set("UsageDeliv", "Invalid");
+					fields.Set("Data", "Invalid!: " + sValue);
+					fields.Set("HaveTimeout", true);
+					fields.Set("CounterToday", "Invalid");
+					fields.Set("CounterDelivToday", "Invalid");
+				}
+				else
+				{
+					float EnergyDivider = 1000.0F;
+					int tValue;
+					if (m_sql.GetPreferencesVar("MeterDividerEnergy", tValue))
+					{
+						EnergyDivider = float(tValue);
+					}
 
-						std::vector<std::vector<std::string>> result2;
+					uint64_t powerusage1 = std::stoull(splitresults[0]);
+					uint64_t powerusage2 = std::stoull(splitresults[1]);
+					uint64_t powerdeliv1 = std::stoull(splitresults[2]);
+					uint64_t powerdeliv2 = std::stoull(splitresults[3]);
+					uint64_t usagecurrent = std::stoull(splitresults[4]);
+					uint64_t delivcurrent = std::stoull(splitresults[5]);
 
-						float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
+					powerdeliv1 = (powerdeliv1 < 10) ? 0 : powerdeliv1;
+					powerdeliv2 = (powerdeliv2 < 10) ? 0 : powerdeliv2;
 
-						strcpy(szTmp, "0");
-						result2 = m_sql.safe_query("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
-						if (!result2.empty())
-						{
-							std::vector<std::string> sd2 = result2[0];
+					uint64_t powerusage = powerusage1 + powerusage2;
+					uint64_t powerdeliv = powerdeliv1 + powerdeliv2;
+					if (powerdeliv < 2)
+						powerdeliv = 0;
 
-							uint64_t total_min_usage = std::stoull(sd2[0]);
-							uint64_t usage;
-							try
-							{
-								usage = std::stoull(sValue);
-							}
-							catch (std::invalid_argument e)
-							{
-								_log.Log(LOG_ERROR, "Gas - invalid value: '%s'", sValue.c_str());
-								continue;
-							}
-							uint64_t total_today_usage = usage - total_min_usage;
-
-							double musage = double(usage) / divider;
-							sprintf(szTmp, "%.03f", musage);
-							root["result"][ii]["Counter"] = szTmp;
-							musage = double(total_today_usage) / divider;
-							if (dSubType == sTypeP1CityHeat)
-								sprintf(szTmp, "%.03f GJ", musage);
-							else
-								sprintf(szTmp, "%.03f m3", musage);
-							root["result"][ii]["CounterToday"] = szTmp;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							sprintf(szTmp, "%.03f", atof(sValue.c_str()) / divider);
-							root["result"][ii]["Data"] = szTmp;
-						}
-						else
-						{
-							sprintf(szTmp, "%.03f", 0.0F);
-							root["result"][ii]["Counter"] = szTmp;
-							if (dSubType == sTypeP1CityHeat)
-								sprintf(szTmp, "%.03f GJ", 0.0F);
-							else
-								sprintf(szTmp, "%.03f m3", 0.0F);
-							root["result"][ii]["CounterToday"] = szTmp;
-							sprintf(szTmp, "%.03f", atof(sValue.c_str()) / divider);
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
-					}
-					else if (dType == pTypeCURRENT)
-					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 3)
-						{
-							// CM113
-							int displaytype = 0;
-							int voltage = 230;
-							m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
-							m_sql.GetPreferencesVar("ElectricVoltage", voltage);
+					double musage = 0;
 
-							double val1 = atof(strarray[0].c_str());
-							double val2 = atof(strarray[1].c_str());
-							double val3 = atof(strarray[2].c_str());
+					fields.Set("SwitchTypeVal", device::tmeter::type::ENERGY);
+					musage = double(powerusage) / EnergyDivider;
+					sprintf(szTmp, "%.03f", musage);
+					fields.Set("Counter", szTmp);
+					musage = double(powerdeliv) / EnergyDivider;
+					sprintf(szTmp, "%.03f", musage);
+					fields.Set("CounterDeliv", szTmp);
 
-							if (displaytype == 0)
-							{
-								if ((val2 == 0) && (val3 == 0))
-									sprintf(szData, "%.1f A", val1);
-								else
-									sprintf(szData, "%.1f A, %.1f A, %.1f A", val1, val2, val3);
-							}
-							else
-							{
-								if ((val2 == 0) && (val3 == 0))
-									sprintf(szData, "%d Watt", int(val1 * voltage));
-								else
-									sprintf(szData, "%d Watt, %d Watt, %d Watt", int(val1 * voltage), int(val2 * voltage), int(val3 * voltage));
-							}
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["displaytype"] = displaytype;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
-					}
-					else if (dType == pTypeCURRENTENERGY)
+					if (bHaveTimeout)
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 4)
-						{
-							// CM180i
-							int displaytype = 0;
-							int voltage = 230;
-							m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
-							m_sql.GetPreferencesVar("ElectricVoltage", voltage);
-
-							double total = atof(strarray[3].c_str());
-							if (displaytype == 0)
-							{
-								sprintf(szData, "%.1f A, %.1f A, %.1f A", atof(strarray[0].c_str()), atof(strarray[1].c_str()), atof(strarray[2].c_str()));
-							}
-							else
-							{
-								sprintf(szData, "%d Watt, %d Watt, %d Watt", int(atof(strarray[0].c_str()) * voltage), int(atof(strarray[1].c_str()) * voltage),
-									int(atof(strarray[2].c_str()) * voltage));
-							}
-							if (total > 0)
-							{
-								sprintf(szTmp, ", Total: %.3f kWh", total / 1000.0F);
-								strcat(szData, szTmp);
-							}
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["displaytype"] = displaytype;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
+						usagecurrent = 0;
+						delivcurrent = 0;
 					}
-					else if (((dType == pTypeENERGY) || (dType == pTypePOWER)) || ((dType == pTypeGeneral) && (dSubType == sTypeKwh)))
+					sprintf(szTmp, "%" PRIu64 " Watt", usagecurrent);
+					fields.Set("Usage", szTmp);
+					sprintf(szTmp, "%" PRIu64 " Watt", delivcurrent);
+					fields.Set("UsageDeliv", szTmp);
+					fields.Set("Data", sValue);
+					fields.Set("HaveTimeout", bHaveTimeout);
+
+					// get value of today
+					time_t now = mytime(nullptr);
+					struct tm ltime;
+					localtime_r(&now, &ltime);
+					char szDate[40];
+					sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+					char szDateEndofToday[40];
+					strcpy(szDateEndofToday, szDate);
+					strcat(szDateEndofToday, " 23:59:59");
+
+					std::vector<std::vector<std::string>> result2;
+					strcpy(szTmp, "0");
+					result2 = m_sql.safe_query("SELECT MIN(Value1), MIN(Value2), MIN(Value5), MIN(Value6) FROM MultiMeter WHERE (DeviceRowID='%q' AND Date>='%q')",
+						sd[0].c_str(), szDate);
+					if (!result2.empty())
 					{
-						std::vector<std::string> strarray;
-						StringSplit(sValue, ";", strarray);
-						if (strarray.size() == 2)
-						{
-							double total = atof(strarray[1].c_str()) / 1000;
+						std::vector<std::string> sd2 = result2[0];
 
-							time_t now = mytime(nullptr);
-							struct tm ltime;
-							localtime_r(&now, &ltime);
-							char szDate[40];
-							sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+						uint64_t total_min_usage_1 = std::stoull(sd2[0]);
+						uint64_t total_min_deliv_1 = std::stoull(sd2[1]);
+						uint64_t total_min_usage_2 = std::stoull(sd2[2]);
+						uint64_t total_min_deliv_2 = std::stoull(sd2[3]);
+						uint64_t total_real_usage, total_real_deliv;
 
-							std::vector<std::vector<std::string>> result2;
-							strcpy(szTmp, "0");
-							// get the first value of the day instead of the minimum value, because counter can also decrease
-							// result2 = m_sql.safe_query("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')",
-							result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
-							if (!result2.empty())
-							{
-								float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
+						total_min_deliv_1 = (total_min_deliv_1 < 10) ? 0 : total_min_deliv_1;
+						total_min_deliv_2 = (total_min_deliv_2 < 10) ? 0 : total_min_deliv_2;
 
-								std::vector<std::string> sd2 = result2[0];
-								double minimum = atof(sd2[0].c_str()) / divider;
+						total_real_usage = powerusage - (total_min_usage_1 + total_min_usage_2);
+						total_real_deliv = powerdeliv - (total_min_deliv_1 + total_min_deliv_2);
 
-								sprintf(szData, "%.3f kWh", total);
-								root["result"][ii]["Data"] = szData;
-								if ((dType == pTypeENERGY) || (dType == pTypePOWER))
-								{
-									sprintf(szData, "%ld Watt", atol(strarray[0].c_str()));
-								}
-								else
-								{
-									sprintf(szData, "%g Watt", atof(strarray[0].c_str()));
-								}
-								root["result"][ii]["Usage"] = szData;
-								root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-								sprintf(szTmp, "%.3f kWh", total - minimum);
-								root["result"][ii]["CounterToday"] = szTmp;
-							}
-							else
-							{
-								sprintf(szData, "%.3f kWh", total);
-								root["result"][ii]["Data"] = szData;
-								if ((dType == pTypeENERGY) || (dType == pTypePOWER))
-								{
-									sprintf(szData, "%ld Watt", atol(strarray[0].c_str()));
-								}
-								else
-								{
-									sprintf(szData, "%g Watt", atof(strarray[0].c_str()));
-								}
-								root["result"][ii]["Usage"] = szData;
-								root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-								sprintf(szTmp, "%d kWh", 0);
-								root["result"][ii]["CounterToday"] = szTmp;
-							}
-						}
-						root["result"][ii]["TypeImg"] = "current";
-						root["result"][ii]["SwitchTypeVal"] = switchtype;		    // device::tmeter::type::ENERGY
-						root["result"][ii]["EnergyMeterMode"] = options["EnergyMeterMode"]; // for alternate Energy Reading
+						if (total_real_deliv < 2)
+							total_real_deliv = 0;
+
+						musage = double(total_real_usage) / EnergyDivider;
+						sprintf(szTmp, "%.3f kWh", musage);
+						fields.Set("CounterToday", szTmp);
+						musage = double(total_real_deliv) / EnergyDivider;
+						sprintf(szTmp, "%.3f kWh", musage);
+						fields.Set("CounterDelivToday", szTmp);
 					}
-					else if (dType == pTypeAirQuality)
+					else
 					{
-						if (bHaveTimeout)
-							nValue = 0;
-						sprintf(szTmp, "%d ppm", nValue);
-						root["result"][ii]["Data"] = szTmp;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						int airquality = nValue;
-						if (airquality < 700)
-							root["result"][ii]["Quality"] = "Excellent";
-						else if (airquality < 900)
-							root["result"][ii]["Quality"] = "Good";
-						else if (airquality < 1100)
-							root["result"][ii]["Quality"] = "Fair";
-						else if (airquality < 1600)
-							root["result"][ii]["Quality"] = "Mediocre";
-						else
-							root["result"][ii]["Quality"] = "Bad";
+						sprintf(szTmp, "%.3f kWh", 0.0F);
+						fields.Set("CounterToday", szTmp);
+						fields.Set("CounterDelivToday", szTmp);
 					}
-					else if (dType == pTypeSetpoint)
-					{
-						if (dSubType == sTypeSetpoint)
-						{
-							bHasTimers = m_sql.HasTimers(sd[0]);
+				}
+			}
+			else if (dType == pTypeP1BusDevice)
+			{
 
-							std::string value_step = options["ValueStep"];
-							std::string value_min = options["ValueMin"];
-							std::string value_max = options["ValueMax"];
-							std::string value_unit = options["ValueUnit"];
+				if (dSubType == sTypeP1Water)
+					fields.Set("SwitchTypeVal", device::tmeter::type::WATER);
+				else if (dSubType == sTypeP1CityHeat)
+					fields.Set("SwitchTypeVal", device::tmeter::type::CITYHEAT);
+				else
+					fields.Set("SwitchTypeVal", device::tmeter::type::GAS);
 
-							double valuestep = (!value_step.empty()) ? atof(value_step.c_str()) : 0.5;
-							double valuemin = (!value_min.empty()) ? atof(value_min.c_str()) : -200.0;
-							double valuemax = (!value_max.empty()) ? atof(value_max.c_str()) : 200.0;
+				// get lowest value of today
+				time_t now = mytime(nullptr);
+				struct tm ltime;
+				localtime_r(&now, &ltime);
+				char szDate[40];
+				sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
 
-							double value = atof(sValue.c_str());
+				std::vector<std::vector<std::string>> result2;
 
-							if (
-								(value_unit.empty())
-								|| (value_unit == "°C")
-								|| (value_unit == "°F")
-								|| (value_unit == "C")
-								|| (value_unit == "F")
-								)
-							{
-								if (tempsign == 'C')
-									value_unit = "°C";
-								else
-									value_unit = "°F";
+				float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-								double tempCelcius = value;
-								double temp = ConvertTemperature(tempCelcius, tempsign);
+				strcpy(szTmp, "0");
+				result2 = m_sql.safe_query("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+				if (!result2.empty())
+				{
+					std::vector<std::string> sd2 = result2[0];
 
-								sprintf(szTmp, "%.1f", temp);
-							}
-							else
-								sprintf(szTmp, "%g", value);
-
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["SetPoint"] = szTmp;
-							root["result"][ii]["HaveTimeout"] = false;
-							root["result"][ii]["step"] = valuestep;
-							root["result"][ii]["min"] = valuemin;
-							root["result"][ii]["max"] = valuemax;
-							root["result"][ii]["vunit"] = value_unit;
-							root["result"][ii]["TypeImg"] = "override_mini";
-						}
+					uint64_t total_min_usage = std::stoull(sd2[0]);
+					uint64_t usage;
+					try
+					{
+						usage = std::stoull(sValue);
 					}
-					else if (dType == pTypeRadiator1)
+					catch (std::invalid_argument e)
 					{
-						if (dSubType == sTypeSmartwares)
-						{
-							bHasTimers = m_sql.HasTimers(sd[0]);
+						_log.Log(LOG_ERROR, "Gas - invalid value: '%s'", sValue.c_str());
+						return false;
+					}
+					uint64_t total_today_usage = usage - total_min_usage;
+
+					double musage = double(usage) / divider;
+					sprintf(szTmp, "%.03f", musage);
+					fields.Set("Counter", szTmp);
+					musage = double(total_today_usage) / divider;
+					if (dSubType == sTypeP1CityHeat)
+						sprintf(szTmp, "%.03f GJ", musage);
+					else
+						sprintf(szTmp, "%.03f m3", musage);
+					fields.Set("CounterToday", szTmp);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					sprintf(szTmp, "%.03f", atof(sValue.c_str()) / divider);
+					fields.Set("Data", szTmp);
+				}
+				else
+				{
+					sprintf(szTmp, "%.03f", 0.0F);
+					fields.Set("Counter", szTmp);
+					if (dSubType == sTypeP1CityHeat)
+						sprintf(szTmp, "%.03f GJ", 0.0F);
+					else
+						sprintf(szTmp, "%.03f m3", 0.0F);
+					fields.Set("CounterToday", szTmp);
+					sprintf(szTmp, "%.03f", atof(sValue.c_str()) / divider);
+					fields.Set("Data", szTmp);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if (dType == pTypeCURRENT)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 3)
+				{
+					// CM113
+					int displaytype = 0;
+					int voltage = 230;
+					m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
+					m_sql.GetPreferencesVar("ElectricVoltage", voltage);
 
-							double tempCelcius = atof(sValue.c_str());
-							double temp = ConvertTemperature(tempCelcius, tempsign);
+					double val1 = atof(strarray[0].c_str());
+					double val2 = atof(strarray[1].c_str());
+					double val3 = atof(strarray[2].c_str());
 
-							sprintf(szTmp, "%.1f", temp);
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["SetPoint"] = szTmp;
-							root["result"][ii]["HaveTimeout"] = false; // this device does not provide feedback, so no timeout!
-							root["result"][ii]["TypeImg"] = "override_mini";
-						}
+					if (displaytype == 0)
+					{
+						if ((val2 == 0) && (val3 == 0))
+							sprintf(szData, "%.1f A", val1);
+						else
+							sprintf(szData, "%.1f A, %.1f A, %.1f A", val1, val2, val3);
 					}
-					else if (dType == pTypeGeneral)
+					else
 					{
-						if (dSubType == sTypeVisibility)
-						{
-							float vis = static_cast<float>(atof(sValue.c_str()));
-							if (metertype == 0)
-							{
-								// km
-								sprintf(szTmp, "%.1f km", vis);
-							}
-							else
-							{
-								// miles
-								sprintf(szTmp, "%.1f mi", vis * 0.6214F);
-							}
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Visibility"] = atof(sValue.c_str());
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["TypeImg"] = "visibility";
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-						}
-						else if (dSubType == sTypeDistance)
-						{
-							float vis = static_cast<float>(atof(sValue.c_str()));
-							if (metertype == 0)
-							{
-								// Metric
-								sprintf(szTmp, "%.1f cm", vis);
-							}
-							else
-							{
-								// Imperial
-								sprintf(szTmp, "%.1f in", vis * 0.3937007874015748F);
-							}
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["TypeImg"] = "visibility";
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-						}
-						else if (dSubType == sTypeSolarRadiation)
-						{
-							float radiation = static_cast<float>(atof(sValue.c_str()));
-							sprintf(szTmp, "%.1f Watt/m2", radiation);
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Radiation"] = atof(sValue.c_str());
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["TypeImg"] = "radiation";
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-						}
-						else if (dSubType == sTypeSoilMoisture)
-						{
-							sprintf(szTmp, "%d cb", nValue);
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["Desc"] = Get_Moisture_Desc(nValue);
-							root["result"][ii]["TypeImg"] = "moisture";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-						}
-						else if (dSubType == sTypeLeafWetness)
-						{
-							sprintf(szTmp, "%d", nValue);
-							root["result"][ii]["Data"] = szTmp;
-							root["result"][ii]["TypeImg"] = "leaf";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-						}
-						else if (dSubType == sTypeSystemTemp)
-						{
-							double tvalue = ConvertTemperature(atof(sValue.c_str()), tempsign);
-							root["result"][ii]["Temp"] = tvalue;
-							sprintf(szData, "%.1f %c", tvalue, tempsign);
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Computer";
-							root["result"][ii]["TypeImg"] = "temperature";
-							root["result"][ii]["Type"] = "temperature";
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
-							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
-							root["result"][ii]["trend"] = (int)tstate;
-						}
-						else if (dSubType == sTypePercentage)
-						{
-							sprintf(szData, "%g%%", atof(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["TypeImg"] = "hardware";
-						}
-						else if (dSubType == sTypeWaterflow)
-						{
-							sprintf(szData, "%g l/min", atof(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Moisture";
-							root["result"][ii]["TypeImg"] = "moisture";
-						}
-						else if (dSubType == sTypeCustom)
-						{
-							std::string szAxesLabel;
-							int SensorType = 1;
-							std::vector<std::string> sResults;
-							StringSplit(sOptions, ";", sResults);
+						if ((val2 == 0) && (val3 == 0))
+							sprintf(szData, "%d Watt", int(val1 * voltage));
+						else
+							sprintf(szData, "%d Watt, %d Watt, %d Watt", int(val1 * voltage), int(val2 * voltage), int(val3 * voltage));
+					}
+					fields.Set("Data", szData);
+					fields.Set("displaytype", displaytype);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if (dType == pTypeCURRENTENERGY)
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 4)
+				{
+					// CM180i
+					int displaytype = 0;
+					int voltage = 230;
+					m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
+					m_sql.GetPreferencesVar("ElectricVoltage", voltage);
+
+					double total = atof(strarray[3].c_str());
+					if (displaytype == 0)
+					{
+						sprintf(szData, "%.1f A, %.1f A, %.1f A", atof(strarray[0].c_str()), atof(strarray[1].c_str()), atof(strarray[2].c_str()));
+					}
+					else
+					{
+						sprintf(szData, "%d Watt, %d Watt, %d Watt", int(atof(strarray[0].c_str()) * voltage), int(atof(strarray[1].c_str()) * voltage),
+							int(atof(strarray[2].c_str()) * voltage));
+					}
+					if (total > 0)
+					{
+						sprintf(szTmp, ", Total: %.3f kWh", total / 1000.0F);
+						strcat(szData, szTmp);
+					}
+					fields.Set("Data", szData);
+					fields.Set("displaytype", displaytype);
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+			}
+			else if (((dType == pTypeENERGY) || (dType == pTypePOWER)) || ((dType == pTypeGeneral) && (dSubType == sTypeKwh)))
+			{
+				std::vector<std::string> strarray;
+				StringSplit(sValue, ";", strarray);
+				if (strarray.size() == 2)
+				{
+					double total = atof(strarray[1].c_str()) / 1000;
+
+					time_t now = mytime(nullptr);
+					struct tm ltime;
+					localtime_r(&now, &ltime);
+					char szDate[40];
+					sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+
+					std::vector<std::vector<std::string>> result2;
+					strcpy(szTmp, "0");
+					// get the first value of the day instead of the minimum value, because counter can also decrease
+					// result2 = m_sql.safe_query("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')",
+					result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
+					if (!result2.empty())
+					{
+						float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-							if (sResults.size() == 2)
-							{
-								SensorType = atoi(sResults[0].c_str());
-								szAxesLabel = sResults[1];
-							}
-							sprintf(szData, "%g %s", atof(sValue.c_str()), szAxesLabel.c_str());
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["SensorType"] = SensorType;
-							root["result"][ii]["SensorUnit"] = szAxesLabel;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Custom";
-							root["result"][ii]["TypeImg"] = "Custom";
-						}
-						else if (dSubType == sTypeFan)
-						{
-							sprintf(szData, "%d RPM", atoi(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Fan";
-							root["result"][ii]["TypeImg"] = "Fan";
-						}
-						else if (dSubType == sTypeSoundLevel)
-						{
-							sprintf(szData, "%d dB", atoi(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["TypeImg"] = "Speaker";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
-						else if (dSubType == sTypeVoltage)
-						{
-							sprintf(szData, "%g V", atof(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["TypeImg"] = "current";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["Voltage"] = atof(sValue.c_str());
-						}
-						else if (dSubType == sTypeCurrent)
-						{
-							sprintf(szData, "%g A", atof(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["TypeImg"] = "current";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["Current"] = atof(sValue.c_str());
-						}
-						else if (dSubType == sTypeTextStatus)
+						std::vector<std::string> sd2 = result2[0];
+						double minimum = atof(sd2[0].c_str()) / divider;
+
+						sprintf(szData, "%.3f kWh", total);
+						fields.Set("Data", szData);
+						if ((dType == pTypeENERGY) || (dType == pTypePOWER))
 						{
-							root["result"][ii]["Data"] = sValue;
-							root["result"][ii]["TypeImg"] = "text";
-							root["result"][ii]["HaveTimeout"] = false;
-							root["result"][ii]["ShowNotifications"] = false;
+							sprintf(szData, "%ld Watt", atol(strarray[0].c_str()));
 						}
-						else if (dSubType == sTypeAlert)
+						else
 						{
-							if (nValue > 4)
-								nValue = 4;
-							sprintf(szData, "Level: %d", nValue);
-							root["result"][ii]["Data"] = szData;
-							if (!sValue.empty())
-								root["result"][ii]["Data"] = sValue;
-							else
-								root["result"][ii]["Data"] = Get_Alert_Desc(nValue);
-							root["result"][ii]["TypeImg"] = "Alert";
-							root["result"][ii]["Level"] = nValue;
-							root["result"][ii]["HaveTimeout"] = false;
+							sprintf(szData, "%g Watt", atof(strarray[0].c_str()));
 						}
-						else if (dSubType == sTypePressure)
+						fields.Set("Usage", szData);
+						fields.Set("HaveTimeout", bHaveTimeout);
+						sprintf(szTmp, "%.3f kWh", total - minimum);
+						fields.Set("CounterToday", szTmp);
+					}
+					else
+					{
+						sprintf(szData, "%.3f kWh", total);
+						fields.Set("Data", szData);
+						if ((dType == pTypeENERGY) || (dType == pTypePOWER))
 						{
-							sprintf(szData, "%.1f Bar", atof(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["TypeImg"] = "gauge";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["Pressure"] = atof(sValue.c_str());
+							sprintf(szData, "%ld Watt", atol(strarray[0].c_str()));
 						}
-						else if (dSubType == sTypeBaro)
+						else
 						{
-							std::vector<std::string> tstrarray;
-							StringSplit(sValue, ";", tstrarray);
-							if (tstrarray.empty())
-								continue;
-							sprintf(szData, "%g hPa", atof(tstrarray[0].c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["TypeImg"] = "gauge";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							if (tstrarray.size() > 1)
-							{
-								root["result"][ii]["Barometer"] = atof(tstrarray[0].c_str());
-								int forecast = atoi(tstrarray[1].c_str());
-								root["result"][ii]["Forecast"] = forecast;
-								root["result"][ii]["ForecastStr"] = BMP_Forecast_Desc(forecast);
-							}
+							sprintf(szData, "%g Watt", atof(strarray[0].c_str()));
 						}
+						fields.Set("Usage", szData);
+						fields.Set("HaveTimeout", bHaveTimeout);
+						sprintf(szTmp, "%d kWh", 0);
+						fields.Set("CounterToday", szTmp);
+					}
+				}
+				fields.Set("TypeImg", "current");
+				fields.Set("SwitchTypeVal", switchtype);		    // device::tmeter::type::ENERGY
+				fields.Set("EnergyMeterMode", options["EnergyMeterMode"]); // for alternate Energy Reading
+			}
+			else if (dType == pTypeAirQuality)
+			{
+				if (bHaveTimeout)
+					nValue = 0;
+				sprintf(szTmp, "%d ppm", nValue);
+				fields.Set("Data", szTmp);
+				fields.Set("HaveTimeout", bHaveTimeout);
+				int airquality = nValue;
+				if (airquality < 700)
+					fields.Set("Quality", "Excellent");
+				else if (airquality < 900)
+					fields.Set("Quality", "Good");
+				else if (airquality < 1100)
+					fields.Set("Quality", "Fair");
+				else if (airquality < 1600)
+					fields.Set("Quality", "Mediocre");
+				else
+					fields.Set("Quality", "Bad");
+			}
+			else if (dType == pTypeSetpoint)
+			{
+				if (dSubType == sTypeSetpoint)
+				{
+					bHasTimers = m_sql.HasTimers(sd[0]);
+
+					std::string value_step = options["ValueStep"];
+					std::string value_min = options["ValueMin"];
+					std::string value_max = options["ValueMax"];
+					std::string value_unit = options["ValueUnit"];
+
+					double valuestep = (!value_step.empty()) ? atof(value_step.c_str()) : 0.5;
+					double valuemin = (!value_min.empty()) ? atof(value_min.c_str()) : -200.0;
+					double valuemax = (!value_max.empty()) ? atof(value_max.c_str()) : 200.0;
+
+					double value = atof(sValue.c_str());
+
+					if (
+						(value_unit.empty())
+						|| (value_unit == "°C")
+						|| (value_unit == "°F")
+						|| (value_unit == "C")
+						|| (value_unit == "F")
+						)
+					{
+						if (tempsign == 'C')
+							value_unit = "°C";
+						else
+							value_unit = "°F";
+
+						double tempCelcius = value;
+						double temp = ConvertTemperature(tempCelcius, tempsign);
+
+						sprintf(szTmp, "%.1f", temp);
+					}
+					else
+						sprintf(szTmp, "%g", value);
+
+					fields.Set("Data", szTmp);
+					fields.Set("SetPoint", szTmp);
+					fields.Set("HaveTimeout", false);
+					fields.Set("step", valuestep);
+					fields.Set("min", valuemin);
+					fields.Set("max", valuemax);
+					fields.Set("vunit", value_unit);
+					fields.Set("TypeImg", "override_mini");
+				}
+			}
+			else if (dType == pTypeRadiator1)
+			{
+				if (dSubType == sTypeSmartwares)
+				{
+					bHasTimers = m_sql.HasTimers(sd[0]);
+
+					double tempCelcius = atof(sValue.c_str());
+					double temp = ConvertTemperature(tempCelcius, tempsign);
+
+					sprintf(szTmp, "%.1f", temp);
+					fields.Set("Data", szTmp);
+					fields.Set("SetPoint", szTmp);
+					fields.Set("HaveTimeout", false); // this device does not provide feedback, so no timeout!
+					fields.Set("TypeImg", "override_mini");
+				}
+			}
+			else if (dType == pTypeGeneral)
+			{
+				if (dSubType == sTypeVisibility)
+				{
+					float vis = static_cast<float>(atof(sValue.c_str()));
+					if (metertype == 0)
+					{
+						// km
+						sprintf(szTmp, "%.1f km", vis);
+					}
+					else
+					{
+						// miles
+						sprintf(szTmp, "%.1f mi", vis * 0.6214F);
+					}
+					fields.Set("Data", szTmp);
+					fields.Set("Visibility", atof(sValue.c_str()));
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("TypeImg", "visibility");
+					fields.Set("SwitchTypeVal", metertype);
+				}
+				else if (dSubType == sTypeDistance)
+				{
+					float vis = static_cast<float>(atof(sValue.c_str()));
+					if (metertype == 0)
+					{
+						// Metric
+						sprintf(szTmp, "%.1f cm", vis);
+					}
+					else
+					{
+						// Imperial
+						sprintf(szTmp, "%.1f in", vis * 0.3937007874015748F);
+					}
+					fields.Set("Data", szTmp);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("TypeImg", "visibility");
+					fields.Set("SwitchTypeVal", metertype);
+				}
+				else if (dSubType == sTypeSolarRadiation)
+				{
+					float radiation = static_cast<float>(atof(sValue.c_str()));
+					sprintf(szTmp, "%.1f Watt/m2", radiation);
+					fields.Set("Data", szTmp);
+					fields.Set("Radiation", atof(sValue.c_str()));
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("TypeImg", "radiation");
+					fields.Set("SwitchTypeVal", metertype);
+				}
+				else if (dSubType == sTypeSoilMoisture)
+				{
+					sprintf(szTmp, "%d cb", nValue);
+					fields.Set("Data", szTmp);
+					fields.Set("Desc", Get_Moisture_Desc(nValue));
+					fields.Set("TypeImg", "moisture");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("SwitchTypeVal", metertype);
+				}
+				else if (dSubType == sTypeLeafWetness)
+				{
+					sprintf(szTmp, "%d", nValue);
+					fields.Set("Data", szTmp);
+					fields.Set("TypeImg", "leaf");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("SwitchTypeVal", metertype);
+				}
+				else if (dSubType == sTypeSystemTemp)
+				{
+					double tvalue = ConvertTemperature(atof(sValue.c_str()), tempsign);
+					fields.Set("Temp", tvalue);
+					sprintf(szData, "%.1f %c", tvalue, tempsign);
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					if (!CustomImage)
+						fields.Set("Image", "Computer");
+					fields.Set("TypeImg", "temperature");
+					fields.Set("Type", "temperature");
+					_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+					uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
+					{
+						std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+						auto ittTC = m_mainworker.m_trend_calculator.find(tID);
+						if (ittTC != m_mainworker.m_trend_calculator.end())
+							tstate = ittTC->second.m_state;
+					}
+					fields.Set("trend", (int)tstate);
+				}
+				else if (dSubType == sTypePercentage)
+				{
+					sprintf(szData, "%g%%", atof(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("TypeImg", "hardware");
+				}
+				else if (dSubType == sTypeWaterflow)
+				{
+					sprintf(szData, "%g l/min", atof(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					if (!CustomImage)
+						fields.Set("Image", "Moisture");
+					fields.Set("TypeImg", "moisture");
+				}
+				else if (dSubType == sTypeCustom)
+				{
+					std::string szAxesLabel;
+					int SensorType = 1;
+					std::vector<std::string> sResults;
+					StringSplit(sOptions, ";", sResults);
+
+					if (sResults.size() == 2)
+					{
+						SensorType = atoi(sResults[0].c_str());
+						szAxesLabel = sResults[1];
+					}
+					sprintf(szData, "%g %s", atof(sValue.c_str()), szAxesLabel.c_str());
+					fields.Set("Data", szData);
+					fields.Set("SensorType", SensorType);
+					fields.Set("SensorUnit", szAxesLabel);
+					fields.Set("HaveTimeout", bHaveTimeout);
+
+					if (!CustomImage)
+						fields.Set("Image", "Custom");
+					fields.Set("TypeImg", "Custom");
+				}
+				else if (dSubType == sTypeFan)
+				{
+					sprintf(szData, "%d RPM", atoi(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					if (!CustomImage)
+						fields.Set("Image", "Fan");
+					fields.Set("TypeImg", "Fan");
+				}
+				else if (dSubType == sTypeSoundLevel)
+				{
+					sprintf(szData, "%d dB", atoi(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("TypeImg", "Speaker");
+					fields.Set("HaveTimeout", bHaveTimeout);
+				}
+				else if (dSubType == sTypeVoltage)
+				{
+					sprintf(szData, "%g V", atof(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("TypeImg", "current");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("Voltage", atof(sValue.c_str()));
+				}
+				else if (dSubType == sTypeCurrent)
+				{
+					sprintf(szData, "%g A", atof(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("TypeImg", "current");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("Current", atof(sValue.c_str()));
+				}
+				else if (dSubType == sTypeTextStatus)
+				{
+					fields.Set("Data", sValue);
+					fields.Set("TypeImg", "text");
+					fields.Set("HaveTimeout", false);
+					fields.Set("ShowNotifications", false);
+				}
+				else if (dSubType == sTypeAlert)
+				{
+					if (nValue > 4)
+						nValue = 4;
+					sprintf(szData, "Level: %d", nValue);
+					fields.Set("Data", szData);
+					if (!sValue.empty())
+						fields.Set("Data", sValue);
+					else
+						fields.Set("Data", Get_Alert_Desc(nValue));
+					fields.Set("TypeImg", "Alert");
+					fields.Set("Level", nValue);
+					fields.Set("HaveTimeout", false);
+				}
+				else if (dSubType == sTypePressure)
+				{
+					sprintf(szData, "%.1f Bar", atof(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("TypeImg", "gauge");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("Pressure", atof(sValue.c_str()));
+				}
+				else if (dSubType == sTypeBaro)
+				{
+					std::vector<std::string> tstrarray;
+					StringSplit(sValue, ";", tstrarray);
+					if (tstrarray.empty())
+						return false;
+					sprintf(szData, "%g hPa", atof(tstrarray[0].c_str()));
+					fields.Set("Data", szData);
+					fields.Set("TypeImg", "gauge");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					if (tstrarray.size() > 1)
+					{
+						fields.Set("Barometer", atof(tstrarray[0].c_str()));
+						int forecast = atoi(tstrarray[1].c_str());
+						fields.Set("Forecast", forecast);
+						fields.Set("ForecastStr", BMP_Forecast_Desc(forecast));
+					}
+				}
 #ifdef WITH_OPENZWAVE
-						else if (dSubType == sTypeZWaveThermostatMode)
-						{
-							strcpy(szData, "");
-							root["result"][ii]["Mode"] = nValue;
-							root["result"][ii]["TypeImg"] = "mode";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							std::string modes;
-							// Add supported modes
-							if (pHardware)
-							{
-								if (pHardware->HwdType == hardware::type::OpenZWave)
-								{
-									COpenZWave* pZWave = dynamic_cast<COpenZWave*>(pHardware);
-									unsigned long ID;
-									std::stringstream s_strid;
-									s_strid << std::hex << sd[1];
-									s_strid >> ID;
-									std::vector<std::string> vmodes = pZWave->GetSupportedThermostatModes(ID);
-									int smode = 0;
-									char szTmp[200];
-									for (const auto& mode : vmodes)
-									{
-										// Value supported
-										sprintf(szTmp, "%d;%s;", smode, mode.c_str());
-										modes += szTmp;
-										smode++;
-									}
-
-									if (!vmodes.empty())
-									{
-										if (nValue < (int)vmodes.size())
-										{
-											sprintf(szData, "%s", vmodes[nValue].c_str());
-										}
-									}
-								}
-							}
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["Modes"] = modes;
-						}
-						else if (dSubType == sTypeZWaveThermostatFanMode)
+				else if (dSubType == sTypeZWaveThermostatMode)
+				{
+					strcpy(szData, "");
+					fields.Set("Mode", nValue);
+					fields.Set("TypeImg", "mode");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					std::string modes;
+					// Add supported modes
+					if (pHardware)
+					{
+						if (pHardware->HwdType == hardware::type::OpenZWave)
 						{
-							sprintf(szData, "%s", ZWave_Thermostat_Fan_Modes[nValue]);
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["Mode"] = nValue;
-							root["result"][ii]["TypeImg"] = "mode";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							// Add supported modes (add all for now)
-							bool bAddedSupportedModes = false;
-							std::string modes;
-							// Add supported modes
-							if (pHardware)
+							COpenZWave* pZWave = dynamic_cast<COpenZWave*>(pHardware);
+							unsigned long ID;
+							std::stringstream s_strid;
+							s_strid << std::hex << sd[1];
+							s_strid >> ID;
+							std::vector<std::string> vmodes = pZWave->GetSupportedThermostatModes(ID);
+							int smode = 0;
+							char szTmp[200];
+							for (const auto& mode : vmodes)
 							{
-								if (pHardware->HwdType == hardware::type::OpenZWave)
-								{
-									COpenZWave* pZWave = dynamic_cast<COpenZWave*>(pHardware);
-									unsigned long ID;
-									std::stringstream s_strid;
-									s_strid << std::hex << sd[1];
-									s_strid >> ID;
-									modes = pZWave->GetSupportedThermostatFanModes(ID);
-									bAddedSupportedModes = !modes.empty();
-								}
+								// Value supported
+								sprintf(szTmp, "%d;%s;", smode, mode.c_str());
+								modes += szTmp;
+								smode++;
 							}
-							if (!bAddedSupportedModes)
+
+							if (!vmodes.empty())
 							{
-								int smode = 0;
-								while (ZWave_Thermostat_Fan_Modes[smode] != nullptr)
+								if (nValue < (int)vmodes.size())
 								{
-									sprintf(szTmp, "%d;%s;", smode, ZWave_Thermostat_Fan_Modes[smode]);
-									modes += szTmp;
-									smode++;
+									sprintf(szData, "%s", vmodes[nValue].c_str());
 								}
 							}
-							root["result"][ii]["Modes"] = modes;
 						}
-						else if (dSubType == sTypeZWaveThermostatOperatingState)
+					}
+					fields.Set("Data", szData);
+					fields.Set("Modes", modes);
+				}
+				else if (dSubType == sTypeZWaveThermostatFanMode)
+				{
+					sprintf(szData, "%s", ZWave_Thermostat_Fan_Modes[nValue]);
+					fields.Set("Data", szData);
+					fields.Set("Mode", nValue);
+					fields.Set("TypeImg", "mode");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					// Add supported modes (add all for now)
+					bool bAddedSupportedModes = false;
+					std::string modes;
+					// Add supported modes
+					if (pHardware)
+					{
+						if (pHardware->HwdType == hardware::type::OpenZWave)
 						{
-							strcpy(szData, "");
-							root["result"][ii]["State"] = nValue;
-							root["result"][ii]["TypeImg"] = "Fan";
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							if (nValue == 1)
-							{
-								sprintf(szData, "%s", "Cooling");
-							}
-							else if (nValue == 2)
-							{
-								sprintf(szData, "%s", "Heating");
-							}
-							else
-							{
-								sprintf(szData, "%s", "Idle");
-							}
-							root["result"][ii]["Data"] = szData;
+							COpenZWave* pZWave = dynamic_cast<COpenZWave*>(pHardware);
+							unsigned long ID;
+							std::stringstream s_strid;
+							s_strid << std::hex << sd[1];
+							s_strid >> ID;
+							modes = pZWave->GetSupportedThermostatFanModes(ID);
+							bAddedSupportedModes = !modes.empty();
 						}
-						else if (dSubType == sTypeZWaveAlarm)
+					}
+					if (!bAddedSupportedModes)
+					{
+						int smode = 0;
+						while (ZWave_Thermostat_Fan_Modes[smode] != nullptr)
 						{
-							sprintf(szData, "Event: 0x%02X (%d)", nValue, nValue);
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["TypeImg"] = "Alert";
-							root["result"][ii]["Level"] = nValue;
-							root["result"][ii]["HaveTimeout"] = false;
+							sprintf(szTmp, "%d;%s;", smode, ZWave_Thermostat_Fan_Modes[smode]);
+							modes += szTmp;
+							smode++;
 						}
+					}
+					fields.Set("Modes", modes);
+				}
+				else if (dSubType == sTypeZWaveThermostatOperatingState)
+				{
+					strcpy(szData, "");
+					fields.Set("State", nValue);
+					fields.Set("TypeImg", "Fan");
+					fields.Set("HaveTimeout", bHaveTimeout);
+					if (nValue == 1)
+					{
+						sprintf(szData, "%s", "Cooling");
+					}
+					else if (nValue == 2)
+					{
+						sprintf(szData, "%s", "Heating");
+					}
+					else
+					{
+						sprintf(szData, "%s", "Idle");
+					}
+					fields.Set("Data", szData);
+				}
+				else if (dSubType == sTypeZWaveAlarm)
+				{
+					sprintf(szData, "Event: 0x%02X (%d)", nValue, nValue);
+					fields.Set("Data", szData);
+					fields.Set("TypeImg", "Alert");
+					fields.Set("Level", nValue);
+					fields.Set("HaveTimeout", false);
+				}
 #endif
-						else if (dSubType == sTypeCounterIncremental)
-						{
-							std::string ValueQuantity = options["ValueQuantity"];
-							std::string ValueUnits = options["ValueUnits"];
-							if (ValueQuantity.empty())
-							{
-								ValueQuantity = "Custom";
-							}
-
-							double divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
-
-							// get value of today
-							time_t now = mytime(nullptr);
-							struct tm ltime;
-							localtime_r(&now, &ltime);
-							char szDate[40];
-							sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+				else if (dSubType == sTypeCounterIncremental)
+				{
+					std::string ValueQuantity = options["ValueQuantity"];
+					std::string ValueUnits = options["ValueUnits"];
+					if (ValueQuantity.empty())
+					{
+						ValueQuantity = "Custom";
+					}
 
-							std::vector<std::vector<std::string>> result2;
-							strcpy(szTmp, "0.000");
-							result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
-							if (!result2.empty())
-							{
-								std::vector<std::string> sd2 = result2[0];
+					double divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-								if (sd2[0].empty())
-								{
-									_log.Log(LOG_ERROR, "Empty Value in Meter table for device idx: '%q'", sd[0].c_str());
-									continue;
-								}
-								if (!is_number(sValue))
-								{
-									_log.Log(LOG_ERROR, "Invalid Number sValue: '%q' for device idx: '%q'", sValue.c_str(), sd[0].c_str());
-									continue;
-								}
-								if (!is_number(sd2[0]))
-								{
-									_log.Log(LOG_ERROR, "Invalid Number value: '%q' for device idx: '%q'", sd2[0].c_str(), sd[0].c_str());
-									continue;
-								}
+					// get value of today
+					time_t now = mytime(nullptr);
+					struct tm ltime;
+					localtime_r(&now, &ltime);
+					char szDate[40];
+					sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
 
-								int64_t total_first = std::stoll(sd2[0]);
-								int64_t total_last = std::stoll(sValue);
-								int64_t total_real = total_last - total_first;
+					std::vector<std::vector<std::string>> result2;
+					strcpy(szTmp, "0.000");
+					result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
+					if (!result2.empty())
+					{
+						std::vector<std::string> sd2 = result2[0];
 
-								double musage = 0;
-								switch (metertype)
-								{
-								case device::tmeter::type::ENERGY:
-								case device::tmeter::type::ENERGY_GENERATED:
-									musage = double(total_real) / divider;
-									sprintf(szTmp, "%.3f kWh", musage);
-									break;
-								case device::tmeter::type::GAS:
-									musage = double(total_real) / divider;
-									sprintf(szTmp, "%.3f m3", musage);
-									break;
-								case device::tmeter::type::WATER:
-									musage = double(total_real) / divider;
-									sprintf(szTmp, "%.3f m3", musage);
-									break;
-								case device::tmeter::type::COUNTER:
-									sprintf(szTmp, "%.10g", double(total_real) / divider);
-									if (!ValueUnits.empty())
-									{
-										strcat(szTmp, " ");
-										strcat(szTmp, ValueUnits.c_str());
-									}
-									break;
-								default:
-									strcpy(szTmp, "0");
-									break;
-								}
-							}
-							root["result"][ii]["Counter"] = sValue;
-							root["result"][ii]["CounterToday"] = szTmp;
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["TypeImg"] = "counter";
-							root["result"][ii]["ValueQuantity"] = ValueQuantity;
-							root["result"][ii]["ValueUnits"] = ValueUnits;
-							root["result"][ii]["Divider"] = divider;
-
-							double dvalue = static_cast<double>(atof(sValue.c_str()));
-							double meteroffset = AddjValue;
-
-							switch (metertype)
-							{
-							case device::tmeter::type::ENERGY:
-							case device::tmeter::type::ENERGY_GENERATED:
-								sprintf(szTmp, "%.3f kWh", meteroffset + (dvalue / divider));
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							case device::tmeter::type::GAS:
-								sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							case device::tmeter::type::WATER:
-								sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							case device::tmeter::type::COUNTER:
-								sprintf(szTmp, "%.10g", meteroffset + (dvalue / divider));
-								if (!ValueUnits.empty())
-								{
-									strcat(szTmp, " ");
-									strcat(szTmp, ValueUnits.c_str());
-								}
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							default:
-								root["result"][ii]["Data"] = "?";
-								root["result"][ii]["Counter"] = "?";
-								break;
-							}
+						if (sd2[0].empty())
+						{
+							_log.Log(LOG_ERROR, "Empty Value in Meter table for device idx: '%q'", sd[0].c_str());
+							return false;
 						}
-						else if (dSubType == sTypeManagedCounter)
+						if (!is_number(sValue))
 						{
-							std::string ValueQuantity = options["ValueQuantity"];
-							std::string ValueUnits = options["ValueUnits"];
-							if (ValueQuantity.empty())
-							{
-								ValueQuantity = "Custom";
-							}
+							_log.Log(LOG_ERROR, "Invalid Number sValue: '%q' for device idx: '%q'", sValue.c_str(), sd[0].c_str());
+							return false;
+						}
+						if (!is_number(sd2[0]))
+						{
+							_log.Log(LOG_ERROR, "Invalid Number value: '%q' for device idx: '%q'", sd2[0].c_str(), sd[0].c_str());
+							return false;
+						}
 
-							float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
+						int64_t total_first = std::stoll(sd2[0]);
+						int64_t total_last = std::stoll(sValue);
+						int64_t total_real = total_last - total_first;
 
-							std::vector<std::string> splitresults;
-							StringSplit(sValue, ";", splitresults);
-							double dvalue;
-							if (splitresults.size() < 2)
-							{
-								dvalue = static_cast<double>(atof(sValue.c_str()));
-							}
-							else
-							{
-								dvalue = static_cast<double>(atof(splitresults[1].c_str()));
-								if (dvalue < 0.0)
-								{
-									dvalue = static_cast<double>(atof(splitresults[0].c_str()));
-								}
-							}
-							root["result"][ii]["SwitchTypeVal"] = metertype;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["TypeImg"] = "counter";
-							root["result"][ii]["ValueQuantity"] = ValueQuantity;
-							root["result"][ii]["ValueUnits"] = ValueUnits;
-							root["result"][ii]["Divider"] = divider;
-							root["result"][ii]["ShowNotifications"] = false;
-							double meteroffset = AddjValue;
-
-							switch (metertype)
+						double musage = 0;
+						switch (metertype)
+						{
+						case device::tmeter::type::ENERGY:
+						case device::tmeter::type::ENERGY_GENERATED:
+							musage = double(total_real) / divider;
+							sprintf(szTmp, "%.3f kWh", musage);
+							break;
+						case device::tmeter::type::GAS:
+							musage = double(total_real) / divider;
+							sprintf(szTmp, "%.3f m3", musage);
+							break;
+						case device::tmeter::type::WATER:
+							musage = double(total_real) / divider;
+							sprintf(szTmp, "%.3f m3", musage);
+							break;
+						case device::tmeter::type::COUNTER:
+							sprintf(szTmp, "%.10g", double(total_real) / divider);
+							if (!ValueUnits.empty())
 							{
-							case device::tmeter::type::ENERGY:
-							case device::tmeter::type::ENERGY_GENERATED:
-								sprintf(szTmp, "%.3f kWh", meteroffset + (dvalue / divider));
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							case device::tmeter::type::GAS:
-								sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							case device::tmeter::type::WATER:
-								sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							case device::tmeter::type::COUNTER:
-								sprintf(szTmp, "%.10g", meteroffset + (dvalue / divider));
-								if (!ValueUnits.empty())
-								{
-									strcat(szTmp, " ");
-									strcat(szTmp, ValueUnits.c_str());
-								}
-								root["result"][ii]["Data"] = szTmp;
-								root["result"][ii]["Counter"] = szTmp;
-								break;
-							default:
-								root["result"][ii]["Data"] = "?";
-								root["result"][ii]["Counter"] = "?";
-								break;
+								strcat(szTmp, " ");
+								strcat(szTmp, ValueUnits.c_str());
 							}
+							break;
+						default:
+							strcpy(szTmp, "0");
+							break;
 						}
 					}
-					else if (dType == pTypeLux)
+					fields.Set("Counter", sValue);
+					fields.Set("CounterToday", szTmp);
+					fields.Set("SwitchTypeVal", metertype);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("TypeImg", "counter");
+					fields.Set("ValueQuantity", ValueQuantity);
+					fields.Set("ValueUnits", ValueUnits);
+					fields.Set("Divider", divider);
+
+					double dvalue = static_cast<double>(atof(sValue.c_str()));
+					double meteroffset = AddjValue;
+
+					switch (metertype)
 					{
-						sprintf(szTmp, "%.0f Lux", atof(sValue.c_str()));
-						root["result"][ii]["Data"] = szTmp;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+					case device::tmeter::type::ENERGY:
+					case device::tmeter::type::ENERGY_GENERATED:
+						sprintf(szTmp, "%.3f kWh", meteroffset + (dvalue / divider));
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
+						break;
+					case device::tmeter::type::GAS:
+						sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
+						break;
+					case device::tmeter::type::WATER:
+						sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
+						break;
+					case device::tmeter::type::COUNTER:
+						sprintf(szTmp, "%.10g", meteroffset + (dvalue / divider));
+						if (!ValueUnits.empty())
+						{
+							strcat(szTmp, " ");
+							strcat(szTmp, ValueUnits.c_str());
+						}
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
+						break;
+					default:
+						fields.Set("Data", "?");
+						fields.Set("Counter", "?");
+						break;
 					}
-					else if (dType == pTypeWEIGHT)
+				}
+				else if (dSubType == sTypeManagedCounter)
+				{
+					std::string ValueQuantity = options["ValueQuantity"];
+					std::string ValueUnits = options["ValueUnits"];
+					if (ValueQuantity.empty())
 					{
-						sprintf(szTmp, "%g %s", m_sql.m_weightscale * atof(sValue.c_str()), m_sql.m_weightsign.c_str());
-						root["result"][ii]["Data"] = szTmp;
-						root["result"][ii]["HaveTimeout"] = false;
-						root["result"][ii]["SwitchTypeVal"] = (m_sql.m_weightsign == "kg") ? 0 : 1;
+						ValueQuantity = "Custom";
 					}
-					else if (dType == pTypeUsage)
+
+					float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
+
+					std::vector<std::string> splitresults;
+					StringSplit(sValue, ";", splitresults);
+					double dvalue;
+					if (splitresults.size() < 2)
 					{
-						if (dSubType == sTypeElectric)
-						{
-							sprintf(szData, "%g Watt", atof(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-						}
-						else
-						{
-							root["result"][ii]["Data"] = sValue;
-						}
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+						dvalue = static_cast<double>(atof(sValue.c_str()));
 					}
-					else if (dType == pTypeRFXSensor)
+					else
 					{
-						switch (dSubType)
+						dvalue = static_cast<double>(atof(splitresults[1].c_str()));
+						if (dvalue < 0.0)
 						{
-						case sTypeRFXSensorAD:
-							sprintf(szData, "%d mV", atoi(sValue.c_str()));
-							root["result"][ii]["TypeImg"] = "current";
-							break;
-						case sTypeRFXSensorVolt:
-							sprintf(szData, "%d mV", atoi(sValue.c_str()));
-							root["result"][ii]["TypeImg"] = "current";
-							break;
+							dvalue = static_cast<double>(atof(splitresults[0].c_str()));
 						}
-						root["result"][ii]["Data"] = szData;
-						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
 					}
-					else if (dType == pTypeRego6XXValue)
+					fields.Set("SwitchTypeVal", metertype);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("TypeImg", "counter");
+					fields.Set("ValueQuantity", ValueQuantity);
+					fields.Set("ValueUnits", ValueUnits);
+					fields.Set("Divider", divider);
+					fields.Set("ShowNotifications", false);
+					double meteroffset = AddjValue;
+
+					switch (metertype)
 					{
-						switch (dSubType)
-						{
-						case sTypeRego6XXStatus:
-						{
-							std::string lstatus = "On";
-
-							if (atoi(sValue.c_str()) == 0)
-							{
-								lstatus = "Off";
-							}
-							root["result"][ii]["Status"] = lstatus;
-							root["result"][ii]["HaveDimmer"] = false;
-							root["result"][ii]["MaxDimLevel"] = 0;
-							root["result"][ii]["HaveGroupCmd"] = false;
-							root["result"][ii]["SwitchTypeVal"] = device::tswitch::type::OnOff;
-							root["result"][ii]["SwitchType"] = device::tswitch::type::Description(device::tswitch::type::OnOff);
-							sprintf(szData, "%d", atoi(sValue.c_str()));
-							root["result"][ii]["Data"] = szData;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-							root["result"][ii]["StrParam1"] = strParam1;
-							root["result"][ii]["StrParam2"] = strParam2;
-							root["result"][ii]["Protected"] = (iProtected != 0);
-
-							if (!CustomImage)
-								root["result"][ii]["Image"] = "Light";
-							root["result"][ii]["TypeImg"] = "utility";
-
-							uint64_t camIDX = m_mainworker.m_cameras.IsDevSceneInCamera(0, sd[0]);
-							root["result"][ii]["UsedByCamera"] = (camIDX != 0) ? true : false;
-							if (camIDX != 0)
-							{
-								std::stringstream scidx;
-								scidx << camIDX;
-								root["result"][ii]["CameraIdx"] = scidx.str();
-								root["result"][ii]["CameraAspect"] = m_mainworker.m_cameras.GetCameraAspectRatio(scidx.str());
-							}
-
-							root["result"][ii]["Level"] = 0;
-							root["result"][ii]["LevelInt"] = atoi(sValue.c_str());
-						}
+					case device::tmeter::type::ENERGY:
+					case device::tmeter::type::ENERGY_GENERATED:
+						sprintf(szTmp, "%.3f kWh", meteroffset + (dvalue / divider));
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
 						break;
-						case sTypeRego6XXCounter:
+					case device::tmeter::type::GAS:
+						sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
+						break;
+					case device::tmeter::type::WATER:
+						sprintf(szTmp, "%.3f m3", meteroffset + (dvalue / divider));
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
+						break;
+					case device::tmeter::type::COUNTER:
+						sprintf(szTmp, "%.10g", meteroffset + (dvalue / divider));
+						if (!ValueUnits.empty())
 						{
-							// get value of today
-							time_t now = mytime(nullptr);
-							struct tm ltime;
-							localtime_r(&now, &ltime);
-							char szDate[40];
-							sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-							std::vector<std::vector<std::string>> result2;
-							strcpy(szTmp, "0");
-							result2 = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
-							if (!result2.empty())
-							{
-								std::vector<std::string> sd2 = result2[0];
-
-								uint64_t total_min = std::stoull(sd2[0]);
-								uint64_t total_max = std::stoull(sd2[1]);
-								uint64_t total_real = total_max - total_min;
-
-								sprintf(szTmp, "%" PRIu64, total_real);
-							}
-							root["result"][ii]["SwitchTypeVal"] = device::tmeter::type::COUNTER;
-							root["result"][ii]["Counter"] = sValue;
-							root["result"][ii]["CounterToday"] = szTmp;
-							root["result"][ii]["Data"] = sValue;
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
+							strcat(szTmp, " ");
+							strcat(szTmp, ValueUnits.c_str());
 						}
+						fields.Set("Data", szTmp);
+						fields.Set("Counter", szTmp);
 						break;
-						}
+					default:
+						fields.Set("Data", "?");
+						fields.Set("Counter", "?");
+						break;
+					}
+				}
+			}
+			else if (dType == pTypeLux)
+			{
+				sprintf(szTmp, "%.0f Lux", atof(sValue.c_str()));
+				fields.Set("Data", szTmp);
+				fields.Set("HaveTimeout", bHaveTimeout);
+			}
+			else if (dType == pTypeWEIGHT)
+			{
+				sprintf(szTmp, "%g %s", m_sql.m_weightscale * atof(sValue.c_str()), m_sql.m_weightsign.c_str());
+				fields.Set("Data", szTmp);
+				fields.Set("HaveTimeout", false);
+				fields.Set("SwitchTypeVal", (m_sql.m_weightsign == "kg") ? 0 : 1);
+			}
+			else if (dType == pTypeUsage)
+			{
+				if (dSubType == sTypeElectric)
+				{
+					sprintf(szData, "%g Watt", atof(sValue.c_str()));
+					fields.Set("Data", szData);
+				}
+				else
+				{
+					fields.Set("Data", sValue);
+				}
+				fields.Set("HaveTimeout", bHaveTimeout);
+			}
+			else if (dType == pTypeRFXSensor)
+			{
+				switch (dSubType)
+				{
+				case sTypeRFXSensorAD:
+					sprintf(szData, "%d mV", atoi(sValue.c_str()));
+					fields.Set("TypeImg", "current");
+					break;
+				case sTypeRFXSensorVolt:
+					sprintf(szData, "%d mV", atoi(sValue.c_str()));
+					fields.Set("TypeImg", "current");
+					break;
+				}
+				fields.Set("Data", szData);
+				fields.Set("HaveTimeout", bHaveTimeout);
+			}
+			else if (dType == pTypeRego6XXValue)
+			{
+				switch (dSubType)
+				{
+				case sTypeRego6XXStatus:
+				{
+					std::string lstatus = "On";
+
+					if (atoi(sValue.c_str()) == 0)
+					{
+						lstatus = "Off";
 					}
-					//Add calculated price if known
-					if (m_sql.m_actual_prices.find(devIDX) != m_sql.m_actual_prices.end())
+					fields.Set("Status", lstatus);
+					fields.Set("HaveDimmer", false);
+					fields.Set("MaxDimLevel", 0);
+					fields.Set("HaveGroupCmd", false);
+					fields.Set("SwitchTypeVal", device::tswitch::type::OnOff);
+					fields.Set("SwitchType", device::tswitch::type::Description(device::tswitch::type::OnOff));
+					sprintf(szData, "%d", atoi(sValue.c_str()));
+					fields.Set("Data", szData);
+					fields.Set("HaveTimeout", bHaveTimeout);
+					fields.Set("StrParam1", strParam1);
+					fields.Set("StrParam2", strParam2);
+					fields.Set("Protected", (iProtected != 0));
+
+					if (!CustomImage)
+						fields.Set("Image", "Light");
+					fields.Set("TypeImg", "utility");
+
+					uint64_t camIDX = m_mainworker.m_cameras.IsDevSceneInCamera(0, sd[0]);
+					fields.Set("UsedByCamera", (camIDX != 0) ? true : false);
+					if (camIDX != 0)
 					{
-						sprintf(szTmp, "%.4f", m_sql.m_actual_prices[devIDX]);
-						root["result"][ii]["price"] = szTmp;
+						std::stringstream scidx;
+						scidx << camIDX;
+						fields.Set("CameraIdx", scidx.str());
+						fields.Set("CameraAspect", m_mainworker.m_cameras.GetCameraAspectRatio(scidx.str()));
 					}
 
-#ifdef ENABLE_PYTHON
-					if (pHardware != nullptr)
+					fields.Set("Level", 0);
+					fields.Set("LevelInt", atoi(sValue.c_str()));
+				}
+				break;
+				case sTypeRego6XXCounter:
+				{
+					// get value of today
+					time_t now = mytime(nullptr);
+					struct tm ltime;
+					localtime_r(&now, &ltime);
+					char szDate[40];
+					sprintf(szDate, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+
+					std::vector<std::vector<std::string>> result2;
+					strcpy(szTmp, "0");
+					result2 = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+					if (!result2.empty())
 					{
-						if (pHardware->HwdType == hardware::type::PythonPlugin)
-						{
-							Plugins::CPlugin* pPlugin = (Plugins::CPlugin*)pHardware;
-							bHaveTimeout = pPlugin->HasNodeFailed(sd[1].c_str(), atoi(sd[2].c_str()));
-							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						}
+						std::vector<std::string> sd2 = result2[0];
+
+						uint64_t total_min = std::stoull(sd2[0]);
+						uint64_t total_max = std::stoull(sd2[1]);
+						uint64_t total_real = total_max - total_min;
+
+						sprintf(szTmp, "%" PRIu64, total_real);
 					}
-#endif
-					root["result"][ii]["Timers"] = (bHasTimers == true) ? "true" : "false";
-					ii++;
+					fields.Set("SwitchTypeVal", device::tmeter::type::COUNTER);
+					fields.Set("Counter", sValue);
+					fields.Set("CounterToday", szTmp);
+					fields.Set("Data", sValue);
+					fields.Set("HaveTimeout", bHaveTimeout);
 				}
-				catch (const std::exception& e)
+				break;
+				}
+			}
+			//Add calculated price if known
+			if (m_sql.m_actual_prices.find(devIDX) != m_sql.m_actual_prices.end())
+			{
+				sprintf(szTmp, "%.4f", m_sql.m_actual_prices[devIDX]);
+				fields.Set("price", szTmp);
+			}
+
+#ifdef ENABLE_PYTHON
+			if (pHardware != nullptr)
+			{
+				if (pHardware->HwdType == hardware::type::PythonPlugin)
 				{
-					_log.Log(LOG_ERROR, "GetJSonDevices: exception occurred : '%s'", e.what());
-					continue;
+					Plugins::CPlugin* pPlugin = (Plugins::CPlugin*)pHardware;
+					bHaveTimeout = pPlugin->HasNodeFailed(sd[1].c_str(), atoi(sd[2].c_str()));
+					fields.Set("HaveTimeout", bHaveTimeout);
 				}
 			}
+#endif
+			fields.Set("Timers", (bHasTimers == true) ? "true" : "false");
+			return true;
 		}
 
 		void CWebServer::MakeCompareDataSensor(Json::Value& root, const std::string& sgroupby, const std::string& dbasetable, uint64_t deviceidx, const std::string& dfield, const double divider, const bool isCounter)
@@ -4189,13 +4328,29 @@ namespace http
 				if (!cparam.empty())
 				{
 					_log.Debug(DEBUG_WEBSERVER, "CWebServer::GetJSonPage :%s :%s ", cparam.c_str(), req.uri.c_str());
+					// only registered commands get their own series
+					bool bKnownParam = (m_webstreamcommands.find(cparam) != m_webstreamcommands.end()) || (m_webcommands.find(cparam) != m_webcommands.end());
+					auto timer = std::make_shared<CMetrics::CTimer>("oikomaticz_web_request_seconds", CMetrics::Label("param", bKnownParam ? cparam : "other"));
+
+					auto ps = m_webstreamcommands.find(cparam);
+					if ((ps != m_webstreamcommands.end()) && ps->second(session, req, rep))
+					{
+						if (rep.content_producer)
+						{
+							// the body is written while it is sent, time it until the producer is released after the last part
+							std::function<bool(std::string &)> producer = std::move(rep.content_producer);
+							reply::set_content_producer(&rep, [producer, timer](std::string &out) { return producer(out); });
+						}
+						rep.status = static_cast<http::server::reply::status_type>(session.reply_status);
+						return;
+					}
 
 					auto pf = m_webcommands.find(cparam);
 					if (pf != m_webcommands.end())
 					{
 						pf->second(session, req, root);
 					}
-					else
+					else if (ps == m_webstreamcommands.end())
 					{	// See if we still have a Param based version not converted to a proper command
 						// TODO: remove this once all param based code has been converted to proper commands
 						if (!HandleCommandParam(cparam, session, req, root))
@@ -4305,6 +4460,61 @@ namespace http
 			reply::add_header_attachment(&rep, oname);
 		}
 
+		// Prometheus text format
+		void CWebServer::GetMetrics(WebEmSession& session, const request& req, reply& rep)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			std::string szText = m_metrics.GetPrometheusText();
+
+			int ii = 0;
+			for (const auto& lane : m_mainworker.GetRxLaneStatus())
+			{
+				std::string szLane = CMetrics::Label("lane", std::to_string(ii++));
+				CMetrics::AddGauge(szText, "oikomaticz_rx_lane_queue_depth", szLane, static_cast<double>(lane.QueueDepth));
+				for (const auto& itt : lane.HardwareDepth)
+					CMetrics::AddGauge(szText, "oikomaticz_rx_hardware_queue_depth", CMetrics::Label("hardware", std::to_string(itt.first)) + "," + szLane, static_cast<double>(itt.second));
+			}
+			CMetrics::AddGauge(szText, "oikomaticz_rx_lane_threads", "", ii);
+
+#ifdef __linux__
+			std::ifstream status("/proc/self/status");
+			std::string sLine;
+			while (std::getline(status, sLine))
+			{
+				if (sLine.compare(0, 8, "Threads:") == 0)
+				{
+					CMetrics::AddGauge(szText, "oikomaticz_threads", "", atof(sLine.c_str() + 8));
+					break;
+				}
+			}
+#endif
+			CMetrics::AddGauge(szText, "oikomaticz_log_dropped_lines", "", static_cast<double>(_log.GetDroppedLines()));
+
+			for (const auto& cat : m_workerpool.GetStatus())
+			{
+				std::string szCategory = CMetrics::Label("category", cat.szName);
+				CMetrics::AddGauge(szText, "oikomaticz_worker_running", szCategory, static_cast<double>(cat.Running));
+				CMetrics::AddGauge(szText, "oikomaticz_worker_queued", szCategory, static_cast<double>(cat.Queued));
+			}
+			CMetrics::AddGauge(szText, "oikomaticz_worker_threads", "", static_cast<double>(m_workerpool.GetThreadCount()));
+
+			Json::Value influxStats;
+			m_influxpush.GetStatistics(influxStats);
+			for (const auto& szMember : influxStats.getMemberNames())
+			{
+				std::string szName = "oikomaticz_influx_" + szMember;
+				std::transform(szName.begin(), szName.end(), szName.begin(), ::tolower);
+				CMetrics::AddGauge(szText, szName.c_str(), "", influxStats[szMember].asDouble());
+			}
+
+			reply::set_content(&rep, szText);
+			reply::add_header_content_type(&rep, "text/plain; version=0.0.4");
+		}
+
 		void CWebServer::GetDatabaseBackup(WebEmSession& session, const request& req, reply& rep)
 		{
 			if (session.rights != 2)
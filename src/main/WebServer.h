@@ -8,6 +8,8 @@
 
 struct lua_State;
 struct lua_Debug;
+class CGraphRowWriter;
+class CDeviceFields;
 
 namespace Json
 {
@@ -18,9 +20,12 @@ namespace http {
 	namespace server {
 		class cWebem;
 		struct _tWebUserPassword;
+		struct _tHardwareListInt;
 class CWebServer : public session_store, public std::enable_shared_from_this<CWebServer>
 {
 	typedef std::function<void(WebEmSession &session, const request &req, Json::Value &root)> webserver_response_function;
+	// Sets a content producer on the reply for results that are too large to build at once, false to leave the command to the regular handler
+	typedef std::function<bool(WebEmSession &session, const request &req, reply &rep)> webserver_stream_function;
 
       public:
 	struct _tCustomIcon
@@ -35,6 +40,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	bool StartServer(server_settings &settings, const std::string &serverpath, bool bIgnoreUsernamePassword);
 	void StopServer();
 	void RegisterCommandCode(const char *idname, const webserver_response_function &ResponseFunction, bool bypassAuthentication = false);
+	void RegisterStreamCommandCode(const char *idname, const webserver_stream_function &StreamFunction);
 
 	void GetJSonPage(WebEmSession & session, const request& req, reply & rep);
 	void GetCameraSnapshot(WebEmSession & session, const request& req, reply & rep);
@@ -42,6 +48,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void GetFloorplanImage(WebEmSession& session, const request& req, reply& rep);
 	void GetServiceWorker(WebEmSession& session, const request& req, reply& rep);
 	void GetDatabaseBackup(WebEmSession & session, const request& req, reply & rep);
+	void GetMetrics(WebEmSession& session, const request& req, reply& rep);
 
 	void GetOauth2AuthCode(WebEmSession &session, const request &req, reply &rep);
 	void PostOauth2AccessToken(WebEmSession &session, const request &req, reply &rep);
@@ -83,6 +90,13 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void GetJSonDevices(Json::Value &root, const std::string &rused, const std::string &rfilter, const std::string &order, const std::string &rowid, const std::string &planID,
 			    const std::string &floorID, bool bDisplayHidden, bool bDisplayDisabled, bool bFetchFavorites, time_t LastUpdate, const std::string &username,
 			    const std::string &hardwareid = ""); // OTO
+	// As above, but every result is passed to AddResult when it is complete instead of being added to root["result"],
+	// the other members of root are set before the first call
+	void GetJSonDevices(Json::Value &root, const std::function<void(Json::Value &item)> &AddResult, const std::string &rused, const std::string &rfilter,
+			    const std::string &order, const std::string &rowid, const std::string &planID, const std::string &floorID, bool bDisplayHidden,
+			    bool bDisplayDisabled, bool bFetchFavorites, time_t LastUpdate, const std::string &username, const std::string &hardwareid);
+	// The fields GetJSonDevices returns for a single device, false when the device is not listed
+	bool GetDeviceFields(uint64_t idx, CDeviceFields &fields);
 
 	// SessionStore interface
 	WebEmStoredSession GetSession(const std::string &sessionId) override;
@@ -93,6 +107,16 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	std::string PluginHardwareDesc(int HwdID);
 
 private:
+	struct _tDeviceFieldsContext
+	{
+		time_t now;
+		struct tm tm1;
+		int SensorTimeOut;
+		std::map<int, _tHardwareListInt> *pHardwareNames;
+	};
+	bool ComputeDeviceFields(const std::vector<std::string> &sd, const std::string &sDeviceName, const _tDeviceFieldsContext &ctx, CDeviceFields &fields);
+	std::map<int, _tHardwareListInt> GetHardwareNames(const std::string &szWhere);
+
 	bool HandleCommandParam(const std::string &cparam, WebEmSession & session, const request& req, Json::Value &root);
     void GroupBy(Json::Value &root, std::string dbasetable, uint64_t idx, std::string sgroupby, bool bUseValuesOrCounter, std::function<std::string (std::string)> counterExpr, std::function<std::string (std::string)> valueExpr, std::function<std::string (double)> sumToResult);
 	void MakeCompareDataSensor(Json::Value& root, const std::string &sgroupby, const std::string &dbasetable, uint64_t deviceidx, const std::string &dfield, const double divider = 1.0, const bool isCounter = false);
@@ -157,8 +181,9 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void Cmd_GetUserVariables(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetUserVariable(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_AllowNewHardware(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetLog(WebEmSession & session, const request& req, Json::Value &root);
+	bool Cmd_StreamLog(WebEmSession & session, const request& req, reply & rep);
 	void Cmd_ClearLog(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetRxQueueStatus(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_AddPlan(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_UpdatePlan(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DeletePlan(WebEmSession & session, const request& req, Json::Value &root);
@@ -319,9 +344,9 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	//Migrated RTypes
 	void Cmd_GetUsers(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetSettings(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetDevices(WebEmSession & session, const request& req, Json::Value &root);
+	bool Cmd_StreamDevices(WebEmSession & session, const request& req, reply & rep);
 	void Cmd_DeleteDevice(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetSceneLog(WebEmSession & session, const request& req, Json::Value &root);
+	bool Cmd_StreamSceneLog(WebEmSession & session, const request& req, reply & rep);
 	void Cmd_GetScenes(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_AddScene(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DeleteScene(WebEmSession & session, const request& req, Json::Value &root);
@@ -336,8 +361,11 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void Cmd_GetSetpointTimers(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetPlans(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetFloorPlans(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetLightLog(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetTextLog(WebEmSession & session, const request& req, Json::Value &root);
+	bool Cmd_StreamLightLog(WebEmSession & session, const request& req, reply & rep);
+	bool Cmd_StreamTextLog(WebEmSession & session, const request& req, reply & rep);
+	void StreamLogRows(reply & rep, const Json::Value & root, const std::string & szTable, const std::string & szDeviceColumn, uint64_t idx, const std::string & szColumns,
+			   const std::function<bool(const std::vector<std::string> & sd, Json::Value & row)> & MakeRow,
+			   const std::function<void(Json::Value & tail)> & Finish = nullptr);
 	void Cmd_GetTransfers(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DoTransferDevice(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_Events(WebEmSession & session, const request& req, Json::Value &root);
@@ -354,6 +382,11 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void Cmd_BindEvohome(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_CustomLightIcons(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_HandleGraph(WebEmSession & session, const request& req, Json::Value &root);
+	bool Cmd_StreamGraph(WebEmSession & session, const request& req, reply & rep);
+	bool StreamCounterDayGraph(WebEmSession & session, const request& req, reply & rep, uint64_t idx);
+	void StreamGraphRows(reply & rep, uint64_t idx, const Json::Value & root, const std::string & szTable, const std::string & szColumns,
+			     const std::function<void(CGraphRowWriter & rows, const std::vector<std::string> & sd)> & WriteRow,
+			     const std::function<void(CGraphRowWriter & rows)> & Finish = nullptr);
 	void Cmd_RemoteWebClientsLog(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_SetUsed(WebEmSession & session, const request& req, Json::Value &root);
 
@@ -443,6 +476,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	std::shared_ptr<std::thread> m_thread;
 
 	std::map < std::string, webserver_response_function > m_webcommands;	//Commands
+	std::map < std::string, webserver_stream_function > m_webstreamcommands;	//Commands that can stream their result
 	void Do_Work();
 	std::vector<_tCustomIcon> m_custom_light_icons;
 	std::map<int, int> m_custom_light_icons_lookup;
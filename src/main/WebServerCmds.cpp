@@ -87,7 +87,13 @@ namespace http
 {
 	namespace server
 	{
+		// Bytes handed to the connection per call of the content producer of a complete streamed reply
+#define STREAM_TEXT_PART_SIZE (64 * 1024)
+		// Log rows fetched per call of the content producer
+#define LOG_STREAM_PAGE_ROWS 500
+
 		extern std::map<std::string, http::server::connection::_tRemoteClients> m_remote_web_clients;
+		extern std::mutex m_remote_web_clients_mutex;
 
 		struct _tGuiLanguage
 		{
@@ -1038,11 +1044,9 @@ namespace http
 			m_sql.DeleteHardware(idx);
 		}
 
-		void CWebServer::Cmd_GetLog(WebEmSession& session, const request& req, Json::Value& root)
+		// The lines are written a page at a time from the copy of the log, each page is released when it is written
+		bool CWebServer::Cmd_StreamLog(WebEmSession& session, const request& req, reply& rep)
 		{
-			root["status"] = "OK";
-			root["title"] = "GetLog";
-
 			time_t lastlogtime = 0;
 			std::string slastlogtime = request::findValue(&req, "lastlogtime");
 			if (!slastlogtime.empty())
@@ -1058,19 +1062,69 @@ namespace http
 				lLevel = (_eLogLevel)atoi(sloglevel.c_str());
 			}
 
-			std::list<CLogger::_tLogLineStruct> logmessages = _log.GetLog(lLevel);
-			int ii = 0;
-			for (const auto& msg : logmessages)
+			struct _tLogStream
+			{
+				CJSonStreamWriter writer;
+				std::list<CLogger::_tLogLineStruct> logmessages;
+				std::string LastLogTime;
+			};
+			auto state = std::make_shared<_tLogStream>();
+			state->logmessages = _log.GetLog(lLevel, lastlogtime);
+			state->writer.BeginObject();
+			state->writer.Member("status", "OK");
+			state->writer.Member("title", "GetLog");
+			if (!state->logmessages.empty())
 			{
-				if (msg.logtime > lastlogtime)
+				state->writer.Key("result");
+				state->writer.BeginArray();
+			}
+
+			reply::set_content_producer(&rep, [state](std::string& out) {
+				CJSonStreamWriter& writer = state->writer;
+				bool bHaveResult = !state->logmessages.empty();
+				for (int ii = 0; (ii < LOG_STREAM_PAGE_ROWS) && (!state->logmessages.empty()); ii++)
 				{
+					const auto& msg = state->logmessages.front();
 					std::stringstream szLogTime;
 					szLogTime << msg.logtime;
-					root["LastLogTime"] = szLogTime.str();
-					root["result"][ii]["level"] = static_cast<int>(msg.level);
-					root["result"][ii]["message"] = msg.logmessage;
-					ii++;
+					state->LastLogTime = szLogTime.str();
+					writer.BeginObject();
+					writer.Member("level", static_cast<int>(msg.level));
+					writer.Member("message", msg.logmessage);
+					writer.EndObject();
+					state->logmessages.pop_front();
+				}
+				bool bMore = !state->logmessages.empty();
+				if (!bMore)
+				{
+					if (bHaveResult)
+					{
+						writer.EndArray();
+						writer.Member("LastLogTime", state->LastLogTime);
+					}
+					writer.EndObject();
 				}
+				out += writer.Take();
+				return bMore;
+			});
+			return true;
+		}
+
+		void CWebServer::Cmd_GetRxQueueStatus(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			root["status"] = "OK";
+			root["title"] = "GetRxQueueStatus";
+
+			int ii = 0;
+			for (const auto& lane : m_mainworker.GetRxLaneStatus())
+			{
+				root["result"][ii]["Lane"] = ii;
+				root["result"][ii]["QueueDepth"] = static_cast<Json::UInt64>(lane.QueueDepth);
+				root["result"][ii]["Processed"] = static_cast<Json::UInt64>(lane.Processed);
+				root["result"][ii]["AvgWaitMs"] = lane.AvgWaitMs;
+				root["result"][ii]["MaxWaitMs"] = lane.MaxWaitMs;
+				root["result"][ii]["AvgProcessMs"] = lane.AvgProcessMs;
+				ii++;
 			}
 		}
 
@@ -3129,7 +3183,9 @@ namespace http
 			root["status"] = "OK";
 		}
 
-		void CWebServer::Cmd_GetDevices(WebEmSession& session, const request& req, Json::Value& root)
+		// The device list is written one device at a time as compact JSON, without a document of all devices,
+		// and handed to the connection in parts so it is compressed a part at a time
+		bool CWebServer::Cmd_StreamDevices(WebEmSession& session, const request& req, reply& rep)
 		{
 			std::string rfilter = request::findValue(&req, "filter");
 			std::string order = request::findValue(&req, "order");
@@ -3160,10 +3216,52 @@ namespace http
 				sstr >> LastUpdate;
 			}
 
+			Json::Value root;
 			root["status"] = "OK";
 			root["title"] = "Devices";
 			root["app_version"] = szAppVersion;
-			GetJSonDevices(root, rused, rfilter, order, rid, planid, floorid, bDisplayHidden, bDisabledDisabled, bFetchFavorites, LastUpdate, session.username, hwidx);
+
+			CJSonStreamWriter writer;
+			writer.BeginObject();
+			bool bHaveResult = false;
+			GetJSonDevices(
+				root,
+				[&writer, &root, &bHaveResult](Json::Value& item) {
+					if (!bHaveResult)
+					{
+						// the other members are complete before the first device
+						for (const auto& name : root.getMemberNames())
+							writer.Member(name.c_str(), root[name]);
+						writer.Key("result");
+						writer.BeginArray();
+						bHaveResult = true;
+					}
+					writer.Value(item);
+				},
+				rused, rfilter, order, rid, planid, floorid, bDisplayHidden, bDisabledDisabled, bFetchFavorites, LastUpdate, session.username, hwidx);
+			if (bHaveResult)
+				writer.EndArray();
+			else
+			{
+				for (const auto& name : root.getMemberNames())
+					writer.Member(name.c_str(), root[name]);
+			}
+			writer.EndObject();
+
+			struct _tTextParts
+			{
+				std::string text;
+				size_t offset = 0;
+			};
+			auto parts = std::make_shared<_tTextParts>();
+			parts->text = writer.Take();
+			reply::set_content_producer(&rep, [parts](std::string& out) {
+				size_t size = std::min(parts->text.size() - parts->offset, static_cast<size_t>(STREAM_TEXT_PART_SIZE));
+				out.append(parts->text, parts->offset, size);
+				parts->offset += size;
+				return (parts->offset < parts->text.size());
+			});
+			return true;
 		}
 
 		void CWebServer::Cmd_GetUsers(WebEmSession& session, const request& req, Json::Value& root)
@@ -4785,7 +4883,70 @@ namespace http
 			}
 		}
 
-		void CWebServer::Cmd_GetLightLog(WebEmSession& session, const request& req, Json::Value& root)
+		// Sends the members of root and a result of the rows MakeRow makes of the rows of szTable where szDeviceColumn is idx, newest first.
+		// The rows are read a page at a time in (Date, ROWID) descending order, so no more than a page is in memory
+		// and no database connection is held while the client receives it.
+		// MakeRow gets the szColumns values followed by Date and ROWID, and returns false to leave the row out.
+		// Finish adds the members that follow from all rows.
+		void CWebServer::StreamLogRows(reply& rep, const Json::Value& root, const std::string& szTable, const std::string& szDeviceColumn, const uint64_t idx,
+					       const std::string& szColumns, const std::function<bool(const std::vector<std::string>& sd, Json::Value& row)>& MakeRow,
+					       const std::function<void(Json::Value& tail)>& Finish)
+		{
+			struct _tLogStream
+			{
+				CJSonStreamWriter writer;
+				std::string LastDate = "9999-12-31 23:59:59"; // after every date, so the first page starts at the newest row
+				int64_t LastRowID = INT64_MAX;
+				bool bHaveResult = false;
+			};
+			auto state = std::make_shared<_tLogStream>();
+			state->writer.BeginObject();
+			for (const auto& name : root.getMemberNames())
+				state->writer.Member(name.c_str(), root[name]);
+
+			reply::set_content_producer(&rep, [state, idx, szTable, szDeviceColumn, szColumns, MakeRow, Finish](std::string& out) {
+				auto result = m_sql.safe_readonly_query("SELECT %s, Date, ROWID FROM %s WHERE (%s==%" PRIu64 " AND Date<='%q' AND (Date<'%q' OR ROWID<%" PRId64 ")) ORDER BY Date DESC, ROWID DESC LIMIT %d",
+									szColumns.c_str(), szTable.c_str(), szDeviceColumn.c_str(), idx, state->LastDate.c_str(), state->LastDate.c_str(), state->LastRowID, LOG_STREAM_PAGE_ROWS);
+				bool bMore = (result.size() == LOG_STREAM_PAGE_ROWS);
+				CJSonStreamWriter& writer = state->writer;
+				for (const auto& sd : result)
+				{
+					Json::Value row;
+					if (!MakeRow(sd, row))
+						continue;
+					if (!state->bHaveResult)
+					{
+						// like the other replies, there is no result member without rows
+						writer.Key("result");
+						writer.BeginArray();
+						state->bHaveResult = true;
+					}
+					writer.Value(row);
+				}
+				if (!result.empty())
+				{
+					state->LastDate = result.back()[result.back().size() - 2];
+					state->LastRowID = std::stoll(result.back().back());
+				}
+				if (!bMore)
+				{
+					if (state->bHaveResult)
+						writer.EndArray();
+					if (Finish)
+					{
+						Json::Value tail;
+						Finish(tail);
+						for (const auto& name : tail.getMemberNames())
+							writer.Member(name.c_str(), tail[name]);
+					}
+					writer.EndObject();
+				}
+				out += writer.Take();
+				return bMore;
+			});
+		}
+
+		bool CWebServer::Cmd_StreamLightLog(WebEmSession& session, const request& req, reply& rep)
 		{
 			uint64_t idx = 0;
 			if (!request::findValue(&req, "idx").empty())
@@ -4796,7 +4957,7 @@ namespace http
 			// First get Device Type/SubType
 			result = m_sql.safe_query("SELECT Type, SubType, SwitchType, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
 			if (result.empty())
-				return;
+				return false;
 
 			unsigned char dType = atoi(result[0][0].c_str());
 			unsigned char dSubType = atoi(result[0][1].c_str());
@@ -4810,28 +4971,35 @@ namespace http
 				(dType != pTypeThermostat2) && (dType != pTypeThermostat3) && (dType != pTypeThermostat4) && (dType != pTypeRemote) && (dType != pTypeGeneralSwitch) &&
 				(dType != pTypeHomeConfort) && (dType != pTypeFS20) && (!((dType == pTypeRadiator1) && (dSubType == sTypeSmartwaresSwitchRadiator))) && (dType != pTypeHunter) && (dType != pTypeDDxxxx) && (dType != pTypeHoneywell_AL)
 				)
-				return; // no light device! we should not be here!
+				return false; // no light device! we should not be here!
 
+			Json::Value root;
 			root["status"] = "OK";
 			root["title"] = "getlightlog";
 
-			result = m_sql.safe_query("SELECT ROWID, nValue, sValue, User, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
-			if (!result.empty())
+			std::map<std::string, std::string> selectorStatuses;
+			if (switchtype == device::tswitch::type::Selector)
 			{
-				std::map<std::string, std::string> selectorStatuses;
-				if (switchtype == device::tswitch::type::Selector)
-				{
-					GetSelectorSwitchStatuses(options, selectorStatuses);
-				}
+				GetSelectorSwitchStatuses(options, selectorStatuses);
+			}
 
-				int ii = 0;
-				for (const auto& sd : result)
-				{
-					std::string lidx = sd.at(0);
-					int nValue = atoi(sd.at(1).c_str());
-					std::string sValue = sd.at(2);
-					std::string sUser = sd.at(3);
-					std::string ldate = sd.at(4);
+			// The parameters that are logged once, from the first row
+			struct _tLightLogState
+			{
+				int nRows = 0;
+				bool bHaveDimmer = false;
+				bool bHaveGroupCmd = false;
+				bool bHaveSelector = false;
+			};
+			auto st = std::make_shared<_tLightLogState>();
+			StreamLogRows(
+				rep, root, "LightingLog", "DeviceRowID", idx, "nValue, sValue, User",
+				[this, dType, dSubType, switchtype, selectorStatuses, st](const std::vector<std::string>& sd, Json::Value& row) {
+					int nValue = atoi(sd.at(0).c_str());
+					std::string sValue = sd.at(1);
+					std::string sUser = sd.at(2);
+					std::string ldate = sd.at(3);
+					std::string lidx = sd.at(4);
 
 					// add light details
 					std::string lstatus;
@@ -4845,21 +5013,21 @@ namespace http
 					if (switchtype == device::tswitch::type::Media)
 					{
 						if (sValue == "0")
-							continue; // skip 0-values in log for MediaPlayers
+							return false; // skip 0-values in log for MediaPlayers
 						lstatus = sValue;
 						ldata = lstatus;
 					}
 					else if (switchtype == device::tswitch::type::Selector)
 					{
-						if (ii == 0)
+						if (st->nRows == 0)
 						{
 							bHaveSelector = true;
 							maxDimLevel = (int)selectorStatuses.size();
 						}
 						if (!selectorStatuses.empty())
 						{
-
-							std::string sLevel = selectorStatuses[sValue];
+							auto itt = selectorStatuses.find(sValue);
+							std::string sLevel = (itt != selectorStatuses.end()) ? itt->second : "";
 							ldata = sLevel;
 							lstatus = "Set Level: " + sLevel;
 							llevel = atoi(sValue.c_str());
@@ -4871,13 +5039,13 @@ namespace http
 						ldata = lstatus;
 					}
 
-					if (ii == 0)
+					if (st->nRows == 0)
 					{
 						// Log these parameters once
-						root["HaveDimmer"] = bHaveDimmer;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["HaveGroupCmd"] = bHaveGroupCmd;
-						root["HaveSelector"] = bHaveSelector;
+						st->bHaveDimmer = bHaveDimmer;
+						row["MaxDimLevel"] = maxDimLevel;
+						st->bHaveGroupCmd = bHaveGroupCmd;
+						st->bHaveSelector = bHaveSelector;
 					}
 
 					// Corrent names for certain switch types
@@ -4897,70 +5065,68 @@ namespace http
 						break;
 					}
 
-					root["result"][ii]["idx"] = lidx;
-					root["result"][ii]["Date"] = ldate;
-					root["result"][ii]["Data"] = ldata;
-					root["result"][ii]["Status"] = lstatus;
-					root["result"][ii]["Level"] = llevel;
-					root["result"][ii]["User"] = sUser;
-					ii++;
-				}
-			}
+					row["idx"] = lidx;
+					row["Date"] = ldate;
+					row["Data"] = ldata;
+					row["Status"] = lstatus;
+					row["Level"] = llevel;
+					row["User"] = sUser;
+					st->nRows++;
+					return true;
+				},
+				[st](Json::Value& tail) {
+					if (st->nRows == 0)
+						return;
+					tail["HaveDimmer"] = st->bHaveDimmer;
+					tail["HaveGroupCmd"] = st->bHaveGroupCmd;
+					tail["HaveSelector"] = st->bHaveSelector;
+				});
+			return true;
 		}
 
-		void CWebServer::Cmd_GetTextLog(WebEmSession& session, const request& req, Json::Value& root)
+		bool CWebServer::Cmd_StreamTextLog(WebEmSession& session, const request& req, reply& rep)
 		{
 			uint64_t idx = 0;
 			if (!request::findValue(&req, "idx").empty())
 			{
 				idx = std::stoull(request::findValue(&req, "idx"));
 			}
-			std::vector<std::vector<std::string>> result;
 
+			Json::Value root;
 			root["status"] = "OK";
 			root["title"] = "gettextlog";
 
-			result = m_sql.safe_query("SELECT ROWID, sValue, User, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
-			if (!result.empty())
-			{
-				int ii = 0;
-				for (const auto& sd : result)
-				{
-					root["result"][ii]["idx"] = sd[0];
-					root["result"][ii]["Data"] = sd[1];
-					root["result"][ii]["User"] = sd[2];
-					root["result"][ii]["Date"] = sd[3];
-					ii++;
-				}
-			}
+			StreamLogRows(rep, root, "LightingLog", "DeviceRowID", idx, "sValue, User", [](const std::vector<std::string>& sd, Json::Value& row) {
+				row["idx"] = sd[3];
+				row["Data"] = sd[0];
+				row["User"] = sd[1];
+				row["Date"] = sd[2];
+				return true;
+			});
+			return true;
 		}
 
-		void CWebServer::Cmd_GetSceneLog(WebEmSession& session, const request& req, Json::Value& root)
+		bool CWebServer::Cmd_StreamSceneLog(WebEmSession& session, const request& req, reply& rep)
 		{
 			uint64_t idx = 0;
 			if (!request::findValue(&req, "idx").empty())
 			{
 				idx = std::stoull(request::findValue(&req, "idx"));
 			}
-			std::vector<std::vector<std::string>> result;
 
+			Json::Value root;
 			root["status"] = "OK";
 			root["title"] = "getscenelog";
 
-			result = m_sql.safe_query("SELECT ROWID, nValue, User, Date FROM SceneLog WHERE (SceneRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
-			if (!result.empty())
-			{
-				int ii = 0;
-				for (const auto& sd : result)
-				{
-					root["result"][ii]["idx"] = sd[0];
-					int nValue = atoi(sd[1].c_str());
-					root["result"][ii]["Data"] = (nValue == 0) ? "Off" : "On";
-					root["result"][ii]["User"] = sd[2];
-					root["result"][ii]["Date"] = sd[3];
-					ii++;
-				}
-			}
+			StreamLogRows(rep, root, "SceneLog", "SceneRowID", idx, "nValue, User", [](const std::vector<std::string>& sd, Json::Value& row) {
+				row["idx"] = sd[3];
+				int nValue = atoi(sd[0].c_str());
+				row["Data"] = (nValue == 0) ? "Off" : "On";
+				row["User"] = sd[1];
+				row["Date"] = sd[2];
+				return true;
+			});
+			return true;
 		}
 
 		void CWebServer::Cmd_RemoteWebClientsLog(WebEmSession& session, const request& req, Json::Value& root)
@@ -4973,6 +5139,7 @@ namespace http
 
 			int ii = 0;
 			root["title"] = "rclientslog";
+			std::lock_guard<std::mutex> l(m_remote_web_clients_mutex);
 			for (const auto& itt_rc : m_remote_web_clients)
 			{
 				char timestring[128];
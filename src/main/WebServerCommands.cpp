@@ -3415,12 +3415,14 @@ namespace http
 				{
 					root["title"] = "LearnSW";
 					m_sql.AllowNewHardwareTimer(5);
-					m_sql.m_LastSwitchID = "";
+					m_sql.ClearLastSwitch();
+					std::string szSwitchID;
+					uint64_t SwitchRowID = 0;
 					bool bReceivedSwitch = false;
 					unsigned char cntr = 0;
 					while ((!bReceivedSwitch) && (cntr < 50)) // wait for max. 5 seconds
 					{
-						if (!m_sql.m_LastSwitchID.empty())
+						if (m_sql.GetLastSwitch(szSwitchID, SwitchRowID))
 						{
 							bReceivedSwitch = true;
 							break;
@@ -3432,12 +3434,12 @@ namespace http
 					if (bReceivedSwitch)
 					{
 						// check if used
-						result = m_sql.safe_query("SELECT Name, Used, nValue FROM DeviceStatus WHERE (ID==%" PRIu64 ")", m_sql.m_LastSwitchRowID);
+						result = m_sql.safe_query("SELECT Name, Used, nValue FROM DeviceStatus WHERE (ID==%" PRIu64 ")", SwitchRowID);
 						if (!result.empty())
 						{
 							root["status"] = "OK";
-							root["ID"] = m_sql.m_LastSwitchID;
-							root["idx"] = Json::Value::UInt64(m_sql.m_LastSwitchRowID);
+							root["ID"] = szSwitchID;
+							root["idx"] = Json::Value::UInt64(SwitchRowID);
 							root["Name"] = result[0][0];
 							root["Used"] = atoi(result[0][1].c_str());
 							root["Cmd"] = atoi(result[0][2].c_str());
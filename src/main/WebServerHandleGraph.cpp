@@ -27,42 +27,297 @@
 #include "Logger.h"
 #include "SQLHelper.h"
 
+// Result rows of a streamed graph. Like the regular graphs, there is no result member without rows.
+class CGraphRowWriter
+{
+public:
+	explicit CGraphRowWriter(CJSonStreamWriter &writer)
+		: m_writer(writer)
+	{
+	}
+	// Starts a row with its date, followed by its values with Member() and EndRow()
+	void BeginRow(const std::string &szDate)
+	{
+		if (!m_bHaveResult)
+		{
+			m_writer.Key("result");
+			m_writer.BeginArray();
+			m_bHaveResult = true;
+		}
+		m_writer.BeginObject();
+		m_writer.Member("d", szDate);
+	}
+	// Starts a row with the date of a short log row
+	void BeginRow(const std::vector<std::string> &sd)
+	{
+		BeginRow(sd[sd.size() - 2].substr(0, 16));
+	}
+	void EndRow()
+	{
+		m_writer.EndObject();
+	}
+	// Ends the result, Member() then adds to the reply itself
+	void EndRows()
+	{
+		if (m_bHaveResult && !m_bEnded)
+			m_writer.EndArray();
+		m_bEnded = true;
+	}
+	template <typename T> void Member(const char *szKey, const T &value)
+	{
+		m_writer.Member(szKey, value);
+	}
+	// The short log row that is being written is the last one of the graph
+	bool IsLastRow() const
+	{
+		return m_bLastRow;
+	}
+	void SetLastRow(const bool bLastRow)
+	{
+		m_bLastRow = bLastRow;
+	}
+
+private:
+	CJSonStreamWriter &m_writer;
+	bool m_bHaveResult = false;
+	bool m_bEnded = false;
+	bool m_bLastRow = false;
+};
+
 namespace http
 {
 	namespace server
 	{
-		void CWebServer::Cmd_HandleGraph(WebEmSession& session, const request& req, Json::Value& root)
+		// Rows fetched from the short log per call of the content producer
+#define GRAPH_STREAM_PAGE_ROWS 500
+
+		enum _eRollupAggregate
 		{
-			uint64_t idx = 0;
-			if (!request::findValue(&req, "idx").empty())
+			RA_MIN = 0,
+			RA_MAX,
+			RA_AVG
+		};
+
+		// MIN/MAX/AVG of short log columns since szDate ("add today") from the hourly rollups, shaped like the result
+		// of the aggregate query over the raw rows. There is no row when the device has no data since szDate, as before:
+		// that query returned a single row of NULLs, and the query helpers drop a row whose first column is NULL.
+		static std::vector<std::vector<std::string>> GetRollupAggregates(const CGraphRollups::_eTable table, const uint64_t idx, const std::string &szDate,
+										const std::vector<std::pair<_eRollupAggregate, size_t>> &columns)
+		{
+			std::vector<std::vector<std::string>> result;
+			CGraphRollups::_tBucket total;
+			if (!m_sql.m_graphrollups.GetTotal(table, idx, szDate, "9999", total))
+				return result;
+			std::vector<std::string> row;
+			char szTmp[40];
+			for (const auto &column : columns)
 			{
-				idx = std::stoull(request::findValue(&req, "idx"));
+				double value = total.Avg(column.second);
+				if (column.first == RA_MIN)
+					value = total.Min[column.second];
+				else if (column.first == RA_MAX)
+					value = total.Max[column.second];
+				sprintf(szTmp, "%.15g", value);
+				row.push_back(szTmp);
 			}
+			result.push_back(row);
+			return result;
+		}
 
-			std::vector<std::vector<std::string>> result;
-			char szTmp[300];
+		// Next page of StreamGraphRows rows (the columns, Date and ROWID as text) from the short log store, starting at tNext.
+		// A page only ends between two dates, so the next one can start at the date after the last row.
+		static bool ReadStoredGraphRows(const CTimeSeriesStore::_eTable table, const uint64_t idx, const std::vector<int> &columns, time_t &tNext,
+						std::vector<std::vector<std::string>> &result, bool &bMore)
+		{
+			time_t tLast = 0;
+			char szTmp[40];
+			bMore = false;
+			bool bRead = m_sql.m_shortlogstore.Read(table, idx, tNext, [&](const time_t tDate, const double *values) {
+				if ((result.size() >= GRAPH_STREAM_PAGE_ROWS) && (tDate != tLast))
+				{
+					bMore = true;
+					return false;
+				}
+				std::vector<std::string> sd;
+				for (const int col : columns)
+				{
+					sprintf(szTmp, "%.15g", values[col]);
+					sd.push_back(szTmp);
+				}
+				sd.push_back(TimeToString(&tDate, TF_DateTime));
+				sd.push_back("0");
+				result.push_back(sd);
+				tLast = tDate;
+				return true;
+			});
+			if (!bRead)
+				return false;
+			if (!result.empty())
+				tNext = tLast + 1;
+			return true;
+		}
 
+		// The day graphs come from the 5 minute short log and can hold many rows, those of these sensors
+		// are written while they are sent instead of being built as a whole by Cmd_HandleGraph
+		bool CWebServer::Cmd_StreamGraph(WebEmSession& session, const request& req, reply& rep)
+		{
 			std::string sensor = request::findValue(&req, "sensor");
-			if (sensor.empty())
-				return;
-			std::string sensorarea = request::findValue(&req, "sensorarea");
 			std::string srange = request::findValue(&req, "range");
-			std::string sgroupby = request::findValue(&req, "groupby");
-			if (srange.empty() && sgroupby.empty())
-				return;
+			std::string sidx = request::findValue(&req, "idx");
+			if ((srange != "day") || sidx.empty())
+				return false;
+			if ((sensor != "temp") && (sensor != "Percentage") && (sensor != "fan") && (sensor != "counter") && (sensor != "uv") && (sensor != "wind"))
+				return false;
+			uint64_t idx = std::stoull(sidx);
+			if (sensor == "counter")
+				return StreamCounterDayGraph(session, req, rep, idx);
+
+			auto result = m_sql.safe_readonly_query("SELECT Type, SubType, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
+			if (result.empty())
+				return false;
+			unsigned char dType = atoi(result[0][0].c_str());
+			unsigned char dSubType = atoi(result[0][1].c_str());
+			Json::Value root;
+			root["status"] = "OK";
+			root["title"] = "Graph " + sensor + " " + srange;
 
-			time_t now = mytime(nullptr);
-			struct tm tm1;
-			localtime_r(&now, &tm1);
+			if (sensor == "Percentage")
+			{
+				StreamGraphRows(rep, idx, root, "Percentage", "Percentage", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("v", sd[0]);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (sensor == "fan")
+			{
+				StreamGraphRows(rep, idx, root, "Fan", "Speed", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("v", sd[0]);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (sensor == "uv")
+			{
+				StreamGraphRows(rep, idx, root, "UV", "Level", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("uvi", sd[0]);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (sensor == "wind")
+			{
+				_eWindUnit windunit = m_sql.m_windunit;
+				float windscale = m_sql.m_windscale;
+				StreamGraphRows(rep, idx, root, "Wind", "Direction, Speed, Gust", [windunit, windscale](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					char szTmp[30];
+					rows.BeginRow(sd);
+					rows.Member("di", sd[0]);
+
+					int intSpeed = atoi(sd[1].c_str());
+					int intGust = atoi(sd[2].c_str());
+
+					if (windunit != WINDUNIT_Beaufort)
+					{
+						sprintf(szTmp, "%.1f", float(intSpeed) * windscale);
+						rows.Member("sp", szTmp);
+						sprintf(szTmp, "%.1f", float(intGust) * windscale);
+						rows.Member("gu", szTmp);
+					}
+					else
+					{
+						float windspeedms = float(intSpeed) * 0.1F;
+						float windgustms = float(intGust) * 0.1F;
+						sprintf(szTmp, "%d", MStoBeaufort(windspeedms));
+						rows.Member("sp", szTmp);
+						sprintf(szTmp, "%d", MStoBeaufort(windgustms));
+						rows.Member("gu", szTmp);
+					}
+					rows.EndRow();
+				});
+				return true;
+			}
+
+			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(result[0][2]);
+			std::string value_unit = options["ValueUnit"];
+			unsigned char tempsign = m_sql.m_tempsign[0];
+			StreamGraphRows(rep, idx, root, "Temperature", "Temperature, Chill, Humidity, Barometer, SetPoint",
+				[dType, dSubType, value_unit, tempsign](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					char szTmp[30];
+					rows.BeginRow(sd);
+					if (dType == pTypeRego6XXTemp
+						|| dType == pTypeTEMP
+						|| dType == pTypeTEMP_HUM
+						|| dType == pTypeTEMP_HUM_BARO
+						|| dType == pTypeTEMP_BARO
+						|| dType == pTypeWIND && dSubType == sTypeWIND4
+						|| dType == pTypeUV && dSubType == sTypeUV3
+						|| dType == pTypeThermostat1
+						|| dType == pTypeRadiator1
+						|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorTemp
+						|| dType == pTypeGeneral && dSubType == sTypeSystemTemp
+						|| dType == pTypeGeneral && dSubType == sTypeBaro
+						|| dType == pTypeEvohomeZone
+						|| dType == pTypeEvohomeWater
+						)
+					{
+						rows.Member("te", ConvertTemperature(atof(sd[0].c_str()), tempsign));
+					}
+					if (((dType == pTypeWIND) && (dSubType == sTypeWIND4)) || ((dType == pTypeWIND) && (dSubType == sTypeWINDNoTemp)))
+					{
+						rows.Member("ch", ConvertTemperature(atof(sd[1].c_str()), tempsign));
+					}
+					if ((dType == pTypeHUM) || (dType == pTypeTEMP_HUM) || (dType == pTypeTEMP_HUM_BARO))
+					{
+						rows.Member("hu", sd[2]);
+					}
+					if ((dType == pTypeTEMP_HUM_BARO) || (dType == pTypeTEMP_BARO) || ((dType == pTypeGeneral) && (dSubType == sTypeBaro)))
+					{
+						if ((dType == pTypeTEMP_HUM_BARO) && (dSubType != sTypeTHBFloat))
+							rows.Member("ba", sd[3]);
+						else
+						{
+							sprintf(szTmp, "%.1f", atof(sd[3].c_str()) / 10.0F);
+							rows.Member("ba", szTmp);
+						}
+					}
+					if ((dType == pTypeEvohomeZone) || (dType == pTypeEvohomeWater))
+					{
+						rows.Member("se", ConvertTemperature(atof(sd[4].c_str()), tempsign));
+					}
+					if (dType == pTypeSetpoint && dSubType == sTypeSetpoint)
+					{
+						if (
+							(value_unit.empty())
+							|| (value_unit == "°C")
+							|| (value_unit == "°F")
+							|| (value_unit == "C")
+							|| (value_unit == "F")
+							)
+						{
+							rows.Member("te", ConvertTemperature(atof(sd[0].c_str()), tempsign));
+						}
+						else
+							rows.Member("te", atof(sd[0].c_str()));
+					}
+					rows.EndRow();
+				});
+			return true;
+		}
 
-			result = m_sql.safe_query("SELECT Type, SubType, SwitchType, AddjValue, AddjMulti, AddjValue2, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
+		// Day graph of a counter or meter, written while it is sent like the other day graphs of Cmd_StreamGraph
+		bool CWebServer::StreamCounterDayGraph(WebEmSession& session, const request& req, reply& rep, const uint64_t idx)
+		{
+			auto result = m_sql.safe_readonly_query("SELECT Type, SubType, SwitchType, AddjValue2, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
 			if (result.empty())
-				return;
+				return false;
 
 			unsigned char dType = atoi(result[0][0].c_str());
 			unsigned char dSubType = atoi(result[0][1].c_str());
 			device::tmeter::type::value metertype = (device::tmeter::type::value)atoi(result[0][2].c_str());
-			_log.Debug(DEBUG_WEBSERVER, "CWebServer::Cmd_HandleGraph() : dType:%02X  dSubType:%02X  metertype:%d", dType, dSubType, int(metertype));
 			if ((dType == pTypeP1Power) || (dType == pTypeENERGY) || (dType == pTypePOWER) || (dType == pTypeCURRENTENERGY) || ((dType == pTypeGeneral) && (dSubType == sTypeKwh)))
 			{
 				metertype = device::tmeter::type::ENERGY;
@@ -75,1261 +330,1092 @@ namespace http
 			// Special case of managed counter: Usage instead of Value in Meter table, and we don't want to calculate last value
 			bool bIsManagedCounter = (dType == pTypeGeneral) && (dSubType == sTypeManagedCounter);
 
-			double AddjValue = atof(result[0][3].c_str());
-			double AddjMulti = atof(result[0][4].c_str());
-			double AddjValue2 = atof(result[0][5].c_str());
-			std::string sOptions = result[0][6];
-			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sOptions);
-
+			double AddjValue2 = atof(result[0][3].c_str());
+			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(result[0][4]);
 			double divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-			double meteroffset = AddjValue;
+			Json::Value root;
+			Cmd_GetCosts(session, req, root);
+			root["status"] = "OK";
+			root["title"] = "Graph counter day";
 
-			std::string dbasetable;
-			if ((srange == "day") || (srange == "hour"))
+			if (dType == pTypeP1Power)
 			{
-				if (sensor == "temp")
-					dbasetable = "Temperature";
-				else if (sensor == "rain")
-					dbasetable = "Rain";
-				else if (sensor == "Percentage")
-					dbasetable = "Percentage";
-				else if (sensor == "fan")
-					dbasetable = "Fan";
-				else if (sensor == "counter")
+				int P1DisplayType = 0; //0=Low/High tariff, 1=simple (for dynamic contracts)
+				m_sql.GetPreferencesVar("P1DisplayType", P1DisplayType);
+				root["P1DisplayType"] = P1DisplayType;
+
+				struct _tP1State
 				{
-					Cmd_GetCosts(session, req, root);
+					bool bHaveDeliverd = false;
+					bool bHaveFirstValue = false;
+					int64_t lastUsage1 = 0, lastUsage2 = 0, lastDeliv1 = 0, lastDeliv2 = 0;
+					time_t lastTime = 0;
+					int64_t firstUsage1 = 0;
+					int64_t firstUsage2 = 0;
+					int64_t firstDeliv1 = 0;
+					int64_t firstDeliv2 = 0;
+					int lastDay = 0;
+				};
+				auto st = std::make_shared<_tP1State>();
+				StreamGraphRows(
+					rep, idx, root, "MultiMeter", "Value1, Value2, Value3, Value4, Value5, Value6",
+					[idx, P1DisplayType, st](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+						char szTmp[100];
+						int64_t actUsage1 = std::stoll(sd[0]);
+						int64_t actUsage2 = std::stoll(sd[4]);
+						int64_t actDeliv1 = std::stoll(sd[1]);
+						int64_t actDeliv2 = std::stoll(sd[5]);
+						actDeliv1 = (actDeliv1 < 10) ? 0 : actDeliv1;
+						actDeliv2 = (actDeliv2 < 10) ? 0 : actDeliv2;
+
+						std::string stime = sd[6];
+						struct tm ntime;
+						time_t atime;
+						ParseSQLdatetime(atime, ntime, stime, -1);
+						if (st->lastDay != ntime.tm_mday)
+						{
+							st->lastDay = ntime.tm_mday;
+							st->firstUsage1 = actUsage1;
+							st->firstUsage2 = actUsage2;
+							st->firstDeliv1 = actDeliv1;
+							st->firstDeliv2 = actDeliv2;
+						}
 
-					if ((dType == pTypeP1Power) || (dType == pTypeCURRENT) || (dType == pTypeCURRENTENERGY))
+						if (st->bHaveFirstValue)
+						{
+							long curUsage1 = (long)(actUsage1 - st->lastUsage1);
+							long curUsage2 = (long)(actUsage2 - st->lastUsage2);
+							long curDeliv1 = (long)(actDeliv1 - st->lastDeliv1);
+							long curDeliv2 = (long)(actDeliv2 - st->lastDeliv2);
+
+							if ((curUsage1 < 0) || (curUsage1 > 100000))
+								curUsage1 = 0;
+							if ((curUsage2 < 0) || (curUsage2 > 100000))
+								curUsage2 = 0;
+							if ((curDeliv1 < 0) || (curDeliv1 > 100000))
+								curDeliv1 = 0;
+							if ((curDeliv2 < 0) || (curDeliv2 > 100000))
+								curDeliv2 = 0;
+
+							float tdiff = static_cast<float>(difftime(atime, st->lastTime));
+							if (tdiff <= 10)
+							{
+								// datapoints in the shortlog should not be this close together - DST clock backwards move?
+								return;
+							}
+
+							float tlaps = 3600.0F / tdiff;
+							curUsage1 *= int(tlaps);
+							curUsage2 *= int(tlaps);
+							curDeliv1 *= int(tlaps);
+							curDeliv2 *= int(tlaps);
+
+							rows.BeginRow(sd);
+
+							if ((curDeliv1 != 0) || (curDeliv2 != 0))
+								st->bHaveDeliverd = true;
+
+							if (P1DisplayType == 0)
+							{
+								//Low/High Tarrif
+								sprintf(szTmp, "%ld", curUsage1);
+								rows.Member("v1", szTmp);
+								sprintf(szTmp, "%ld", curUsage2);
+								rows.Member("v2", szTmp);
+								sprintf(szTmp, "%ld", curDeliv1);
+								rows.Member("r1", szTmp);
+								sprintf(szTmp, "%ld", curDeliv2);
+								rows.Member("r2", szTmp);
+							}
+							else
+							{
+								//Simple
+								sprintf(szTmp, "%ld", curUsage1 + curUsage2);
+								rows.Member("v", szTmp);
+								sprintf(szTmp, "%ld", curDeliv1 + curDeliv2);
+								rows.Member("r", szTmp);
+							}
+							long pUsage1 = (long)(actUsage1 - st->firstUsage1);
+							long pUsage2 = (long)(actUsage2 - st->firstUsage2);
+
+							sprintf(szTmp, "%ld", pUsage1 + pUsage2);
+							rows.Member("eu", szTmp);
+							if (st->bHaveDeliverd)
+							{
+								long pDeliv1 = (long)(actDeliv1 - st->firstDeliv1);
+								long pDeliv2 = (long)(actDeliv2 - st->firstDeliv2);
+								sprintf(szTmp, "%ld", pDeliv1 + pDeliv2);
+								rows.Member("eg", szTmp);
+							}
+							rows.EndRow();
+						}
+						else
+						{
+							st->bHaveFirstValue = true;
+							if ((ntime.tm_hour != 0) && (ntime.tm_min != 0))
+							{
+								struct tm ltime;
+								getNoon(atime, ltime, ntime.tm_year + 1900, ntime.tm_mon + 1,
+									ntime.tm_mday - 1); // We're only interested in finding the date
+								int year = ltime.tm_year + 1900;
+								int mon = ltime.tm_mon + 1;
+								int day = ltime.tm_mday;
+								sprintf(szTmp, "%04d-%02d-%02d", year, mon, day);
+								std::vector<std::vector<std::string>> result2;
+								result2 = m_sql.safe_readonly_query(
+									"SELECT Counter1, Counter2, Counter3, Counter4 FROM Multimeter_Calendar WHERE (DeviceRowID==%" PRIu64
+									") AND (Date=='%q')",
+									idx, szTmp);
+								if (!result2.empty())
+								{
+									std::vector<std::string> sd2 = result2[0];
+									st->firstUsage1 = std::stoll(sd2[0]);
+									st->firstDeliv1 = std::stoll(sd2[1]);
+									st->firstUsage2 = std::stoll(sd2[2]);
+									st->firstDeliv2 = std::stoll(sd2[3]);
+									st->lastDay = ntime.tm_mday;
+								}
+							}
+						}
+						st->lastUsage1 = actUsage1;
+						st->lastUsage2 = actUsage2;
+						st->lastDeliv1 = actDeliv1;
+						st->lastDeliv2 = actDeliv2;
+						st->lastTime = atime;
+					},
+					[st](CGraphRowWriter& rows) {
+						rows.EndRows();
+						if (st->bHaveDeliverd)
+							rows.Member("delivered", true);
+					});
+				return true;
+			}
+			if (dType == pTypeAirQuality)
+			{
+				StreamGraphRows(rep, idx, root, "Meter", "Value", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("co2", sd[0]);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (((dType == pTypeGeneral) && ((dSubType == sTypeSoilMoisture) || (dSubType == sTypeLeafWetness)))
+			    || ((dType == pTypeRFXSensor) && ((dSubType == sTypeRFXSensorAD) || (dSubType == sTypeRFXSensorVolt))))
+			{
+				StreamGraphRows(rep, idx, root, "Meter", "Value", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("v", sd[0]);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (((dType == pTypeGeneral) && (dSubType == sTypeVisibility)) || ((dType == pTypeGeneral) && (dSubType == sTypeDistance)) ||
+			    ((dType == pTypeGeneral) && (dSubType == sTypeSolarRadiation)) || ((dType == pTypeGeneral) && (dSubType == sTypeVoltage)) ||
+			    ((dType == pTypeGeneral) && (dSubType == sTypeCurrent)) || ((dType == pTypeGeneral) && (dSubType == sTypePressure)) ||
+			    ((dType == pTypeGeneral) && (dSubType == sTypeSoundLevel)))
+			{
+				float vdiv = 10.0F;
+				if (((dType == pTypeGeneral) && (dSubType == sTypeVoltage)) || ((dType == pTypeGeneral) && (dSubType == sTypeCurrent)))
+				{
+					vdiv = 1000.0F;
+				}
+				StreamGraphRows(rep, idx, root, "Meter", "Value", [dSubType, metertype, vdiv](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					char szTmp[100];
+					rows.BeginRow(sd);
+					float fValue = float(atof(sd[0].c_str())) / vdiv;
+					if (metertype == 1)
 					{
-						dbasetable = "MultiMeter";
+						if (dSubType == sTypeDistance)
+							fValue *= 0.3937007874015748F; // inches
+						else
+							fValue *= 0.6214F; // miles
 					}
+					if ((dSubType == sTypeVoltage) || (dSubType == sTypeCurrent))
+						sprintf(szTmp, "%.3f", fValue);
 					else
-					{
-						dbasetable = "Meter";
-					}
-				}
-				else if ((sensor == "wind") || (sensor == "winddir"))
-					dbasetable = "Wind";
-				else if (sensor == "uv")
-					dbasetable = "UV";
-				else
-					return;
+						sprintf(szTmp, "%.1f", fValue);
+					rows.Member("v", szTmp);
+					rows.EndRow();
+				});
+				return true;
 			}
-			else
+			if (dType == pTypeLux)
 			{
-				// week,year,month
-				if (sensor == "temp")
-					dbasetable = "Temperature_Calendar";
-				else if (sensor == "rain")
-					dbasetable = "Rain_Calendar";
-				else if (sensor == "Percentage")
-					dbasetable = "Percentage_Calendar";
-				else if (sensor == "fan")
-					dbasetable = "Fan_Calendar";
-				else if (sensor == "counter")
-				{
-					Cmd_GetCosts(session, req, root);
+				StreamGraphRows(rep, idx, root, "Meter", "Value", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("lux", sd[0]);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (dType == pTypeWEIGHT)
+			{
+				float weightscale = m_sql.m_weightscale;
+				StreamGraphRows(rep, idx, root, "Meter", "Value", [weightscale](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					char szTmp[100];
+					rows.BeginRow(sd);
+					sprintf(szTmp, "%.1f", weightscale * atof(sd[0].c_str()) / 10.0F);
+					rows.Member("v", szTmp);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if (dType == pTypeUsage)
+			{
+				StreamGraphRows(rep, idx, root, "Meter", "Value", [](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					rows.BeginRow(sd);
+					rows.Member("u", atof(sd[0].c_str()) / 10.0F);
+					rows.EndRow();
+				});
+				return true;
+			}
+			if ((dType == pTypeCURRENT) || (dType == pTypeCURRENTENERGY))
+			{
+				// CM113
+				int displaytype = 0;
+				int voltage = 230;
+				m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
+				m_sql.GetPreferencesVar("ElectricVoltage", voltage);
 
-					if (dType == pTypeP1Power
-						|| dType == pTypeCURRENT
-						|| dType == pTypeCURRENTENERGY
-						|| dType == pTypeAirQuality
-						|| dType == pTypeLux
-						|| dType == pTypeWEIGHT
-						|| dType == pTypeUsage
-						|| dType == pTypeGeneral && dSubType == sTypeVisibility
-						|| dType == pTypeGeneral && dSubType == sTypeDistance
-						|| dType == pTypeGeneral && dSubType == sTypeSolarRadiation
-						|| dType == pTypeGeneral && dSubType == sTypeSoilMoisture
-						|| dType == pTypeGeneral && dSubType == sTypeLeafWetness
-						|| dType == pTypeGeneral && dSubType == sTypeVoltage
-						|| dType == pTypeGeneral && dSubType == sTypeCurrent
-						|| dType == pTypeGeneral && dSubType == sTypePressure
-						|| dType == pTypeGeneral && dSubType == sTypeSoundLevel
-						|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorAD
-						|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorVolt
-						) {
-						dbasetable = "MultiMeter_Calendar";
-					}
-					else {
-						dbasetable = "Meter_Calendar";
-					}
-				}
-				else if ((sensor == "wind") || (sensor == "winddir"))
-					dbasetable = "Wind_Calendar";
-				else if (sensor == "uv")
-					dbasetable = "UV_Calendar";
-				else
-					return;
+				root["displaytype"] = displaytype;
+
+				struct _tCurrentState
+				{
+					bool bHaveRows = false;
+					bool bHaveL1 = false;
+					bool bHaveL2 = false;
+					bool bHaveL3 = false;
+				};
+				auto st = std::make_shared<_tCurrentState>();
+				StreamGraphRows(
+					rep, idx, root, "MultiMeter", "Value1, Value2, Value3",
+					[displaytype, voltage, st](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+						char szTmp[100];
+						st->bHaveRows = true;
+						rows.BeginRow(sd);
+
+						float fval1 = static_cast<float>(atof(sd[0].c_str()) / 10.0F);
+						float fval2 = static_cast<float>(atof(sd[1].c_str()) / 10.0F);
+						float fval3 = static_cast<float>(atof(sd[2].c_str()) / 10.0F);
+
+						if (fval1 != 0)
+							st->bHaveL1 = true;
+						if (fval2 != 0)
+							st->bHaveL2 = true;
+						if (fval3 != 0)
+							st->bHaveL3 = true;
+
+						if (displaytype == 0)
+						{
+							sprintf(szTmp, "%.1f", fval1);
+							rows.Member("v1", szTmp);
+							sprintf(szTmp, "%.1f", fval2);
+							rows.Member("v2", szTmp);
+							sprintf(szTmp, "%.1f", fval3);
+							rows.Member("v3", szTmp);
+						}
+						else
+						{
+							sprintf(szTmp, "%d", int(fval1 * voltage));
+							rows.Member("v1", szTmp);
+							sprintf(szTmp, "%d", int(fval2 * voltage));
+							rows.Member("v2", szTmp);
+							sprintf(szTmp, "%d", int(fval3 * voltage));
+							rows.Member("v3", szTmp);
+						}
+						rows.EndRow();
+					},
+					[st](CGraphRowWriter& rows) {
+						rows.EndRows();
+						if (!st->bHaveRows)
+							return;
+						if ((!st->bHaveL1) && (!st->bHaveL2) && (!st->bHaveL3))
+						{
+							rows.Member("haveL1", true); // show at least something
+						}
+						else
+						{
+							if (st->bHaveL1)
+								rows.Member("haveL1", true);
+							if (st->bHaveL2)
+								rows.Member("haveL2", true);
+							if (st->bHaveL3)
+								rows.Member("haveL3", true);
+						}
+					});
+				return true;
 			}
-			unsigned char tempsign = m_sql.m_tempsign[0];
 
-			int iPrev;
+			root["ValueQuantity"] = options["ValueQuantity"];
+			root["ValueUnits"] = options["ValueUnits"];
+			root["Divider"] = divider;
 
-			if (srange == "hour")
+			int method = 0;
+			std::string sMethod = request::findValue(&req, "method");
+			if (!sMethod.empty())
+				method = atoi(sMethod.c_str());
+
+			if ((dType == pTypeENERGY) || (dType == pTypePOWER) || (dType == pTypeYouLess) || ((dType == pTypeGeneral) && (dSubType == sTypeKwh)))
 			{
-				if (sensor == "counter")
+				// First check if we had any usage in the short log, if not, its probably a meter without usage
+				bool bHaveUsage = true;
+				result = m_sql.safe_readonly_query("SELECT MIN([Usage]), MAX([Usage]) FROM Meter WHERE (DeviceRowID==%" PRIu64 ")", idx);
+				if (!result.empty())
 				{
-					if (dType == pTypeP1Power)
+					int64_t minValue = std::stoll(result[0][0]);
+					int64_t maxValue = std::stoll(result[0][1]);
+
+					if ((minValue == 0) && (maxValue == 0))
 					{
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
-/*
-						char szDateStart[40];
-						char szDateEnd[40];
-						sprintf(szDateEnd, "%04d-%02d-%02d %02d:%02d:%02d", tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday, tm1.tm_hour, tm1.tm_min, tm1.tm_sec);
+						bHaveUsage = false;
+					}
+				}
 
-						// Subtract a day
-						time_t daybefore;
-						struct tm tm2;
-						getNoon(daybefore, tm2, tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday - 1); // We only want one day
-						sprintf(szDateStart, "%04d-%02d-%02d %02d:%02d:%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday, tm1.tm_hour, tm1.tm_min, tm1.tm_sec);
+				if (bHaveUsage == false)
+					method = 0;
 
-						result = m_sql.safe_query("SELECT strftime('%%Y-%%m-%%d %%H:00:00', Date) as ymd, MIN(Value1) as u1, MIN(Value5) as u2, MIN(Value2) as d1, MIN(Value6) as d2 FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') GROUP BY ymd",
-							dbasetable.c_str(), idx, szDateStart, szDateEnd);
-*/
+				if ((dType == pTypeYouLess) && ((metertype == device::tmeter::type::ENERGY) || (metertype == device::tmeter::type::ENERGY_GENERATED)))
+					method = 1;
 
-						result = m_sql.safe_query("SELECT strftime('%%Y-%%m-%%d %%H:00:00', Date) as ymd, MIN(Value1) as u1, MIN(Value5) as u2, MIN(Value2) as d1, MIN(Value6) as d2, Price FROM %s WHERE (DeviceRowID==%" PRIu64 ") GROUP BY ymd",
-							dbasetable.c_str(), idx);
-						if (!result.empty())
+				double dividerForQuantity = divider; // kWh, m3, l
+				double dividerForRate = divider; // Watt, m3/hour, l/hour
+				if (method != 0)
+				{
+					// realtime graph
+					if ((dType == pTypeENERGY) || (dType == pTypePOWER))
+					{
+						dividerForRate /= 100.0F;
+					}
+				}
+
+				root["method"] = method;
+
+				struct _tEnergyState
+				{
+					bool bHaveFirstValue = false;
+					bool bHaveFirstRealValue = false;
+					int64_t ulFirstRealValue = 0;
+					int64_t ulFirstValue = 0;
+					int64_t ulLastValue = 0;
+					std::string LastDateTime;
+				};
+				auto st = std::make_shared<_tEnergyState>();
+				StreamGraphRows(rep, idx, root, "Meter", "Value, Usage",
+					[dType, dSubType, metertype, method, dividerForQuantity, dividerForRate, st](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+						char szTmp[100];
+						// If method == 1, provide BOTH hourly and instant usage for combined graph
 						{
-							int ii = 0;
-							bool bHaveDeliverd = false;
-							bool bHaveFirstValue = false;
-							int64_t lastUsage, lastDeliv;
-							time_t lastTime = 0;
+							// bars / hour
+							std::string actDateTimeHour = sd[2].substr(0, 13);
+							int64_t actValue = std::stoll(sd[0]); // actual energy value
 
-							int lastDay = 0;
+							st->ulLastValue = actValue;
 
-							for (const auto& sd : result)
+							if (st->ulLastValue < st->ulFirstValue)
 							{
-								int64_t actUsage1 = std::stoll(sd[1]);
-								int64_t actUsage2 = std::stoll(sd[2]);
-								int64_t actDeliv1 = std::stoll(sd[3]);
-								int64_t actDeliv2 = std::stoll(sd[4]);
-								actDeliv1 = (actDeliv1 < 10) ? 0 : actDeliv1;
-								actDeliv2 = (actDeliv2 < 10) ? 0 : actDeliv2;
-
-								int64_t actUsage = actUsage1 + actUsage2;
-								int64_t actDeliv = actDeliv1 + actDeliv2;
-
-								std::string stime = sd[0];
-								struct tm ntime;
-								time_t atime;
-								ParseSQLdatetime(atime, ntime, stime, -1);
-								if (lastDay != ntime.tm_mday)
+								if (st->ulFirstValue - st->ulLastValue > 20000)
 								{
-									lastDay = ntime.tm_mday;
+									//probably a meter/counter turnover
+									st->ulFirstValue = st->ulFirstRealValue = st->ulLastValue;
+									st->LastDateTime = actDateTimeHour;
 								}
+							}
 
-								if (bHaveFirstValue)
+							if (actDateTimeHour != st->LastDateTime || ((method == 1) && rows.IsLastRow()))
+							{
+								if (st->bHaveFirstValue)
 								{
-									if (
-										(actUsage < lastUsage)
-										|| (actDeliv < lastDeliv)
-										|| (atime <= lastTime)
-										)
+									// rows.BeginRow(st->LastDateTime + (method == 1 ? ":30" : ":00"));
+									//^^ not necessarily bad, but is currently inconsistent with all other day graphs
+									rows.BeginRow(st->LastDateTime + ":00");
+
+									int64_t ulTotalValue = st->ulLastValue - st->ulFirstValue;
+									if (ulTotalValue == 0)
 									{
-										//daylight change happened, meter changed?, ignoring  for now
-										lastUsage = actUsage;
-										lastDeliv = actDeliv;
-										lastTime = atime;
-										continue;
+										// Could be the P1 Gas Meter, only transmits one every 1 a 2 hours
+										ulTotalValue = st->ulLastValue - st->ulFirstRealValue;
 									}
+									st->ulFirstRealValue = st->ulLastValue;
+									double TotalValue = double(ulTotalValue);
+									double dividerHere = method == 1 ? dividerForQuantity : dividerForRate;
+									switch (metertype)
+									{
+									case device::tmeter::type::ENERGY:
+									case device::tmeter::type::ENERGY_GENERATED:
+										sprintf(szTmp, "%.3f", (TotalValue / dividerHere) * 1000.0); // from kWh -> Watt
+										break;
+									case device::tmeter::type::GAS:
+										sprintf(szTmp, "%.3f", TotalValue / dividerHere);
+										break;
+									case device::tmeter::type::WATER:
+										sprintf(szTmp, "%.3f", TotalValue / dividerHere);
+										break;
+									case device::tmeter::type::COUNTER:
+										sprintf(szTmp, "%.10g", TotalValue / dividerHere);
+										break;
+									default:
+										strcpy(szTmp, "0");
+										break;
+									}
+									rows.Member(method == 1 ? "eu" : "v", szTmp);
+									rows.EndRow();
+								}
+								st->LastDateTime = actDateTimeHour;
+								st->bHaveFirstValue = false;
+							}
+							if (!st->bHaveFirstValue)
+							{
+								st->ulFirstValue = st->ulLastValue;
+								st->bHaveFirstValue = true;
+							}
+							if (!st->bHaveFirstRealValue)
+							{
+								st->bHaveFirstRealValue = true;
+								st->ulFirstRealValue = st->ulLastValue;
+							}
+						}
 
-									long curUsage = (long)(actUsage - lastUsage);
-									long curDeliv = (long)(actDeliv - lastDeliv);
-
-									std::string stime = sd[0].substr(0, 16);
-									root["result"][ii]["d"] = stime;
-
-									if (curDeliv != 0)
-										bHaveDeliverd = true;
+						if (method == 1)
+						{
+							int64_t actValue = std::stoll(sd[1]);
 
-									sprintf(szTmp, "%ld", curUsage);
-									root["result"][ii]["v"] = szTmp;
-									sprintf(szTmp, "%ld", curDeliv);
-									root["result"][ii]["r"] = szTmp;
+							rows.BeginRow(sd);
 
-									float total = (curUsage - curDeliv) / 1000.0F;
-									float fPrice = std::stof(sd[5]) * total;
-									sprintf(szTmp, "%.4f", fPrice);
-									root["result"][ii]["p"] = szTmp;
-									ii++;
-								}
-								else
-								{
-									bHaveFirstValue = true;
-								}
-								lastUsage = actUsage;
-								lastDeliv = actDeliv;
-								lastTime = atime;
-							}
-							if (bHaveDeliverd)
+							double TotalValue = double(actValue);
+							if ((dType == pTypeGeneral) && (dSubType == sTypeKwh))
+								TotalValue /= 10.0F;
+							switch (metertype)
 							{
-								root["delivered"] = true;
+							case device::tmeter::type::ENERGY:
+							case device::tmeter::type::ENERGY_GENERATED:
+								sprintf(szTmp, "%.3f", (TotalValue / dividerForRate) * 1000.0); // from kWh -> Watt
+								break;
+							case device::tmeter::type::GAS:
+								sprintf(szTmp, "%.2f", TotalValue / dividerForRate);
+								break;
+							case device::tmeter::type::WATER:
+								sprintf(szTmp, "%.3f", TotalValue / dividerForRate);
+								break;
+							case device::tmeter::type::COUNTER:
+								sprintf(szTmp, "%.10g", TotalValue / dividerForRate);
+								break;
+							default:
+								strcpy(szTmp, "0");
+								break;
 							}
+							rows.Member("v", szTmp);
+							rows.EndRow();
 						}
-					}
-				}
+					});
+				return true;
 			}
-			else if (srange == "day")
-			{
-				if (sensor == "temp")
-				{
-					root["status"] = "OK";
-					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Temperature, Chill, Humidity, Barometer, Date, SetPoint FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC",
-						dbasetable.c_str(), idx);
-					if (!result.empty())
+			struct _tCounterState
+			{
+				bool bHaveFirstValue = false;
+				bool bHaveFirstRealValue = false;
+				int64_t ulFirstValue = 0;
+				int64_t ulRealFirstValue = 0;
+				int lastDay = 0;
+				std::string szLastDateTimeHour;
+				int64_t ulLastValue = 0;
+				int lastHour = 0;
+				time_t lastTime = 0;
+				double lastUsageValue = 0;
+			};
+			auto st = std::make_shared<_tCounterState>();
+			if (bIsManagedCounter)
+			{
+				st->bHaveFirstValue = true;
+				st->bHaveFirstRealValue = true;
+				method = 1;
+			}
+			StreamGraphRows(
+				rep, idx, root, "Meter", bIsManagedCounter ? "Usage" : "Value",
+				[idx, metertype, divider, bIsManagedCounter, method, st](CGraphRowWriter& rows, const std::vector<std::string>& sd) {
+					char szTmp[100];
+					if (method == 0)
 					{
-						int ii = 0;
-						for (const auto& sd : result)
+						// bars / hour
+						int64_t actValue = std::stoll(sd[0]);
+						std::string szActDateTimeHour = sd[1].substr(0, 13) + ":00";
+
+						struct tm ntime;
+						time_t atime;
+						ParseSQLdatetime(atime, ntime, sd[1], -1);
+
+						if (actValue < st->ulFirstValue)
 						{
-							root["result"][ii]["d"] = sd[4].substr(0, 16);
-							if (dType == pTypeRego6XXTemp
-								|| dType == pTypeTEMP
-								|| dType == pTypeTEMP_HUM
-								|| dType == pTypeTEMP_HUM_BARO
-								|| dType == pTypeTEMP_BARO
-								|| dType == pTypeWIND && dSubType == sTypeWIND4
-								|| dType == pTypeUV && dSubType == sTypeUV3
-								|| dType == pTypeThermostat1
-								|| dType == pTypeRadiator1
-								|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorTemp
-								|| dType == pTypeGeneral && dSubType == sTypeSystemTemp
-								|| dType == pTypeGeneral && dSubType == sTypeBaro
-								|| dType == pTypeEvohomeZone
-								|| dType == pTypeEvohomeWater
-								)
+							if (st->ulRealFirstValue - actValue > 20000)
 							{
-								double tvalue = ConvertTemperature(atof(sd[0].c_str()), tempsign);
-								root["result"][ii]["te"] = tvalue;
+								//Assume ,eter/counter turnover
+								st->ulFirstValue = st->ulRealFirstValue = actValue;
+								st->lastHour = ntime.tm_hour;
 							}
-							if (((dType == pTypeWIND) && (dSubType == sTypeWIND4)) || ((dType == pTypeWIND) && (dSubType == sTypeWINDNoTemp)))
-							{
-								double tvalue = ConvertTemperature(atof(sd[1].c_str()), tempsign);
-								root["result"][ii]["ch"] = tvalue;
-							}
-							if ((dType == pTypeHUM) || (dType == pTypeTEMP_HUM) || (dType == pTypeTEMP_HUM_BARO))
+						}
+
+						if (st->lastHour != ntime.tm_hour)
+						{
+							if (st->lastDay != ntime.tm_mday)
 							{
-								root["result"][ii]["hu"] = sd[2];
+								st->lastDay = ntime.tm_mday;
+								st->ulRealFirstValue = actValue;
 							}
-							if ((dType == pTypeTEMP_HUM_BARO) || (dType == pTypeTEMP_BARO) || ((dType == pTypeGeneral) && (dSubType == sTypeBaro)))
+
+							if (st->bHaveFirstValue)
 							{
-								if (dType == pTypeTEMP_HUM_BARO)
-								{
-									if (dSubType == sTypeTHBFloat)
-									{
-										sprintf(szTmp, "%.1f", atof(sd[3].c_str()) / 10.0F);
-										root["result"][ii]["ba"] = szTmp;
-									}
-									else
-										root["result"][ii]["ba"] = sd[3];
-								}
-								else if (dType == pTypeTEMP_BARO)
+								rows.BeginRow(st->szLastDateTimeHour);
+
+								// prevents graph from going crazy if the meter counter resets
+								// removed because it breaks  negative increments
+								double TotalValue = double(actValue - st->ulFirstValue);
+								switch (metertype)
 								{
-									sprintf(szTmp, "%.1f", atof(sd[3].c_str()) / 10.0F);
-									root["result"][ii]["ba"] = szTmp;
+								case device::tmeter::type::ENERGY:
+								case device::tmeter::type::ENERGY_GENERATED:
+									sprintf(szTmp, "%.3f", (TotalValue / divider) * 1000.0); // from kWh -> Watt
+									break;
+								case device::tmeter::type::GAS:
+									sprintf(szTmp, "%.3f", TotalValue / divider);
+									break;
+								case device::tmeter::type::WATER:
+									sprintf(szTmp, "%.3f", TotalValue / divider);
+									break;
+								case device::tmeter::type::COUNTER:
+									sprintf(szTmp, "%.10g", TotalValue / divider);
+									break;
+								default:
+									strcpy(szTmp, "0");
+									break;
 								}
-								else if ((dType == pTypeGeneral) && (dSubType == sTypeBaro))
+								rows.Member("v", szTmp);
+
+								if (!bIsManagedCounter)
 								{
-									sprintf(szTmp, "%.1f", atof(sd[3].c_str()) / 10.0F);
-									root["result"][ii]["ba"] = szTmp;
+									double usageValue = st->lastUsageValue;
+
+									switch (metertype)
+									{
+									case device::tmeter::type::ENERGY:
+									case device::tmeter::type::ENERGY_GENERATED:
+										sprintf(szTmp, "%.3f", usageValue / divider);
+										break;
+									case device::tmeter::type::GAS:
+										sprintf(szTmp, "%.3f", usageValue / divider);
+										break;
+									case device::tmeter::type::WATER:
+										sprintf(szTmp, "%g", usageValue);
+										break;
+									case device::tmeter::type::COUNTER:
+										sprintf(szTmp, "%.3f", usageValue / divider);
+										break;
+									}
+									rows.Member("mu", szTmp);
 								}
+								rows.EndRow();
 							}
-							if ((dType == pTypeEvohomeZone) || (dType == pTypeEvohomeWater))
+							if (!bIsManagedCounter)
 							{
-								double se = ConvertTemperature(atof(sd[5].c_str()), tempsign);
-								root["result"][ii]["se"] = se;
+								st->ulFirstValue = actValue;
 							}
-							if (dType == pTypeSetpoint && dSubType == sTypeSetpoint)
+							st->lastHour = ntime.tm_hour;
+						}
+
+						if (!st->bHaveFirstValue)
+						{
+							st->bHaveFirstValue = true;
+							st->lastHour = ntime.tm_hour;
+							st->ulFirstValue = actValue;
+							st->ulRealFirstValue = actValue;
+							st->lastDay = ntime.tm_mday;
+
+							if (!((ntime.tm_hour == 0) && (ntime.tm_min == 0)))
 							{
-								std::string value_unit = options["ValueUnit"];
-								if (
-									(value_unit.empty())
-									|| (value_unit == "°C")
-									|| (value_unit == "°F")
-									|| (value_unit == "C")
-									|| (value_unit == "F")
-									)
+								struct tm ltime;
+								getNoon(atime, ltime, ntime.tm_year + 1900, ntime.tm_mon + 1,
+									ntime.tm_mday - 1); // We're only interested in finding the date
+								int year = ltime.tm_year + 1900;
+								int mon = ltime.tm_mon + 1;
+								int day = ltime.tm_mday;
+								sprintf(szTmp, "%04d-%02d-%02d", year, mon, day);
+								std::vector<std::vector<std::string>> result2;
+								result2 = m_sql.safe_readonly_query(
+									"SELECT Counter FROM Meter_Calendar WHERE (DeviceRowID==%" PRIu64
+									") AND (Date=='%q')",
+									idx, szTmp);
+								if (!result2.empty())
 								{
-									double se = ConvertTemperature(atof(sd[0].c_str()), tempsign);
-									root["result"][ii]["te"] = se;
+									st->ulRealFirstValue = std::stoll(result2[0][0]);
+									st->lastDay = ntime.tm_mday;
 								}
-								else
-									root["result"][ii]["te"] = atof(sd[0].c_str());
 							}
-							ii++;
 						}
+						st->szLastDateTimeHour = szActDateTimeHour;
+						st->lastUsageValue = (double)(actValue - st->ulRealFirstValue);
+						st->ulLastValue = actValue;
 					}
-				}
-				else if (sensor == "Percentage")
-				{
-					root["status"] = "OK";
-					root["title"] = "Graph " + sensor + " " + srange;
-
-					result = m_sql.safe_query("SELECT Percentage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-					if (!result.empty())
+					else
 					{
-						int ii = 0;
-						for (const auto& sd : result)
+						// realtime graph
+						int64_t actValue = std::stoll(sd[0]);
+
+						std::string stime = sd[1];
+						struct tm ntime;
+						time_t atime;
+						ParseSQLdatetime(atime, ntime, stime, -1);
+						if (st->bHaveFirstRealValue)
 						{
-							root["result"][ii]["d"] = sd[1].substr(0, 16);
-							root["result"][ii]["v"] = sd[0];
-							ii++;
-						}
-					}
-				}
-				else if (sensor == "fan")
-				{
-					root["status"] = "OK";
-					root["title"] = "Graph " + sensor + " " + srange;
+							int64_t curValue;
+							float tlaps = 1;
 
-					result = m_sql.safe_query("SELECT Speed, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-					if (!result.empty())
-					{
-						int ii = 0;
-						for (const auto& sd : result)
+							if (!bIsManagedCounter)
+							{
+								curValue = actValue - st->ulLastValue;
+								float tdiff;
+								tdiff = static_cast<float>(difftime(atime, st->lastTime));
+								if (tdiff <= 10)
+								{
+									// datapoints in the shortlog should not be this close together - DST clock backwards move?
+									return;
+								}
+								tlaps = 3600.0F / tdiff;
+							}
+							else
+							{
+								curValue = actValue;
+							}
+
+							curValue *= int(tlaps);
+
+							rows.BeginRow(sd);
+
+							double TotalValue = double(curValue);
+							switch (metertype)
+							{
+							case device::tmeter::type::ENERGY:
+							case device::tmeter::type::ENERGY_GENERATED:
+								sprintf(szTmp, "%.3f", (TotalValue / divider) * 1000.0); // from kWh -> Watt
+								break;
+							case device::tmeter::type::GAS:
+								sprintf(szTmp, "%.2f", TotalValue / divider);
+								break;
+							case device::tmeter::type::WATER:
+								sprintf(szTmp, "%.3f", TotalValue / divider);
+								break;
+							case device::tmeter::type::COUNTER:
+								sprintf(szTmp, "%.10g", TotalValue / divider);
+								break;
+							default:
+								strcpy(szTmp, "0");
+								break;
+							}
+							rows.Member("v", szTmp);
+							rows.EndRow();
+						}
+						else
+							st->bHaveFirstRealValue = true;
+						if (!bIsManagedCounter)
 						{
-							root["result"][ii]["d"] = sd[1].substr(0, 16);
-							root["result"][ii]["v"] = sd[0];
-							ii++;
+							st->ulLastValue = actValue;
 						}
+						st->lastTime = atime;
 					}
-				}
-				else if (sensor == "counter")
-				{
-					if (dType == pTypeP1Power)
-					{
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+				},
+				[metertype, divider, bIsManagedCounter, method, st](CGraphRowWriter& rows) {
+					if ((bIsManagedCounter) || (!st->bHaveFirstValue) || (method != 0))
+						return;
+					// add last value
+					char szTmp[100];
+					rows.BeginRow(st->szLastDateTimeHour);
 
-						int P1DisplayType = 0; //0=Low/High tariff, 1=simple (for dynamic contracts)
-						m_sql.GetPreferencesVar("P1DisplayType", P1DisplayType);
-						root["P1DisplayType"] = P1DisplayType;
+					int64_t ulTotalValue = st->ulLastValue - st->ulFirstValue;
 
-						result = m_sql.safe_query("SELECT Value1, Value2, Value3, Value4, Value5, Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC",
-							dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							bool bHaveDeliverd = false;
-							bool bHaveFirstValue = false;
-							int64_t lastUsage1, lastUsage2, lastDeliv1, lastDeliv2;
-							time_t lastTime = 0;
+					double TotalValue = double(ulTotalValue);
 
-							int64_t firstUsage1 = 0;
-							int64_t firstUsage2 = 0;
-							int64_t firstDeliv1 = 0;
-							int64_t firstDeliv2 = 0;
+					switch (metertype)
+					{
+					case device::tmeter::type::ENERGY:
+					case device::tmeter::type::ENERGY_GENERATED:
+						sprintf(szTmp, "%.3f", (TotalValue / divider) * 1000.0); // from kWh -> Watt
+						break;
+					case device::tmeter::type::GAS:
+						sprintf(szTmp, "%.3f", TotalValue / divider);
+						break;
+					case device::tmeter::type::WATER:
+						sprintf(szTmp, "%.3f", TotalValue / divider);
+						break;
+					case device::tmeter::type::COUNTER:
+						sprintf(szTmp, "%.10g", TotalValue / divider);
+						break;
+					default:
+						strcpy(szTmp, "0");
+						break;
+					}
+					rows.Member("v", szTmp);
 
-							int lastDay = 0;
+					double usageValue = (double)(st->ulLastValue - st->ulRealFirstValue);
+					switch (metertype)
+					{
+					case device::tmeter::type::ENERGY:
+					case device::tmeter::type::ENERGY_GENERATED:
+						sprintf(szTmp, "%.3f", usageValue / divider);
+						break;
+					case device::tmeter::type::GAS:
+						sprintf(szTmp, "%.3f", usageValue / divider);
+						break;
+					case device::tmeter::type::WATER:
+						sprintf(szTmp, "%.3f", usageValue);
+						break;
+					case device::tmeter::type::COUNTER:
+						sprintf(szTmp, "%.3f", usageValue / divider);
+						break;
+					}
+					rows.Member("mu", szTmp);
+					rows.EndRow();
+				});
+			return true;
+		}
 
-							for (const auto& sd : result)
-							{
-								int64_t actUsage1 = std::stoll(sd[0]);
-								int64_t actUsage2 = std::stoll(sd[4]);
-								int64_t actDeliv1 = std::stoll(sd[1]);
-								int64_t actDeliv2 = std::stoll(sd[5]);
-								actDeliv1 = (actDeliv1 < 10) ? 0 : actDeliv1;
-								actDeliv2 = (actDeliv2 < 10) ? 0 : actDeliv2;
 
-								std::string stime = sd[6];
-								struct tm ntime;
-								time_t atime;
-								ParseSQLdatetime(atime, ntime, stime, -1);
-								if (lastDay != ntime.tm_mday)
-								{
-									lastDay = ntime.tm_mday;
-									firstUsage1 = actUsage1;
-									firstUsage2 = actUsage2;
-									firstDeliv1 = actDeliv1;
-									firstDeliv2 = actDeliv2;
-								}
-
-								if (bHaveFirstValue)
-								{
-									long curUsage1 = (long)(actUsage1 - lastUsage1);
-									long curUsage2 = (long)(actUsage2 - lastUsage2);
-									long curDeliv1 = (long)(actDeliv1 - lastDeliv1);
-									long curDeliv2 = (long)(actDeliv2 - lastDeliv2);
-
-									if ((curUsage1 < 0) || (curUsage1 > 100000))
-										curUsage1 = 0;
-									if ((curUsage2 < 0) || (curUsage2 > 100000))
-										curUsage2 = 0;
-									if ((curDeliv1 < 0) || (curDeliv1 > 100000))
-										curDeliv1 = 0;
-									if ((curDeliv2 < 0) || (curDeliv2 > 100000))
-										curDeliv2 = 0;
-
-									float tdiff = static_cast<float>(difftime(atime, lastTime));
-									if (tdiff <= 10)
-									{
-										// datapoints in the shortlog should not be this close together - DST clock backwards move?
-										continue;
-									}
-
-									float tlaps = 3600.0F / tdiff;
-									curUsage1 *= int(tlaps);
-									curUsage2 *= int(tlaps);
-									curDeliv1 *= int(tlaps);
-									curDeliv2 *= int(tlaps);
-
-									root["result"][ii]["d"] = sd[6].substr(0, 16);
-
-									if ((curDeliv1 != 0) || (curDeliv2 != 0))
-										bHaveDeliverd = true;
-
-									if (P1DisplayType == 0)
-									{
-										//Low/High Tarrif
-										sprintf(szTmp, "%ld", curUsage1);
-										root["result"][ii]["v1"] = szTmp;
-										sprintf(szTmp, "%ld", curUsage2);
-										root["result"][ii]["v2"] = szTmp;
-										sprintf(szTmp, "%ld", curDeliv1);
-										root["result"][ii]["r1"] = szTmp;
-										sprintf(szTmp, "%ld", curDeliv2);
-										root["result"][ii]["r2"] = szTmp;
-									}
-									else
-									{
-										//Simple
-										sprintf(szTmp, "%ld", curUsage1 + curUsage2);
-										root["result"][ii]["v"] = szTmp;
-										sprintf(szTmp, "%ld", curDeliv1 + curDeliv2);
-										root["result"][ii]["r"] = szTmp;
-									}
-									long pUsage1 = (long)(actUsage1 - firstUsage1);
-									long pUsage2 = (long)(actUsage2 - firstUsage2);
-
-									sprintf(szTmp, "%ld", pUsage1 + pUsage2);
-									root["result"][ii]["eu"] = szTmp;
-									if (bHaveDeliverd)
-									{
-										long pDeliv1 = (long)(actDeliv1 - firstDeliv1);
-										long pDeliv2 = (long)(actDeliv2 - firstDeliv2);
-										sprintf(szTmp, "%ld", pDeliv1 + pDeliv2);
-										root["result"][ii]["eg"] = szTmp;
-									}
-
-									ii++;
-								}
-								else
-								{
-									bHaveFirstValue = true;
-									if ((ntime.tm_hour != 0) && (ntime.tm_min != 0))
-									{
-										struct tm ltime;
-										localtime_r(&atime, &tm1);
-										getNoon(atime, ltime, ntime.tm_year + 1900, ntime.tm_mon + 1,
-											ntime.tm_mday - 1); // We're only interested in finding the date
-										int year = ltime.tm_year + 1900;
-										int mon = ltime.tm_mon + 1;
-										int day = ltime.tm_mday;
-										sprintf(szTmp, "%04d-%02d-%02d", year, mon, day);
-										std::vector<std::vector<std::string>> result2;
-										result2 = m_sql.safe_query(
-											"SELECT Counter1, Counter2, Counter3, Counter4 FROM Multimeter_Calendar WHERE (DeviceRowID==%" PRIu64
-											") AND (Date=='%q')",
-											idx, szTmp);
-										if (!result2.empty())
-										{
-											std::vector<std::string> sd = result2[0];
-											firstUsage1 = std::stoll(sd[0]);
-											firstDeliv1 = std::stoll(sd[1]);
-											firstUsage2 = std::stoll(sd[2]);
-											firstDeliv2 = std::stoll(sd[3]);
-											lastDay = ntime.tm_mday;
-										}
-									}
-								}
-								lastUsage1 = actUsage1;
-								lastUsage2 = actUsage2;
-								lastDeliv1 = actDeliv1;
-								lastDeliv2 = actDeliv2;
-								lastTime = atime;
-							}
-							if (bHaveDeliverd)
-							{
-								root["delivered"] = true;
-							}
-						}
+		// Sends the members of root ({"status":"OK","title":...}) and a result of rows written by WriteRow from the rows of szTable for the device.
+		// The rows are read a page at a time in (Date, ROWID) order, so no more than a page is in memory
+		// and no database connection is held while the client receives it.
+		// They come from the short log store when it holds a valid copy of the table, else from the database.
+		// WriteRow gets the szColumns values followed by Date and ROWID, and writes any number of result rows for them.
+		// Finish is called after the last row, for what follows from all rows.
+		void CWebServer::StreamGraphRows(reply& rep, const uint64_t idx, const Json::Value& root, const std::string& szTable, const std::string& szColumns,
+						 const std::function<void(CGraphRowWriter& rows, const std::vector<std::string>& sd)>& WriteRow,
+						 const std::function<void(CGraphRowWriter& rows)>& Finish)
+		{
+			struct _tGraphStream
+			{
+				CJSonStreamWriter writer;
+				CGraphRowWriter rows{ writer };
+				std::string LastDate;
+				std::string LastRowID = "0";
+				bool bFromStore = false;
+				std::vector<int> StoreColumns;
+				time_t NextTime = 0;
+			};
+			auto state = std::make_shared<_tGraphStream>();
+			CTimeSeriesStore::_eTable stable = CTimeSeriesStore::GetTable(szTable.c_str());
+			if ((stable != CTimeSeriesStore::TABLE_COUNT) && m_sql.m_shortlogstore.IsValid(stable))
+			{
+				std::vector<std::string> columns;
+				StringSplit(szColumns, ",", columns);
+				state->bFromStore = true;
+				for (auto &column : columns)
+				{
+					int col = CTimeSeriesStore::GetColumn(stable, stdstring_trim(column));
+					state->StoreColumns.push_back(col);
+					state->bFromStore = state->bFromStore && (col >= 0);
+				}
+			}
+			state->writer.BeginObject();
+			for (const auto& name : root.getMemberNames())
+				state->writer.Member(name.c_str(), root[name]);
+
+			reply::set_content_producer(&rep, [this, state, idx, stable, szTable, szColumns, WriteRow, Finish](std::string& out) {
+				std::vector<std::vector<std::string>> result;
+				bool bMore = false;
+				if (state->bFromStore && (!ReadStoredGraphRows(stable, idx, state->StoreColumns, state->NextTime, result, bMore)))
+				{
+					// changed behind the store meanwhile, continue after the last row that was sent
+					state->bFromStore = false;
+					result.clear();
+					if (state->NextTime != 0)
+					{
+						time_t tLast = state->NextTime - 1;
+						state->LastDate = TimeToString(&tLast, TF_DateTime);
+						state->LastRowID = std::to_string(INT64_MAX);
 					}
-					else if (dType == pTypeAirQuality)
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+				}
+				if (!state->bFromStore)
+				{
+					// one row more than a page tells whether this page holds the last row
+					result = m_sql.safe_readonly_query("SELECT %s, Date, ROWID FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND (Date>'%q' OR ROWID>%" PRId64 ")) ORDER BY Date ASC, ROWID ASC LIMIT %d",
+									   szColumns.c_str(), szTable.c_str(), idx, state->LastDate.c_str(), state->LastDate.c_str(), std::stoll(state->LastRowID), GRAPH_STREAM_PAGE_ROWS + 1);
+					bMore = (result.size() > GRAPH_STREAM_PAGE_ROWS);
+					if (bMore)
+						result.pop_back();
+				}
+				for (size_t ii = 0; ii < result.size(); ii++)
+				{
+					state->rows.SetLastRow((!bMore) && (ii + 1 == result.size()));
+					WriteRow(state->rows, result[ii]);
+				}
+				if ((!state->bFromStore) && (!result.empty()))
+				{
+					state->LastDate = result.back()[result.back().size() - 2];
+					state->LastRowID = result.back().back();
+				}
+				if (!bMore)
+				{
+					if (Finish)
+						Finish(state->rows);
+					state->rows.EndRows();
+					state->writer.EndObject();
+				}
+				out += state->writer.Take();
+				return bMore;
+			});
+		}
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								root["result"][ii]["co2"] = sd[0];
-								ii++;
-							}
-						}
-					}
-					else if ((dType == pTypeGeneral) && ((dSubType == sTypeSoilMoisture) || (dSubType == sTypeLeafWetness)))
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+		void CWebServer::Cmd_HandleGraph(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			uint64_t idx = 0;
+			if (!request::findValue(&req, "idx").empty())
+			{
+				idx = std::stoull(request::findValue(&req, "idx"));
+			}
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								root["result"][ii]["v"] = sd[0];
-								ii++;
-							}
-						}
-					}
-					else if (((dType == pTypeGeneral) && (dSubType == sTypeVisibility)) || ((dType == pTypeGeneral) && (dSubType == sTypeDistance)) ||
-						((dType == pTypeGeneral) && (dSubType == sTypeSolarRadiation)) || ((dType == pTypeGeneral) && (dSubType == sTypeVoltage)) ||
-						((dType == pTypeGeneral) && (dSubType == sTypeCurrent)) || ((dType == pTypeGeneral) && (dSubType == sTypePressure)) ||
-						((dType == pTypeGeneral) && (dSubType == sTypeSoundLevel)))
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
-						float vdiv = 10.0F;
-						if (((dType == pTypeGeneral) && (dSubType == sTypeVoltage)) || ((dType == pTypeGeneral) && (dSubType == sTypeCurrent)))
-						{
-							vdiv = 1000.0F;
-						}
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								float fValue = float(atof(sd[0].c_str())) / vdiv;
-								if (metertype == 1)
-								{
-									if ((dType == pTypeGeneral) && (dSubType == sTypeDistance))
-										fValue *= 0.3937007874015748F; // inches
-									else
-										fValue *= 0.6214F; // miles
-								}
-								if ((dType == pTypeGeneral) && (dSubType == sTypeVoltage))
-									sprintf(szTmp, "%.3f", fValue);
-								else if ((dType == pTypeGeneral) && (dSubType == sTypeCurrent))
-									sprintf(szTmp, "%.3f", fValue);
-								else
-									sprintf(szTmp, "%.1f", fValue);
-								root["result"][ii]["v"] = szTmp;
-								ii++;
-							}
-						}
-					}
-					else if ((dType == pTypeRFXSensor) && ((dSubType == sTypeRFXSensorAD) || (dSubType == sTypeRFXSensorVolt)))
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+			std::vector<std::vector<std::string>> result;
+			char szTmp[300];
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								root["result"][ii]["v"] = sd[0];
-								ii++;
-							}
-						}
-					}
-					else if (dType == pTypeLux)
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+			std::string sensor = request::findValue(&req, "sensor");
+			if (sensor.empty())
+				return;
+			std::string sensorarea = request::findValue(&req, "sensorarea");
+			std::string srange = request::findValue(&req, "range");
+			std::string sgroupby = request::findValue(&req, "groupby");
+			if (srange.empty() && sgroupby.empty())
+				return;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								root["result"][ii]["lux"] = sd[0];
-								ii++;
-							}
-						}
-					}
-					else if (dType == pTypeWEIGHT)
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+			time_t now = mytime(nullptr);
+			struct tm tm1;
+			localtime_r(&now, &tm1);
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								sprintf(szTmp, "%.1f", m_sql.m_weightscale * atof(sd[0].c_str()) / 10.0F);
-								root["result"][ii]["v"] = szTmp;
-								ii++;
-							}
-						}
-					}
-					else if (dType == pTypeUsage)
-					{ // day
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+			result = m_sql.safe_readonly_query("SELECT Type, SubType, SwitchType, AddjValue, AddjMulti, AddjValue2, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
+			if (result.empty())
+				return;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[1].substr(0, 16);
-								root["result"][ii]["u"] = atof(sd[0].c_str()) / 10.0F;
-								ii++;
-							}
-						}
-					}
-					else if (dType == pTypeCURRENT)
-					{
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
+			unsigned char dType = atoi(result[0][0].c_str());
+			unsigned char dSubType = atoi(result[0][1].c_str());
+			device::tmeter::type::value metertype = (device::tmeter::type::value)atoi(result[0][2].c_str());
+			_log.Debug(DEBUG_WEBSERVER, "CWebServer::Cmd_HandleGraph() : dType:%02X  dSubType:%02X  metertype:%d", dType, dSubType, int(metertype));
+			if ((dType == pTypeP1Power) || (dType == pTypeENERGY) || (dType == pTypePOWER) || (dType == pTypeCURRENTENERGY) || ((dType == pTypeGeneral) && (dSubType == sTypeKwh)))
+			{
+				metertype = device::tmeter::type::ENERGY;
+			}
+			else if (dType == pTypeP1BusDevice)
+				metertype = device::tmeter::type::GAS;
+			else if ((dType == pTypeRego6XXValue) && (dSubType == sTypeRego6XXCounter))
+				metertype = device::tmeter::type::COUNTER;
 
-						// CM113
-						int displaytype = 0;
-						int voltage = 230;
-						m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
-						m_sql.GetPreferencesVar("ElectricVoltage", voltage);
+			// Special case of managed counter: Usage instead of Value in Meter table, and we don't want to calculate last value
+			bool bIsManagedCounter = (dType == pTypeGeneral) && (dSubType == sTypeManagedCounter);
 
-						root["displaytype"] = displaytype;
+			double AddjValue = atof(result[0][3].c_str());
+			double AddjMulti = atof(result[0][4].c_str());
+			double AddjValue2 = atof(result[0][5].c_str());
+			std::string sOptions = result[0][6];
+			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sOptions);
 
-						result = m_sql.safe_query("SELECT Value1, Value2, Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							bool bHaveL1 = false;
-							bool bHaveL2 = false;
-							bool bHaveL3 = false;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[3].substr(0, 16);
+			double divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
-								float fval1 = static_cast<float>(atof(sd[0].c_str()) / 10.0F);
-								float fval2 = static_cast<float>(atof(sd[1].c_str()) / 10.0F);
-								float fval3 = static_cast<float>(atof(sd[2].c_str()) / 10.0F);
+			double meteroffset = AddjValue;
 
-								if (fval1 != 0)
-									bHaveL1 = true;
-								if (fval2 != 0)
-									bHaveL2 = true;
-								if (fval3 != 0)
-									bHaveL3 = true;
+			std::string dbasetable;
+			if ((srange == "day") || (srange == "hour"))
+			{
+				if (sensor == "temp")
+					dbasetable = "Temperature";
+				else if (sensor == "rain")
+					dbasetable = "Rain";
+				else if (sensor == "Percentage")
+					dbasetable = "Percentage";
+				else if (sensor == "fan")
+					dbasetable = "Fan";
+				else if (sensor == "counter")
+				{
+					Cmd_GetCosts(session, req, root);
 
-								if (displaytype == 0)
-								{
-									sprintf(szTmp, "%.1f", fval1);
-									root["result"][ii]["v1"] = szTmp;
-									sprintf(szTmp, "%.1f", fval2);
-									root["result"][ii]["v2"] = szTmp;
-									sprintf(szTmp, "%.1f", fval3);
-									root["result"][ii]["v3"] = szTmp;
-								}
-								else
-								{
-									sprintf(szTmp, "%d", int(fval1 * voltage));
-									root["result"][ii]["v1"] = szTmp;
-									sprintf(szTmp, "%d", int(fval2 * voltage));
-									root["result"][ii]["v2"] = szTmp;
-									sprintf(szTmp, "%d", int(fval3 * voltage));
-									root["result"][ii]["v3"] = szTmp;
-								}
-								ii++;
-							}
-							if ((!bHaveL1) && (!bHaveL2) && (!bHaveL3))
-							{
-								root["haveL1"] = true; // show at least something
-							}
-							else
-							{
-								if (bHaveL1)
-									root["haveL1"] = true;
-								if (bHaveL2)
-									root["haveL2"] = true;
-								if (bHaveL3)
-									root["haveL3"] = true;
-							}
-						}
-					}
-					else if (dType == pTypeCURRENTENERGY)
+					if ((dType == pTypeP1Power) || (dType == pTypeCURRENT) || (dType == pTypeCURRENTENERGY))
 					{
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
-
-						// CM113
-						int displaytype = 0;
-						int voltage = 230;
-						m_sql.GetPreferencesVar("CM113DisplayType", displaytype);
-						m_sql.GetPreferencesVar("ElectricVoltage", voltage);
-
-						root["displaytype"] = displaytype;
-
-						result = m_sql.safe_query("SELECT Value1, Value2, Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int ii = 0;
-							bool bHaveL1 = false;
-							bool bHaveL2 = false;
-							bool bHaveL3 = false;
-							for (const auto& sd : result)
-							{
-								root["result"][ii]["d"] = sd[3].substr(0, 16);
-
-								float fval1 = static_cast<float>(atof(sd[0].c_str()) / 10.0F);
-								float fval2 = static_cast<float>(atof(sd[1].c_str()) / 10.0F);
-								float fval3 = static_cast<float>(atof(sd[2].c_str()) / 10.0F);
-
-								if (fval1 != 0)
-									bHaveL1 = true;
-								if (fval2 != 0)
-									bHaveL2 = true;
-								if (fval3 != 0)
-									bHaveL3 = true;
-
-								if (displaytype == 0)
-								{
-									sprintf(szTmp, "%.1f", fval1);
-									root["result"][ii]["v1"] = szTmp;
-									sprintf(szTmp, "%.1f", fval2);
-									root["result"][ii]["v2"] = szTmp;
-									sprintf(szTmp, "%.1f", fval3);
-									root["result"][ii]["v3"] = szTmp;
-								}
-								else
-								{
-									sprintf(szTmp, "%d", int(fval1 * voltage));
-									root["result"][ii]["v1"] = szTmp;
-									sprintf(szTmp, "%d", int(fval2 * voltage));
-									root["result"][ii]["v2"] = szTmp;
-									sprintf(szTmp, "%d", int(fval3 * voltage));
-									root["result"][ii]["v3"] = szTmp;
-								}
-								ii++;
-							}
-							if ((!bHaveL1) && (!bHaveL2) && (!bHaveL3))
-							{
-								root["haveL1"] = true; // show at least something
-							}
-							else
-							{
-								if (bHaveL1)
-									root["haveL1"] = true;
-								if (bHaveL2)
-									root["haveL2"] = true;
-								if (bHaveL3)
-									root["haveL3"] = true;
-							}
-						}
+						dbasetable = "MultiMeter";
 					}
-					else if ((dType == pTypeENERGY) || (dType == pTypePOWER) || (dType == pTypeYouLess) || ((dType == pTypeGeneral) && (dSubType == sTypeKwh)))
+					else
 					{
-						root["status"] = "OK";
-						root["title"] = "Graph " + sensor + " " + srange;
-						root["ValueQuantity"] = options["ValueQuantity"];
-						root["ValueUnits"] = options["ValueUnits"];
-						root["Divider"] = divider;
-
-						// First check if we had any usage in the short log, if not, its probably a meter without usage
-						bool bHaveUsage = true;
-						result = m_sql.safe_query("SELECT MIN([Usage]), MAX([Usage]) FROM %s WHERE (DeviceRowID==%" PRIu64 ")", dbasetable.c_str(), idx);
-						if (!result.empty())
-						{
-							int64_t minValue = std::stoll(result[0][0]);
-							int64_t maxValue = std::stoll(result[0][1]);
-
-							if ((minValue == 0) && (maxValue == 0))
-							{
-								bHaveUsage = false;
-							}
-						}
-
-						int ii = 0;
-						result = m_sql.safe_query("SELECT Value,[Usage], Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-
-						int method = 0;
-						std::string sMethod = request::findValue(&req, "method");
-						if (!sMethod.empty())
-							method = atoi(sMethod.c_str());
-						if (bHaveUsage == false)
-							method = 0;
-
-						if ((dType == pTypeYouLess) && ((metertype == device::tmeter::type::ENERGY) || (metertype == device::tmeter::type::ENERGY_GENERATED)))
-							method = 1;
-
-						double dividerForQuantity = divider; // kWh, m3, l
-						double dividerForRate = divider; // Watt, m3/hour, l/hour
-						if (method != 0)
-						{
-							// realtime graph
-							if ((dType == pTypeENERGY) || (dType == pTypePOWER))
-							{
-								dividerForRate /= 100.0F;
-							}
-						}
-
-						root["method"] = method;
-						bool bHaveFirstValue = false;
-						bool bHaveFirstRealValue = false;
-						int64_t ulFirstRealValue = 0;
-						int64_t ulFirstValue = 0;
-						int64_t ulLastValue = 0;
-						std::string LastDateTime;
-
-						if (!result.empty())
-						{
-							for (auto itt = result.begin(); itt != result.end(); ++itt)
-							{
-								std::vector<std::string> sd = *itt;
-
-								// If method == 1, provide BOTH hourly and instant usage for combined graph
-								{
-									// bars / hour
-									std::string actDateTimeHour = sd[2].substr(0, 13);
-									int64_t actValue = std::stoll(sd[0]); // actual energy value
-
-									ulLastValue = actValue;
-
-									if (ulLastValue < ulFirstValue)
-									{
-										if (ulFirstValue - ulLastValue > 20000)
-										{
-											//probably a meter/counter turnover
-											ulFirstValue = ulFirstRealValue = ulLastValue;
-											LastDateTime = actDateTimeHour;
-										}
-									}
-
-									if (actDateTimeHour != LastDateTime || ((method == 1) && (itt + 1 == result.end())))
-									{
-										if (bHaveFirstValue)
-										{
-											// root["result"][ii]["d"] = LastDateTime + (method == 1 ? ":30" : ":00");
-											//^^ not necessarily bad, but is currently inconsistent with all other day graphs
-											root["result"][ii]["d"] = LastDateTime + ":00";
-
-											int64_t ulTotalValue = ulLastValue - ulFirstValue;
-											if (ulTotalValue == 0)
-											{
-												// Could be the P1 Gas Meter, only transmits one every 1 a 2 hours
-												ulTotalValue = ulLastValue - ulFirstRealValue;
-											}
-											ulFirstRealValue = ulLastValue;
-											double TotalValue = double(ulTotalValue);
-											double dividerHere = method == 1 ? dividerForQuantity : dividerForRate;
-											switch (metertype)
-											{
-											case device::tmeter::type::ENERGY:
-											case device::tmeter::type::ENERGY_GENERATED:
-												sprintf(szTmp, "%.3f", (TotalValue / dividerHere) * 1000.0); // from kWh -> Watt
-												break;
-											case device::tmeter::type::GAS:
-												sprintf(szTmp, "%.3f", TotalValue / dividerHere);
-												break;
-											case device::tmeter::type::WATER:
-												sprintf(szTmp, "%.3f", TotalValue / dividerHere);
-												break;
-											case device::tmeter::type::COUNTER:
-												sprintf(szTmp, "%.10g", TotalValue / dividerHere);
-												break;
-											default:
-												strcpy(szTmp, "0");
-												break;
-											}
-											root["result"][ii][method == 1 ? "eu" : "v"] = szTmp;
-											ii++;
-										}
-										LastDateTime = actDateTimeHour;
-										bHaveFirstValue = false;
-									}
-									if (!bHaveFirstValue)
-									{
-										ulFirstValue = ulLastValue;
-										bHaveFirstValue = true;
-									}
-									if (!bHaveFirstRealValue)
-									{
-										bHaveFirstRealValue = true;
-										ulFirstRealValue = ulLastValue;
-									}
-								}
+						dbasetable = "Meter";
+					}
+				}
+				else if ((sensor == "wind") || (sensor == "winddir"))
+					dbasetable = "Wind";
+				else if (sensor == "uv")
+					dbasetable = "UV";
+				else
+					return;
+			}
+			else
+			{
+				// week,year,month
+				if (sensor == "temp")
+					dbasetable = "Temperature_Calendar";
+				else if (sensor == "rain")
+					dbasetable = "Rain_Calendar";
+				else if (sensor == "Percentage")
+					dbasetable = "Percentage_Calendar";
+				else if (sensor == "fan")
+					dbasetable = "Fan_Calendar";
+				else if (sensor == "counter")
+				{
+					Cmd_GetCosts(session, req, root);
 
-								if (method == 1)
-								{
-									int64_t actValue = std::stoll(sd[1]);
+					if (dType == pTypeP1Power
+						|| dType == pTypeCURRENT
+						|| dType == pTypeCURRENTENERGY
+						|| dType == pTypeAirQuality
+						|| dType == pTypeLux
+						|| dType == pTypeWEIGHT
+						|| dType == pTypeUsage
+						|| dType == pTypeGeneral && dSubType == sTypeVisibility
+						|| dType == pTypeGeneral && dSubType == sTypeDistance
+						|| dType == pTypeGeneral && dSubType == sTypeSolarRadiation
+						|| dType == pTypeGeneral && dSubType == sTypeSoilMoisture
+						|| dType == pTypeGeneral && dSubType == sTypeLeafWetness
+						|| dType == pTypeGeneral && dSubType == sTypeVoltage
+						|| dType == pTypeGeneral && dSubType == sTypeCurrent
+						|| dType == pTypeGeneral && dSubType == sTypePressure
+						|| dType == pTypeGeneral && dSubType == sTypeSoundLevel
+						|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorAD
+						|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorVolt
+						) {
+						dbasetable = "MultiMeter_Calendar";
+					}
+					else {
+						dbasetable = "Meter_Calendar";
+					}
+				}
+				else if ((sensor == "wind") || (sensor == "winddir"))
+					dbasetable = "Wind_Calendar";
+				else if (sensor == "uv")
+					dbasetable = "UV_Calendar";
+				else
+					return;
+			}
+			unsigned char tempsign = m_sql.m_tempsign[0];
 
-									root["result"][ii]["d"] = sd[2].substr(0, 16);
+			int iPrev;
 
-									double TotalValue = double(actValue);
-									if ((dType == pTypeGeneral) && (dSubType == sTypeKwh))
-										TotalValue /= 10.0F;
-									switch (metertype)
-									{
-									case device::tmeter::type::ENERGY:
-									case device::tmeter::type::ENERGY_GENERATED:
-										sprintf(szTmp, "%.3f", (TotalValue / dividerForRate) * 1000.0); // from kWh -> Watt
-										break;
-									case device::tmeter::type::GAS:
-										sprintf(szTmp, "%.2f", TotalValue / dividerForRate);
-										break;
-									case device::tmeter::type::WATER:
-										sprintf(szTmp, "%.3f", TotalValue / dividerForRate);
-										break;
-									case device::tmeter::type::COUNTER:
-										sprintf(szTmp, "%.10g", TotalValue / dividerForRate);
-										break;
-									default:
-										strcpy(szTmp, "0");
-										break;
-									}
-									root["result"][ii]["v"] = szTmp;
-									ii++;
-								}
-							}
-						}
-					}
-					else
+			if (srange == "hour")
+			{
+				if (sensor == "counter")
+				{
+					if (dType == pTypeP1Power)
 					{
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
-						root["ValueQuantity"] = options["ValueQuantity"];
-						root["ValueUnits"] = options["ValueUnits"];
-						root["Divider"] = divider;
+/*
+						char szDateStart[40];
+						char szDateEnd[40];
+						sprintf(szDateEnd, "%04d-%02d-%02d %02d:%02d:%02d", tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday, tm1.tm_hour, tm1.tm_min, tm1.tm_sec);
 
-						int ii = 0;
+						// Subtract a day
+						time_t daybefore;
+						struct tm tm2;
+						getNoon(daybefore, tm2, tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday - 1); // We only want one day
+						sprintf(szDateStart, "%04d-%02d-%02d %02d:%02d:%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday, tm1.tm_hour, tm1.tm_min, tm1.tm_sec);
 
-						bool bHaveFirstValue = false;
-						bool bHaveFirstRealValue = false;
-						int64_t ulFirstValue = 0;
-						int64_t ulRealFirstValue = 0;
-						int lastDay = 0;
-						std::string szLastDateTimeHour;
-						std::string szActDateTimeHour;
-						std::string szlastDateTime;
-						int64_t ulLastValue = 0;
-
-						int lastHour = 0;
-						time_t lastTime = 0;
-
-						int method = 0;
-						std::string sMethod = request::findValue(&req, "method");
-						if (!sMethod.empty())
-							method = atoi(sMethod.c_str());
-
-						if (bIsManagedCounter)
-						{
-							result = m_sql.safe_query("SELECT Usage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-							bHaveFirstValue = true;
-							bHaveFirstRealValue = true;
-							method = 1;
-						}
-						else
+						result = m_sql.safe_readonly_query("SELECT strftime('%%Y-%%m-%%d %%H:00:00', Date) as ymd, MIN(Value1) as u1, MIN(Value5) as u2, MIN(Value2) as d1, MIN(Value6) as d2 FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') GROUP BY ymd",
+							dbasetable.c_str(), idx, szDateStart, szDateEnd);
+*/
+
+						// ymd, MIN(Value1), MIN(Value5), MIN(Value2), MIN(Value6) and Price per hour
+						std::vector<CGraphRollups::_tBucket> hours;
+						m_sql.m_graphrollups.GetHours(CGraphRollups::TABLE_MULTIMETER, idx, "", "9999", hours);
+						result.clear();
+						for (const auto& hour : hours)
 						{
-							result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+							result.push_back({ hour.Hour, std::to_string((int64_t)hour.Min[0]), std::to_string((int64_t)hour.Min[4]), std::to_string((int64_t)hour.Min[1]),
+									   std::to_string((int64_t)hour.Min[5]), std::to_string(hour.Price) });
 						}
-
 						if (!result.empty())
 						{
-							double lastUsageValue = 0;
+							int ii = 0;
+							bool bHaveDeliverd = false;
+							bool bHaveFirstValue = false;
+							int64_t lastUsage, lastDeliv;
+							time_t lastTime = 0;
+
+							int lastDay = 0;
 
 							for (const auto& sd : result)
 							{
-								if (method == 0)
-								{
-									// bars / hour
-									int64_t actValue = std::stoll(sd[0]);
-									szlastDateTime = sd[1].substr(0, 16);
-									szActDateTimeHour = sd[1].substr(0, 13) + ":00";
+								int64_t actUsage1 = std::stoll(sd[1]);
+								int64_t actUsage2 = std::stoll(sd[2]);
+								int64_t actDeliv1 = std::stoll(sd[3]);
+								int64_t actDeliv2 = std::stoll(sd[4]);
+								actDeliv1 = (actDeliv1 < 10) ? 0 : actDeliv1;
+								actDeliv2 = (actDeliv2 < 10) ? 0 : actDeliv2;
+
+								int64_t actUsage = actUsage1 + actUsage2;
+								int64_t actDeliv = actDeliv1 + actDeliv2;
 
-									struct tm ntime;
-									time_t atime;
-									ParseSQLdatetime(atime, ntime, sd[1], -1);
+								std::string stime = sd[0];
+								struct tm ntime;
+								time_t atime;
+								ParseSQLdatetime(atime, ntime, stime, -1);
+								if (lastDay != ntime.tm_mday)
+								{
+									lastDay = ntime.tm_mday;
+								}
 
-									if (actValue < ulFirstValue)
+								if (bHaveFirstValue)
+								{
+									if (
+										(actUsage < lastUsage)
+										|| (actDeliv < lastDeliv)
+										|| (atime <= lastTime)
+										)
 									{
-										if (ulRealFirstValue - actValue > 20000)
-										{
-											//Assume ,eter/counter turnover
-											ulFirstValue = ulRealFirstValue = actValue;
-											lastHour = ntime.tm_hour;
-										}
+										//daylight change happened, meter changed?, ignoring  for now
+										lastUsage = actUsage;
+										lastDeliv = actDeliv;
+										lastTime = atime;
+										continue;
 									}
 
-									if (lastHour != ntime.tm_hour)
-									{
-										if (lastDay != ntime.tm_mday)
-										{
-											lastDay = ntime.tm_mday;
-											ulRealFirstValue = actValue;
-										}
+									long curUsage = (long)(actUsage - lastUsage);
+									long curDeliv = (long)(actDeliv - lastDeliv);
 
-										if (bHaveFirstValue)
-										{
-											root["result"][ii]["d"] = szLastDateTimeHour;
-
-											// float TotalValue = float(actValue - ulFirstValue);
-
-											// prevents graph from going crazy if the meter counter resets
-											// removed because it breaks  negative increments
-											double TotalValue = double(actValue - ulFirstValue);
-											//if (actValue < ulFirstValue) TotalValue=actValue;
-
-											// if (TotalValue != 0)
-											{
-												switch (metertype)
-												{
-												case device::tmeter::type::ENERGY:
-												case device::tmeter::type::ENERGY_GENERATED:
-													sprintf(szTmp, "%.3f", (TotalValue / divider) * 1000.0); // from kWh -> Watt
-													break;
-												case device::tmeter::type::GAS:
-													sprintf(szTmp, "%.3f", TotalValue / divider);
-													break;
-												case device::tmeter::type::WATER:
-													sprintf(szTmp, "%.3f", TotalValue / divider);
-													break;
-												case device::tmeter::type::COUNTER:
-													sprintf(szTmp, "%.10g", TotalValue / divider);
-													break;
-												default:
-													strcpy(szTmp, "0");
-													break;
-												}
-												root["result"][ii]["v"] = szTmp;
-
-												if (!bIsManagedCounter)
-												{
-													double usageValue = lastUsageValue;
-
-													switch (metertype)
-													{
-													case device::tmeter::type::ENERGY:
-													case device::tmeter::type::ENERGY_GENERATED:
-														sprintf(szTmp, "%.3f", usageValue / divider);
-														break;
-													case device::tmeter::type::GAS:
-														sprintf(szTmp, "%.3f", usageValue / divider);
-														break;
-													case device::tmeter::type::WATER:
-														sprintf(szTmp, "%g", usageValue);
-														break;
-													case device::tmeter::type::COUNTER:
-														sprintf(szTmp, "%.3f", usageValue / divider);
-														break;
-													}
-													root["result"][ii]["mu"] = szTmp;
-												}
-												ii++;
-											}
-										}
-										if (!bIsManagedCounter)
-										{
-											ulFirstValue = actValue;
-										}
-										lastHour = ntime.tm_hour;
-									}
+									std::string stime = sd[0].substr(0, 16);
+									root["result"][ii]["d"] = stime;
 
-									if (!bHaveFirstValue)
-									{
-										bHaveFirstValue = true;
-										lastHour = ntime.tm_hour;
-										ulFirstValue = actValue;
-										ulRealFirstValue = actValue;
-										lastDay = ntime.tm_mday;
+									if (curDeliv != 0)
+										bHaveDeliverd = true;
 
-										if (!((ntime.tm_hour == 0) && (ntime.tm_min == 0)))
-										{
-											struct tm ltime;
-											localtime_r(&atime, &tm1);
-											getNoon(atime, ltime, ntime.tm_year + 1900, ntime.tm_mon + 1,
-												ntime.tm_mday - 1); // We're only interested in finding the date
-											int year = ltime.tm_year + 1900;
-											int mon = ltime.tm_mon + 1;
-											int day = ltime.tm_mday;
-											sprintf(szTmp, "%04d-%02d-%02d", year, mon, day);
-											std::vector<std::vector<std::string>> result2;
-											result2 = m_sql.safe_query(
-												"SELECT Counter FROM %s_Calendar WHERE (DeviceRowID==%" PRIu64
-												") AND (Date=='%q')",
-												dbasetable.c_str(), idx, szTmp);
-											if (!result2.empty())
-											{
-												std::vector<std::string> sd = result2[0];
-												ulRealFirstValue = std::stoll(sd[0]);
-												lastDay = ntime.tm_mday;
-											}
-										}
-									}
-									szLastDateTimeHour = szActDateTimeHour;
-									lastUsageValue = (double)(actValue - ulRealFirstValue);
-									ulLastValue = actValue;
+									sprintf(szTmp, "%ld", curUsage);
+									root["result"][ii]["v"] = szTmp;
+									sprintf(szTmp, "%ld", curDeliv);
+									root["result"][ii]["r"] = szTmp;
+
+									float total = (curUsage - curDeliv) / 1000.0F;
+									float fPrice = std::stof(sd[5]) * total;
+									sprintf(szTmp, "%.4f", fPrice);
+									root["result"][ii]["p"] = szTmp;
+									ii++;
 								}
 								else
 								{
-									// realtime graph
-									int64_t actValue = std::stoll(sd[0]);
-
-									std::string stime = sd[1];
-									struct tm ntime;
-									time_t atime;
-									ParseSQLdatetime(atime, ntime, stime, -1);
-									if (bHaveFirstRealValue)
-									{
-										int64_t curValue;
-										float tlaps = 1;
-
-										if (!bIsManagedCounter)
-										{
-											curValue = actValue - ulLastValue;
-											float tdiff;
-											tdiff = static_cast<float>(difftime(atime, lastTime));
-											if (tdiff <= 10)
-											{
-												// datapoints in the shortlog should not be this close together - DST clock backwards move?
-												continue;
-											}
-											tlaps = 3600.0F / tdiff;
-										}
-										else
-										{
-											curValue = actValue;
-										}
-
-										curValue *= int(tlaps);
-
-										root["result"][ii]["d"] = sd[1].substr(0, 16);
-
-										double TotalValue = double(curValue);
-										// if (TotalValue != 0)
-										{
-											switch (metertype)
-											{
-											case device::tmeter::type::ENERGY:
-											case device::tmeter::type::ENERGY_GENERATED:
-												sprintf(szTmp, "%.3f", (TotalValue / divider) * 1000.0); // from kWh -> Watt
-												break;
-											case device::tmeter::type::GAS:
-												sprintf(szTmp, "%.2f", TotalValue / divider);
-												break;
-											case device::tmeter::type::WATER:
-												sprintf(szTmp, "%.3f", TotalValue / divider);
-												break;
-											case device::tmeter::type::COUNTER:
-												sprintf(szTmp, "%.10g", TotalValue / divider);
-												break;
-											default:
-												strcpy(szTmp, "0");
-												break;
-											}
-											root["result"][ii]["v"] = szTmp;
-											ii++;
-										}
-									}
-									else
-										bHaveFirstRealValue = true;
-									if (!bIsManagedCounter)
-									{
-										ulLastValue = actValue;
-									}
-									lastTime = atime;
+									bHaveFirstValue = true;
 								}
+								lastUsage = actUsage;
+								lastDeliv = actDeliv;
+								lastTime = atime;
 							}
-						}
-						if ((!bIsManagedCounter) && (bHaveFirstValue) && (method == 0))
-						{
-							// add last value
-							root["result"][ii]["d"] = szLastDateTimeHour;
-
-							int64_t ulTotalValue = ulLastValue - ulFirstValue;
-
-							double TotalValue = double(ulTotalValue);
-
-							// if (TotalValue != 0)
+							if (bHaveDeliverd)
 							{
-								switch (metertype)
-								{
-								case device::tmeter::type::ENERGY:
-								case device::tmeter::type::ENERGY_GENERATED:
-									sprintf(szTmp, "%.3f", (TotalValue / divider) * 1000.0); // from kWh -> Watt
-									break;
-								case device::tmeter::type::GAS:
-									sprintf(szTmp, "%.3f", TotalValue / divider);
-									break;
-								case device::tmeter::type::WATER:
-									sprintf(szTmp, "%.3f", TotalValue / divider);
-									break;
-								case device::tmeter::type::COUNTER:
-									sprintf(szTmp, "%.10g", TotalValue / divider);
-									break;
-								default:
-									strcpy(szTmp, "0");
-									break;
-								}
-								root["result"][ii]["v"] = szTmp;
-
-								if (!bIsManagedCounter)
-								{
-									double usageValue = (double)(ulLastValue - ulRealFirstValue);
-									switch (metertype)
-									{
-									case device::tmeter::type::ENERGY:
-									case device::tmeter::type::ENERGY_GENERATED:
-										sprintf(szTmp, "%.3f", usageValue / divider);
-										break;
-									case device::tmeter::type::GAS:
-										sprintf(szTmp, "%.3f", usageValue / divider);
-										break;
-									case device::tmeter::type::WATER:
-										sprintf(szTmp, "%.3f", usageValue);
-										break;
-									case device::tmeter::type::COUNTER:
-										sprintf(szTmp, "%.3f", usageValue / divider);
-										break;
-									}
-									root["result"][ii]["mu"] = szTmp;
-								}
-								ii++;
+								root["delivered"] = true;
 							}
 						}
 					}
 				}
-				else if (sensor == "uv")
-				{
-					root["status"] = "OK";
-					root["title"] = "Graph " + sensor + " " + srange;
-
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-					if (!result.empty())
-					{
-						int ii = 0;
-						for (const auto& sd : result)
-						{
-							root["result"][ii]["d"] = sd[1].substr(0, 16);
-							root["result"][ii]["uvi"] = sd[0];
-							ii++;
-						}
-					}
-				}
-				else if (sensor == "rain")
+			}
+			else if (srange == "day")
+			{
+				// temp, Percentage, fan, counter, uv and wind are streamed by Cmd_StreamGraph
+				if (sensor == "rain")
 				{
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
@@ -1341,7 +1427,7 @@ namespace http
 					float LastValue = -1;
 					std::string LastDate;
 
-					result = m_sql.safe_query("SELECT Total, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.safe_readonly_query("SELECT Total, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -1369,7 +1455,7 @@ namespace http
 							LastDate = sd[1];
 						}
 						//Add last value
-						result = m_sql.safe_query("SELECT sValue, LastUpdate FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
+						result = m_sql.safe_readonly_query("SELECT sValue, LastUpdate FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
 						if (!result.empty())
 						{
 							std::string sValue = result[0][0];
@@ -1393,49 +1479,12 @@ namespace http
 						}
 					}
 				}
-				else if (sensor == "wind")
-				{
-					root["status"] = "OK";
-					root["title"] = "Graph " + sensor + " " + srange;
-
-					result = m_sql.safe_query("SELECT Direction, Speed, Gust, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
-					if (!result.empty())
-					{
-						int ii = 0;
-						for (const auto& sd : result)
-						{
-							root["result"][ii]["d"] = sd[3].substr(0, 16);
-							root["result"][ii]["di"] = sd[0];
-
-							int intSpeed = atoi(sd[1].c_str());
-							int intGust = atoi(sd[2].c_str());
-
-							if (m_sql.m_windunit != WINDUNIT_Beaufort)
-							{
-								sprintf(szTmp, "%.1f", float(intSpeed) * m_sql.m_windscale);
-								root["result"][ii]["sp"] = szTmp;
-								sprintf(szTmp, "%.1f", float(intGust) * m_sql.m_windscale);
-								root["result"][ii]["gu"] = szTmp;
-							}
-							else
-							{
-								float windspeedms = float(intSpeed) * 0.1F;
-								float windgustms = float(intGust) * 0.1F;
-								sprintf(szTmp, "%d", MStoBeaufort(windspeedms));
-								root["result"][ii]["sp"] = szTmp;
-								sprintf(szTmp, "%d", MStoBeaufort(windgustms));
-								root["result"][ii]["gu"] = szTmp;
-							}
-							ii++;
-						}
-					}
-				}
 				else if (sensor == "winddir")
 				{
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Direction, Speed, Gust FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.safe_readonly_query("SELECT Direction, Speed, Gust FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 					if (!result.empty())
 					{
 						std::map<int, int> _directions;
@@ -1691,7 +1740,7 @@ namespace http
 					getNoon(weekbefore, tm2, tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday - 7); // We only want the date
 					sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
 
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_readonly_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -1709,12 +1758,12 @@ namespace http
 					// add today (have to calculate it)
 					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 					{
-						result = m_sql.safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
+						result = m_sql.safe_readonly_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
 							szDateEnd);
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_readonly_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					}
 					if (!result.empty())
 					{
@@ -1765,7 +1814,7 @@ namespace http
 						m_sql.GetPreferencesVar("P1DisplayType", P1DisplayType);
 						root["P1DisplayType"] = P1DisplayType;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6,Price,Date FROM %s WHERE (DeviceRowID==%" PRIu64
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value5,Value6,Price,Date FROM %s WHERE (DeviceRowID==%" PRIu64
 							" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
@@ -1812,7 +1861,7 @@ namespace http
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT Value, Price, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value, Price, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -1862,9 +1911,8 @@ namespace http
 						m_sql.GetPreferencesVar("P1DisplayType", P1DisplayType);
 						root["P1DisplayType"] = P1DisplayType;
 
-						result = m_sql.safe_query("SELECT MIN(Value1), MAX(Value1), MIN(Value2), MAX(Value2),MIN(Value5), MAX(Value5), MIN(Value6), MAX(Value6) FROM "
-							"MultiMeter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
-							idx, szDateStart);
+						result = GetRollupAggregates(CGraphRollups::TABLE_MULTIMETER, idx, szDateStart,
+							{ { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_MIN, 1 }, { RA_MAX, 1 }, { RA_MIN, 4 }, { RA_MAX, 4 }, { RA_MIN, 5 }, { RA_MAX, 5 } });
 						if (!result.empty())
 						{
 							std::vector<std::string> sd = result[0];
@@ -1931,7 +1979,7 @@ namespace http
 					else if (!bIsManagedCounter)
 					{
 						// get the first value of the day
-						result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateStart);
+						result = m_sql.safe_readonly_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateStart);
 						if (!result.empty())
 						{
 							std::vector<std::string> sd = result[0];
@@ -1941,7 +1989,7 @@ namespace http
 							int64_t total_real;
 
 							// get the last value of the day
-							result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx, szDateStart);
+							result = m_sql.safe_readonly_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx, szDateStart);
 							if (!result.empty())
 							{
 								std::vector<std::string> sd = result[0];
@@ -2072,7 +2120,7 @@ namespace http
 					root["title"] = "Graph " + sensor + " " + srange;
 
 					// Actual Year
-					result = m_sql.safe_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
+					result = m_sql.safe_readonly_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
 						" Humidity, Barometer, Temp_Avg, Date, SetPoint_Min,"
 						" SetPoint_Max, SetPoint_Avg "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
@@ -2190,13 +2238,8 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MIN(Temperature), MAX(Temperature),"
-						" MIN(Chill), MAX(Chill), AVG(Humidity),"
-						" AVG(Barometer), AVG(Temperature), MIN(SetPoint),"
-						" MAX(SetPoint), AVG(SetPoint) "
-						"FROM Temperature WHERE (DeviceRowID==%" PRIu64 ""
-						" AND Date>='%q')",
-						idx, szDateEnd);
+					result = GetRollupAggregates(CGraphRollups::TABLE_TEMPERATURE, idx, szDateEnd,
+						{ { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_MIN, 1 }, { RA_MAX, 1 }, { RA_AVG, 2 }, { RA_AVG, 3 }, { RA_AVG, 0 }, { RA_MIN, 4 }, { RA_MAX, 4 }, { RA_AVG, 4 } });
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -2295,7 +2338,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
+					result = m_sql.safe_readonly_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
 						" Humidity, Barometer, Temp_Avg, Date, SetPoint_Min,"
 						" SetPoint_Max, SetPoint_Avg "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
@@ -2425,7 +2468,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Percentage_Min, Percentage_Max, Percentage_Avg, Date FROM %s WHERE (DeviceRowID==%" PRIu64
+					result = m_sql.safe_readonly_query("SELECT Percentage_Min, Percentage_Max, Percentage_Avg, Date FROM %s WHERE (DeviceRowID==%" PRIu64
 						" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
@@ -2441,7 +2484,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MIN(Percentage), MAX(Percentage), AVG(Percentage) FROM Percentage WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx,
+					result = m_sql.safe_readonly_query("SELECT MIN(Percentage), MAX(Percentage), AVG(Percentage) FROM Percentage WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx,
 						szDateEnd);
 					if (!result.empty())
 					{
@@ -2466,7 +2509,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Speed_Min, Speed_Max, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_readonly_query("SELECT Speed_Min, Speed_Max, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -2480,7 +2523,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MIN(Speed), MAX(Speed) FROM Fan WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+					result = m_sql.safe_readonly_query("SELECT MIN(Speed), MAX(Speed) FROM Fan WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -2503,7 +2546,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
+					result = m_sql.safe_readonly_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
 						idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -2516,7 +2559,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+					result = m_sql.safe_readonly_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -2526,7 +2569,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
+					result = m_sql.safe_readonly_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
 						idx, szDateStartPrev, szDateEndPrev);
 					if (!result.empty())
 					{
@@ -2552,7 +2595,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_readonly_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -2570,12 +2613,12 @@ namespace http
 					// add today (have to calculate it)
 					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 					{
-						result = m_sql.safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
+						result = m_sql.safe_readonly_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
 							szDateEnd);
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_readonly_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					}
 					if (!result.empty())
 					{
@@ -2601,7 +2644,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_readonly_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 					if (!result.empty())
 					{
@@ -2628,7 +2671,7 @@ namespace http
 					// int nValue = 0;
 					std::string sValue; //Counter
 
-					result = m_sql.safe_query("SELECT sValue FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
+					result = m_sql.safe_readonly_query("SELECT sValue FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
 					if (!result.empty())
 					{
 						sValue = result[0][0];
@@ -2688,7 +2731,7 @@ namespace http
 						else
 						{
 							// Actual Year
-							result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6, Date,"
+							result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value5,Value6, Date,"
 								" Counter1, Counter2, Counter3, Counter4, Price "
 								"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 								" AND Date<='%q') ORDER BY Date ASC",
@@ -2780,7 +2823,7 @@ namespace http
 								}
 							}
 							// Previous Year
-							result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6, Date "
+							result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value5,Value6, Date "
 								"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 								dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 							if (!result.empty())
@@ -2830,7 +2873,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2843,7 +2886,7 @@ namespace http
 								ii++;
 							}
 						}
-						result = m_sql.safe_query("SELECT Value2,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value2,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 						if (!result.empty())
 						{
@@ -2871,7 +2914,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2906,7 +2949,7 @@ namespace http
 						}
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2973,7 +3016,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -3001,7 +3044,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -3028,7 +3071,7 @@ namespace http
 						}
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -3043,7 +3086,7 @@ namespace http
 					}
 					else if (dType == pTypeCURRENT)
 					{
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
 							" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
@@ -3127,7 +3170,7 @@ namespace http
 					}
 					else if (dType == pTypeCURRENTENERGY)
 					{
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
 							" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
@@ -3356,7 +3399,7 @@ namespace http
 
 							// Actual Year
 							result =
-								m_sql.safe_query("SELECT Value, Date, Counter, Price FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+								m_sql.safe_readonly_query("SELECT Value, Date, Counter, Price FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 									dbasetable.c_str(), idx, szDateStart, szDateEnd);
 							if (!result.empty())
 							{
@@ -3416,7 +3459,7 @@ namespace http
 							}
 							// Past Year
 							result =
-								m_sql.safe_query("SELECT Value, Date, Counter, Price FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+								m_sql.safe_readonly_query("SELECT Value, Date, Counter, Price FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 									dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 							if (!result.empty())
 							{
@@ -3485,18 +3528,9 @@ namespace http
 						m_sql.GetPreferencesVar("P1DisplayType", P1DisplayType);
 						root["P1DisplayType"] = P1DisplayType;
 
-						result = m_sql.safe_query("SELECT "
-							" MIN(Value1) as levering_laag_min,"
-							" MAX(Value1) as levering_laag_max,"
-							" MIN(Value2) as teruglevering_laag_min,"
-							" MAX(Value2) as teruglevering_laag_max,"
-							" MIN(Value5) as levering_normaal_min,"
-							" MAX(Value5) as levering_normaal_max,"
-							" MIN(Value6) as teruglevering_normaal_min,"
-							" MAX(Value6) as teruglevering_normaal_max"
-							" FROM MultiMeter WHERE (DeviceRowID=%" PRIu64 ""
-							" AND Date>='%q')",
-							idx, szDateEnd);
+						// levering laag, teruglevering laag, levering normaal, teruglevering normaal
+						result = GetRollupAggregates(CGraphRollups::TABLE_MULTIMETER, idx, szDateEnd,
+							{ { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_MIN, 1 }, { RA_MAX, 1 }, { RA_MIN, 4 }, { RA_MAX, 4 }, { RA_MIN, 5 }, { RA_MAX, 5 } });
 						bool bHaveDeliverd = false;
 						if (!result.empty())
 						{
@@ -3580,7 +3614,7 @@ namespace http
 					}
 					else if (dType == pTypeAirQuality)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value), AVG(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = GetRollupAggregates(CGraphRollups::TABLE_METER, idx, szDateEnd, { { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_AVG, 0 } });
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3593,7 +3627,7 @@ namespace http
 					else if (((dType == pTypeGeneral) && ((dSubType == sTypeSoilMoisture) || (dSubType == sTypeLeafWetness))) ||
 						((dType == pTypeRFXSensor) && ((dSubType == sTypeRFXSensorAD) || (dSubType == sTypeRFXSensorVolt))))
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = GetRollupAggregates(CGraphRollups::TABLE_METER, idx, szDateEnd, { { RA_MIN, 0 }, { RA_MAX, 0 } });
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3613,7 +3647,7 @@ namespace http
 							vdiv = 1000.0F;
 						}
 
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = GetRollupAggregates(CGraphRollups::TABLE_METER, idx, szDateEnd, { { RA_MIN, 0 }, { RA_MAX, 0 } });
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3654,7 +3688,7 @@ namespace http
 					}
 					else if (dType == pTypeLux)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value), AVG(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = GetRollupAggregates(CGraphRollups::TABLE_METER, idx, szDateEnd, { { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_AVG, 0 } });
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3666,7 +3700,7 @@ namespace http
 					}
 					else if (dType == pTypeWEIGHT)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = GetRollupAggregates(CGraphRollups::TABLE_METER, idx, szDateEnd, { { RA_MIN, 0 }, { RA_MAX, 0 } });
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3679,7 +3713,7 @@ namespace http
 					}
 					else if (dType == pTypeUsage)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = GetRollupAggregates(CGraphRollups::TABLE_METER, idx, szDateEnd, { { RA_MIN, 0 }, { RA_MAX, 0 } });
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3695,7 +3729,7 @@ namespace http
 						} else*/
 						{
 							// get the first value
-							result = m_sql.safe_query(
+							result = m_sql.safe_readonly_query(
 								//"SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
 								"SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateEnd);
 							if (!result.empty())
@@ -3706,7 +3740,7 @@ namespace http
 								int64_t total_real;
 
 								// Get the last value
-								result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
+								result = m_sql.safe_readonly_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
 									szDateEnd);
 								if (!result.empty())
 								{
@@ -3813,7 +3847,7 @@ namespace http
 
 					int ii = 0;
 
-					result = m_sql.safe_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
+					result = m_sql.safe_readonly_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
 						" Gust_Max, Date "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 						" AND Date<='%q') ORDER BY Date ASC",
@@ -3847,7 +3881,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed),"
+					result = m_sql.safe_readonly_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed),"
 						" MIN(Gust), MAX(Gust) "
 						"FROM Wind WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC",
 						idx, szDateEnd);
@@ -3879,7 +3913,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
+					result = m_sql.safe_readonly_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
 						" Gust_Max, Date "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 						" AND Date<='%q') ORDER BY Date ASC",
@@ -3971,7 +4005,7 @@ namespace http
 					if (sgraphtype == "1")
 					{
 						// Need to get all values of the end date so 23:59:59 is appended to the date string
-						result = m_sql.safe_query("SELECT Temperature, Chill, Humidity, Barometer,"
+						result = m_sql.safe_readonly_query("SELECT Temperature, Chill, Humidity, Barometer,"
 							" Date, DewPoint, SetPoint "
 							"FROM Temperature WHERE (DeviceRowID==%" PRIu64 ""
 							" AND Date>='%q' AND Date<='%q 23:59:59') ORDER BY Date ASC",
@@ -4039,7 +4073,7 @@ namespace http
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
+						result = m_sql.safe_readonly_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
 							" Humidity, Barometer, Date, DewPoint, Temp_Avg,"
 							" SetPoint_Min, SetPoint_Max, SetPoint_Avg "
 							"FROM Temperature_Calendar "
@@ -4119,12 +4153,8 @@ namespace http
 						}
 
 						// add today (have to calculate it)
-						result = m_sql.safe_query("SELECT MIN(Temperature), MAX(Temperature),"
-							" MIN(Chill), MAX(Chill), AVG(Humidity),"
-							" AVG(Barometer), MIN(DewPoint), AVG(Temperature),"
-							" MIN(SetPoint), MAX(SetPoint), AVG(SetPoint) "
-							"FROM Temperature WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
-							idx, szDateEnd.c_str());
+						result = GetRollupAggregates(CGraphRollups::TABLE_TEMPERATURE, idx, szDateEnd,
+							{ { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_MIN, 1 }, { RA_MAX, 1 }, { RA_AVG, 2 }, { RA_AVG, 3 }, { RA_MIN, 5 }, { RA_AVG, 0 }, { RA_MIN, 4 }, { RA_MAX, 4 }, { RA_AVG, 4 } });
 						if (!result.empty())
 						{
 							std::vector<std::string> sd = result[0];
@@ -4198,7 +4228,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ""
+					result = m_sql.safe_readonly_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ""
 						" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
 					int ii = 0;
@@ -4212,7 +4242,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
+					result = m_sql.safe_readonly_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -4227,7 +4257,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s "
+					result = m_sql.safe_readonly_query("SELECT Total, Rate, Date FROM %s "
 						"WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
 					int ii = 0;
@@ -4243,12 +4273,12 @@ namespace http
 					// add today (have to calculate it)
 					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 					{
-						result = m_sql.safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
+						result = m_sql.safe_readonly_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
 							szDateEnd.c_str());
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
+						result = m_sql.safe_readonly_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
 					}
 					if (!result.empty())
 					{
@@ -4288,7 +4318,7 @@ namespace http
 						m_sql.GetPreferencesVar("P1DisplayType", P1DisplayType);
 						root["P1DisplayType"] = P1DisplayType;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6, Date "
+						result = m_sql.safe_readonly_query("SELECT Value1,Value2,Value5,Value6, Date "
 							"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 							" AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
@@ -4323,7 +4353,7 @@ namespace http
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_readonly_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
 						if (!result.empty())
 						{
@@ -4360,11 +4390,8 @@ namespace http
 					// add today (have to calculate it)
 					if (dType == pTypeP1Power)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value1), MAX(Value1), MIN(Value2),"
-							" MAX(Value2),MIN(Value5), MAX(Value5),"
-							" MIN(Value6), MAX(Value6) "
-							"FROM MultiMeter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
-							idx, szDateEnd.c_str());
+						result = GetRollupAggregates(CGraphRollups::TABLE_MULTIMETER, idx, szDateEnd,
+							{ { RA_MIN, 0 }, { RA_MAX, 0 }, { RA_MIN, 1 }, { RA_MAX, 1 }, { RA_MIN, 4 }, { RA_MAX, 4 }, { RA_MIN, 5 }, { RA_MAX, 5 } });
 						bool bHaveDeliverd = false;
 						if (!result.empty())
 						{
@@ -4409,7 +4436,7 @@ namespace http
 					}
 					else if (!bIsManagedCounter)
 					{ // get the first value of the day
-						result = m_sql.safe_query(
+						result = m_sql.safe_readonly_query(
 							//"SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
 							"SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateEnd.c_str());
 						if (!result.empty())
@@ -4420,7 +4447,7 @@ namespace http
 							int64_t total_real;
 
 							// get the last value of the day
-							result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
+							result = m_sql.safe_readonly_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
 								szDateEnd.c_str());
 							if (!result.empty())
 							{
@@ -4465,7 +4492,7 @@ namespace http
 
 					int ii = 0;
 
-					result = m_sql.safe_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
+					result = m_sql.safe_readonly_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
 						" Gust_Max, Date "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 						" AND Date<='%q') ORDER BY Date ASC",
@@ -4499,7 +4526,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed), MIN(Gust), MAX(Gust) FROM Wind WHERE (DeviceRowID==%" PRIu64
+					result = m_sql.safe_readonly_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed), MIN(Gust), MAX(Gust) FROM Wind WHERE (DeviceRowID==%" PRIu64
 						" AND Date>='%q') ORDER BY Date ASC",
 						idx, szDateEnd.c_str());
 					if (!result.empty())
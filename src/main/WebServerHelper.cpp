@@ -153,6 +153,19 @@ namespace http {
 #endif
 		}
 
+		bool CWebServerHelper::GetDeviceFields(const uint64_t idx, CDeviceFields &fields)
+		{
+			if (plainServer_) { // assert
+				return plainServer_->GetDeviceFields(idx, fields);
+			}
+#ifdef WWW_ENABLE_SSL
+			if (secureServer_) {
+				return secureServer_->GetDeviceFields(idx, fields);
+			}
+#endif
+			return false;
+		}
+
 		void CWebServerHelper::ReloadCustomSwitchIcons()
 		{
 			for (auto &it : serverCollection)
@@ -27,6 +27,7 @@ namespace http {
 			void GetJSonDevices(Json::Value &root, const std::string &rused, const std::string &rfilter, const std::string &order, const std::string &rowid, const std::string &planID,
 					    const std::string &floorID, bool bDisplayHidden, bool bDisplayDisabled, bool bFetchFavorites, time_t LastUpdate, const std::string &username,
 					    const std::string &hardwareid = "");
+			bool GetDeviceFields(uint64_t idx, CDeviceFields &fields);
 			// called from CSQLHelper
 			void ReloadCustomSwitchIcons();
 			std::string our_listener_port;
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+#include "Helper.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <algorithm>
+
+namespace
+{
+	constexpr size_t MAX_THREADS = 8;
+
+	struct _tCategoryLimits
+	{
+		const char *szName;
+		size_t MaxRunning;
+		size_t MaxQueued;
+	};
+
+	// indexed by CWorkerPool::_eCategory
+	constexpr _tCategoryLimits CategoryLimits[CWorkerPool::CATEGORY_COUNT] = {
+		{ "shell", 4, 100 },
+		{ "email", 2, 50 },
+		{ "notification", 4, 200 },
+		{ "maintenance", 1, 4 },
+	};
+} // namespace
+
+CWorkerPool::CWorkerPool()
+	: m_maxThreads(MAX_THREADS)
+{
+	for (size_t ii = 0; ii < CATEGORY_COUNT; ii++)
+	{
+		m_categories[ii].szName = CategoryLimits[ii].szName;
+		m_categories[ii].MaxRunning = CategoryLimits[ii].MaxRunning;
+		m_categories[ii].MaxQueued = CategoryLimits[ii].MaxQueued;
+	}
+}
+
+CWorkerPool::~CWorkerPool()
+{
+	Stop(false, 0);
+}
+
+bool CWorkerPool::Post(const _eCategory category, std::function<void()> job, const int iPriority)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	_tCategory &cat = m_categories[category];
+	if ((m_bStopRequested) || (cat.Jobs.size() >= cat.MaxQueued))
+	{
+		cat.Rejected++;
+		m_metrics.AddCounter("oikomaticz_worker_rejected_total", CMetrics::Label("category", cat.szName));
+		_log.Log(LOG_ERROR, "WorkerPool: %s job rejected (%s)", cat.szName, (m_bStopRequested) ? "shutting down" : "queue full");
+		return false;
+	}
+	cat.Jobs.push_back({ iPriority, m_sequence++, std::move(job) });
+	std::push_heap(cat.Jobs.begin(), cat.Jobs.end());
+
+	// jobs that could start now, the others wait for a slot of their category
+	size_t nRunnable = 0;
+	for (const auto &itt : m_categories)
+		nRunnable += std::min(itt.Jobs.size(), itt.MaxRunning - std::min(itt.Running, itt.MaxRunning));
+	if ((m_liveThreads - m_busyThreads < nRunnable) && (m_threads.size() < m_maxThreads))
+	{
+		m_liveThreads++;
+		m_threads.push_back(std::make_shared<std::thread>([this] { Do_Work(); }));
+		SetThreadName(m_threads.back()->native_handle(), "WorkerPool");
+	}
+	m_cond.notify_one();
+	return true;
+}
+
+void CWorkerPool::Stop(const bool bDrain, const int iTimeoutMs)
+{
+	std::vector<std::shared_ptr<std::thread>> threads;
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		m_bStopRequested = true;
+		if (!bDrain)
+		{
+			for (auto &cat : m_categories)
+				cat.Jobs.clear();
+		}
+		m_cond.notify_all();
+
+		if (!m_cond.wait_for(l, std::chrono::milliseconds(iTimeoutMs), [this] { return m_liveThreads == 0; }))
+		{
+			size_t nQueued = GetQueuedCount();
+			for (auto &cat : m_categories)
+				cat.Jobs.clear();
+			m_cond.notify_all();
+			_log.Log(LOG_ERROR, "WorkerPool: %d queued jobs dropped, waiting for %d running jobs to finish", static_cast<int>(nQueued), static_cast<int>(m_busyThreads));
+		}
+		// the running jobs use the pool and the database, they have to finish before these are destroyed
+		threads.swap(m_threads);
+	}
+	for (auto &thread : threads)
+		thread->join();
+}
+
+std::vector<CWorkerPool::_tCategoryStatus> CWorkerPool::GetStatus()
+{
+	std::vector<_tCategoryStatus> status;
+	std::lock_guard<std::mutex> l(m_mutex);
+	for (const auto &cat : m_categories)
+		status.push_back({ cat.szName, cat.Running, cat.Jobs.size(), cat.Rejected });
+	return status;
+}
+
+size_t CWorkerPool::GetThreadCount()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return m_liveThreads;
+}
+
+size_t CWorkerPool::GetQueuedCount()
+{
+	size_t nQueued = 0;
+	for (const auto &cat : m_categories)
+		nQueued += cat.Jobs.size();
+	return nQueued;
+}
+
+// The category of the job to run next, the one with the highest priority (and the oldest) that is below its limit
+CWorkerPool::_tCategory *CWorkerPool::GetNextCategory()
+{
+	_tCategory *pNext = nullptr;
+	for (auto &cat : m_categories)
+	{
+		if ((cat.Jobs.empty()) || (cat.Running >= cat.MaxRunning))
+			continue;
+		if ((pNext == nullptr) || (pNext->Jobs.front() < cat.Jobs.front()))
+			pNext = &cat;
+	}
+	return pNext;
+}
+
+void CWorkerPool::Do_Work()
+{
+	std::unique_lock<std::mutex> l(m_mutex);
+	while (true)
+	{
+		_tCategory *pCat = GetNextCategory();
+		if (pCat == nullptr)
+		{
+			if ((m_bStopRequested) && (GetQueuedCount() == 0))
+				break;
+			m_cond.wait(l);
+			continue;
+		}
+
+		std::pop_heap(pCat->Jobs.begin(), pCat->Jobs.end());
+		_tJob job = std::move(pCat->Jobs.back());
+		pCat->Jobs.pop_back();
+		pCat->Running++;
+		m_busyThreads++;
+		l.unlock();
+		try
+		{
+			job.Job();
+		}
+		catch (const std::exception &e)
+		{
+			_log.Log(LOG_ERROR, "WorkerPool: Exception in %s job: %s", pCat->szName, e.what());
+		}
+		catch (...)
+		{
+			_log.Log(LOG_ERROR, "WorkerPool: Exception in %s job", pCat->szName);
+		}
+		l.lock();
+		pCat->Running--;
+		m_busyThreads--;
+		// a slot of the category is free again
+		m_cond.notify_all();
+	}
+	m_liveThreads--;
+	m_cond.notify_all();
+}
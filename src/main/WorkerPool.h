@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A bounded set of worker threads for the blocking side jobs (shell commands, emails, notifications, backups).
+// Every category has a limit on the jobs it may run at the same time and on the jobs it may queue,
+// a job that does not fit in the queue is rejected. Queued jobs with a higher priority run first.
+class CWorkerPool
+{
+public:
+	enum _eCategory
+	{
+		CATEGORY_SHELL = 0,
+		CATEGORY_EMAIL,
+		CATEGORY_NOTIFICATION,
+		CATEGORY_MAINTENANCE,
+		CATEGORY_COUNT
+	};
+
+	struct _tCategoryStatus
+	{
+		const char *szName;
+		size_t Running;
+		size_t Queued;
+		uint64_t Rejected;
+	};
+
+	CWorkerPool();
+	~CWorkerPool();
+
+	// false when the job was rejected, the pool starts its threads when needed
+	bool Post(_eCategory category, std::function<void()> job, int iPriority = 0);
+	// Runs (bDrain) or drops the queued jobs and waits for the running ones, new jobs are rejected.
+	// Queued jobs that did not start within iTimeoutMs are dropped.
+	void Stop(bool bDrain, int iTimeoutMs);
+
+	std::vector<_tCategoryStatus> GetStatus();
+	size_t GetThreadCount();
+
+private:
+	struct _tJob
+	{
+		int Priority;
+		uint64_t Sequence;
+		std::function<void()> Job;
+		// the heap keeps the highest priority on top, the oldest first within a priority
+		bool operator<(const _tJob &other) const
+		{
+			if (Priority != other.Priority)
+				return Priority < other.Priority;
+			return Sequence > other.Sequence;
+		}
+	};
+
+	struct _tCategory
+	{
+		const char *szName;
+		size_t MaxRunning;
+		size_t MaxQueued;
+		size_t Running = 0;
+		uint64_t Rejected = 0;
+		std::vector<_tJob> Jobs; // heap
+	};
+
+	void Do_Work();
+	_tCategory *GetNextCategory();
+	size_t GetQueuedCount();
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::array<_tCategory, CATEGORY_COUNT> m_categories;
+	std::vector<std::shared_ptr<std::thread>> m_threads;
+	size_t m_maxThreads;
+	size_t m_liveThreads = 0;
+	size_t m_busyThreads = 0; // running a job
+	uint64_t m_sequence = 0;
+	bool m_bStopRequested = false;
+};
+extern CWorkerPool m_workerpool;
@@ -14,6 +14,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <vector>
 
 template<typename Data>
 class concurrent_queue {
@@ -51,6 +52,14 @@ class concurrent_queue {
 		the_condition_variable.notify_one();
 	}
 
+	void push_all(std::vector<Data> const& data) {
+		std::unique_lock<std::mutex> lock(the_mutex);
+		for (const auto& item : data)
+			the_queue.push(item);
+		lock.unlock();
+		the_condition_variable.notify_one();
+	}
+
 	bool empty() const {
 		std::unique_lock<std::mutex> lock(the_mutex);
 		return the_queue.empty();
@@ -909,13 +909,79 @@ void CdzVents::SetGlobalVariables(lua_State* lua_state, const bool reasonTime, c
 	luaTable.Publish();
 }
 
-void CdzVents::ExportHardwareData(CLuaTable& luaTable, int& index, const std::vector<CEventSystem::_tEventQueue>& items)
+void CdzVents::ExportHardwareData(lua_State* /*lua_state*/, const int /*dataIndex*/, int& /*index*/, const std::vector<CEventSystem::_tEventQueue>& /*items*/)
 {
 	;// to be implemented when hardware notification support is added
 }
 
+// Pushes the registry table that holds the entries exported by the previous run in this lua_State, followed by
+// an empty table for the entries of this run. Returns the index of the first, the second is at index + 1
+int CdzVents::PushExportCache(lua_State* lua_state, const char* name)
+{
+	if (lua_getfield(lua_state, LUA_REGISTRYINDEX, name) != LUA_TTABLE)
+	{
+		lua_pop(lua_state, 1);
+		lua_newtable(lua_state);
+	}
+	int cacheIndex = lua_gettop(lua_state);
+	lua_newtable(lua_state);
+	return cacheIndex;
+}
+
+// Replaces the registry table by the one with the entries of this run, so entries of deleted items are dropped
+void CdzVents::StoreExportCache(lua_State* lua_state, const int cacheIndex, const char* name)
+{
+	lua_pushvalue(lua_state, cacheIndex + 1);
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, name);
+	lua_settop(lua_state, cacheIndex - 1);
+}
+
+bool CdzVents::PushCachedEntry(lua_State* lua_state, const int cacheIndex, const uint64_t ID, const bool bUseCache)
+{
+	if (!bUseCache)
+		return false;
+	if (lua_rawgeti(lua_state, cacheIndex, (lua_Integer)ID) == LUA_TTABLE)
+		return true;
+	lua_pop(lua_state, 1);
+	return false;
+}
+
+// Keeps the entry on top of the stack for the next run and replaces it with a copy, scripts are free
+// to change their domoticzData without changing what the next run gets
+void CdzVents::KeepExportEntry(lua_State* lua_state, const int cacheIndex, const uint64_t ID)
+{
+	lua_pushvalue(lua_state, -1);
+	lua_rawseti(lua_state, cacheIndex + 1, (lua_Integer)ID);
+	PushTableCopy(lua_state, lua_gettop(lua_state));
+	lua_remove(lua_state, -2);
+}
+
+void CdzVents::PushTableCopy(lua_State* lua_state, const int tIndex)
+{
+	lua_newtable(lua_state);
+	lua_pushnil(lua_state);
+	while (lua_next(lua_state, tIndex) != 0)
+	{
+		if (lua_type(lua_state, -1) == LUA_TTABLE)
+		{
+			PushTableCopy(lua_state, lua_gettop(lua_state));
+			lua_remove(lua_state, -2);
+		}
+		lua_pushvalue(lua_state, -2);
+		lua_insert(lua_state, -2);
+		lua_rawset(lua_state, -4); // leaves the key for lua_next
+	}
+}
+
+// Entries for devices, scenes/groups and variables that did not change since the previous export
+// from the same lua_State are copied from its registry, only their changed/timedOut flags are refreshed
 void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<CEventSystem::_tEventQueue>& items)
 {
+	uint64_t exportVersion = m_mainworker.m_eventsystem.m_stateVersion;
+	lua_getfield(lua_state, LUA_REGISTRYINDEX, "dzVents_exportVersion");
+	uint64_t lastExportVersion = (uint64_t)lua_tointeger(lua_state, -1);
+	lua_pop(lua_state, 1);
+
 	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_mainworker.m_eventsystem.m_devicestatesMutex);
 	int index = 1;
 	time_t now = mytime(nullptr);
@@ -929,42 +995,54 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 	struct tm ntime;
 	time_t checktime;
 
-	CLuaTable luaTable(lua_state, "domoticzData");
+	lua_createtable(lua_state, (int)m_mainworker.m_eventsystem.m_devicestates.size(), 0);
+	int dataIndex = lua_gettop(lua_state);
+	int cacheIndex = PushExportCache(lua_state, "dzVents_devices");
 
 	// First export all the devices.
 	for (const auto& state : m_mainworker.m_eventsystem.m_devicestates)
 	{
-		CEventSystem::_tDeviceStatus sitem = state.second;
-		const char* dev_type = RFX_Type_Desc(sitem.devType, 1);
-		const char* sub_type = RFX_Type_SubType_Desc(sitem.devType, sitem.subType);
+		if (state.second.ID == 0)
+			continue;
 
-		bool triggerDevice = false;
+		const CEventSystem::_tEventQueue* pTrigger = nullptr;
 		for (const auto& item : items)
 		{
-			if (sitem.ID > 0 && sitem.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
-			{
-				triggerDevice = true;
-				sitem.lastUpdate = item.lastUpdate;
-				sitem.lastLevel = item.lastLevel;
-				sitem.sValue = item.sValue;
-				sitem.nValueWording = item.nValueWording;
-				sitem.nValue = item.nValue;
-				if (!item.JsonMapString.empty())
-					sitem.JsonMapString = item.JsonMapString;
-				if (!item.JsonMapFloat.empty())
-					sitem.JsonMapFloat = item.JsonMapFloat;
-				if (!item.JsonMapInt.empty())
-					sitem.JsonMapInt = item.JsonMapInt;
-				if (!item.JsonMapBool.empty())
-					sitem.JsonMapBool = item.JsonMapBool;
-			}
+			if (state.second.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
+				pTrigger = &item;
 		}
+		bool triggerDevice = (pTrigger != nullptr);
+
+		CEventSystem::_tDeviceStatus triggeritem;
+		if (triggerDevice)
+		{
+			triggeritem = state.second;
+			triggeritem.lastUpdate = pTrigger->lastUpdate;
+			triggeritem.lastLevel = pTrigger->lastLevel;
+			triggeritem.sValue = pTrigger->sValue;
+			triggeritem.nValueWording = pTrigger->nValueWording;
+			triggeritem.nValue = pTrigger->nValue;
+			if (!pTrigger->JsonMapString.empty())
+				triggeritem.JsonMapString = pTrigger->JsonMapString;
+			if (!pTrigger->JsonMapFloat.empty())
+				triggeritem.JsonMapFloat = pTrigger->JsonMapFloat;
+			if (!pTrigger->JsonMapInt.empty())
+				triggeritem.JsonMapInt = pTrigger->JsonMapInt;
+			if (!pTrigger->JsonMapBool.empty())
+				triggeritem.JsonMapBool = pTrigger->JsonMapBool;
+		}
+		const CEventSystem::_tDeviceStatus& sitem = (triggerDevice) ? triggeritem : state.second;
 
 		ParseSQLdatetime(checktime, ntime, sitem.lastUpdate, tm1.tm_isdst);
 		bool timed_out = (now - checktime >= SensorTimeOut * 60);
-		if (sitem.ID > 0)
+
+		// the entry of a triggering device holds the values of the trigger, so it is not cached
+		if (!PushCachedEntry(lua_state, cacheIndex, sitem.ID, (!triggerDevice) && (sitem.version <= lastExportVersion)))
 		{
-			luaTable.OpenSubTableEntry(index, 1, 14);
+			const char* dev_type = RFX_Type_Desc(sitem.devType, 1);
+			const char* sub_type = RFX_Type_SubType_Desc(sitem.devType, sitem.subType);
+
+			CLuaTable luaTable(lua_state, "device", 1, 14);
 
 			luaTable.AddString("name", sitem.deviceName);
 			luaTable.AddBool("protected", (sitem.protection == 1));
@@ -978,8 +1056,6 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 			luaTable.AddInteger("switchTypeValue", sitem.switchtype);
 			luaTable.AddString("lastUpdate", sitem.lastUpdate);
 			luaTable.AddInteger("lastLevel", sitem.lastLevel);
-			luaTable.AddBool("changed", triggerDevice);
-			luaTable.AddBool("timedOut", timed_out);
 
 			//get all svalues separate
 			std::vector<std::string> strarray;
@@ -1045,10 +1121,17 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 			}
 
 			luaTable.CloseSubTableEntry();
-			luaTable.CloseSubTableEntry();
-			index++;
+			luaTable.Push();
 		}
+		if (!triggerDevice)
+			KeepExportEntry(lua_state, cacheIndex, sitem.ID);
+		lua_pushboolean(lua_state, triggerDevice);
+		lua_setfield(lua_state, -2, "changed");
+		lua_pushboolean(lua_state, timed_out);
+		lua_setfield(lua_state, -2, "timedOut");
+		lua_rawseti(lua_state, dataIndex, index++);
 	}
+	StoreExportCache(lua_state, cacheIndex, "dzVents_devices");
 
 	devicestatesMutexLock.unlock();
 
@@ -1057,114 +1140,135 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 
 	std::vector<std::vector<std::string> > result;
 
+	cacheIndex = PushExportCache(lua_state, "dzVents_scenesgroups");
 	for (const auto& scene : m_mainworker.m_eventsystem.m_scenesgroups)
 	{
-		CEventSystem::_tScenesGroups sgitem = scene.second;
-		bool triggerScene = false;
+		const CEventSystem::_tEventQueue* pTrigger = nullptr;
 		for (const auto& item : items)
 		{
-			if (sgitem.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_SCENEGROUP)
+			if (scene.second.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_SCENEGROUP)
+				pTrigger = &item;
+		}
+		bool triggerScene = (pTrigger != nullptr);
+
+		if (!PushCachedEntry(lua_state, cacheIndex, scene.second.ID, (!triggerScene) && (scene.second.version <= lastExportVersion)))
+		{
+			CEventSystem::_tScenesGroups sgitem = scene.second;
+			if (triggerScene)
 			{
-				triggerScene = true;
-				sgitem.lastUpdate = item.lastUpdate;
-				sgitem.scenesgroupValue = item.sValue;
+				sgitem.lastUpdate = pTrigger->lastUpdate;
+				sgitem.scenesgroupValue = pTrigger->sValue;
 			}
-		}
 
-		luaTable.OpenSubTableEntry(index, 1, 7);
+			CLuaTable luaTable(lua_state, "scenegroup", 1, 7);
 
-		luaTable.AddString("name", sgitem.scenesgroupName);
-		luaTable.AddInteger("id", sgitem.ID);
-		luaTable.AddString("description", sgitem.description);
-		luaTable.AddString("baseType", (sgitem.scenesgroupType == 0) ? "scene" : "group");
-		luaTable.AddBool("protected", (lua_Number)sgitem.protection == 1);
-		luaTable.AddString("lastUpdate", sgitem.lastUpdate);
-		luaTable.AddBool("changed", triggerScene);
+			luaTable.AddString("name", sgitem.scenesgroupName);
+			luaTable.AddInteger("id", sgitem.ID);
+			luaTable.AddString("description", sgitem.description);
+			luaTable.AddString("baseType", (sgitem.scenesgroupType == 0) ? "scene" : "group");
+			luaTable.AddBool("protected", (lua_Number)sgitem.protection == 1);
+			luaTable.AddString("lastUpdate", sgitem.lastUpdate);
 
-		luaTable.OpenSubTableEntry("data", 0, 0);
+			luaTable.OpenSubTableEntry("data", 0, 0);
 
-		luaTable.AddString("_state", sgitem.scenesgroupValue);
+			luaTable.AddString("_state", sgitem.scenesgroupValue);
 
-		luaTable.CloseSubTableEntry();
+			luaTable.CloseSubTableEntry();
 
-		luaTable.OpenSubTableEntry("deviceIDs", 0, 0);
-		if (!sgitem.memberID.empty())
-		{
-			int index = 1;
-			for (const auto& id : sgitem.memberID)
+			luaTable.OpenSubTableEntry("deviceIDs", 0, 0);
+			if (!sgitem.memberID.empty())
 			{
-				luaTable.AddInteger(index, id);
-				index++;
+				int index = 1;
+				for (const auto& id : sgitem.memberID)
+				{
+					luaTable.AddInteger(index, id);
+					index++;
+				}
 			}
-		}
 
-		luaTable.CloseSubTableEntry(); // device table
-		luaTable.CloseSubTableEntry(); // end entry
-		index++;
+			luaTable.CloseSubTableEntry(); // device table
+			luaTable.Push();
+		}
+		if (!triggerScene)
+			KeepExportEntry(lua_state, cacheIndex, scene.second.ID);
+		lua_pushboolean(lua_state, triggerScene);
+		lua_setfield(lua_state, -2, "changed");
+		lua_rawseti(lua_state, dataIndex, index++);
 	}
+	StoreExportCache(lua_state, cacheIndex, "dzVents_scenesgroups");
 	scenesgroupsMutexLock.unlock();
 
 	std::string vtype;
 
 	// Now do the user variables.
 	boost::shared_lock<boost::shared_mutex> uservariablesMutexLock(m_mainworker.m_eventsystem.m_uservariablesMutex);
+	cacheIndex = PushExportCache(lua_state, "dzVents_uservariables");
 	for (const auto& var : m_mainworker.m_eventsystem.m_uservariables)
 	{
-		CEventSystem::_tUserVariable uvitem = var.second;
-		bool triggerVar = false;
+		const CEventSystem::_tEventQueue* pTrigger = nullptr;
 		for (const auto& item : items)
 		{
-			if (uvitem.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_USERVARIABLE)
+			if (var.second.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_USERVARIABLE)
+				pTrigger = &item;
+		}
+		bool triggerVar = (pTrigger != nullptr);
+
+		if (!PushCachedEntry(lua_state, cacheIndex, var.second.ID, (!triggerVar) && (var.second.version <= lastExportVersion)))
+		{
+			CEventSystem::_tUserVariable uvitem = var.second;
+			if (triggerVar)
 			{
-				triggerVar = true;
-				uvitem.lastUpdate = item.lastUpdate;
-				uvitem.variableValue = item.sValue;
+				uvitem.lastUpdate = pTrigger->lastUpdate;
+				uvitem.variableValue = pTrigger->sValue;
 			}
-		}
 
-		luaTable.OpenSubTableEntry(index, 1, 5);
+			CLuaTable luaTable(lua_state, "uservariable", 1, 5);
 
-		luaTable.AddString("name", uvitem.variableName);
-		luaTable.AddInteger("id", uvitem.ID);
-		luaTable.AddString("baseType", "uservariable");
-		luaTable.AddString("lastUpdate", uvitem.lastUpdate);
-		luaTable.AddBool("changed", triggerVar);
+			luaTable.AddString("name", uvitem.variableName);
+			luaTable.AddInteger("id", uvitem.ID);
+			luaTable.AddString("baseType", "uservariable");
+			luaTable.AddString("lastUpdate", uvitem.lastUpdate);
 
-		luaTable.OpenSubTableEntry("data", 0, 0);
+			luaTable.OpenSubTableEntry("data", 0, 0);
 
-		if (uvitem.variableType == 0)
-		{
-			luaTable.AddInteger("value", atoi(uvitem.variableValue.c_str()));
-			vtype = "integer";
-		}
-		else if (uvitem.variableType == 1)
-		{
-			//Float
-			luaTable.AddNumber("value", atof(uvitem.variableValue.c_str()));
-			vtype = "float";
-		}
-		else
-		{
-			//String,Date,Time
-			luaTable.AddString("value", uvitem.variableValue);
-			if (uvitem.variableType == 2)
-				vtype = "string";
-			else if (uvitem.variableType == 3)
-				vtype = "date";
-			else if (uvitem.variableType == 4)
-				vtype = "time";
+			if (uvitem.variableType == 0)
+			{
+				luaTable.AddInteger("value", atoi(uvitem.variableValue.c_str()));
+				vtype = "integer";
+			}
+			else if (uvitem.variableType == 1)
+			{
+				//Float
+				luaTable.AddNumber("value", atof(uvitem.variableValue.c_str()));
+				vtype = "float";
+			}
 			else
-				vtype = "unknown";
-		}
-
-		luaTable.CloseSubTableEntry(); // data table
-
-		luaTable.AddString("variableType", vtype);
+			{
+				//String,Date,Time
+				luaTable.AddString("value", uvitem.variableValue);
+				if (uvitem.variableType == 2)
+					vtype = "string";
+				else if (uvitem.variableType == 3)
+					vtype = "date";
+				else if (uvitem.variableType == 4)
+					vtype = "time";
+				else
+					vtype = "unknown";
+			}
 
-		luaTable.CloseSubTableEntry(); // end entry
+			luaTable.CloseSubTableEntry(); // data table
 
-		index++;
+			luaTable.AddString("variableType", vtype);
+			luaTable.Push();
+		}
+		if (!triggerVar)
+			KeepExportEntry(lua_state, cacheIndex, var.second.ID);
+		lua_pushboolean(lua_state, triggerVar);
+		lua_setfield(lua_state, -2, "changed");
+		lua_rawseti(lua_state, dataIndex, index++);
 	}
+	StoreExportCache(lua_state, cacheIndex, "dzVents_uservariables");
+	uservariablesMutexLock.unlock();
 
 	// Now do the cameras.
 	result = m_sql.safe_query("SELECT ID, Name FROM Cameras where enabled = '1' ORDER BY ID ASC");
@@ -1172,13 +1276,12 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 	{
 		for (const auto& sd : result)
 		{
-			luaTable.OpenSubTableEntry(index, 1, 3);
+			CLuaTable luaTable(lua_state, "camera", 1, 3);
 			luaTable.AddString("name", sd[1]);
 			luaTable.AddInteger("id", atoi(sd[0].c_str()));
 			luaTable.AddString("baseType", "camera");
-			luaTable.CloseSubTableEntry(); // end entry
-
-			index++;
+			luaTable.Push();
+			lua_rawseti(lua_state, dataIndex, index++);
 		}
 	}
 
@@ -1192,7 +1295,7 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 		{
 			HardwareTypeVal = atoi(sd[2].c_str());
 
-			luaTable.OpenSubTableEntry(index, 1, 6);
+			CLuaTable luaTable(lua_state, "hardware", 1, 6);
 			luaTable.AddString("name", sd[1]);
 			luaTable.AddInteger("id", atoi(sd[0].c_str()));
 			luaTable.AddInteger("typeValue", HardwareTypeVal);
@@ -1207,13 +1310,15 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 				luaTable.AddString("typeName", "Python plugin");
 				luaTable.AddBool("isPythonPlugin", true);
 			}
-			luaTable.CloseSubTableEntry(); // end entry
-
-			index++;
+			luaTable.Push();
+			lua_rawseti(lua_state, dataIndex, index++);
 		}
 	}
 
-	ExportHardwareData(luaTable, index, items);
+	ExportHardwareData(lua_state, dataIndex, index, items);
 
-	luaTable.Publish();
+	lua_setglobal(lua_state, "domoticzData");
+
+	lua_pushinteger(lua_state, (lua_Integer)exportVersion);
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, "dzVents_exportVersion");
 }
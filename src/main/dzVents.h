@@ -47,8 +47,13 @@ class CdzVents
 	bool CancelItem(lua_State* lua_state, const std::vector<_tLuaTableValues>& vLuaTable, const std::string& eventName);
 	bool TriggerIFTTT(lua_State* lua_state, const std::vector<_tLuaTableValues>& vLuaTable);
 	bool TriggerCustomEvent(lua_State* lua_state, const std::vector<_tLuaTableValues>& vLuaTable);
-	void ExportHardwareData(CLuaTable& luaTable, int& index, const std::vector<CEventSystem::_tEventQueue>& items);
+	void ExportHardwareData(lua_State* lua_state, int dataIndex, int& index, const std::vector<CEventSystem::_tEventQueue>& items);
 	void ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<CEventSystem::_tEventQueue>& items);
+	int PushExportCache(lua_State* lua_state, const char* name);
+	void StoreExportCache(lua_State* lua_state, int cacheIndex, const char* name);
+	bool PushCachedEntry(lua_State* lua_state, int cacheIndex, uint64_t ID, bool bUseCache);
+	void KeepExportEntry(lua_State* lua_state, int cacheIndex, uint64_t ID);
+	void PushTableCopy(lua_State* lua_state, int tIndex);
 	void IterateTable(lua_State* lua_state, const int tIndex, std::vector<_tLuaTableValues>& vLuaTable);
 	void SetGlobalVariables(lua_State* lua_state, const bool reasonTime, const int secStatus);
 	void ProcessHttpResponse(lua_State* lua_state, const std::vector<CEventSystem::_tEventQueue>& items);
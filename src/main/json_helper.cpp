@@ -52,3 +52,93 @@ bool JSonRenameKey(Json::Value& value, const std::string& srcKey, const std::str
 	value.removeMember(srcKey);
 	return true;
 }
+
+void CJSonStreamWriter::Separate()
+{
+	if (m_bAfterKey)
+	{
+		m_bAfterKey = false;
+		return;
+	}
+	if (m_first.empty())
+		return;
+	if (!m_first.back())
+		m_buffer += ',';
+	m_first.back() = false;
+}
+
+void CJSonStreamWriter::BeginObject()
+{
+	Separate();
+	m_buffer += '{';
+	m_first.push_back(true);
+}
+
+void CJSonStreamWriter::EndObject()
+{
+	m_buffer += '}';
+	m_first.pop_back();
+}
+
+void CJSonStreamWriter::BeginArray()
+{
+	Separate();
+	m_buffer += '[';
+	m_first.push_back(true);
+}
+
+void CJSonStreamWriter::EndArray()
+{
+	m_buffer += ']';
+	m_first.pop_back();
+}
+
+void CJSonStreamWriter::Key(const char* szKey)
+{
+	Separate();
+	m_buffer += Json::valueToQuotedString(szKey);
+	m_buffer += ':';
+	m_bAfterKey = true;
+}
+
+void CJSonStreamWriter::Value(const std::string& sValue)
+{
+	Value(sValue.c_str());
+}
+
+void CJSonStreamWriter::Value(const char* szValue)
+{
+	Separate();
+	m_buffer += Json::valueToQuotedString(szValue);
+}
+
+void CJSonStreamWriter::Value(const int nValue)
+{
+	Separate();
+	m_buffer += std::to_string(nValue);
+}
+
+void CJSonStreamWriter::Value(const double dValue)
+{
+	Separate();
+	m_buffer += Json::valueToString(dValue);
+}
+
+void CJSonStreamWriter::Value(const bool bValue)
+{
+	Separate();
+	m_buffer += bValue ? "true" : "false";
+}
+
+void CJSonStreamWriter::Value(const Json::Value& value)
+{
+	Separate();
+	m_buffer += JSonToRawString(value);
+}
+
+std::string CJSonStreamWriter::Take()
+{
+	std::string result;
+	result.swap(m_buffer);
+	return result;
+}
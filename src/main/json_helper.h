@@ -7,3 +7,42 @@ bool ParseJSonStrict(const std::string& inStr, Json::Value& json_output, std::st
 std::string JSonToFormatString(const Json::Value& json_input);
 std::string JSonToRawString(const Json::Value& json_input);
 bool JSonRenameKey(Json::Value& value, const std::string& srcKey, const std::string& destKey);
+
+// Writes compact JSON piece by piece, so a large reply can be sent while it is produced.
+// Take() hands over what was written so far.
+class CJSonStreamWriter
+{
+public:
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+	// Name of the next member of the current object
+	void Key(const char* szKey);
+	void Value(const std::string& sValue);
+	void Value(const char* szValue);
+	void Value(int nValue);
+	void Value(double dValue);
+	void Value(bool bValue);
+	void Value(const Json::Value& value);
+
+	template <typename T> void Member(const char* szKey, const T& value)
+	{
+		Key(szKey);
+		Value(value);
+	}
+
+	size_t Size() const
+	{
+		return m_buffer.size();
+	}
+	std::string Take();
+
+private:
+	void Separate();
+
+	std::string m_buffer;
+	// per open object/array: true until its first element is written
+	std::vector<bool> m_first;
+	bool m_bAfterKey = false;
+};
@@ -3,6 +3,8 @@
 #include "Helper.h"
 #include "SunRiseSet.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "WorkerPool.h"
 #include "WebServerHelper.h"
 #include "SQLHelper.h"
 #include "push/FibaroPush.h"
@@ -242,6 +244,9 @@ MainWorker::MainWorker()
 
 	m_rxMessageIdx = 1;
 	m_bForceLogNotificationCheck = false;
+
+	// One RX lane keeps the messages of all hardware in the order they arrived, see SetRxLanes()
+	m_rxLanes.push_back(std::make_unique<_tRxLane>());
 }
 
 MainWorker::~MainWorker()
@@ -249,6 +254,23 @@ MainWorker::~MainWorker()
 	Stop();
 }
 
+void MainWorker::SetRxLanes(const size_t nLanes)
+{
+	// Only before Start(), the lane threads are started there
+	if ((nLanes < 1) || (m_rxLanes[0]->thread))
+		return;
+	if (nLanes > 16)
+	{
+		_log.Log(LOG_ERROR, "Invalid number of RX lanes (%d), keeping one lane", static_cast<int>(nLanes));
+		return;
+	}
+	m_rxLanes.clear();
+	for (size_t ii = 0; ii < nLanes; ii++)
+		m_rxLanes.push_back(std::make_unique<_tRxLane>());
+	if (nLanes > 1)
+		_log.Log(LOG_STATUS, "Decoding received messages on %d lanes, messages of different hardware are no longer handled in the order they arrived", static_cast<int>(nLanes));
+}
+
 void MainWorker::AddAllDomoticzHardware()
 {
 	//Add Hardware devices
@@ -1193,9 +1215,12 @@ bool MainWorker::Start()
 
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "MainWorker");
-	m_rxMessageThread = std::make_shared<std::thread>([this] { Do_Work_On_Rx_Messages(); });
-	SetThreadName(m_rxMessageThread->native_handle(), "MainWorkerRxMsg");
-	return (m_thread != nullptr) && (m_rxMessageThread != nullptr);
+	for (size_t ii = 0; ii < m_rxLanes.size(); ii++)
+	{
+		m_rxLanes[ii]->thread = std::make_shared<std::thread>([this, ii] { Do_Work_On_Rx_Messages(ii); });
+		SetThreadName(m_rxLanes[ii]->thread->native_handle(), std_format("MainWorkerRx%d", static_cast<int>(ii)).c_str());
+	}
+	return (m_thread != nullptr);
 }
 
 bool MainWorker::Stop()
@@ -1205,12 +1230,18 @@ bool MainWorker::Stop()
 		m_notificationsystem.NotifyWait(Notification::DZ_STOP, Notification::STATUS_INFO); // blocking call
 	}
 
-	if (m_rxMessageThread) {
-		// Stop RxMessage thread before hardware to avoid NULL pointer exception
+	if ((!m_rxLanes.empty()) && (m_rxLanes[0]->thread)) {
+		// Stop RxMessage threads before hardware to avoid NULL pointer exception
 		m_TaskRXMessage.RequestStop();
 		UnlockRxMessageQueue();
-		m_rxMessageThread->join();
-		m_rxMessageThread.reset();
+		for (auto& lane : m_rxLanes)
+		{
+			if (lane->thread)
+			{
+				lane->thread->join();
+				lane->thread.reset();
+			}
+		}
 	}
 	if (m_thread)
 	{
@@ -1232,6 +1263,9 @@ bool MainWorker::Stop()
 
 		//    m_cameras.StopCameraGrabber();
 
+		// finish the queued shell commands, emails and notifications
+		m_workerpool.Stop(true, 5000);
+
 		HTTPClient::Cleanup();
 
 		RequestStop();
@@ -1315,8 +1349,9 @@ void MainWorker::HandleAutomaticBackups()
 			sTmp << "backup-hour-" << std::setw(2) << std::setfill('0') << hour << "-" << szInstanceName << ".db";
 
 			backupInfo["type"] = "Hour";
-			backupInfo["location"] = sbackup_DirH + sTmp.str();
-			if (m_sql.BackupDatabase(backupInfo["location"].asString())) {
+			backupInfo["location"] = sbackup_DirH + sTmp.str() + ".gz";
+			if (m_sql.BackupDatabase(backupInfo["location"].asString(), true)) {
+				std::remove((sbackup_DirH + sTmp.str()).c_str()); // uncompressed backup of an older version
 				m_sql.SetLastBackupNo(backupInfo["type"].asString().c_str(), hour);
 
 				backupStatus = Notification::STATUS_OK;
@@ -1344,8 +1379,9 @@ void MainWorker::HandleAutomaticBackups()
 			sTmp << "backup-day-" << std::setw(2) << std::setfill('0') << day << "-" << szInstanceName << ".db";
 
 			backupInfo["type"] = "Day";
-			backupInfo["location"] = sbackup_DirD + sTmp.str();
-			if (m_sql.BackupDatabase(backupInfo["location"].asString())) {
+			backupInfo["location"] = sbackup_DirD + sTmp.str() + ".gz";
+			if (m_sql.BackupDatabase(backupInfo["location"].asString(), true)) {
+				std::remove((sbackup_DirD + sTmp.str()).c_str()); // uncompressed backup of an older version
 				m_sql.SetLastBackupNo(backupInfo["type"].asString().c_str(), day);
 				backupStatus = Notification::STATUS_OK;
 			}
@@ -1371,8 +1407,9 @@ void MainWorker::HandleAutomaticBackups()
 			sTmp << "backup-month-" << std::setw(2) << std::setfill('0') << month + 1 << "-" << szInstanceName << ".db";
 
 			backupInfo["type"] = "Month";
-			backupInfo["location"] = sbackup_DirM + sTmp.str();
-			if (m_sql.BackupDatabase(backupInfo["location"].asString())) {
+			backupInfo["location"] = sbackup_DirM + sTmp.str() + ".gz";
+			if (m_sql.BackupDatabase(backupInfo["location"].asString(), true)) {
+				std::remove((sbackup_DirM + sTmp.str()).c_str()); // uncompressed backup of an older version
 				m_sql.SetLastBackupNo(backupInfo["type"].asString().c_str(), month);
 				backupStatus = Notification::STATUS_OK;
 			}
@@ -1596,6 +1633,12 @@ void MainWorker::Do_Work()
 							_ScheduleLastDayTime = atime;
 							if (!bNoCleanupDev)
 								m_sql.ScheduleDay();
+							// the backups no longer vacuum and optimize the database, do it once a week
+							if (ltime.tm_wday == 0)
+								m_workerpool.Post(CWorkerPool::CATEGORY_MAINTENANCE, [] {
+									m_sql.VacuumDatabase();
+									m_sql.OptimizeDatabase();
+								});
 						}
 					}
 #ifdef WITH_OPENZWAVE
@@ -1613,7 +1656,8 @@ void MainWorker::Do_Work()
 						}
 					}
 #endif
-					HandleAutomaticBackups();
+					// the backups can take minutes on a large database
+					m_workerpool.Post(CWorkerPool::CATEGORY_MAINTENANCE, [this] { HandleAutomaticBackups(); });
 				}
 			}
 		}
@@ -1722,30 +1766,47 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 		return;
 	}
 
-	// Build queue item
-	_tRxQueueItem rxMessage;
+	// Build message
+	_tRxMessage message;
 	if (defaultName != nullptr)
 	{
-		rxMessage.Name = defaultName;
+		message.Name = defaultName;
 	}
-	rxMessage.BatteryLevel = BatteryLevel;
+	message.BatteryLevel = BatteryLevel;
 	if (userName != nullptr)
-		rxMessage.UserName = userName;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = pHardware->m_HwdID;
+		message.UserName = userName;
 	// defensive copy of the command
-	rxMessage.vrxCommand.insert(rxMessage.vrxCommand.begin(), pRXCommand, pRXCommand + pRXCommand[0] + 1);
-	rxMessage.crc = 0x0;
+	message.vrxCommand.insert(message.vrxCommand.begin(), pRXCommand, pRXCommand + pRXCommand[0] + 1);
+	message.crc = 0x0;
 #ifdef DEBUG_RXQUEUE
 	// CRC
-	rxMessage.crc = crc16ccitt(pRXCommand, pRXCommand[0] + 1);
+	message.crc = crc16ccitt(pRXCommand, pRXCommand[0] + 1);
 #endif
 
+	if (t_RxBatchDepth > 0)
+	{
+		if ((!wait) && (t_pRxBatchHardware == pHardware))
+		{
+			// queued when the batch ends
+			t_RxBatch.push_back(std::move(message));
+			return;
+		}
+		// the messages collected so far go first
+		if (wait)
+			FlushRxBatch();
+	}
+
 	if (m_TaskRXMessage.IsStopRequested(0)) {
 		// Server is stopping
 		return;
 	}
 
+	// Build queue item
+	_tRxQueueItem rxMessage;
+	rxMessage.rxMessageIdx = m_rxMessageIdx++;
+	rxMessage.hardwareId = pHardware->m_HwdID;
+	rxMessage.messages.push_back(std::move(message));
+
 	// Trigger
 	rxMessage.trigger = nullptr; // Should be initialized to NULL if trigger is no used
 	if (wait) { // add trigger to wait for the message to be processed
@@ -1762,8 +1823,9 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 		pRXCommand[2]);
 #endif
 
-	// Push item to queue
-	m_rxMessageQueue.push(rxMessage);
+	// Push item to the queue of the lane that handles this hardware
+	rxMessage.pushTime = std::chrono::steady_clock::now();
+	PushRxQueueItem(rxMessage);
 
 	if (rxMessage.trigger != nullptr)
 	{
@@ -1788,29 +1850,114 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 	}
 }
 
+thread_local const CDomoticzHardwareBase *MainWorker::t_pRxBatchHardware = nullptr;
+thread_local int MainWorker::t_RxBatchDepth = 0;
+thread_local std::vector<MainWorker::_tRxMessage> MainWorker::t_RxBatch;
+
+void MainWorker::BeginRxBatch(const CDomoticzHardwareBase *pHardware)
+{
+	if (t_RxBatchDepth++ == 0)
+		t_pRxBatchHardware = pHardware;
+}
+
+void MainWorker::EndRxBatch()
+{
+	if ((t_RxBatchDepth <= 0) || (--t_RxBatchDepth > 0))
+		return;
+	FlushRxBatch();
+	t_pRxBatchHardware = nullptr;
+}
+
+// Pushes the messages collected by the batch of the current thread so far
+void MainWorker::FlushRxBatch()
+{
+	const CDomoticzHardwareBase *pHardware = t_pRxBatchHardware;
+	if (t_RxBatch.empty())
+		return;
+	if (m_TaskRXMessage.IsStopRequested(0)) {
+		// Server is stopping
+		t_RxBatch.clear();
+		return;
+	}
+
+	_tRxQueueItem rxMessage;
+	rxMessage.rxMessageIdx = m_rxMessageIdx++;
+	rxMessage.hardwareId = pHardware->m_HwdID;
+	rxMessage.messages.swap(t_RxBatch);
+	rxMessage.trigger = nullptr;
+#ifdef DEBUG_RXQUEUE
+	_log.Log(LOG_STATUS, "RxQueue: push a batch rxMessage(%lu) of %d messages (hrdwId=%d, hrdwType=%d, hrdwName=%s)",
+		rxMessage.rxMessageIdx,
+		static_cast<int>(rxMessage.messages.size()),
+		pHardware->m_HwdID,
+		pHardware->HwdType,
+		pHardware->m_Name.c_str());
+#endif
+	rxMessage.pushTime = std::chrono::steady_clock::now();
+	PushRxQueueItem(rxMessage);
+}
+
 void MainWorker::UnlockRxMessageQueue()
 {
 #ifdef DEBUG_RXQUEUE
 	_log.Log(LOG_STATUS, "RxQueue: unlock queue using dummy message");
 #endif
-	// Push dummy message to unlock queue
-	_tRxQueueItem rxMessage;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = -1;
-	rxMessage.trigger = nullptr;
-	rxMessage.BatteryLevel = 0;
-	m_rxMessageQueue.push(rxMessage);
+	// Push dummy message to unlock the queue of every lane
+	for (auto& lane : m_rxLanes)
+	{
+		_tRxQueueItem rxMessage;
+		rxMessage.rxMessageIdx = m_rxMessageIdx++;
+		rxMessage.hardwareId = -1;
+		rxMessage.trigger = nullptr;
+		lane->queue.push(rxMessage);
+	}
+}
+
+MainWorker::_tRxLane& MainWorker::GetRxLane(const int hardwareId)
+{
+	return *m_rxLanes[static_cast<size_t>(hardwareId) % m_rxLanes.size()];
+}
+
+void MainWorker::PushRxQueueItem(const _tRxQueueItem& rxMessage)
+{
+	_tRxLane& rxLane = GetRxLane(rxMessage.hardwareId);
+	{
+		std::lock_guard<std::mutex> l(rxLane.pendingMutex);
+		rxLane.pending[rxMessage.hardwareId] += rxMessage.messages.size();
+	}
+	rxLane.queue.push(rxMessage);
 }
 
-void MainWorker::Do_Work_On_Rx_Messages()
+std::vector<MainWorker::_tRxLaneStatus> MainWorker::GetRxLaneStatus()
 {
-	_log.Log(LOG_STATUS, "RxQueue: queue worker started...");
+	std::vector<_tRxLaneStatus> ret;
+	for (auto& lane : m_rxLanes)
+	{
+		_tRxLaneStatus status;
+		status.QueueDepth = lane->queue.size();
+		status.Processed = lane->processed;
+		status.AvgWaitMs = (status.Processed != 0) ? (lane->totalWaitUs / 1000.0 / status.Processed) : 0;
+		status.MaxWaitMs = lane->maxWaitUs / 1000.0;
+		status.AvgProcessMs = (status.Processed != 0) ? (lane->totalProcessUs / 1000.0 / status.Processed) : 0;
+		{
+			std::lock_guard<std::mutex> l(lane->pendingMutex);
+			status.HardwareDepth = lane->pending;
+		}
+		ret.push_back(status);
+	}
+	return ret;
+}
+
+void MainWorker::Do_Work_On_Rx_Messages(const size_t lane)
+{
+	_log.Log(LOG_STATUS, "RxQueue: queue worker %d started...", static_cast<int>(lane));
+	_tRxLane& rxLane = *m_rxLanes[lane];
 
 	while (!m_TaskRXMessage.IsStopRequested(0))
 	{
 		// Wait and pop next message or timeout
 		_tRxQueueItem rxQItem;
-		bool hasPopped = m_rxMessageQueue.timed_wait_and_pop<std::chrono::duration<int> >(rxQItem, std::chrono::duration<int>(5));
+		bool hasPopped = rxLane.queue.timed_wait_and_pop<std::chrono::duration<int> >(rxQItem, std::chrono::duration<int>(5));
 		// (if no message for 5 seconds, returns anyway to check m_TaskRXMessage.IsStopRequested)
 
 		if (!hasPopped) {
@@ -1827,6 +1974,16 @@ void MainWorker::Do_Work_On_Rx_Messages()
 #endif
 			continue;
 		}
+		{
+			std::lock_guard<std::mutex> l(rxLane.pendingMutex);
+			auto itt = rxLane.pending.find(rxQItem.hardwareId);
+			if (itt != rxLane.pending.end())
+			{
+				itt->second -= std::min<uint64_t>(itt->second, rxQItem.messages.size());
+				if (itt->second == 0)
+					rxLane.pending.erase(itt);
+			}
+		}
 		if (rxQItem.hardwareId < 1) {
 			_log.Log(LOG_ERROR, "RxQueue: cannot process invalid hardware id: (%d)", rxQItem.hardwareId);
 			// cannot process message with invalid id or null message
@@ -1845,43 +2002,75 @@ void MainWorker::Do_Work_On_Rx_Messages()
 				rxQItem.trigger->popped();
 			continue;
 		}
-		if (rxQItem.vrxCommand.empty()) {
+		if (rxQItem.messages.empty()) {
 			_log.Log(LOG_ERROR, "RxQueue: cannot retrieve command with id: %d", rxQItem.hardwareId);
 			if (rxQItem.trigger != nullptr)
 				rxQItem.trigger->popped();
 			continue;
 		}
 
-		const uint8_t* pRXCommand = &rxQItem.vrxCommand[0];
+		std::string szLabels = CMetrics::Label("hardware", std::to_string(pHardware->m_HwdID));
+		CMetrics::CHistogram &waitHistogram = m_metrics.GetHistogram("oikomaticz_rx_wait_seconds", szLabels);
+		CMetrics::CHistogram &processHistogram = m_metrics.GetHistogram("oikomaticz_rx_process_seconds", szLabels);
 
-#ifdef DEBUG_RXQUEUE
-		// CRC
-		uint16_t crc = crc16ccitt(pRXCommand, rxQItem.vrxCommand.size());
-		if (rxQItem.crc != crc) {
-			_log.Log(LOG_ERROR, "RxQueue: cannot process invalid rxMessage(%lu) from hardware with id=%d (type %d)",
-				rxQItem.rxMessageIdx,
-				rxQItem.hardwareId,
-				pHardware->HwdType);
-			if (rxQItem.trigger != NULL) rxQItem.trigger->popped();
-			continue;
+		// A batch is written in one transaction and its events are evaluated together
+		const bool bBatch = (rxQItem.messages.size() > 1);
+		if (bBatch)
+		{
+			m_sql.HoldGroupCommit();
+			m_eventsystem.HoldEventQueue();
 		}
+		for (const auto &message : rxQItem.messages)
+		{
+			if (message.vrxCommand.empty())
+				continue;
+			const uint8_t* pRXCommand = &message.vrxCommand[0];
 
-		_log.Log(LOG_STATUS, "RxQueue: process a rxMessage(%lu) (hrdwId=%d, hrdwType=%d, hrdwName=%s, type=%02X, subtype=%02X)",
-			rxQItem.rxMessageIdx,
-			pHardware->m_HwdID,
-			pHardware->HwdType,
-			pHardware->m_Name.c_str(),
-			pRXCommand[1],
-			pRXCommand[2]);
+#ifdef DEBUG_RXQUEUE
+			// CRC
+			uint16_t crc = crc16ccitt(pRXCommand, message.vrxCommand.size());
+			if (message.crc != crc) {
+				_log.Log(LOG_ERROR, "RxQueue: cannot process invalid rxMessage(%lu) from hardware with id=%d (type %d)",
+					rxQItem.rxMessageIdx,
+					rxQItem.hardwareId,
+					pHardware->HwdType);
+				continue;
+			}
+
+			_log.Log(LOG_STATUS, "RxQueue: process a rxMessage(%lu) (hrdwId=%d, hrdwType=%d, hrdwName=%s, type=%02X, subtype=%02X)",
+				rxQItem.rxMessageIdx,
+				pHardware->m_HwdID,
+				pHardware->HwdType,
+				pHardware->m_Name.c_str(),
+				pRXCommand[1],
+				pRXCommand[2]);
 #endif
-		ProcessRXMessage(pHardware, pRXCommand, rxQItem.Name.c_str(), rxQItem.BatteryLevel, rxQItem.UserName.c_str());
+			auto tStart = std::chrono::steady_clock::now();
+			ProcessRXMessage(pHardware, pRXCommand, message.Name.c_str(), message.BatteryLevel, message.UserName.c_str());
+
+			auto tEnd = std::chrono::steady_clock::now();
+			waitHistogram.Record(tStart - rxQItem.pushTime);
+			processHistogram.Record(tEnd - tStart);
+
+			auto waitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(tStart - rxQItem.pushTime).count());
+			rxLane.processed++;
+			rxLane.totalWaitUs += waitUs;
+			rxLane.totalProcessUs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(tEnd - tStart).count());
+			if (waitUs > rxLane.maxWaitUs)
+				rxLane.maxWaitUs = waitUs;
+		}
+		if (bBatch)
+		{
+			m_eventsystem.ReleaseEventQueue();
+			m_sql.ReleaseGroupCommit();
+		}
 		if (rxQItem.trigger != nullptr)
 		{
 			rxQItem.trigger->popped();
 		}
 	}
 
-	_log.Log(LOG_STATUS, "RxQueue: queue worker stopped...");
+	_log.Log(LOG_STATUS, "RxQueue: queue worker %d stopped...", static_cast<int>(lane));
 }
 
 void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const uint8_t* pRXCommand, const char* defaultName, const int BatteryLevel, const char* userName)
@@ -2750,14 +2939,16 @@ void MainWorker::decode_Rain(const CDomoticzHardwareBase* pHardware, const tRBUF
 		//calculate new Total
 		TotalRain = 0;
 
-		std::vector<std::vector<std::string>> result;
-
 		//Get our index
-		result = m_sql.safe_query(
-			"SELECT ID FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)", pHardware->m_HwdID, ID.c_str(), Unit, devType, subType);
-		if (!result.empty())
+		uint64_t ulID = 0;
+		{
+			auto stmt = m_sql.prepared_query(
+				"SELECT ID FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)", pHardware->m_HwdID, ID, Unit, devType, subType);
+			if (stmt.Step())
+				ulID = static_cast<uint64_t>(stmt.GetInt64(0));
+		}
+		if (ulID != 0)
 		{
-			uint64_t ulID = std::stoull(result[0][0]);
 
 			time_t now = mytime(nullptr);
 			struct tm ltime;
@@ -2796,14 +2987,16 @@ void MainWorker::decode_Rain(const CDomoticzHardwareBase* pHardware, const tRBUF
 	{
 		Rainrate = 0;
 		//Calculate our own rainrate
-		std::vector<std::vector<std::string>> result;
-
 		//Get our index
-		result = m_sql.safe_query(
-			"SELECT ID FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)", pHardware->m_HwdID, ID.c_str(), Unit, devType, subType);
-		if (!result.empty())
+		uint64_t ulID = 0;
+		{
+			auto stmt = m_sql.prepared_query(
+				"SELECT ID FROM DeviceStatus WHERE (HardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)", pHardware->m_HwdID, ID, Unit, devType, subType);
+			if (stmt.Step())
+				ulID = static_cast<uint64_t>(stmt.GetInt64(0));
+		}
+		if (ulID != 0)
 		{
-			uint64_t ulID = std::stoull(result[0][0]);
 
 			//Get Counter from one Hour ago
 			time_t now = mytime(nullptr);
@@ -2933,7 +3126,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 	//Apply user defined offset
 	dDirection = std::fmod(dDirection + AddjValue2, 360.0);
 
-	dDirection = m_wind_calculator[windID].AddValueAndReturnAvarage(dDirection);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		dDirection = m_wind_calculator[windID].AddValueAndReturnAvarage(dDirection);
+	}
 
 	std::string strDirection;
 	if (dDirection > 348.75 || dDirection < 11.26)
@@ -2987,7 +3183,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 		intSpeed = intGust;
 	}
 
-	m_wind_calculator[windID].SetSpeedGust(intSpeed, intGust);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_wind_calculator[windID].SetSpeedGust(intSpeed, intGust);
+	}
 
 	float temp = 0, chill = 0;
 	if (subType != sTypeWINDNoTempNoChill)
@@ -3057,7 +3256,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(chill), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(chill), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	if (_log.IsDebugLevelEnabled(DEBUG_RECEIVED))
 	{
@@ -3196,7 +3398,10 @@ void MainWorker::decode_Temp(const CDomoticzHardwareBase* pHardware, const tRBUF
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	bool bHandledNotification = false;
 	uint8_t humidity = 0;
@@ -3511,7 +3716,10 @@ void MainWorker::decode_TempHum(const CDomoticzHardwareBase* pHardware, const tR
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
@@ -3722,7 +3930,10 @@ void MainWorker::decode_TempHumBaro(const CDomoticzHardwareBase* pHardware, cons
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	//calculate Altitude
 	//float seaLevelPressure=101325.0f;
@@ -3858,7 +4069,10 @@ void MainWorker::decode_TempBaro(const CDomoticzHardwareBase* pHardware, const t
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
@@ -3962,7 +4176,10 @@ void MainWorker::decode_TempRain(const CDomoticzHardwareBase* pHardware, const t
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	sprintf(szTmp, "%.1f", temp);
 	uint64_t DevRowIdxTemp = m_sql.UpdateValue(pHardware->m_HwdID, 0, ID.c_str(), Unit, pTypeTEMP, sTypeTEMP3, SignalLevel, BatteryLevel, cmnd, szTmp, procResult.DeviceName, true, procResult.Username.c_str());
@@ -13735,17 +13952,19 @@ void MainWorker::HeartbeatCheck()
 bool MainWorker::UpdateDevice(const int DevIdx, const int nValue, const std::string& sValue, const std::string& userName, const int signallevel, const int batterylevel, const bool parseTrigger)
 {
 	// Get the raw device parameters
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT HardwareID, OrgHardwareID, DeviceID, Unit, Type, SubType FROM DeviceStatus WHERE (ID==%d)", DevIdx);
-	if (result.empty())
-		return false;
-
-	int HardwareID = std::stoi(result[0][0]);
-	int OrgHardwareID = std::stoi(result[0][1]);
-	std::string DeviceID = result[0][2];
-	int unit = std::stoi(result[0][3]);
-	int devType = std::stoi(result[0][4]);
-	int subType = std::stoi(result[0][5]);
+	int HardwareID, OrgHardwareID, unit, devType, subType;
+	std::string DeviceID;
+	{
+		auto stmt = m_sql.prepared_query("SELECT HardwareID, OrgHardwareID, DeviceID, Unit, Type, SubType FROM DeviceStatus WHERE (ID==?)", DevIdx);
+		if (!stmt.Step())
+			return false;
+		HardwareID = stmt.GetInt(0);
+		OrgHardwareID = stmt.GetInt(1);
+		DeviceID = stmt.GetString(2);
+		unit = stmt.GetInt(3);
+		devType = stmt.GetInt(4);
+		subType = stmt.GetInt(5);
+	}
 
 	return UpdateDevice(HardwareID, OrgHardwareID, DeviceID, unit, devType, subType, nValue, sValue, userName, signallevel, batterylevel, parseTrigger);
 }
@@ -13887,7 +14106,10 @@ bool MainWorker::UpdateDevice(const int HardwareID, const int OrgHardwareID, con
 				if (temp != 12345.0F)
 				{
 					uint64_t tID = ((uint64_t)(HardwareID & 0x7FFFFFFF) << 32) | (devidx & 0x7FFFFFFF);
-					m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+					{
+						std::lock_guard<std::mutex> l(m_calculatormutex);
+						m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+					}
 				}
 			}
 		}
@@ -6,6 +6,7 @@
 #include "EventSystem.h"
 #include "NotificationSystem.h"
 #include "Camera.h"
+#include <atomic>
 #include <deque>
 #include "WindCalculation.h"
 #include "TrendCalculator.h"
@@ -41,6 +42,9 @@ class MainWorker : public StoppableTask
 	void HeartbeatRemove(const std::string &component);
 	void HeartbeatCheck();
 
+	// More than one lane decodes the messages of different hardware in parallel, but then a message
+	// can be handled before an older one of other hardware. Only has effect before Start()
+	void SetRxLanes(size_t nLanes);
 	void SetWebserverSettings(const http::server::server_settings & settings);
 	void SetIamserverSettings(const iamserver::iam_settings& iam_settings);
 	std::string GetWebserverAddress();
@@ -51,6 +55,10 @@ class MainWorker : public StoppableTask
 #endif
 	void DecodeRXMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 	void PushAndWaitRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
+	// Messages the calling thread decodes for pHardware until the matching EndRxBatch are queued as one item,
+	// they are processed in one database transaction and their events are evaluated together
+	void BeginRxBatch(const CDomoticzHardwareBase *pHardware);
+	void EndRxBatch();
 
 	enum eSwitchLightReturnCode
 	{
@@ -125,6 +133,18 @@ class MainWorker : public StoppableTask
 	std::vector<std::string> m_webthemes;
 	std::map<uint16_t, _tWindCalculator> m_wind_calculator;
 	std::map<uint64_t, _tTrendCalculator> m_trend_calculator;
+	std::mutex m_calculatormutex; // RX lanes update the calculators in parallel
+
+	struct _tRxLaneStatus
+	{
+		size_t QueueDepth;
+		uint64_t Processed;
+		double AvgWaitMs;
+		double MaxWaitMs;
+		double AvgProcessMs;
+		std::map<int, uint64_t> HardwareDepth; // messages waiting per hardware id
+	};
+	std::vector<_tRxLaneStatus> GetRxLaneStatus();
 
 	time_t m_LastHeartbeat = 0;
 
@@ -185,21 +205,43 @@ class MainWorker : public StoppableTask
 	uint8_t get_BateryLevel(hardware::type::value HwdType, bool bIsInPercentage, uint8_t level);
 
 	// RxMessage queue resources
-	volatile unsigned long m_rxMessageIdx;
-	std::shared_ptr<std::thread> m_rxMessageThread;
+	// Messages are spread over lanes by hardware id, each lane has its own queue and worker thread so
+	// messages from one hardware are always processed in order. There is one lane unless SetRxLanes() asks for more
+	std::atomic<unsigned long> m_rxMessageIdx;
 	StoppableTask m_TaskRXMessage;
-	void Do_Work_On_Rx_Messages();
-	struct _tRxQueueItem {
+	void Do_Work_On_Rx_Messages(size_t lane);
+	struct _tRxMessage {
 		std::string Name;
 		int BatteryLevel;
-		unsigned long rxMessageIdx;
-		int hardwareId;
 		std::vector<uint8_t> vrxCommand;
 		boost::uint16_t crc;
-		queue_element_trigger* trigger;
 		std::string UserName;
 	};
-	concurrent_queue<_tRxQueueItem> m_rxMessageQueue;
+	struct _tRxQueueItem {
+		unsigned long rxMessageIdx;
+		int hardwareId;
+		std::vector<_tRxMessage> messages; // more than one for a batch
+		queue_element_trigger* trigger;
+		std::chrono::steady_clock::time_point pushTime;
+	};
+	// Batch that is open on this thread
+	static thread_local const CDomoticzHardwareBase *t_pRxBatchHardware;
+	static thread_local int t_RxBatchDepth;
+	static thread_local std::vector<_tRxMessage> t_RxBatch;
+	void FlushRxBatch();
+	struct _tRxLane {
+		concurrent_queue<_tRxQueueItem> queue;
+		std::shared_ptr<std::thread> thread;
+		std::atomic<uint64_t> processed{ 0 };
+		std::atomic<uint64_t> totalWaitUs{ 0 };
+		std::atomic<uint64_t> maxWaitUs{ 0 };
+		std::atomic<uint64_t> totalProcessUs{ 0 };
+		std::mutex pendingMutex;
+		std::map<int, uint64_t> pending; // messages per hardware id that wait in the queue
+	};
+	void PushRxQueueItem(const _tRxQueueItem &rxMessage);
+	std::vector<std::unique_ptr<_tRxLane>> m_rxLanes;
+	_tRxLane &GetRxLane(int hardwareId);
 	void UnlockRxMessageQueue();
 	void PushRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 	void CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName, bool wait);
@@ -25,9 +25,12 @@
 #include <iostream>
 #include "CmdLine.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "WorkerPool.h"
 #include "Helper.h"
 #include "WebServerHelper.h"
 #include "SQLHelper.h"
+#include "Benchmark.h"
 #include "notifications/NotificationHelper.h"
 #include "appversion.h"
 #include "SignalHandler.h"
@@ -53,6 +56,7 @@ namespace
 		"\t-www port (for example -www 8080, or -www 0 to disable http)\n"
 		"\t-wwwbind address (for example -wwwbind 0.0.0.0 or -wwwbind 192.168.0.20)\n"
 		"\t-vhostname virtualhostname (for example -vhostname internal.mydomain.name or -vhostname localhost)\n"
+		"\t-wwwthreads number (threads serving http/https requests, default is one per core with a maximum of 4)\n"
 #ifdef WWW_ENABLE_SSL
 		"\t-sslwww port (for example -sslwww 443, or -sslwww 0 to disable https)\n"
 		"\t-sslcert file_path (for example /opt/oikomaticz/server_cert.pem)\n"
@@ -82,6 +86,10 @@ namespace
 		"\t-nobrowser (do not start web browser (Windows Only)\n"
 #endif
 		"\t-dbase_disable_wal_mode\n"
+		"\t-dbase_commit_window ms (collect database writes in one transaction for this many milliseconds, default=50, 0=disabled)\n"
+		"\t-dbase_shortlog_store (keep a compressed copy of the 5 minute logs next to the database as a read cache for the day graphs)\n"
+		"\t-rxlanes count (decode received messages of different hardware in parallel on this many threads, default=1, messages of one hardware stay in order but not across hardware)\n"
+		"\t-benchmark name (run a benchmark on temporary files in the user data folder and exit, name is one of: sqlwrite, rfxnames, shortlog)\n"
 #if defined WIN32
 		"\t-log file_path (for example D:\\oikomaticz.log)\n"
 		"\t-weblog file_path (for example D:\\oikomaticz_access.log)\n"
@@ -137,12 +145,17 @@ std::string szPyVersion="None";
 int ActYear;
 time_t m_StartTime = time(nullptr);
 std::string journalMode="WAL";
+int dbaseCommitWindow = 50;
+bool bDbaseShortLogStore = false;
+int rxLanes = 1;
 
 MainWorker m_mainworker;
 CLogger _log;
 http::server::CWebServerHelper m_webservers;
 CSQLHelper m_sql;
 CNotificationHelper m_notifications;
+CMetrics m_metrics;
+CWorkerPool m_workerpool;
 
 std::string logfile;
 std::string weblogfile;
@@ -571,6 +584,15 @@ bool ParseConfigFile(const std::string &szConfigFile)
 		else if ( (szFlag == "dbase_disable_wal_mode") && (GetConfigBool(sLine) ) )  {
 			journalMode = "DELETE";
 		}
+		else if (szFlag == "dbase_commit_window") {
+			dbaseCommitWindow = atoi(sLine.c_str());
+		}
+		else if ((szFlag == "dbase_shortlog_store") && (GetConfigBool(sLine))) {
+			bDbaseShortLogStore = true;
+		}
+		else if (szFlag == "rx_lanes") {
+			rxLanes = atoi(sLine.c_str());
+		}
 
 		else if (szFlag == "startup_delay") {
 			int DelaySeconds = atoi(sLine.c_str());
@@ -590,6 +612,12 @@ bool ParseConfigFile(const std::string &szConfigFile)
 			webserver_settings.vhostname = sLine;
 #ifdef WWW_ENABLE_SSL
 			secure_webserver_settings.vhostname = sLine;
+#endif
+		}
+		else if (szFlag == "wwwthreads") {
+			webserver_settings.number_of_threads = atoi(sLine.c_str());
+#ifdef WWW_ENABLE_SSL
+			secure_webserver_settings.number_of_threads = webserver_settings.number_of_threads;
 #endif
 		}
 		else if (szFlag == "app_path") {
@@ -838,6 +866,15 @@ int main(int argc, char**argv)
 			}
 			webserver_settings.vhostname = cmdLine.GetSafeArgument("-vhostname", 0, "");
 		}
+		if (cmdLine.HasSwitch("-wwwthreads"))
+		{
+			if (cmdLine.GetArgumentCount("-wwwthreads") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the number of webserver threads");
+				return 1;
+			}
+			webserver_settings.number_of_threads = atoi(cmdLine.GetSafeArgument("-wwwthreads", 0, "0").c_str());
+		}
 		if (cmdLine.HasSwitch("-php_cgi_path"))
 		{
 			if (cmdLine.GetArgumentCount("-php_cgi_path") != 1)
@@ -891,6 +928,10 @@ int main(int argc, char**argv)
 			// php_cgi_path has to be equal
 			secure_webserver_settings.php_cgi_path = webserver_settings.php_cgi_path;
 		}
+		if (webserver_settings.number_of_threads > 0) {
+			// number of threads has to be equal
+			secure_webserver_settings.number_of_threads = webserver_settings.number_of_threads;
+		}
 		if (cmdLine.HasSwitch("-sslcert"))
 		{
 			if (cmdLine.GetArgumentCount("-sslcert") != 1)
@@ -1020,6 +1061,51 @@ int main(int argc, char**argv)
 	}
 	m_sql.SetJournalMode(journalMode);
 
+	if (!bUseConfigFile) {
+		if (cmdLine.HasSwitch("-dbase_commit_window"))
+		{
+			if (cmdLine.GetArgumentCount("-dbase_commit_window") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the database commit window in milliseconds");
+				return 1;
+			}
+			dbaseCommitWindow = atoi(cmdLine.GetSafeArgument("-dbase_commit_window", 0, "50").c_str());
+		}
+	}
+	m_sql.SetGroupCommit(dbaseCommitWindow, 200);
+
+	if (!bUseConfigFile) {
+		if (cmdLine.HasSwitch("-dbase_shortlog_store"))
+		{
+			bDbaseShortLogStore = true;
+		}
+	}
+	m_sql.SetShortLogStore(bDbaseShortLogStore);
+
+	if (!bUseConfigFile) {
+		if (cmdLine.HasSwitch("-rxlanes"))
+		{
+			if (cmdLine.GetArgumentCount("-rxlanes") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the number of RX lanes");
+				return 1;
+			}
+			rxLanes = atoi(cmdLine.GetSafeArgument("-rxlanes", 0, "1").c_str());
+		}
+	}
+	if (rxLanes > 1)
+		m_mainworker.SetRxLanes(static_cast<size_t>(rxLanes));
+
+	if (cmdLine.HasSwitch("-benchmark"))
+	{
+		if (cmdLine.GetArgumentCount("-benchmark") != 1)
+		{
+			_log.Log(LOG_ERROR, "Please specify a benchmark name");
+			return 1;
+		}
+		return RunBenchmark(cmdLine.GetSafeArgument("-benchmark", 0, ""), szUserDataFolder) ? 0 : 1;
+	}
+
 	if (!bUseConfigFile) {
 		if (cmdLine.HasSwitch("-webroot"))
 		{
@@ -1136,6 +1222,9 @@ int main(int argc, char**argv)
 	}
 #endif
 
+	// log output is written by its own thread from here on (after daemonization, threads do not survive a fork)
+	_log.StartWriterThread();
+
 	m_mainworker.SetIamserverSettings(iamserver_settings);
 
 	if (!g_bRunAsDaemon)
@@ -1231,6 +1320,7 @@ int main(int argc, char**argv)
 #endif
 	g_stop_watchdog = true;
 	thread_watchdog.join();
+	_log.StopWriterThread();
 	return 0;
 }
 
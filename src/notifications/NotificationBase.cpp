@@ -2,6 +2,7 @@
 #include "NotificationBase.h"
 #include "main/SQLHelper.h"
 #include "main/Logger.h"
+#include "main/Metrics.h"
 #include "main/Helper.h"
 #include "protocols/UrlEncode.h"
 #include "webserver/Base64.h"
@@ -119,7 +120,9 @@ bool CNotificationBase::SendMessageEx(
 	}
 
 	std::unique_lock<std::mutex> SendMessageEx(SendMessageExMutex);
+	CMetrics::CTimer timer("oikomaticz_notification_seconds", CMetrics::Label("subsystem", _subsystemid));
 	bool bRet = SendMessageImplementation(Idx, Name, fSubject, fText, ExtraData, Priority, Sound, bFromNotification);
+	m_metrics.AddCounter("oikomaticz_notifications_total", CMetrics::Label("subsystem", _subsystemid) + "," + CMetrics::Label("result", bRet ? "success" : "failed"));
 	if (bRet) {
 		_log.Log(LOG_NORM, "Notification sent (%s) => Success", _subsystemid.c_str());
 	}
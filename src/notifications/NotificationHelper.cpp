@@ -5,6 +5,7 @@
 #include "main/RFXtrx.h"
 #include "main/mainworker.h"
 #include "main/WebServer.h"
+#include "main/WorkerPool.h"
 #include "hardware/DomoticzHardware.h"
 #include "hardware/hardwaretypes.h"
 #include "NotificationHelper.h"
@@ -138,8 +139,8 @@ bool CNotificationHelper::SendMessageEx(
 			{
 				if (bThread)
 				{
-					boost::thread SendMessageEx([=] { m_notifier.second->SendMessageEx(Idx, Name, Subject, Text, ExtraData, Priority, Sound, bFromNotification); });
-					SetThreadName(SendMessageEx.native_handle(), "SendMessageEx");
+					m_workerpool.Post(
+						CWorkerPool::CATEGORY_NOTIFICATION, [=] { m_notifier.second->SendMessageEx(Idx, Name, Subject, Text, ExtraData, Priority, Sound, bFromNotification); }, Priority);
 				}
 				else
 					bRet |= m_notifier.second->SendMessageEx(Idx, Name, Subject, Text, ExtraData, Priority, Sound,
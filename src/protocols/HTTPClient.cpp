@@ -176,6 +176,48 @@ bool HTTPClient::GETBinaryToFile(const std::string &szUrl, const std::string &sz
 }
 
 
+/************************************************************************
+ *									*
+ * asynchronous methods with access to the return header data		*
+ *									*
+ ************************************************************************/
+
+void HTTPClient::GETAsync(const std::string &szUrl, const std::vector<std::string> &vExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut)
+{
+	RESTClient::ExecuteAsync((connection::HTTP::method::value)(connection::HTTP::method::GET | connection::HTTP::method::HEAD), szUrl, "", vExtraHeaders, callback, true, iTimeOut);
+}
+
+void HTTPClient::POSTAsync(const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const RESTClient::_tCallback &callback, const bool bFollowRedirect, const long iTimeOut)
+{
+	RESTClient::ExecuteAsync((connection::HTTP::method::value)(connection::HTTP::method::POST | connection::HTTP::method::HEAD), szUrl, szPostdata, vExtraHeaders, callback, bFollowRedirect, iTimeOut);
+}
+
+void HTTPClient::PUTAsync(const std::string &szUrl, const std::string &szPutdata, const std::vector<std::string> &vExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut)
+{
+	RESTClient::ExecuteAsync((connection::HTTP::method::value)(connection::HTTP::method::PUT | connection::HTTP::method::HEAD), szUrl, szPutdata, vExtraHeaders, callback, true, iTimeOut);
+}
+
+void HTTPClient::DELETEAsync(const std::string &szUrl, const std::string &szPutdata, const std::vector<std::string> &vExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut)
+{
+	RESTClient::ExecuteAsync((connection::HTTP::method::value)(connection::HTTP::method::DELETE | connection::HTTP::method::HEAD), szUrl, szPutdata, vExtraHeaders, callback, true, iTimeOut);
+}
+
+void HTTPClient::PATCHAsync(const std::string &szUrl, const std::string &szPutdata, const std::vector<std::string> &vExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut)
+{
+	RESTClient::ExecuteAsync((connection::HTTP::method::value)(connection::HTTP::method::PATCH | connection::HTTP::method::HEAD), szUrl, szPutdata, vExtraHeaders, callback, true, iTimeOut);
+}
+
+std::future<RESTClient::_tResponse> HTTPClient::GETFuture(const std::string &szUrl, const std::vector<std::string> &vExtraHeaders, const long iTimeOut)
+{
+	return RESTClient::ExecuteFuture((connection::HTTP::method::value)(connection::HTTP::method::GET | connection::HTTP::method::HEAD), szUrl, "", vExtraHeaders, true, iTimeOut);
+}
+
+std::future<RESTClient::_tResponse> HTTPClient::POSTFuture(const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const bool bFollowRedirect, const long iTimeOut)
+{
+	return RESTClient::ExecuteFuture((connection::HTTP::method::value)(connection::HTTP::method::POST | connection::HTTP::method::HEAD), szUrl, szPostdata, vExtraHeaders, bFollowRedirect, iTimeOut);
+}
+
+
 /************************************************************************
  *									*
  * can't inherit static public methods					*
@@ -83,6 +83,23 @@ std::vector<std::string> &vHeaderData, const long iTimeOut = -1);
 std::vector<std::string> &vHeaderData, const long iTimeOut = -1);
 
 
+	/************************************************************************
+	 *									*
+	 * asynchronous methods with access to the return header data		*
+	 *   - the callback is called on the transfer thread when the		*
+	 *     request is done, it should not block				*
+	 *									*
+	 ************************************************************************/
+
+	static void GETAsync(const std::string &szUrl, const std::vector<std::string> &ExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut = -1);
+	static void POSTAsync(const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &ExtraHeaders, const RESTClient::_tCallback &callback, const bool bFollowRedirect = true, const long iTimeOut = -1);
+	static void PUTAsync(const std::string &szUrl, const std::string &szPutdata, const std::vector<std::string> &ExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut = -1);
+	static void DELETEAsync(const std::string &szUrl, const std::string &szPutdata, const std::vector<std::string> &ExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut = -1);
+	static void PATCHAsync(const std::string &szUrl, const std::string &szPutdata, const std::vector<std::string> &ExtraHeaders, const RESTClient::_tCallback &callback, const long iTimeOut = -1);
+	static std::future<RESTClient::_tResponse> GETFuture(const std::string &szUrl, const std::vector<std::string> &ExtraHeaders, const long iTimeOut = -1);
+	static std::future<RESTClient::_tResponse> POSTFuture(const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &ExtraHeaders, const bool bFollowRedirect = true, const long iTimeOut = -1);
+
+
 	/************************************************************************
 	 *									*
 	 * can't inherit static public methods					*
@@ -7,11 +7,18 @@
  * Source code subject to GNU GENERAL PUBLIC LICENSE version 3
  */
 
+#include "stdafx.h"
 #include "RESTClient.hpp"
 #include <curl/curl.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include "main/Helper.h"
 #include "main/Logger.h"
 
 
@@ -175,6 +182,209 @@ namespace connection {
 }; // namespace connection
 
 
+/************************************************************************
+ *									*
+ * Transfer engine							*
+ *									*
+ * All requests run on a single curl multi handle driven by one		*
+ * thread. The multi handle keeps the connections to a host open for	*
+ * the next request (at most MAX_HOST_CONNECTIONS per host), DNS	*
+ * results and TLS sessions are shared between all transfers.		*
+ *									*
+ ************************************************************************/
+
+struct RESTClient::_tTransfer
+{
+	CURL *curl = nullptr;
+	struct curl_slist *headers = nullptr;
+	std::string szPostdata;
+	std::ofstream outfile;
+	_tResponse response;
+	_tCallback callback;
+
+	~_tTransfer()
+	{
+		if (curl != nullptr)
+			curl_easy_cleanup(curl);
+		if (headers != nullptr)
+			curl_slist_free_all(headers);
+	}
+};
+
+class CTransferEngine
+{
+      public:
+	static constexpr long MAX_HOST_CONNECTIONS = 4;
+	static constexpr long MAX_TOTAL_CONNECTIONS = 32;
+
+	~CTransferEngine()
+	{
+		Stop();
+	}
+	bool Start();
+	void Stop();
+	// Queues the transfer, it runs on the calling thread when the engine is not running
+	// or when a callback waits for it (bBlocking) on the engine thread
+	void Perform(const std::shared_ptr<RESTClient::_tTransfer> &transfer, bool bBlocking);
+
+      private:
+	void Do_Work();
+	static void LockShare(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+	static void UnlockShare(CURL *handle, curl_lock_data data, void *userptr);
+
+	std::mutex m_mutex;
+	std::shared_ptr<std::thread> m_thread;
+	std::thread::id m_thread_id;
+	bool m_bStopRequested = false;
+	std::vector<std::shared_ptr<RESTClient::_tTransfer>> m_new_transfers;
+	CURLM *m_multi = nullptr;
+	CURLSH *m_share = nullptr;
+	std::array<std::mutex, CURL_LOCK_DATA_LAST> m_share_mutexes;
+};
+
+static CTransferEngine s_engine;
+
+void CTransferEngine::LockShare(CURL * /*handle*/, curl_lock_data data, curl_lock_access /*access*/, void *userptr)
+{
+	static_cast<CTransferEngine *>(userptr)->m_share_mutexes[data].lock();
+}
+
+void CTransferEngine::UnlockShare(CURL * /*handle*/, curl_lock_data data, void *userptr)
+{
+	static_cast<CTransferEngine *>(userptr)->m_share_mutexes[data].unlock();
+}
+
+bool CTransferEngine::Start()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_thread)
+		return true;
+	m_multi = curl_multi_init();
+	if (!m_multi)
+		return false;
+	curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, MAX_HOST_CONNECTIONS);
+	curl_multi_setopt(m_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, MAX_TOTAL_CONNECTIONS);
+	curl_multi_setopt(m_multi, CURLMOPT_MAXCONNECTS, MAX_TOTAL_CONNECTIONS);
+	m_share = curl_share_init();
+	if (m_share)
+	{
+		curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, LockShare);
+		curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, UnlockShare);
+		curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+		curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	}
+	m_bStopRequested = false;
+	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
+	m_thread_id = m_thread->get_id();
+	SetThreadName(m_thread->native_handle(), "HTTPClient");
+	return true;
+}
+
+void CTransferEngine::Stop()
+{
+	std::shared_ptr<std::thread> thread;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		if (!m_thread)
+			return;
+		thread = m_thread;
+		m_bStopRequested = true;
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_wakeup(m_multi);
+#endif
+	}
+	thread->join();
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_thread.reset();
+	curl_multi_cleanup(m_multi);
+	m_multi = nullptr;
+	if (m_share)
+		curl_share_cleanup(m_share);
+	m_share = nullptr;
+}
+
+void CTransferEngine::Perform(const std::shared_ptr<RESTClient::_tTransfer> &transfer, const bool bBlocking)
+{
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		if ((m_thread) && (!m_bStopRequested) && ((!bBlocking) || (std::this_thread::get_id() != m_thread_id)))
+		{
+			if (m_share)
+				curl_easy_setopt(transfer->curl, CURLOPT_SHARE, m_share);
+			m_new_transfers.push_back(transfer);
+#if LIBCURL_VERSION_NUM >= 0x074400
+			curl_multi_wakeup(m_multi);
+#endif
+			return;
+		}
+	}
+	RESTClient::FinishTransfer(*transfer, curl_easy_perform(transfer->curl));
+}
+
+void CTransferEngine::Do_Work()
+{
+	std::map<CURL *, std::shared_ptr<RESTClient::_tTransfer>> active;
+	bool bStop = false;
+	while (!bStop)
+	{
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			for (const auto &transfer : m_new_transfers)
+			{
+				curl_multi_add_handle(m_multi, transfer->curl);
+				active[transfer->curl] = transfer;
+			}
+			m_new_transfers.clear();
+			bStop = m_bStopRequested;
+		}
+		if (bStop)
+			break;
+
+		int iRunning = 0;
+		curl_multi_perform(m_multi, &iRunning);
+
+		CURLMsg *msg;
+		int iMsgsLeft = 0;
+		while ((msg = curl_multi_info_read(m_multi, &iMsgsLeft)) != nullptr)
+		{
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			auto itt = active.find(msg->easy_handle);
+			if (itt == active.end())
+				continue;
+			CURLcode res = msg->data.result;
+			std::shared_ptr<RESTClient::_tTransfer> transfer = itt->second;
+			active.erase(itt);
+			curl_multi_remove_handle(m_multi, transfer->curl);
+			RESTClient::FinishTransfer(*transfer, res);
+		}
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_poll(m_multi, nullptr, 0, 1000, nullptr);
+#else
+		// no wakeup before curl 7.68, poll often enough for new requests
+		curl_multi_wait(m_multi, nullptr, 0, 20, nullptr);
+#endif
+	}
+
+	// new requests run on their own thread from now on, abort what is left
+	for (const auto &itt : active)
+	{
+		curl_multi_remove_handle(m_multi, itt.first);
+		RESTClient::FinishTransfer(*itt.second, CURLE_ABORTED_BY_CALLBACK);
+	}
+	std::vector<std::shared_ptr<RESTClient::_tTransfer>> pending;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		pending.swap(m_new_transfers);
+	}
+	for (const auto &transfer : pending)
+		RESTClient::FinishTransfer(*transfer, CURLE_ABORTED_BY_CALLBACK);
+}
+
+
 /************************************************************************
  *									*
  * Private functions							*
@@ -190,14 +400,18 @@ bool RESTClient::CheckIfGlobalInitDone()
 			return false;
 		m_bCurlGlobalInitialized = true;
 	}
+	if (!s_engine.Start())
+		_log.Log(LOG_ERROR, "HTTPClient: Unable to start the transfer engine, requests will run on the calling thread");
 	return true;
 }
 
 void RESTClient::Cleanup()
 {
+	s_engine.Stop();
 	if (m_bCurlGlobalInitialized)
 	{
 		curl_global_cleanup();
+		m_bCurlGlobalInitialized = false;
 	}
 }
 
@@ -244,100 +458,134 @@ void RESTClient::LogStatus(const long responseCode)
  *									*
  ************************************************************************/
 
-bool RESTClient::ExecuteBinary(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, std::vector<unsigned char> &vResponse, std::vector<std::string> &vHeaderData, const bool bFollowRedirect, const long iTimeOut)
+std::shared_ptr<RESTClient::_tTransfer> RESTClient::CreateTransfer(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const std::string &szFilename, const bool bFollowRedirect, const long iTimeOut)
 {
-	try
+	auto transfer = std::make_shared<_tTransfer>();
+	transfer->curl = curl_easy_init();
+	if (!transfer->curl)
+		return nullptr;
+
+	CURL *curl = transfer->curl;
+	SetGlobalOptions(curl);
+	if (iTimeOut != -1)
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT, iTimeOut);
+	if (!bFollowRedirect)
+		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
+
+	if (vExtraHeaders.size() > 0)
 	{
-		if (!CheckIfGlobalInitDone())
-			return false;
-		CURL *curl = curl_easy_init();
-		if (!curl)
-			return false;
-
-		CURLcode res;
-		SetGlobalOptions(curl);
-		if (iTimeOut != -1)
-			curl_easy_setopt(curl, CURLOPT_TIMEOUT, iTimeOut);
-		if (!bFollowRedirect)
-			curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
-
-		struct curl_slist *headers = nullptr;
-		if (vExtraHeaders.size() > 0)
+		for (const auto &header : vExtraHeaders)
 		{
-			std::vector<std::string>::const_iterator itt;
-			for (itt = vExtraHeaders.begin(); itt != vExtraHeaders.end(); ++itt)
-			{
-				headers = curl_slist_append(headers, (*itt).c_str());
-			}
-			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+			transfer->headers = curl_slist_append(transfer->headers, header.c_str());
 		}
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers);
+	}
 
-		if (eMethod & connection::HTTP::method::HEAD)
-		{
-			curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, connection::HTTP::callback::write_curl_headerdata);
-			curl_easy_setopt(curl, CURLOPT_HEADERDATA, &vHeaderData);
-		}
+	if (eMethod & connection::HTTP::method::HEAD)
+	{
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, connection::HTTP::callback::write_curl_headerdata);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer->response.vHeaderData);
+	}
 
-		std::ofstream outfile;
-		if (eMethod == connection::HTTP::method::HEAD)
-		{
-			curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
-		}
-		else if (eMethod & connection::HTTP::method::DOWNLOAD)
+	if (eMethod == connection::HTTP::method::HEAD)
+	{
+		curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	}
+	else if (eMethod & connection::HTTP::method::DOWNLOAD)
+	{
+		transfer->outfile.open(szFilename.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+		if (!transfer->outfile.is_open())
+			return nullptr;
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, connection::HTTP::callback::write_curl_data_file);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&transfer->outfile);
+	}
+	else
+	{
+		if (eMethod & connection::HTTP::method::GETSINGLELINE)
+			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, connection::HTTP::callback::write_curl_data_single_line);
+		else 
+			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, connection::HTTP::callback::write_curl_data);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&transfer->response.vResponse);
+
+		if ((int)eMethod & (connection::HTTP::method::POST | connection::HTTP::method::PUT | connection::HTTP::method::DELETE | connection::HTTP::method::PATCH))
 		{
-			// vResponse[0] contains the output file name
-			std::string szFilename;
-			szFilename.insert(szFilename.begin(), vResponse.begin(), vResponse.end());
-			outfile.open(szFilename.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
-			if (!outfile.is_open())
-				return false;
-			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, connection::HTTP::callback::write_curl_data_file);
-			curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&outfile);
+			if (eMethod & connection::HTTP::method::POST)
+				curl_easy_setopt(curl, CURLOPT_POST, 1);
+			else if (eMethod & connection::HTTP::method::PUT)
+				curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+			else if (eMethod & connection::HTTP::method::DELETE)
+				curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+			else if (eMethod & connection::HTTP::method::PATCH)
+				curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
+			// the transfer may outlive the caller's data
+			transfer->szPostdata = szPostdata;
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)transfer->szPostdata.size());
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->szPostdata.c_str());
 		}
-		else
-		{
-			if (eMethod & connection::HTTP::method::GETSINGLELINE)
-				curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, connection::HTTP::callback::write_curl_data_single_line);
-			else 
-				curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, connection::HTTP::callback::write_curl_data);
-			curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&vResponse);
+		else if (eMethod & connection::HTTP::method::OPTIONS)
+			curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "OPTIONS");
+	}
 
-			if ((int)eMethod & (connection::HTTP::method::POST | connection::HTTP::method::PUT | connection::HTTP::method::DELETE | connection::HTTP::method::PATCH))
-			{
-				if (eMethod & connection::HTTP::method::POST)
-					curl_easy_setopt(curl, CURLOPT_POST, 1);
-				else if (eMethod & connection::HTTP::method::PUT)
-					curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-				else if (eMethod & connection::HTTP::method::DELETE)
-					curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-				else if (eMethod & connection::HTTP::method::PATCH)
-					curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
-				curl_easy_setopt(curl, CURLOPT_POSTFIELDS, szPostdata.c_str());
-			}
-			else if (eMethod & connection::HTTP::method::OPTIONS)
-				curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "OPTIONS");
-		}
+	curl_easy_setopt(curl, CURLOPT_URL, szUrl.c_str());
+	return transfer;
+}
 
-		curl_easy_setopt(curl, CURLOPT_URL, szUrl.c_str());
-		res = curl_easy_perform(curl);
+void RESTClient::FinishTransfer(_tTransfer &transfer, const int res)
+{
+	if (res != CURLE_HTTP_RETURNED_ERROR)
+	{
+		// create a custom header
+		std::stringstream ss;
+		ss << "CURLE " << res << " " << curl_easy_strerror((CURLcode)res);
+		transfer.response.vHeaderData.push_back(ss.str());
+	}
 
-		if (res != CURLE_HTTP_RETURNED_ERROR)
-		{
-			// create a custom header
-			std::stringstream ss;
-			ss << "CURLE " << res << " " << curl_easy_strerror(res);
-			vHeaderData.push_back(ss.str());
-		}
+	// writes the cookie jar
+	curl_easy_cleanup(transfer.curl);
+	transfer.curl = nullptr;
 
-		curl_easy_cleanup(curl);
+	if (transfer.outfile.is_open())
+		transfer.outfile.close();
 
-		if (headers != nullptr)
-			curl_slist_free_all(headers);
+	transfer.response.bSuccess = (res == CURLE_OK);
+	if (!transfer.callback)
+		return;
+	try
+	{
+		transfer.callback(transfer.response);
+	}
+	catch (...)
+	{
+		_log.Log(LOG_ERROR, "HTTPClient: Exception in request callback");
+	}
+}
 
+bool RESTClient::ExecuteBinary(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, std::vector<unsigned char> &vResponse, std::vector<std::string> &vHeaderData, const bool bFollowRedirect, const long iTimeOut)
+{
+	try
+	{
+		if (!CheckIfGlobalInitDone())
+			return false;
+
+		std::string szFilename;
 		if (eMethod & connection::HTTP::method::DOWNLOAD)
-			outfile.close(); 
+		{
+			// vResponse[0] contains the output file name
+			szFilename.insert(szFilename.begin(), vResponse.begin(), vResponse.end());
+		}
+		std::shared_ptr<_tTransfer> transfer = CreateTransfer(eMethod, szUrl, szPostdata, vExtraHeaders, szFilename, bFollowRedirect, iTimeOut);
+		if (!transfer)
+			return false;
+
+		auto done = std::make_shared<std::promise<void>>();
+		std::future<void> future = done->get_future();
+		transfer->callback = [done](const _tResponse & /*response*/) { done->set_value(); };
+		s_engine.Perform(transfer, true);
+		future.wait();
 
-		return (res == CURLE_OK);
+		vResponse.insert(vResponse.end(), transfer->response.vResponse.begin(), transfer->response.vResponse.end());
+		vHeaderData.insert(vHeaderData.end(), transfer->response.vHeaderData.begin(), transfer->response.vHeaderData.end());
+		return transfer->response.bSuccess;
 	}
 	catch (...)
 	{
@@ -363,4 +611,35 @@ bool RESTClient::Execute(const connection::HTTP::method::value eMethod, const st
 	return true;
 }
 
+void RESTClient::ExecuteAsync(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const _tCallback &callback, const bool bFollowRedirect, const long iTimeOut)
+{
+	_tResponse response;
+	try
+	{
+		if ((CheckIfGlobalInitDone()) && (!(eMethod & connection::HTTP::method::DOWNLOAD)))
+		{
+			std::shared_ptr<_tTransfer> transfer = CreateTransfer(eMethod, szUrl, szPostdata, vExtraHeaders, "", bFollowRedirect, iTimeOut);
+			if (transfer)
+			{
+				transfer->callback = callback;
+				s_engine.Perform(transfer, false);
+				return;
+			}
+		}
+		response.vHeaderData.push_back("CURLE -1 Unable to start HTTP request");
+	}
+	catch (...)
+	{
+		// create a custom header
+		response.vHeaderData.push_back("CURLE -1 Exception in HTTP client");
+	}
+	callback(response);
+}
 
+std::future<RESTClient::_tResponse> RESTClient::ExecuteFuture(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const bool bFollowRedirect, const long iTimeOut)
+{
+	auto promise = std::make_shared<std::promise<_tResponse>>();
+	std::future<_tResponse> future = promise->get_future();
+	ExecuteAsync(eMethod, szUrl, szPostdata, vExtraHeaders, [promise](const _tResponse &response) { promise->set_value(response); }, bFollowRedirect, iTimeOut);
+	return future;
+}
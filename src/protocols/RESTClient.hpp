@@ -8,6 +8,9 @@
  */
 
 #pragma once
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -34,11 +37,13 @@ namespace connection {
 
 
 
+class CTransferEngine;
 
 class RESTClient
 {
 	// give MainWorker acces to the protected Cleanup() function
 	friend class HTTPClient;
+	friend class CTransferEngine;
 
       protected:
 	/************************************************************************
@@ -52,6 +57,16 @@ class RESTClient
 
       public:
 
+	struct _tResponse
+	{
+		bool bSuccess = false;
+		std::vector<unsigned char> vResponse;
+		std::vector<std::string> vHeaderData;
+	};
+	// called on the transfer thread, it should not block
+	typedef std::function<void(const _tResponse &response)> _tCallback;
+
+
 	/************************************************************************
 	 *									*
 	 * Configuration functions						*
@@ -80,6 +95,19 @@ class RESTClient
 	static bool Execute(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, std::string &szResponse, std::vector<std::string> &vHeaderData, const bool bFollowRedirect = true, const long iTimeOut = -1, const bool bIgnoreNoDataReturned = false);
 
 
+	/************************************************************************
+	 *									*
+	 * asynchronous methods							*
+	 *   - the request is queued on the shared transfer engine and the	*
+	 *     caller does not wait for it					*
+	 *   - DOWNLOAD is only supported by the methods above		*
+	 *									*
+	 ************************************************************************/
+
+	static void ExecuteAsync(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const _tCallback &callback, const bool bFollowRedirect = true, const long iTimeOut = -1);
+	static std::future<_tResponse> ExecuteFuture(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const bool bFollowRedirect = true, const long iTimeOut = -1);
+
+
 	/************************************************************************
 	 *									*
 	 * non public								*
@@ -87,6 +115,10 @@ class RESTClient
 	 ************************************************************************/
 
       private:
+	struct _tTransfer;
+
+	static std::shared_ptr<_tTransfer> CreateTransfer(const connection::HTTP::method::value eMethod, const std::string &szUrl, const std::string &szPostdata, const std::vector<std::string> &vExtraHeaders, const std::string &szFilename, const bool bFollowRedirect, const long iTimeOut);
+	static void FinishTransfer(_tTransfer &transfer, int res);
 	static void SetGlobalOptions(void *curlobj);
 	static bool CheckIfGlobalInitDone();
 	static void LogStatus(const long responseCode);
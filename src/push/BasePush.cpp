@@ -12,11 +12,10 @@
 #include <inttypes.h>
 #include <boost/date_time/c_local_time_adjustor.hpp>
 
-extern const char* findTableID1ID2(const _STR_TABLE_ID1_ID2* t, unsigned long id1, unsigned long id2);
 
 const char* RFX_Type_SubType_Values(const unsigned char dType, const unsigned char sType)
 {
-	static const STR_TABLE_ID1_ID2 Table[] = {
+	static constexpr STR_TABLE_ID1_ID2 Table[] = {
 		{ pTypeTEMP, sTypeTEMP1, "Temperature" },
 		{ pTypeTEMP, sTypeTEMP2, "Temperature" },
 		{ pTypeTEMP, sTypeTEMP3, "Temperature" },
@@ -364,7 +363,8 @@ const char* RFX_Type_SubType_Values(const unsigned char dType, const unsigned ch
 
 		{ 0, 0, nullptr },
 	};
-	return findTableID1ID2(Table, dType, sType);
+	static constexpr auto Index = BuildTableIndex(Table);
+	return findTableIndexed(Table, Index, dType, sType);
 }
 
 CBasePush::CBasePush()
@@ -923,48 +923,82 @@ std::string CBasePush::getUnit(const int devType, const int devSubType, const in
 
 void CBasePush::ReloadPushLinks(const PushType PType)
 {
-	std::lock_guard<std::mutex> l(m_link_mutex);
-	m_pushlinks.clear();
 	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Name, B.Type, B.SubType, B.SwitchType "
+	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, A.IncludeUnit, B.Name, B.Type, B.SubType, B.SwitchType "
 		"FROM PushLink as A, DeviceStatus as B "
 		"WHERE (A.PushType==%d AND A.Enabled==1 AND A.DeviceRowID == B.ID)",
 		PType);
+
+	std::unordered_map<uint64_t, std::shared_ptr<_tPushLinks>> pushlinks;
 	for (const auto& sd : result)
 	{
-		_tPushLinks tlink;
-		tlink.DeviceRowIdx = std::stoull(sd[0]);
-		tlink.DelimiterPos = std::stoi(sd[1]);
-		tlink.DeviceName = sd[3];
-		tlink.devType = std::stoi(sd[4]);
-		tlink.devSubType = std::stoi(sd[5]);
-		tlink.metertype = std::stoi(sd[6]);
-		m_pushlinks.push_back(tlink);
+		uint64_t DeviceRowIdx = std::stoull(sd[0]);
+		auto& tlink = pushlinks[DeviceRowIdx];
+		if (!tlink)
+		{
+			tlink = std::make_shared<_tPushLinks>();
+			tlink->DeviceRowIdx = DeviceRowIdx;
+			tlink->DeviceName = sd[7];
+			tlink->devType = std::stoi(sd[8]);
+			tlink->devSubType = std::stoi(sd[9]);
+			tlink->metertype = std::stoi(sd[10]);
+			tlink->pushType = PType;
+		}
+		_tPushLinkTarget target;
+		target.DelimiterPos = std::stoi(sd[1]);
+		target.TargetType = std::stoi(sd[2]);
+		target.TargetVariable = sd[3];
+		target.TargetDeviceID = sd[4];
+		target.TargetProperty = sd[5];
+		target.IncludeUnit = std::stoi(sd[6]);
+		target.ValueName = DropdownOptionsValue(tlink->devType, tlink->devSubType, target.DelimiterPos);
+		CompileLinkTarget(*tlink, target);
+		tlink->targets.push_back(target);
 	}
+
+	std::lock_guard<std::mutex> l(m_link_mutex);
+	m_pushlinks.clear();
+	for (auto& itt : pushlinks)
+		m_pushlinks[itt.first] = std::move(itt.second);
+}
+
+void CBasePush::CompileLinkTarget(const _tPushLinks& /*link*/, _tPushLinkTarget& target)
+{
+	target.FieldName = target.ValueName;
 }
 
 bool CBasePush::IsLinkInDatabase(const uint64_t DeviceRowIdx)
 {
 	std::lock_guard<std::mutex> l(m_link_mutex);
-	return std::any_of(m_pushlinks.begin(), m_pushlinks.end(), [&](const _tPushLinks& val) { return DeviceRowIdx == val.DeviceRowIdx; });
+	return (m_pushlinks.find(DeviceRowIdx) != m_pushlinks.end());
 }
 
-bool CBasePush::GetPushLink(const uint64_t DeviceRowIdx, _tPushLinks& plink)
+std::shared_ptr<const CBasePush::_tPushLinks> CBasePush::GetPushLink(const uint64_t DeviceRowIdx)
 {
 	std::lock_guard<std::mutex> l(m_link_mutex);
-	for (const auto& itt : m_pushlinks)
+	auto itt = m_pushlinks.find(DeviceRowIdx);
+	if (itt == m_pushlinks.end())
+		return nullptr;
+	return itt->second;
+}
+
+std::shared_ptr<const CBasePush::_tPushLinks> CBasePush::GetPushLinkValue(const uint64_t DeviceRowIdx, int& nValue, std::string& sValue, std::string& LastUpdate)
+{
+	auto link = GetPushLink(DeviceRowIdx);
+	if (!link)
+		return nullptr;
+	std::string Name;
+	if (!m_sql.GetDeviceValue(DeviceRowIdx, Name, nValue, sValue, LastUpdate))
+		return nullptr;
+	if (Name != link->DeviceName)
 	{
-		if (itt.DeviceRowIdx == DeviceRowIdx)
-		{
-			plink = itt;
-			return true;
-		}
+		// the keys contain the device name
+		ReloadPushLinks(m_PushType);
+		link = GetPushLink(DeviceRowIdx);
 	}
-	return false;
+	return link;
 }
 
-
-
 //Webserver helpers
 namespace http {
 	namespace server {
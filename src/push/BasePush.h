@@ -2,7 +2,9 @@
 
 #define BOOST_ALLOW_DEPRECATED_HEADERS
 #include <boost/signals2.hpp>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 
 class CBasePush
 {
@@ -17,18 +19,33 @@ class CBasePush
 		PUSHTYPE_WEBSOCKET,
 		PUSHTYPE_MQTT
 	};
+	// One enabled PushLink row, with everything that does not depend on the device value prepared at load time
+	struct _tPushLinkTarget
+	{
+		int DelimiterPos;
+		int TargetType;
+		std::string TargetVariable;
+		std::string TargetDeviceID;
+		std::string TargetProperty;
+		int IncludeUnit;
+		std::string ValueName;	// DropdownOptionsValue() of DelimiterPos
+		std::string FieldName;	// filled in by CompileLinkTarget()
+		std::string Key;	// filled in by CompileLinkTarget()
+	};
+	// All links of one device
 	struct _tPushLinks
 	{
 		uint64_t DeviceRowIdx;
 		std::string DeviceName;
-		int DelimiterPos;
 		int devType;
 		int devSubType;
 		int metertype;
 		PushType pushType;
+		std::vector<_tPushLinkTarget> targets;
 	};
 
 	CBasePush();
+	virtual ~CBasePush() = default;
 
 	static std::vector<std::string> DropdownOptions(const int devType, const int devSubType);
 	static std::string DropdownOptionsValue(const int devType, const int devSubType, const int pos);
@@ -44,7 +61,7 @@ class CBasePush
 		const int metertype);
 
 	void ReloadPushLinks(const PushType PType);
-	bool GetPushLink(const uint64_t DeviceRowIdx, _tPushLinks& plink);
+	std::shared_ptr<const _tPushLinks> GetPushLink(const uint64_t DeviceRowIdx);
 
 protected:
 	PushType m_PushType;
@@ -62,10 +79,14 @@ class CBasePush
 	static void replaceAll(std::string& context, const std::string& from, const std::string& to);
 
 	bool IsLinkInDatabase(const uint64_t DeviceRowIdx);
+	// Links of the device together with its current value, reloads the links when the device was renamed
+	std::shared_ptr<const _tPushLinks> GetPushLinkValue(const uint64_t DeviceRowIdx, int &nValue, std::string &sValue, std::string &LastUpdate);
+	// Lets a push type prepare the names and keys it sends for a link
+	virtual void CompileLinkTarget(const _tPushLinks &link, _tPushLinkTarget &target);
 
 	std::mutex m_link_mutex;
 
 private:
-	std::vector<_tPushLinks> m_pushlinks;
+	std::unordered_map<uint64_t, std::shared_ptr<const _tPushLinks>> m_pushlinks;
 };
 
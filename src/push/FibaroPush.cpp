@@ -5,6 +5,7 @@
 #include "main/json_helper.h"
 #include "main/Helper.h"
 #include "main/Logger.h"
+#include "main/Metrics.h"
 #include "main/mainworker.h"
 #include "main/RFXtrx.h"
 #include "main/SQLHelper.h"
@@ -52,6 +53,7 @@ void CFibaroPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowId
 
 void CFibaroPush::DoFibaroPush(const uint64_t DeviceRowIdx)
 {
+	CMetrics::CTimer timer("oikomaticz_push_seconds", CMetrics::Label("target", "fibaro"));
 	std::vector<std::vector<std::string>> result;
 	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, "
 				  "A.IncludeUnit, B.SwitchType FROM PushLink as A, DeviceStatus as B "
@@ -4,6 +4,7 @@
 #include "main/json_helper.h"
 #include "main/Helper.h"
 #include "main/Logger.h"
+#include "main/Metrics.h"
 #include "main/RFXtrx.h"
 #include "main/SQLHelper.h"
 #include "main/mainworker.h"
@@ -102,6 +103,7 @@ boost::python::dict toPythonDict(std::map<K, V> map) {
 
 void CGooglePubSubPush::DoGooglePubSubPush(const uint64_t DeviceRowIdx)
 {
+	CMetrics::CTimer timer("oikomaticz_push_seconds", CMetrics::Label("target", "googlepubsub"));
 	std::vector<std::vector<std::string>> result;
 	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, "
 				  "A.IncludeUnit, B.SwitchType, strftime('%%s', B.LastUpdate), B.Name FROM PushLink as A, DeviceStatus as B "
@@ -3,6 +3,7 @@
 #include "main/Helper.h"
 #include "protocols/HTTPClient.h"
 #include "main/Logger.h"
+#include "main/Metrics.h"
 #include "hardware/hardwaretypes.h"
 #include "main/RFXtrx.h"
 #include "main/SQLHelper.h"
@@ -41,6 +42,19 @@ void CHttpPush::UpdateActive()
 	int fActive = 0;
 	m_sql.GetPreferencesVar("HttpActive", fActive);
 	m_bLinkActive = (fActive == 1);
+
+	std::lock_guard<std::mutex> l(m_settings_mutex);
+	m_settings = _tHttpSettings();
+	m_sql.GetPreferencesVar("HttpUrl", m_settings.Url);
+	m_sql.GetPreferencesVar("HttpData", m_settings.Data);
+	m_sql.GetPreferencesVar("HttpHeaders", m_settings.Headers);
+	m_sql.GetPreferencesVar("HttpMethod", m_settings.Method);
+	m_sql.GetPreferencesVar("HttpAuth", m_settings.Auth);
+	m_sql.GetPreferencesVar("HttpAuthBasicLogin", m_settings.AuthBasicLogin);
+	m_sql.GetPreferencesVar("HttpAuthBasicPassword", m_settings.AuthBasicPassword);
+	int httpDebugActiveInt = 0;
+	m_sql.GetPreferencesVar("HttpDebug", httpDebugActiveInt);
+	m_settings.bDebug = (httpDebugActiveInt == 1);
 }
 
 void CHttpPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
@@ -51,62 +65,59 @@ void CHttpPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx,
 	}
 }
 
+// Same result as sqlite strftime('%s', LastUpdate), the stored local time is taken as UTC
+static int64_t SQLDateTimeToEpoch(const std::string &szDateTime)
+{
+	int year, month, day, hour, minute, second;
+	if (sscanf(szDateTime.c_str(), "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6)
+		return 0;
+	// days since 1970-01-01 in the proleptic Gregorian calendar
+	year -= (month <= 2) ? 1 : 0;
+	const int era = ((year >= 0) ? year : year - 399) / 400;
+	const int yoe = year - era * 400;
+	const int doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+	const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	const int64_t days = static_cast<int64_t>(era) * 146097 + doe - 719468;
+	return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
 void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 {
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, "
-				  "A.IncludeUnit, B.SwitchType, strftime('%%s', B.LastUpdate), B.Name FROM PushLink as A, DeviceStatus as B "
-				  "WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled = '1' AND A.DeviceRowID==B.ID)",
-				  PushType::PUSHTYPE_HTTP, DeviceRowIdx);
-	if (result.empty())
+	CMetrics::CTimer timer("oikomaticz_push_seconds", CMetrics::Label("target", "http"));
+	int nValue;
+	std::string sValue, sLastUpdate;
+	auto link = GetPushLinkValue(DeviceRowIdx, nValue, sValue, sLastUpdate);
+	if (!link)
 		return;
 
-	std::string httpUrl;
-	std::string httpData;
-	std::string httpHeaders;
-	int httpMethodInt = 0;
-	int httpAuthInt = 0;
-	std::string httpAuthBasicLogin;
-	std::string httpAuthBasicPassword;
-	m_sql.GetPreferencesVar("HttpMethod", httpMethodInt);
-	m_sql.GetPreferencesVar("HttpAuth", httpAuthInt);
-	m_sql.GetPreferencesVar("HttpAuthBasicLogin", httpAuthBasicLogin);
-	m_sql.GetPreferencesVar("HttpAuthBasicPassword", httpAuthBasicPassword);
-
-	int httpDebugActiveInt = 0;
-	bool httpDebugActive = false;
-	m_sql.GetPreferencesVar("HttpDebug", httpDebugActiveInt);
-	if (httpDebugActiveInt == 1) {
-		httpDebugActive = true;
+	_tHttpSettings settings;
+	{
+		std::lock_guard<std::mutex> l(m_settings_mutex);
+		settings = m_settings;
 	}
+	if (settings.Url.empty())
+		return;
+	bool httpDebugActive = settings.bDebug;
+
+	int dType = link->devType;
+	int dSubType = link->devSubType;
+	int metertype = link->metertype;
+	int lastUpdate = static_cast<int>(SQLDateTimeToEpoch(sLastUpdate));
+	std::string sdeviceId = std::to_string(DeviceRowIdx);
+	std::string lname = link->DeviceName;
 
-	for (const auto &sd : result)
+	for (const auto &target : link->targets)
 	{
 		std::string sendValue;
-		m_sql.GetPreferencesVar("HttpUrl", httpUrl);
-		m_sql.GetPreferencesVar("HttpData", httpData);
-		m_sql.GetPreferencesVar("HttpHeaders", httpHeaders);
-		if (httpUrl.empty())
-			return;
-
-		//unsigned int deviceId = atoi(sd[0].c_str());
-		std::string sdeviceId = sd[0];
-		std::string ldelpos = sd[1];
-		int delpos = atoi(sd[1].c_str());
-		int dType = atoi(sd[3].c_str());
-		int dSubType = atoi(sd[4].c_str());
-		int nValue = atoi(sd[5].c_str());
-		std::string sValue = sd[6];
-		//int targetType = atoi(sd[7].c_str());
-		std::string targetVariable = sd[8];
-		//int targetDeviceID = atoi(sd[9].c_str());
-		//std::string targetProperty = sd[10].c_str();
-		int includeUnit = atoi(sd[11].c_str());
-		int metertype = atoi(sd[12].c_str());
-		int lastUpdate = atoi(sd[13].c_str());
-		std::string ltargetVariable = sd[8];
-		std::string ltargetDeviceId = sd[9];
-		std::string lname = sd[14];
+		std::string httpUrl = settings.Url;
+		std::string httpData = settings.Data;
+
+		std::string ldelpos = std::to_string(target.DelimiterPos);
+		int delpos = target.DelimiterPos;
+		std::string targetVariable = target.TargetVariable;
+		int includeUnit = target.IncludeUnit;
+		std::string ltargetVariable = target.TargetVariable;
+		std::string ltargetDeviceId = target.TargetDeviceID;
 		sendValue = sValue;
 
 		unsigned long tzoffset = get_tzoffset();
@@ -202,9 +213,9 @@ void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 
 		std::string sResult;
 		std::vector<std::string> ExtraHeaders;
-		if (httpAuthInt == 1) {			// BASIC authentication
+		if (settings.Auth == 1) {			// BASIC authentication
 			std::stringstream sstr;
-			sstr << httpAuthBasicLogin << ":" << httpAuthBasicPassword;
+			sstr << settings.AuthBasicLogin << ":" << settings.AuthBasicPassword;
 			std::string m_AccessToken = base64_encode(sstr.str());
 			ExtraHeaders.push_back("Authorization:Basic " + m_AccessToken);
 		}
@@ -215,18 +226,18 @@ void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 			_log.Log(LOG_NORM, "HttpLink: sending global variable %s with value: %s", targetVariable.c_str(), sendValue.c_str());
 		}
 
-		if (httpMethodInt == 0) {			// GET
+		if (settings.Method == 0) {			// GET
 			if (!HTTPClient::GET(httpUrl, ExtraHeaders, sResult, true))
 			{
 				_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with GET!");
 			}
 		}
-		else if (httpMethodInt == 1) {		// POST
-			if (!httpHeaders.empty())
+		else if (settings.Method == 1) {		// POST
+			if (!settings.Headers.empty())
 			{
 				// Add additional headers
 				std::vector<std::string> ExtraHeaders2;
-				StringSplit(httpHeaders, "\r\n", ExtraHeaders2);
+				StringSplit(settings.Headers, "\r\n", ExtraHeaders2);
 				std::copy(ExtraHeaders2.begin(), ExtraHeaders2.end(), std::back_inserter(ExtraHeaders));
 			}
 			if (!HTTPClient::POST(httpUrl, httpData, ExtraHeaders, sResult, true, true))
@@ -234,7 +245,7 @@ void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 				_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with POST!");
 			}
 		}
-		else if (httpMethodInt == 2) {		// PUT
+		else if (settings.Method == 2) {		// PUT
 			if (!HTTPClient::PUT(httpUrl, httpData, ExtraHeaders, sResult, true))
 			{
 				_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with PUT!");
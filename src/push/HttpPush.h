@@ -13,7 +13,21 @@ class CHttpPush : public CBasePush, public StoppableTask
 	void UpdateActive();
 
 private:
+  struct _tHttpSettings
+  {
+	  std::string Url;
+	  std::string Data;
+	  std::string Headers;
+	  int Method = 0;
+	  int Auth = 0;
+	  std::string AuthBasicLogin;
+	  std::string AuthBasicPassword;
+	  bool bDebug = false;
+  };
   void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand);
   void DoHttpPush(const uint64_t DeviceRowIdx);
+
+  std::mutex m_settings_mutex;
+  _tHttpSettings m_settings;
 };
 extern CHttpPush m_httppush;
@@ -6,16 +6,26 @@
 #include "main/Helper.h"
 #include "main/json_helper.h"
 #include "main/Logger.h"
+#include "main/Metrics.h"
 #include "main/mainworker.h"
 #include "main/RFXtrx.h"
 #include "main/SQLHelper.h"
 #include "main/WebServer.h"
 #include "webserver/Base64.h"
 #include "webserver/cWebem.h"
+#include "webserver/GZipHelper.h"
+#include <chrono>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
 extern CInfluxPush m_influxpush;
+extern std::string szUserDataFolder;
+
+// every point is appended to the disk spool when it arrives, the sender replays the spool in batches
+#define INFLUX_SPOOL_SEGMENT_SIZE (1024 * 1024)
+#define INFLUX_SPOOL_MAX_SEGMENTS 16
+#define INFLUX_BACKOFF_MIN 1000
+#define INFLUX_BACKOFF_MAX (5 * 60 * 1000)
 
 CInfluxPush::CInfluxPush()
 {
@@ -31,6 +41,7 @@ bool CInfluxPush::Start()
 
 	UpdateSettings();
 	ReloadPushLinks(m_PushType);
+	LoadSpool();
 
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "InfluxPush");
@@ -51,6 +62,13 @@ void CInfluxPush::Stop()
 		m_thread->join();
 		m_thread.reset();
 	}
+
+	// everything that was not sent stays in the spool for the next start
+	std::lock_guard<std::mutex> l(m_background_task_mutex);
+	if (m_SpoolFile.is_open())
+		m_SpoolFile.close();
+	m_ReplayLines.clear();
+	m_bReplayActive = false;
 }
 
 void CInfluxPush::UpdateSettings()
@@ -71,6 +89,15 @@ void CInfluxPush::UpdateSettings()
 	m_sql.GetPreferencesVar("InfluxUsername", m_InfluxUsername);
 	m_sql.GetPreferencesVar("InfluxPassword", m_InfluxPassword);
 
+	m_iBatchSize = 500;
+	m_sql.GetPreferencesVar("InfluxBatchSize", m_iBatchSize);
+	if (m_iBatchSize < 1)
+		m_iBatchSize = 1;
+	m_iLinger = 500;
+	m_sql.GetPreferencesVar("InfluxLinger", m_iLinger);
+	if (m_iLinger < 10)
+		m_iLinger = 10;
+
 	int InfluxDebugActiveInt = 0;
 	m_bInfluxDebugActive = false;
 	m_sql.GetPreferencesVar("InfluxDebug", InfluxDebugActiveInt);
@@ -104,7 +131,7 @@ void CInfluxPush::UpdateSettings()
 		sURL << "org=" << m_InfluxUsername;
 		sURL << "&bucket=" << m_InfluxDatabase;
 	}
-	sURL << "&precision=s";
+	sURL << "&precision=ns";
 	m_szURL = sURL.str();
 }
 
@@ -113,65 +140,51 @@ void CInfluxPush::OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std
 	DoInfluxPush(DeviceRowIdx);
 }
 
+void CInfluxPush::CompileLinkTarget(const _tPushLinks &link, _tPushLinkTarget &target)
+{
+	std::string vType = target.ValueName;
+	std::string name = link.DeviceName;
+	stdreplace(vType, " ", "-");
+	stdreplace(name, " ", "-");
+	target.FieldName = vType;
+	target.Key = vType + ",idx=" + std::to_string(link.DeviceRowIdx) + ",name=" + name;
+}
+
 void CInfluxPush::DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced)
 {
 	if (!m_bLinkActive)
 		return;
-	if (!IsLinkInDatabase(DeviceRowIdx))
+	int nValue;
+	std::string sValue, sLastUpdate;
+	auto link = GetPushLinkValue(DeviceRowIdx, nValue, sValue, sLastUpdate);
+	if (!link)
 		return;
 
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query(
-		"SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.IncludeUnit, B.Name, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-		"WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled==1 AND A.DeviceRowID==B.ID)",
-		PushType::PUSHTYPE_INFLUXDB, DeviceRowIdx);
-	if (result.empty())
-		return;
-
-	int dType = atoi(result[0][3].c_str());
-	int dSubType = atoi(result[0][4].c_str());
-	int nValue = atoi(result[0][5].c_str());
-	std::string sValue = result[0][6];
-	std::string name = result[0][9];
-	int metertype = atoi(result[0][10].c_str());
-
-	time_t atime = mytime(nullptr);
-	for (const auto &sd : result)
+	std::string szTimestamp = std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+	for (const auto &target : link->targets)
 	{
 		std::string sendValue;
-		int delpos = atoi(sd[1].c_str());
-		int targetType = atoi(sd[7].c_str());
-		int includeUnit = atoi(sd[8].c_str());
+		int delpos = target.DelimiterPos;
 
-		std::vector<std::string> strarray;
 		if (sValue.find(';') != std::string::npos)
 		{
+			std::vector<std::string> strarray;
 			std::string rawsendValue("");
 			StringSplit(sValue, ";", strarray);
 			if (int(strarray.size()) >= delpos)
 			{
 				rawsendValue = strarray[delpos - 1];
 			}
-			sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
+			sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, target.IncludeUnit, link->devType, link->devSubType, link->metertype);
 		}
 		else
-			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
+			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, sValue, target.IncludeUnit, link->devType, link->devSubType, link->metertype);
 
 		if (sendValue.empty())
 			continue;
 
-		std::string szKey;
-		std::string vType = CBasePush::DropdownOptionsValue(dType, dSubType, delpos);
-		stdreplace(vType, " ", "-");
-		stdreplace(name, " ", "-");
-		szKey = vType + ",idx=" + sd[0] + ",name=" + name;
-
-		_tPushItem pItem;
-		pItem.skey = szKey;
-		pItem.stimestamp = atime;
-		pItem.svalue = sendValue;
-
-		if ((targetType == 0) && (!bForced))
+		const std::string &szKey = target.Key;
+		if ((target.TargetType == 0) && (!bForced))
 		{
 			// Only send on change
 			auto itt = m_PushedItems.find(szKey);
@@ -180,96 +193,306 @@ void CInfluxPush::DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced)
 				if (sendValue == itt->second.svalue)
 					continue;
 			}
+			_tPushItem pItem;
+			pItem.skey = szKey;
+			pItem.svalue = sendValue;
 			m_PushedItems[szKey] = pItem;
 		}
 
+		std::string szLine = szKey + " value=";
+		if (szKey.find("Text,") == 0)
+		{
+			// string field, the spool holds one point per line
+			std::string szText = sendValue;
+			stdreplace(szText, "\\", "\\\\");
+			stdreplace(szText, "\"", "\\\"");
+			stdreplace(szText, "\n", "\\n");
+			szLine += "\"" + szText + "\"";
+		}
+		else
+			szLine += sendValue;
+		if (m_bInfluxDebugActive)
+		{
+			_log.Log(LOG_NORM, "InfluxLink: value %s", szLine.c_str());
+		}
+		szLine += " " + szTimestamp;
+
+		m_nQueued++;
 		std::lock_guard<std::mutex> l(m_background_task_mutex);
-		if (m_background_task_queue.size() < 50)
-			m_background_task_queue.push_back(pItem);
+		if (!SpoolLine(szLine))
+			m_nDropped++;
 	}
 }
 
-void CInfluxPush::Do_Work()
+std::string CInfluxPush::GetSpoolSegmentName(const uint64_t iSegment)
 {
-	std::vector<_tPushItem> _items2do;
+	char szName[40];
+	snprintf(szName, sizeof(szName), "influxdb_spool_%010" PRIu64 ".lp", iSegment);
+	return szUserDataFolder + szName;
+}
 
-	while (!IsStopRequested(500))
+// Pick up the segments left behind by a previous run
+void CInfluxPush::LoadSpool()
+{
+	std::lock_guard<std::mutex> l(m_background_task_mutex);
+	m_SpoolSegments.clear();
+	m_iNextSpoolSegment = 0;
+	m_nPending = 0;
+
+	std::vector<std::string> entries;
+	DirectoryListing(entries, szUserDataFolder.empty() ? "." : szUserDataFolder, false, true);
+	for (const auto &szFile : entries)
 	{
-		{ // additional scope for lock (accessing size should be within lock too)
-			std::lock_guard<std::mutex> l(m_background_task_mutex);
-			if (m_background_task_queue.empty())
-				continue;
-			_items2do = m_background_task_queue;
-			m_background_task_queue.clear();
-		}
-
-		if (m_szURL.empty())
+		uint64_t iSegment;
+		if ((szFile.size() != strlen("influxdb_spool_0000000000.lp")) || (sscanf(szFile.c_str(), "influxdb_spool_%" SCNu64 ".lp", &iSegment) != 1))
 			continue;
+		m_SpoolSegments.push_back(iSegment);
+		m_iNextSpoolSegment = std::max(m_iNextSpoolSegment, iSegment + 1);
 
-		std::string sSendData;
-
-		for (const auto &item : _items2do)
+		std::ifstream infile(GetSpoolSegmentName(iSegment).c_str(), std::ios::in | std::ios::binary);
+		std::string szLine;
+		while (std::getline(infile, szLine))
 		{
-			if (!sSendData.empty())
-				sSendData += '\n';
-
-			std::stringstream sziData;
-			sziData << item.skey << " value=";
-			if (item.skey.find("Text,") == 0)
-				sziData << "\"" << item.svalue << "\"";
-			else
-				sziData << item.svalue;
-			if (m_bInfluxDebugActive)
-			{
-				_log.Log(LOG_NORM, "InfluxLink: value %s", sziData.str().c_str());
-			}
-			sziData << " " << item.stimestamp;
-			sSendData += sziData.str();
+			if (!szLine.empty())
+				m_nPending++;
 		}
-		std::vector<std::string> ExtraHeaders;
-		std::string sResult;
-		if (m_bInfluxVersion2)
+	}
+	std::sort(m_SpoolSegments.begin(), m_SpoolSegments.end());
+	if (!m_SpoolSegments.empty())
+		_log.Log(LOG_STATUS, "InfluxLink: %d spooled segment(s) pending", static_cast<int>(m_SpoolSegments.size()));
+}
+
+// Append a point to the newest segment (m_background_task_mutex locked), false when the spool is full
+bool CInfluxPush::SpoolLine(const std::string &szLine)
+{
+	if ((!m_SpoolFile.is_open()) || (m_iSpoolFileSize >= INFLUX_SPOOL_SEGMENT_SIZE))
+	{
+		if (m_SpoolFile.is_open())
+			m_SpoolFile.close();
+		if (m_SpoolSegments.size() >= INFLUX_SPOOL_MAX_SEGMENTS)
+			return false;
+		uint64_t iSegment = m_iNextSpoolSegment++;
+		m_SpoolFile.open(GetSpoolSegmentName(iSegment).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_SpoolFile.is_open())
 		{
-			ExtraHeaders.push_back("Authorization: Token " + base64_decode(m_InfluxPassword));
-			ExtraHeaders.push_back("Content-type: text/plain");
+			_log.Log(LOG_ERROR, "InfluxLink: Unable to create spool file %s", GetSpoolSegmentName(iSegment).c_str());
+			return false;
 		}
+		m_SpoolSegments.push_back(iSegment);
+		m_iSpoolFileSize = 0;
+		m_iSpoolFileLines = 0;
+	}
+	m_SpoolFile << szLine << '\n';
+	m_SpoolFile.flush();
+	m_iSpoolFileSize += szLine.size() + 1;
+	m_iSpoolFileLines++;
+	m_nPending++;
+	return true;
+}
 
-		bool bRet = HTTPClient::POST(m_szURL, sSendData, ExtraHeaders, sResult, true, true);
-		if (!bRet)
+// Move the oldest segment to the replay buffer, it is deleted once all its points are sent.
+// When that is the segment being written, new points go to a new segment from here on
+bool CInfluxPush::LoadSpoolSegment()
+{
+	uint64_t iSegment;
+	{
+		std::lock_guard<std::mutex> l(m_background_task_mutex);
+		if (m_SpoolSegments.empty())
+			return false;
+		iSegment = m_SpoolSegments.front();
+		m_SpoolSegments.pop_front();
+		if (m_SpoolSegments.empty() && m_SpoolFile.is_open())
+			m_SpoolFile.close(); // this was the segment being written
+	}
+
+	std::ifstream infile(GetSpoolSegmentName(iSegment).c_str(), std::ios::in | std::ios::binary);
+	std::string szLine;
+	while (std::getline(infile, szLine))
+	{
+		if (!szLine.empty())
+			m_ReplayLines.push_back(szLine);
+	}
+	infile.close();
+	m_iReplaySegment = iSegment;
+	m_bReplayActive = true;
+	return true;
+}
+
+// Take the next batch from the spool
+bool CInfluxPush::FillBatch(std::vector<std::string> &batch, const size_t iBatchSize)
+{
+	while (m_ReplayLines.empty())
+	{
+		if (m_bReplayActive)
 		{
-			_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (check address/port/database/username/password)");
+			// empty segment
+			std::remove(GetSpoolSegmentName(m_iReplaySegment).c_str());
+			m_bReplayActive = false;
 		}
-		else if (!sResult.empty())
+		if (!LoadSpoolSegment())
+			return false;
+	}
+	size_t iCount = std::min(iBatchSize, m_ReplayLines.size());
+	batch.assign(m_ReplayLines.begin(), m_ReplayLines.begin() + iCount);
+	return true;
+}
+
+// Returns the HTTP status code of the last response in vHeaderData (there can be more after a redirect), 0 when there is none
+static int GetHTTPStatusCode(const std::vector<std::string> &vHeaderData)
+{
+	int iStatusCode = 0;
+	for (const auto &szHeader : vHeaderData)
+	{
+		if (szHeader.find("HTTP/") != 0)
+			continue;
+		size_t pos = szHeader.find(' ');
+		if (pos != std::string::npos)
+			iStatusCode = atoi(szHeader.c_str() + pos + 1);
+	}
+	return iStatusCode;
+}
+
+CInfluxPush::_eSendResult CInfluxPush::SendBatch(const std::vector<std::string> &batch)
+{
+	CMetrics::CTimer timer("oikomaticz_push_seconds", CMetrics::Label("target", "influxdb"));
+
+	std::string sSendData;
+	for (const auto &szLine : batch)
+	{
+		sSendData += szLine;
+		sSendData += '\n';
+	}
+
+	std::vector<std::string> ExtraHeaders;
+	std::vector<std::string> vHeaderData;
+	std::string sResult;
+	if (m_bInfluxVersion2)
+	{
+		ExtraHeaders.push_back("Authorization: Token " + base64_decode(m_InfluxPassword));
+		ExtraHeaders.push_back("Content-type: text/plain");
+	}
+	CA2GZIP gzip((char *)sSendData.c_str(), (int)sSendData.size());
+	if (gzip.Length > 0)
+	{
+		sSendData.assign((char *)gzip.pgzip, gzip.Length);
+		ExtraHeaders.push_back("Content-Encoding: gzip");
+	}
+
+	if (!HTTPClient::POST(m_szURL, sSendData, ExtraHeaders, sResult, vHeaderData, true, true))
+		return SEND_FAILED;
+	int iStatusCode = GetHTTPStatusCode(vHeaderData);
+	if ((iStatusCode >= 200) && (iStatusCode <= 299))
+		return SEND_OK;
+
+	// the body tells why, when it is JSON (a proxy in between can answer with anything)
+	std::string szMessage;
+	Json::Value root;
+	if (ParseJSon(sResult, root) && root.isObject())
+	{
+		if (!root["message"].empty())
+			szMessage = root["message"].asString(); // InfluxDB 2.x
+		else if (!root["error"].empty())
+			szMessage = root["error"].asString(); // InfluxDB 1.x
+	}
+	if (szMessage.empty())
+		szMessage = std_format("HTTP status %d", iStatusCode);
+
+	if (iStatusCode == 413)
+		return SEND_TOO_LARGE;
+	if ((iStatusCode == 400) || (iStatusCode == 422))
+	{
+		// unable to parse, partial write, field type conflict: sending them again does not help
+		_log.Log(LOG_ERROR, "InfluxLink: InfluxDB server rejected %d point(s)! (%s)", static_cast<int>(batch.size()), szMessage.c_str());
+		return SEND_REJECTED;
+	}
+	_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (%s)", szMessage.c_str());
+	return SEND_FAILED;
+}
+
+void CInfluxPush::Do_Work()
+{
+	std::vector<std::string> batch;
+	size_t iBatchSize = static_cast<size_t>(m_iBatchSize); // lowered when the server says a batch is too large
+	int iBackoff = 0;
+
+	while (!IsStopRequested((iBackoff > 0) ? iBackoff : m_iLinger))
+	{
+		if (m_szURL.empty())
+			continue;
+
+		// send full batches back to back, a partial batch waits for the next linger period
+		do
 		{
-			Json::Value root;
-			bool ret = ParseJSon(sResult, root);
-			if (root.isObject())
+			if (batch.empty() && !FillBatch(batch, iBatchSize))
+				break;
+
+			_eSendResult result = SendBatch(batch);
+			if (result == SEND_FAILED)
 			{
-				if (!root["code"].empty())
+				if (iBackoff == 0)
 				{
-					std::string szCode = root["code"].asString();
-					bool bHaveError = false;
-					std::string szMessage;
-
-					if (
-						(szCode == "unauthorized")
-						|| (szCode == "forbidden")
-						)
-					{
-						bHaveError = true;
-						szMessage = root["message"].asString();
-					}
-
-					if (bHaveError)
-					{
-						_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (%s)", szMessage.c_str());
-					}
+					_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (check address/port/database/username/password), will retry");
+					iBackoff = INFLUX_BACKOFF_MIN;
 				}
+				else
+					iBackoff = std::min(iBackoff * 2, INFLUX_BACKOFF_MAX);
+				m_nRetried += batch.size();
+				break;
 			}
-		}
+			if (iBackoff != 0)
+			{
+				_log.Log(LOG_STATUS, "InfluxLink: Connection to InfluxDB server restored");
+				iBackoff = 0;
+			}
+			if ((result == SEND_TOO_LARGE) && (batch.size() > 1))
+			{
+				// send the first half again, the rest follows in the next batches
+				iBatchSize = batch.size() / 2;
+				batch.resize(iBatchSize);
+				_log.Log(LOG_STATUS, "InfluxLink: InfluxDB server refused a batch as too large, sending %d point(s) per batch", static_cast<int>(iBatchSize));
+				continue;
+			}
+			if (result == SEND_OK)
+				m_nSent += batch.size();
+			else
+			{
+				if (result == SEND_TOO_LARGE)
+					_log.Log(LOG_ERROR, "InfluxLink: InfluxDB server refused a point as too large! (%s)", batch[0].c_str());
+				m_nDropped += batch.size();
+			}
+			m_nPending -= std::min<uint64_t>(m_nPending, batch.size());
+			m_ReplayLines.erase(m_ReplayLines.begin(), m_ReplayLines.begin() + batch.size());
+			if (m_ReplayLines.empty())
+			{
+				std::remove(GetSpoolSegmentName(m_iReplaySegment).c_str());
+				m_bReplayActive = false;
+			}
+			batch.clear();
+		} while (!IsStopRequested(0) && HasFullBatch(iBatchSize));
 	}
 }
 
+// True when a full batch is waiting, there is no need to wait for the linger period
+bool CInfluxPush::HasFullBatch(const size_t iBatchSize)
+{
+	if (m_ReplayLines.size() >= iBatchSize)
+		return true;
+	std::lock_guard<std::mutex> l(m_background_task_mutex);
+	size_t iClosedSegments = m_SpoolSegments.size() - (m_SpoolFile.is_open() ? 1 : 0);
+	return ((iClosedSegments != 0) || (m_SpoolFile.is_open() && (m_iSpoolFileLines >= iBatchSize)));
+}
+
+void CInfluxPush::GetStatistics(Json::Value &root)
+{
+	root["Queued"] = static_cast<Json::UInt64>(m_nQueued.load());
+	root["Sent"] = static_cast<Json::UInt64>(m_nSent.load());
+	root["Dropped"] = static_cast<Json::UInt64>(m_nDropped.load());
+	root["Retried"] = static_cast<Json::UInt64>(m_nRetried.load());
+	std::lock_guard<std::mutex> l(m_background_task_mutex);
+	root["Pending"] = static_cast<Json::UInt64>(m_nPending.load());
+	root["SpooledSegments"] = static_cast<Json::UInt64>(m_SpoolSegments.size());
+}
+
 // Webserver helpers
 namespace http
 {
@@ -292,6 +515,8 @@ namespace http
 			std::string username = request::findValue(&req, "username");
 			std::string password = request::findValue(&req, "password");
 			std::string debugenabled = request::findValue(&req, "debugenabled");
+			std::string batchsize = request::findValue(&req, "batchsize");
+			std::string linger = request::findValue(&req, "linger");
 			if ((linkactive.empty()) || (remote.empty()) || (port.empty()) || (database.empty()) || (debugenabled.empty()))
 				return;
 			int ilinkactive = atoi(linkactive.c_str());
@@ -305,6 +530,10 @@ namespace http
 			m_sql.UpdatePreferencesVar("InfluxUsername", username);
 			m_sql.UpdatePreferencesVar("InfluxPassword", base64_encode(password));
 			m_sql.UpdatePreferencesVar("InfluxDebug", idebugenabled);
+			if (!batchsize.empty())
+				m_sql.UpdatePreferencesVar("InfluxBatchSize", atoi(batchsize.c_str()));
+			if (!linger.empty())
+				m_sql.UpdatePreferencesVar("InfluxLinger", atoi(linger.c_str()));
 			m_influxpush.UpdateSettings();
 			root["status"] = "OK";
 			root["title"] = "SaveInfluxLinkConfig";
@@ -367,6 +596,13 @@ namespace http
 			{
 				root["InfluxDebug"] = 0;
 			}
+			nValue = 500;
+			m_sql.GetPreferencesVar("InfluxBatchSize", nValue);
+			root["InfluxBatchSize"] = nValue;
+			nValue = 500;
+			m_sql.GetPreferencesVar("InfluxLinger", nValue);
+			root["InfluxLinger"] = nValue;
+			m_influxpush.GetStatistics(root["InfluxStats"]);
 			root["status"] = "OK";
 			root["title"] = "GetInfluxLinkConfig";
 		}
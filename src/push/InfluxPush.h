@@ -2,6 +2,14 @@
 #include "BasePush.h"
 
 #include "main/StoppableTask.h"
+#include <atomic>
+#include <deque>
+#include <fstream>
+
+namespace Json
+{
+	class Value;
+} // namespace Json
 
 class CInfluxPush : public CBasePush, public StoppableTask
 {
@@ -11,21 +19,55 @@ class CInfluxPush : public CBasePush, public StoppableTask
 	void Stop();
 	void UpdateSettings();
 	void DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced = false);
+	void GetStatistics(Json::Value &root);
 private:
 	struct _tPushItem
 	{
 		std::string skey;
-		time_t stimestamp;
 		std::string svalue;
 	};
 	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand);
+	void CompileLinkTarget(const _tPushLinks &link, _tPushLinkTarget &target) override;
 
 	std::shared_ptr<std::thread> m_thread;
 	std::mutex m_background_task_mutex;
 	void Do_Work();
+	enum _eSendResult
+	{
+		SEND_OK,
+		SEND_REJECTED,	// the server can not store the points, sending them again does not help
+		SEND_TOO_LARGE, // the server refused the request for its size
+		SEND_FAILED,	// not sent, retry later
+	};
+	bool FillBatch(std::vector<std::string> &batch, size_t iBatchSize);
+	_eSendResult SendBatch(const std::vector<std::string> &batch);
+	bool HasFullBatch(size_t iBatchSize);
+
+	// Disk spool, a sequence of append-only segment files holding one line-protocol point per line.
+	// Every point is written to it when it arrives, so points that were not sent survive a restart or crash
+	// (accessed with m_background_task_mutex locked, except for the replay members owned by the sender thread)
+	std::string GetSpoolSegmentName(uint64_t iSegment);
+	void LoadSpool();
+	bool SpoolLine(const std::string &szLine);
+	bool LoadSpoolSegment();
+	std::deque<uint64_t> m_SpoolSegments;
+	uint64_t m_iNextSpoolSegment{ 0 };
+	std::ofstream m_SpoolFile;
+	size_t m_iSpoolFileSize{ 0 };
+	size_t m_iSpoolFileLines{ 0 };
+	std::deque<std::string> m_ReplayLines;
+	uint64_t m_iReplaySegment{ 0 };
+	bool m_bReplayActive{ false };
 
 	std::map<std::string, _tPushItem> m_PushedItems;
-	std::vector<_tPushItem> m_background_task_queue;
+	int m_iBatchSize{ 500 };
+	int m_iLinger{ 500 };
+
+	std::atomic<uint64_t> m_nQueued{ 0 };
+	std::atomic<uint64_t> m_nSent{ 0 };
+	std::atomic<uint64_t> m_nDropped{ 0 };
+	std::atomic<uint64_t> m_nRetried{ 0 };
+	std::atomic<uint64_t> m_nPending{ 0 };
 	std::string m_szURL;
 	std::string m_InfluxIP;
 	int m_InfluxPort{ 8086 };
@@ -6,6 +6,7 @@
 #include "main/Helper.h"
 #include "main/json_helper.h"
 #include "main/Logger.h"
+#include "main/Metrics.h"
 #include "main/mainworker.h"
 #include "main/RFXtrx.h"
 #include "main/SQLHelper.h"
@@ -158,19 +159,26 @@ void CMQTTPush::OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::
 	DoMQTTPush(DeviceRowIdx);
 }
 
+void CMQTTPush::CompileLinkTarget(const _tPushLinks& link, _tPushLinkTarget& target)
+{
+	std::string vType = target.ValueName;
+	std::string name = link.DeviceName;
+	stdreplace(vType, " ", "_");
+	stdlower(vType);
+	stdreplace(name, " ", "_");
+	target.FieldName = vType;
+	target.Key = vType + ",idx=" + std::to_string(link.DeviceRowIdx) + ",name=" + name;
+}
+
 void CMQTTPush::DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced)
 {
+	CMetrics::CTimer timer("oikomaticz_push_seconds", CMetrics::Label("target", "mqtt"));
 	if (!m_bLinkActive)
 		return;
-	if (!IsLinkInDatabase(DeviceRowIdx))
-		return;
-
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query(
-		"SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.IncludeUnit, B.Name, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-		"WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled==1 AND A.DeviceRowID==B.ID)",
-		PushType::PUSHTYPE_MQTT, DeviceRowIdx);
-	if (result.empty())
+	int nValue;
+	std::string sValue, sLastUpdate;
+	auto link = GetPushLinkValue(DeviceRowIdx, nValue, sValue, sLastUpdate);
+	if (!link)
 		return;
 
 	Json::Value root;
@@ -178,42 +186,29 @@ void CMQTTPush::DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced)
 
 	time_t atime = mytime(nullptr);
 
-	int dType = atoi(result[0][3].c_str());
-	int dSubType = atoi(result[0][4].c_str());
-	int nValue = atoi(result[0][5].c_str());
-	std::string sValue = result[0][6];
-	std::string name = result[0][9];
-	int metertype = atoi(result[0][10].c_str());
-
-	for (const auto& sd : result)
+	for (const auto& target : link->targets)
 	{
 		std::string sendValue;
-		int delpos = atoi(sd[1].c_str());
-		int targetType = atoi(sd[7].c_str());
-		int includeUnit = atoi(sd[8].c_str());
+		int delpos = target.DelimiterPos;
 
-		std::vector<std::string> strarray;
 		if (sValue.find(';') != std::string::npos)
 		{
+			std::vector<std::string> strarray;
 			StringSplit(sValue, ";", strarray);
 			if (int(strarray.size()) >= delpos)
 			{
 				std::string rawsendValue = strarray[delpos - 1];
-				sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
+				sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, target.IncludeUnit, link->devType, link->devSubType, link->metertype);
 			}
 		}
 		else
-			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
+			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, sValue, target.IncludeUnit, link->devType, link->devSubType, link->metertype);
 
 		if (sendValue.empty())
 			continue;
 
-		std::string szKey;
-		std::string vType = CBasePush::DropdownOptionsValue(dType, dSubType, delpos);
-		stdreplace(vType, " ", "_");
-		stdlower(vType);
-		stdreplace(name, " ", "_");
-		szKey = vType + ",idx=" + sd[0] + ",name=" + name;
+		const std::string& vType = target.FieldName;
+		const std::string& szKey = target.Key;
 
 		if (is_number(sendValue))
 		{
@@ -222,7 +217,7 @@ void CMQTTPush::DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced)
 		else
 			root[vType] = sendValue;
 
-		if ((targetType == 0) && (!bForced))
+		if ((target.TargetType == 0) && (!bForced))
 		{
 			// Only send on change
 			auto itt = m_PushedItems.find(szKey);
@@ -241,7 +236,7 @@ void CMQTTPush::DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced)
 
 	_tPushItem pItem;
 	pItem.idx = DeviceRowIdx;
-	pItem.name = name;
+	pItem.name = link->DeviceName;
 	pItem.stimestamp = atime;
 	pItem.json = JSonToRawString(root);
 
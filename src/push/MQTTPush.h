@@ -24,6 +24,7 @@ class CMQTTPush : public CBasePush, MQTT
 		time_t stimestamp;
 	};
 	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand);
+	void CompileLinkTarget(const _tPushLinks& link, _tPushLinkTarget& target) override;
 	void DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced = false);
 
 	std::shared_ptr<std::thread> m_thread;
@@ -18,8 +18,7 @@ void CWebSocketPush::Start()
 	if (isStarted) {
 		return;
 	}
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, auto &&name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
-	m_sDeviceUpdate = m_mainworker.sOnDeviceUpdate.connect([this](auto id, auto idx) { OnDeviceUpdate(id, idx); });
+	// device updates are sent by the shared CWebsocketFanout of the webserver
 	m_sNotification = sOnNotificationReceived.connect([this](auto &&s, auto &&t, auto &&e, auto p, auto &&sound, auto n) { OnNotificationReceived(s, t, e, p, sound, n); });
 	m_sSceneChanged = m_mainworker.sOnSwitchScene.connect([this](auto idx, auto &&name) { OnSceneChange(idx, name); });
 
@@ -52,26 +51,6 @@ void CWebSocketPush::Stop()
 	m_sLogMessage.disconnect();
 }
 
-void CWebSocketPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
-{
-	std::unique_lock<std::mutex> lock(handlerMutex);
-	if (!isStarted) {
-		return;
-	}
-
-	m_sock->OnDeviceChanged(DeviceRowIdx);
-}
-
-void CWebSocketPush::OnDeviceUpdate(const int m_HwdID, const uint64_t DeviceRowIdx)
-{
-	std::unique_lock<std::mutex> lock(handlerMutex);
-	if (!isStarted) {
-		return;
-	}
-
-	m_sock->OnDeviceChanged(DeviceRowIdx);
-}
-
 void CWebSocketPush::OnSceneChange(const uint64_t SceneRowIdx, const std::string& SceneName)
 {
 	std::unique_lock<std::mutex> lock(handlerMutex);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
 typedef struct _STR_TABLE_SINGLE {
 	unsigned long    id;
 	const char   *str1;
@@ -16,3 +20,80 @@ typedef struct _STR_TABLE_ID1_ID2 {
 const char *findTableIDSingle1(const STR_TABLE_SINGLE *t, const unsigned long id);
 const char *findTableIDSingle2(const STR_TABLE_SINGLE *t, const unsigned long id);
 
+// Compile-time indexes for tables that are looked up on every device render.
+// The tables stay the source, the index only holds positions in them (first entry wins, like the linear scans).
+
+// Position + 1 of the first entry for every id below 256, 0 when there is none
+template <size_t N> constexpr std::array<uint16_t, 256> BuildTableIndex(const STR_TABLE_SINGLE (&t)[N])
+{
+	std::array<uint16_t, 256> index{};
+	for (size_t ii = N; ii-- > 0;)
+	{
+		if ((t[ii].str1 != nullptr) && (t[ii].id < 256))
+			index[t[ii].id] = static_cast<uint16_t>(ii + 1);
+	}
+	return index;
+}
+
+template <size_t N> const char *findTableIndexed(const STR_TABLE_SINGLE (&t)[N], const std::array<uint16_t, 256> &index, const unsigned long id, const bool bStr2 = false)
+{
+	if ((id >= 256) || (index[id] == 0))
+		return "Unknown";
+	const char *str = bStr2 ? t[index[id] - 1].str2 : t[index[id] - 1].str1;
+	return (str != nullptr) ? str : "Unknown";
+}
+
+// Table positions ordered by (id1, id2), stable, with the range of every id1 below 256
+template <size_t N> struct _tTableIndexID1ID2
+{
+	std::array<uint16_t, 257> first{};
+	std::array<uint16_t, N> order{};
+};
+
+template <size_t N> constexpr _tTableIndexID1ID2<N> BuildTableIndex(const STR_TABLE_ID1_ID2 (&t)[N])
+{
+	_tTableIndexID1ID2<N> index{};
+	size_t count = 0;
+	for (size_t ii = 0; ii < N; ii++)
+	{
+		if ((t[ii].str1 == nullptr) || (t[ii].id1 >= 256))
+			continue;
+		// insertion sort, equal keys keep their table order
+		size_t pos = count++;
+		while ((pos > 0) && ((t[index.order[pos - 1]].id1 > t[ii].id1) || ((t[index.order[pos - 1]].id1 == t[ii].id1) && (t[index.order[pos - 1]].id2 > t[ii].id2))))
+		{
+			index.order[pos] = index.order[pos - 1];
+			pos--;
+		}
+		index.order[pos] = static_cast<uint16_t>(ii);
+	}
+	size_t pos = 0;
+	for (size_t id1 = 0; id1 < 256; id1++)
+	{
+		index.first[id1] = static_cast<uint16_t>(pos);
+		while ((pos < count) && (t[index.order[pos]].id1 == id1))
+			pos++;
+	}
+	index.first[256] = static_cast<uint16_t>(pos);
+	return index;
+}
+
+template <size_t N> const char *findTableIndexed(const STR_TABLE_ID1_ID2 (&t)[N], const _tTableIndexID1ID2<N> &index, const unsigned long id1, const unsigned long id2)
+{
+	if (id1 >= 256)
+		return "Unknown";
+	// lower bound of id2 within the id1 range
+	size_t lo = index.first[id1];
+	size_t hi = index.first[id1 + 1];
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (t[index.order[mid]].id2 < id2)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ((lo < index.first[id1 + 1]) && (t[index.order[lo]].id2 == id2))
+		return t[index.order[lo]].str1;
+	return "Unknown";
+}
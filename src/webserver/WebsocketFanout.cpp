@@ -0,0 +1,198 @@
+#include "stdafx.h"
+#include "WebsocketFanout.h"
+#include "WebsocketHandler.h"
+#include "cWebem.h"
+#include "main/Helper.h"
+#include "main/json_helper.h"
+#include "main/Logger.h"
+#include "main/mainworker.h"
+#include <map>
+
+// device changes within this period are sent together, and only once per device
+#define WEBSOCKET_FANOUT_WINDOW 250
+
+namespace http
+{
+	namespace server
+	{
+		CWebsocketFanout::CWebsocketFanout(cWebem *pWebem)
+			: m_pWebem(pWebem)
+		{
+		}
+
+		CWebsocketFanout::~CWebsocketFanout()
+		{
+			Stop();
+		}
+
+		void CWebsocketFanout::Register(CWebsocketHandler *pHandler)
+		{
+			{
+				auto reg = std::make_shared<_tRegistration>();
+				reg->pHandler = pHandler;
+				std::lock_guard<std::mutex> l(m_handlers_mutex);
+				m_handlers[pHandler] = reg;
+			}
+
+			std::lock_guard<std::mutex> l(m_thread_mutex);
+			if (m_thread)
+				return;
+			RequestStart();
+			m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
+			SetThreadName(m_thread->native_handle(), "WebsocketFanout");
+			m_sDeviceReceived = m_mainworker.sOnDeviceReceived.connect([this](auto /*id*/, auto idx, auto && /*name*/, auto /*rx*/) { OnDeviceChanged(idx); });
+			m_sDeviceUpdate = m_mainworker.sOnDeviceUpdate.connect([this](auto /*id*/, auto idx) { OnDeviceChanged(idx); });
+		}
+
+		void CWebsocketFanout::Unregister(CWebsocketHandler *pHandler)
+		{
+			std::shared_ptr<_tRegistration> reg;
+			{
+				std::lock_guard<std::mutex> l(m_handlers_mutex);
+				auto itt = m_handlers.find(pHandler);
+				if (itt == m_handlers.end())
+					return;
+				reg = itt->second;
+				m_handlers.erase(itt);
+			}
+			// waits for a packet being sent to this handler, it is not used after this
+			std::lock_guard<std::mutex> l(reg->mutex);
+			reg->pHandler = nullptr;
+		}
+
+		std::vector<std::shared_ptr<CWebsocketFanout::_tRegistration>> CWebsocketFanout::GetRegistrations()
+		{
+			std::vector<std::shared_ptr<_tRegistration>> registrations;
+			std::lock_guard<std::mutex> l(m_handlers_mutex);
+			registrations.reserve(m_handlers.size());
+			for (const auto &itt : m_handlers)
+				registrations.push_back(itt.second);
+			return registrations;
+		}
+
+		void CWebsocketFanout::Stop()
+		{
+			std::lock_guard<std::mutex> l(m_thread_mutex);
+			if (m_sDeviceReceived.connected())
+				m_sDeviceReceived.disconnect();
+			if (m_sDeviceUpdate.connected())
+				m_sDeviceUpdate.disconnect();
+			if (m_thread)
+			{
+				RequestStop();
+				m_thread->join();
+				m_thread.reset();
+			}
+			std::lock_guard<std::mutex> l2(m_pending_mutex);
+			m_pending_devices.clear();
+		}
+
+		void CWebsocketFanout::OnDeviceChanged(const uint64_t DeviceRowIdx)
+		{
+			std::lock_guard<std::mutex> l(m_pending_mutex);
+			m_pending_devices.insert(DeviceRowIdx);
+		}
+
+		void CWebsocketFanout::Do_Work()
+		{
+			while (!IsStopRequested(WEBSOCKET_FANOUT_WINDOW))
+			{
+				std::set<uint64_t> devices;
+				{
+					std::lock_guard<std::mutex> l(m_pending_mutex);
+					if (m_pending_devices.empty())
+						continue;
+					devices.swap(m_pending_devices);
+				}
+				try
+				{
+					Publish(devices);
+				}
+				catch (std::exception &e)
+				{
+					_log.Log(LOG_ERROR, "WebsocketFanout::%s Exception: %s", __func__, e.what());
+				}
+			}
+		}
+
+		static std::string GetAudienceKey(const WebEmSession &session)
+		{
+			return std::to_string(static_cast<int>(session.rights)) + ":" + session.username;
+		}
+
+		void CWebsocketFanout::Publish(const std::set<uint64_t> &devices)
+		{
+			// Which device is wanted by which user, the handler list lock is not held while rendering and sending,
+			// so a slow client only delays its own packets
+			std::vector<std::shared_ptr<_tRegistration>> registrations = GetRegistrations();
+			std::map<std::string, WebEmSession> audiences;
+			std::set<std::pair<uint64_t, std::string>> wanted;
+			for (const auto &reg : registrations)
+			{
+				std::lock_guard<std::mutex> l(reg->mutex);
+				if (reg->pHandler == nullptr)
+					continue;
+				WebEmSession session;
+				reg->pHandler->GetSession(session, true);
+				std::string szKey = GetAudienceKey(session);
+				for (const auto idx : devices)
+				{
+					if (reg->pHandler->WantsDevice(idx))
+					{
+						audiences.emplace(szKey, session);
+						wanted.emplace(idx, szKey);
+					}
+				}
+			}
+
+			std::map<std::pair<uint64_t, std::string>, std::string> packets;
+			for (const auto &itt : wanted)
+			{
+				std::string packet;
+				if (RenderDevice(itt.first, audiences[itt.second], packet))
+					packets[itt] = std::move(packet);
+			}
+			if (packets.empty())
+				return;
+
+			for (const auto &reg : registrations)
+			{
+				std::lock_guard<std::mutex> l(reg->mutex);
+				if (reg->pHandler == nullptr)
+					continue;
+				WebEmSession session;
+				reg->pHandler->GetSession(session, true);
+				std::string szKey = GetAudienceKey(session);
+				for (const auto idx : devices)
+				{
+					auto itt = packets.find(std::make_pair(idx, szKey));
+					if ((itt != packets.end()) && reg->pHandler->WantsDevice(idx))
+						reg->pHandler->SendPacket(itt->second);
+				}
+			}
+		}
+
+		bool CWebsocketFanout::RenderDevice(const uint64_t DeviceRowIdx, const WebEmSession &session, std::string &packet)
+		{
+			WebEmSession tsession = session;
+			request req;
+			req.method = "GET";
+			req.uri = m_pWebem->GetWebRoot() + "/json.htm?type=command&param=getdevices&rid=" + std::to_string(DeviceRowIdx);
+			req.http_version_major = 1;
+			req.http_version_minor = 1;
+			reply rep;
+			if ((!m_pWebem->CheckForPageOverride(tsession, req, rep)) || (rep.status != reply::ok))
+				return false;
+			reply::finish_content_producer(&rep);
+
+			Json::Value jsonValue;
+			jsonValue["request"] = "device_request";
+			jsonValue["event"] = "response";
+			jsonValue["requestid"] = -1;
+			jsonValue["data"] = rep.content;
+			packet = JSonToFormatString(jsonValue);
+			return true;
+		}
+
+	} // namespace server
+} // namespace http
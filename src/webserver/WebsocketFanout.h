@@ -0,0 +1,59 @@
+#pragma once
+
+#include "main/StoppableTask.h"
+#define BOOST_ALLOW_DEPRECATED_HEADERS
+#include <boost/signals2.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace http
+{
+	namespace server
+	{
+		class cWebem;
+		class CWebsocketHandler;
+		struct _tWebEmSession;
+
+		// Device updates for all websocket clients of one webserver.
+		// Changed devices are collected for a coalescing window. Every changed device is then rendered once per
+		// user (name and rights) among the clients that want it, and that text is written to each of these clients.
+		class CWebsocketFanout : public StoppableTask
+		{
+		public:
+			explicit CWebsocketFanout(cWebem *pWebem);
+			~CWebsocketFanout();
+			void Register(CWebsocketHandler *pHandler);
+			void Unregister(CWebsocketHandler *pHandler);
+			void Stop();
+
+		private:
+			void OnDeviceChanged(uint64_t DeviceRowIdx);
+			bool RenderDevice(uint64_t DeviceRowIdx, const _tWebEmSession &session, std::string &packet);
+			void Publish(const std::set<uint64_t> &devices);
+			void Do_Work();
+
+			// A registered handler, Unregister clears pHandler under its mutex so it is not used afterwards
+			struct _tRegistration
+			{
+				std::mutex mutex;
+				CWebsocketHandler *pHandler;
+			};
+			std::vector<std::shared_ptr<_tRegistration>> GetRegistrations();
+
+			cWebem *m_pWebem;
+			std::mutex m_handlers_mutex;
+			std::map<CWebsocketHandler *, std::shared_ptr<_tRegistration>> m_handlers;
+			std::mutex m_thread_mutex;
+			std::mutex m_pending_mutex;
+			std::set<uint64_t> m_pending_devices;
+			std::shared_ptr<std::thread> m_thread;
+			boost::signals2::connection m_sDeviceReceived;
+			boost::signals2::connection m_sDeviceUpdate;
+		};
+
+	} // namespace server
+} // namespace http
@@ -30,6 +30,7 @@ namespace http {
 			RequestStart();
 
 			m_Push.Start();
+			myWebem->m_websocketFanout.Register(this);
 
 			//Start worker thread
 			m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
@@ -37,6 +38,7 @@ namespace http {
 
 		void CWebsocketHandler::Stop()
 		{
+			myWebem->m_websocketFanout.Unregister(this);
 			m_Push.Stop();
 			if (m_thread)
 			{
@@ -99,17 +101,19 @@ namespace http {
 			return true;
 		}
 
-		bool CWebsocketHandler::HandleRequest(const std::string& szEvent, const Json::Value& value, const bool outbound)
+		void CWebsocketHandler::GetSession(WebEmSession& session, const bool outbound)
 		{
 			// WebSockets only do security during set up so keep pushing the expiry out to stop it being cleaned up
-			WebEmSession session;
+			std::unique_lock<std::mutex> lSessions(myWebem->m_sessionsMutex);
 			auto itt = myWebem->m_sessions.find(sessionid);
 			if (itt != myWebem->m_sessions.end())
 			{
 				session = itt->second;
+				lSessions.unlock();
 			}
 			else
 			{
+				lSessions.unlock();
 				// for outbound messages create a temporary session if required
 				// todo: Add the username and rights from the original connection
 				if (outbound)
@@ -121,6 +125,12 @@ namespace http {
 					session.reply_status = 200;
 				}
 			}
+		}
+
+		bool CWebsocketHandler::HandleRequest(const std::string& szEvent, const Json::Value& value, const bool outbound)
+		{
+			WebEmSession session;
+			GetSession(session, outbound);
 
 			request req;
 			req.method = "GET";
@@ -132,6 +142,7 @@ namespace http {
 			req.content.clear();
 			reply rep;
 			if (myWebem->CheckForPageOverride(session, req, rep)) {
+				reply::finish_content_producer(&rep);
 				if (rep.status == reply::ok) {
 
 					bool bInternal = false;
@@ -140,6 +151,7 @@ namespace http {
 
 					if ((!bInternal) && (querystring.find("param=getdevices") != std::string::npos))
 					{
+						std::unique_lock<std::mutex> lock(m_subscribe_mutex);
 						m_subscribed_devices.clear();
 
 						if (querystring.find("rid=") != std::string::npos)
@@ -178,13 +190,16 @@ namespace http {
 		{
 			// WebSockets only do security during set up so keep pushing the expiry out to stop it being cleaned up
 			WebEmSession session;
+			std::unique_lock<std::mutex> lSessions(myWebem->m_sessionsMutex);
 			auto itt = myWebem->m_sessions.find(sessionid);
 			if (itt != myWebem->m_sessions.end())
 			{
 				session = itt->second;
+				lSessions.unlock();
 			}
 			else
 			{
+				lSessions.unlock();
 				// for outbound messages create a temporary session if required
 				// todo: Add the username and rights from the original connection
 				if (outbound)
@@ -217,13 +232,16 @@ namespace http {
 		{
 			// WebSockets only do security during set up so keep pushing the expiry out to stop it being cleaned up
 			WebEmSession session;
+			std::unique_lock<std::mutex> lSessions(myWebem->m_sessionsMutex);
 			auto itt = myWebem->m_sessions.find(sessionid);
 			if (itt != myWebem->m_sessions.end())
 			{
 				session = itt->second;
+				lSessions.unlock();
 			}
 			else
 			{
+				lSessions.unlock();
 				// for outbound messages create a temporary session if required
 				// todo: Add the username and rights from the original connection
 				if (outbound)
@@ -323,30 +341,17 @@ namespace http {
 			return (m_subscribed_topics.find(szTopic) != m_subscribed_topics.end());
 		}
 
-		void CWebsocketHandler::OnDeviceChanged(const uint64_t DeviceRowIdx)
+		bool CWebsocketHandler::WantsDevice(const uint64_t DeviceRowIdx)
 		{
-			try
-			{
-				if (!m_subscribed_devices.empty())
-				{
-					if (m_subscribed_devices.find(DeviceRowIdx) == m_subscribed_devices.end())
-					{
-						return; //not interested in you
-					}
-				}
-				std::string query = "type=command&param=getdevices&rid=" + std::to_string(DeviceRowIdx);
-				Json::Value request;
-				request["event"] = "device_request";
-				request["internal"] = true;
-				request["requestid"] = -1;
-				request["query"] = query;
-				std::string packet = JSonToFormatString(request);
-				Handle(packet, true);
-			}
-			catch (std::exception& e)
-			{
-				_log.Log(LOG_ERROR, "WebsocketHandler::%s Exception: %s", __func__, e.what());
-			}
+			std::unique_lock<std::mutex> lock(m_subscribe_mutex);
+			if (m_subscribed_devices.empty())
+				return true;
+			return (m_subscribed_devices.find(DeviceRowIdx) != m_subscribed_devices.end());
+		}
+
+		void CWebsocketHandler::SendPacket(const std::string& packet)
+		{
+			MyWrite(packet);
 		}
 
 		void CWebsocketHandler::OnSceneChanged(const uint64_t SceneRowIdx)
@@ -21,6 +21,7 @@ namespace http
 	{
 
 		class cWebem;
+		struct _tWebEmSession;
 
 		class CWebsocketHandler : public StoppableTask
 		{
@@ -30,7 +31,6 @@ namespace http
 			bool Handle(const std::string& packet_data, const bool outbound);
 			void Start();
 			void Stop();
-			void OnDeviceChanged(uint64_t DeviceRowIdx);
 			void OnSceneChanged(uint64_t SceneRowIdx);
 			void SendNotification(const std::string& Subject, const std::string& Text, const std::string& ExtraData, int Priority, const std::string& Sound, const bool bFromNotification);
 			void SendLogMessage(const int iLevel, const std::string& szMessage);
@@ -39,6 +39,11 @@ namespace http
 			bool subscribeTo(const std::string& szTopic);
 			bool unsubscribeFrom(const std::string& szTopic);
 
+			// Used by CWebsocketFanout
+			void GetSession(_tWebEmSession& session, bool outbound);
+			bool WantsDevice(uint64_t DeviceRowIdx);
+			void SendPacket(const std::string& packet);
+
 		protected:
 			std::function<void(const std::string& packet_data)> MyWrite;
 			std::string sessionid;
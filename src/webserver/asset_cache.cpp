@@ -0,0 +1,138 @@
+//
+// asset_cache.cpp
+// ~~~~~~~~~~~~~~~
+//
+#include "stdafx.h"
+#include "asset_cache.hpp"
+#include <fstream>
+#include <sys/stat.h>
+#include "GZipHelper.h"
+
+// files above this size are streamed from disk on every request
+#define ASSET_CACHE_MAX_FILE_SIZE (2 * 1024 * 1024)
+// total budget for raw and gzip variants
+#define ASSET_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+extern std::string szAppVersion;
+
+namespace http {
+namespace server {
+
+static std::string make_etag(size_t hash, const char *suffix)
+{
+	// a new version invalidates the copies held by the browsers, as the application version ETag did before
+	hash ^= std::hash<std::string>()(szAppVersion) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	char szTag[40];
+	snprintf(szTag, sizeof(szTag), "\"%llx%s\"", static_cast<unsigned long long>(hash), suffix);
+	return szTag;
+}
+
+std::shared_ptr<const asset_cache::asset> asset_cache::get(const std::string &full_path, const bool compressible, const bool accept_gzip)
+{
+	// a precompressed .gz file takes precedence over the plain file
+	std::string source_path = full_path;
+	bool is_gzip = false;
+	struct stat st;
+	if (compressible && (stat((full_path + ".gz").c_str(), &st) == 0) && ((st.st_mode & S_IFREG) == S_IFREG))
+	{
+		source_path += ".gz";
+		is_gzip = true;
+	}
+	else if ((stat(full_path.c_str(), &st) != 0) || ((st.st_mode & S_IFREG) != S_IFREG))
+	{
+		return nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> l(mutex_);
+		auto itt = entries_.find(full_path);
+		if ((itt != entries_.end()) && (itt->second.source_path == source_path) && (itt->second.mtime == st.st_mtime) && (itt->second.size == static_cast<int64_t>(st.st_size)))
+			return itt->second.data;
+	}
+
+	// large files are streamed, except a precompressed one for a client that needs it decompressed
+	if ((st.st_size > ASSET_CACHE_MAX_FILE_SIZE) && ((!is_gzip) || accept_gzip))
+		return stream(source_path, is_gzip, st);
+
+	// load outside of the lock, concurrent loads of the same file are harmless
+	std::shared_ptr<const asset> data = load(source_path, is_gzip, compressible, st.st_mtime);
+	if (!data)
+		return nullptr;
+
+	std::lock_guard<std::mutex> l(mutex_);
+	auto itt = entries_.find(full_path);
+	if (itt != entries_.end())
+	{
+		total_bytes_ -= itt->second.bytes;
+		entries_.erase(itt);
+	}
+	size_t bytes = data->content.size() + data->gzip.size();
+	if ((st.st_size <= ASSET_CACHE_MAX_FILE_SIZE) && (total_bytes_ + bytes <= ASSET_CACHE_MAX_SIZE))
+	{
+		_tEntry &entry = entries_[full_path];
+		entry.source_path = source_path;
+		entry.mtime = st.st_mtime;
+		entry.size = static_cast<int64_t>(st.st_size);
+		entry.bytes = bytes;
+		entry.data = data;
+		total_bytes_ += bytes;
+	}
+	return data;
+}
+
+void asset_cache::clear()
+{
+	std::lock_guard<std::mutex> l(mutex_);
+	entries_.clear();
+	total_bytes_ = 0;
+}
+
+std::shared_ptr<const asset_cache::asset> asset_cache::stream(const std::string &source_path, const bool is_gzip, const struct stat &st)
+{
+	auto data = std::make_shared<asset>();
+	data->last_written = st.st_mtime;
+	data->stream_path = source_path;
+	data->stream_is_gzip = is_gzip;
+	// the file is not read, modification time and size stand in for the content
+	size_t hash = std::hash<std::string>()(source_path + ":" + std::to_string(st.st_mtime) + ":" + std::to_string(st.st_size));
+	data->etag = make_etag(hash, (is_gzip) ? "-gz" : "");
+	data->gzip_etag = make_etag(hash, "-gz");
+	return data;
+}
+
+std::shared_ptr<const asset_cache::asset> asset_cache::load(const std::string &source_path, const bool is_gzip, const bool compressible, const time_t mtime)
+{
+	std::ifstream is(source_path.c_str(), std::ios::in | std::ios::binary);
+	if (!is.is_open())
+		return nullptr;
+	std::string filecontent((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
+
+	auto data = std::make_shared<asset>();
+	data->last_written = mtime;
+	if (is_gzip)
+	{
+		// keep the decompressed variant for clients without gzip support
+		CGZIP2AT<> decompress((LPGZIP)filecontent.c_str(), static_cast<int>(filecontent.size()));
+		data->content.append(decompress.psz, decompress.Length);
+		data->gzip = std::move(filecontent);
+	}
+	else
+	{
+		data->content = std::move(filecontent);
+		if (compressible)
+		{
+			CA2GZIP gzip((char *)data->content.c_str(), (int)data->content.size());
+			if ((gzip.Length > 0) && (gzip.Length < (int)data->content.size()))
+				data->gzip.append((char *)gzip.pgzip, gzip.Length);
+		}
+	}
+
+	// strong validators, one per representation
+	size_t hash = std::hash<std::string>()(data->content);
+	data->etag = make_etag(hash, "");
+	data->gzip_etag = make_etag(hash, "-gz");
+	return data;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,68 @@
+//
+// asset_cache.hpp
+// ~~~~~~~~~~~~~~~
+//
+#pragma once
+#ifndef HTTP_ASSET_CACHE_HPP
+#define HTTP_ASSET_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include "main/Noncopyable.h"
+
+namespace http {
+namespace server {
+
+/// In-memory copy of the static files served from the www folder.
+/// Every file is kept with its gzip variant (precompressed .gz file or compressed once at load time)
+/// and a strong ETag per variant. Entries are validated against the modification time and size of
+/// the source file, so changed files are reloaded on the next request.
+/// The ETags include the application version, so an upgrade invalidates the copies held by browsers.
+class asset_cache
+  : private domoticz::noncopyable
+{
+public:
+	struct asset
+	{
+		std::string content;	/// raw bytes
+		std::string gzip;	/// gzip variant, empty if the file does not compress
+		std::string etag;
+		std::string gzip_etag;
+		time_t last_written = 0;
+		/// set for large files: nothing is loaded, the file is streamed from this path
+		std::string stream_path;
+		bool stream_is_gzip = false;
+	};
+
+	/// Return the file (loading it when missing or changed), nullptr if it cannot be read.
+	/// Large files are returned with only stream_path set (a precompressed one only when accept_gzip is set),
+	/// files beyond the cache budget are loaded but not cached.
+	std::shared_ptr<const asset> get(const std::string &full_path, bool compressible, bool accept_gzip);
+
+	void clear();
+
+private:
+	struct _tEntry
+	{
+		std::string source_path;
+		time_t mtime = 0;
+		int64_t size = 0;
+		size_t bytes = 0;
+		std::shared_ptr<const asset> data;
+	};
+	static std::shared_ptr<const asset> stream(const std::string &source_path, bool is_gzip, const struct stat &st);
+	static std::shared_ptr<const asset> load(const std::string &source_path, bool is_gzip, bool compressible, time_t mtime);
+
+	std::mutex mutex_;
+	std::map<std::string, _tEntry> entries_;
+	size_t total_bytes_ = 0;
+};
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_ASSET_CACHE_HPP
@@ -43,6 +43,7 @@ namespace http {
 			, m_authmethod(AUTH_LOGIN)
 			, m_AllowPlainBasicAuth(false)
 			, m_settings(settings)
+			, m_websocketFanout(this)
 			, mySessionStore(nullptr)
 			, myRequestHandler(doc_root, this)
 			// Rene, make sure we initialize m_sessions first, before starting a server
@@ -90,6 +91,7 @@ namespace http {
 		*/
 		void cWebem::Stop()
 		{
+			m_websocketFanout.Stop();
 			// Stop session cleaner
 			try
 			{
@@ -141,13 +143,17 @@ namespace http {
 
 		*/
 
-		void cWebem::RegisterPageCode(const char *pageurl, const webem_page_function &fun, bool bypassAuthentication)
+		void cWebem::RegisterPageCode(const char *pageurl, const webem_page_function &fun, bool bypassAuthentication, bool bReadOnly)
 		{
 			myPages.insert(std::pair<std::string, webem_page_function >(std::string(pageurl), fun));
 			if (bypassAuthentication)
 			{
 				RegisterWhitelistURLString(pageurl);
 			}
+			if (bReadOnly)
+			{
+				myReadOnlyPages.insert(pageurl);
+			}
 		}
 
 		/**
@@ -172,6 +178,10 @@ namespace http {
 		{
 			myWhitelistCommands.push_back(idname);
 		}
+		void cWebem::RegisterReadOnlyCommandString(const char* idname)
+		{
+			myReadOnlyCommands.insert(idname);
+		}
 
 		// Show a Debug line with the registered functions, actions, includes, whitelist urls and commands
 		void cWebem::DebugRegistrations()
@@ -376,6 +386,7 @@ namespace http {
 					// call the function
 					try
 					{
+						std::unique_lock<boost::shared_mutex> lHandlers(m_handlerMutex);
 						pfun->second(session, req, req.uri);
 					}
 					catch (...)
@@ -417,6 +428,21 @@ namespace http {
 			return false;
 		}
 
+		/**
+
+		Pages and JSON commands that were registered as read-only may run concurrently
+		on the webserver threads, every other page and action runs exclusively.
+
+		*/
+		bool cWebem::IsReadOnlyRequest(const std::string &request_path, const request &req)
+		{
+			if (myReadOnlyPages.find(request_path) != myReadOnlyPages.end())
+				return true;
+			if ((request_path != "/json.htm") || (request::findValue(&req, "type") != "command"))
+				return false;
+			return (myReadOnlyCommands.find(request::findValue(&req, "param")) != myReadOnlyCommands.end());
+		}
+
 		bool cWebem::CheckForPageOverride(WebEmSession & session, request& req, reply& rep)
 		{
 			std::string request_path;
@@ -503,7 +529,16 @@ namespace http {
 				rep.status = reply::ok;
 				try
 				{
-					pfun->second(session, req, rep);
+					if (IsReadOnlyRequest(request_path, req))
+					{
+						boost::shared_lock<boost::shared_mutex> lHandlers(m_handlerMutex);
+						pfun->second(session, req, rep);
+					}
+					else
+					{
+						std::unique_lock<boost::shared_mutex> lHandlers(m_handlerMutex);
+						pfun->second(session, req, rep);
+					}
 				}
 				catch (std::exception& e)
 				{
@@ -529,7 +564,8 @@ namespace http {
 					}
 				}
 
-				reply::add_header(&rep, "Content-Length", std::to_string(rep.content.size()));
+				if (!rep.content_producer)
+					reply::add_header(&rep, "Content-Length", std::to_string(rep.content.size()));
 				if (!boost::algorithm::starts_with(strMimeType, "image"))
 				{
 					reply::add_header(&rep, "Cache-Control", "no-cache");
@@ -1604,6 +1640,13 @@ namespace http {
 			{
 				//see if we support gzip
 				bool bHaveGZipSupport = (strstr(encoding_header, "gzip") != nullptr);
+				if (bHaveGZipSupport && rep.content_producer)
+				{
+					// the connection compresses the parts while they are sent
+					rep.bIsGZIP = true;
+					reply::add_header(&rep, "Content-Encoding", "gzip");
+					return true;
+				}
 				if (bHaveGZipSupport)
 				{
 					CA2GZIP gzip((char*)rep.content.c_str(), (int)rep.content.size());
@@ -2033,6 +2076,7 @@ namespace http {
 		}
 
 		std::map<std::string, connection::_tRemoteClients> m_remote_web_clients;
+		std::mutex m_remote_web_clients_mutex;
 
 		void cWebemRequestHandler::handle_request(const request& req, reply& rep)
 		{
@@ -2098,6 +2142,7 @@ namespace http {
 			// 3c) Check if the remote client is known and update the last seen time
 			bool bSeenBefore = true;
 			std::string remoteClientKey = session.remote_host + session.local_port;
+			std::unique_lock<std::mutex> lRemoteClients(m_remote_web_clients_mutex);
 			auto itt_rc = m_remote_web_clients.find(remoteClientKey);
 			if (itt_rc == m_remote_web_clients.end())
 			{
@@ -2112,6 +2157,7 @@ namespace http {
 				bSeenBefore = false;
 			itt_rc->second.last_seen = mytime(nullptr);
 			itt_rc->second.host_last_request_uri_ = req.uri;
+			lRemoteClients.unlock();
 
 			// 4) Respond to CORS Preflight request (for JSON API)
 			if (req.method == "OPTIONS")
@@ -2127,7 +2173,12 @@ namespace http {
 
 			// 5) Check Authentication and in case something unexpected went wrong with the authentication, we will return an internal server error and stop processing
 			bool bAuthErr = false;
-			bool isAuthenticated = CheckAuthentication(session, req, bAuthErr);	// This check also restores the session if an active session is found
+			bool isAuthenticated;
+			{
+				// users and networks are reloaded by (exclusive) page handlers
+				boost::shared_lock<boost::shared_mutex> lHandlers(myWebem->m_handlerMutex);
+				isAuthenticated = CheckAuthentication(session, req, bAuthErr);	// This check also restores the session if an active session is found
+			}
 			if (bAuthErr)
 			{
 				rep = reply::stock_reply(reply::internal_server_error);
@@ -2224,6 +2275,10 @@ namespace http {
 					if (rep.status == reply::status_type::download_file)
 						return;
 
+					// chunked transfer encoding needs HTTP/1.1, and a HEAD reply needs the length of the body
+					if (rep.content_producer && ((req.method == "HEAD") || (req.http_version_major < 1) || ((req.http_version_major == 1) && (req.http_version_minor == 0))))
+						reply::finish_content_producer(&rep);
+
 					if (!rep.bIsGZIP)
 					{
 						CompressWebOutput(req, rep);
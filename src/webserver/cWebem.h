@@ -1,9 +1,11 @@
 #pragma once
 
+#include <set>
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include "server.hpp"
 #include "session_store.hpp"
+#include "WebsocketFanout.h"
 
 namespace http
 {
@@ -167,12 +169,15 @@ namespace http
 			void Run();
 			void Stop();
 
-			void RegisterPageCode(const char *pageurl, const webem_page_function &fun, bool bypassAuthentication = false);
+			// bReadOnly pages only read state and may run at the same time as other read-only handlers
+			void RegisterPageCode(const char *pageurl, const webem_page_function &fun, bool bypassAuthentication = false, bool bReadOnly = false);
 
 			void RegisterActionCode(const char *idname, const webem_action_function &fun);
 
 			void RegisterWhitelistURLString(const char *idname);
 			void RegisterWhitelistCommandsString(const char *idname);
+			// JSON commands (json.htm?type=command&param=idname) that only read state
+			void RegisterReadOnlyCommandString(const char *idname);
 
 			void DebugRegistrations();
 
@@ -183,6 +188,7 @@ namespace http
 
 			bool IsPageOverride(const request &req, reply &rep);
 			bool CheckForPageOverride(WebEmSession &session, request &req, reply &rep);
+			bool IsReadOnlyRequest(const std::string &request_path, const request &req);
 
 			void SetAuthenticationMethod(_eAuthenticationMethod amethod);
 			void SetWebTheme(const std::string &themename);
@@ -226,9 +232,15 @@ namespace http
 			std::vector<std::string> myWhitelistURLs;
 			std::vector<std::string> myWhitelistCommands;
 			std::map<std::string, WebEmSession> m_sessions;
+			/// sessions management
+			std::mutex m_sessionsMutex;
 			server_settings m_settings;
 			// actual theme selected
 			std::string m_actTheme;
+			// shared for read-only JSON commands, exclusive for every other page/action handler
+			boost::shared_mutex m_handlerMutex;
+			// renders device updates once for all websocket clients
+			CWebsocketFanout m_websocketFanout;
 
 			void SetWebCompressionMode(_eWebCompressionMode gzmode);
 			_eWebCompressionMode m_gzipmode;
@@ -240,6 +252,8 @@ namespace http
 			std::map<std::string, webem_action_function> myActions;
 			/// store name walue pairs for form submit action
 			std::map<std::string, webem_page_function> myPages;
+			std::set<std::string> myReadOnlyPages;
+			std::set<std::string> myReadOnlyCommands;
 
 			void CleanSessions();
 			bool sumProxyHeader(const std::string &sHeader, const request &req, std::vector<std::string> &vHeaderLines);
@@ -253,8 +267,6 @@ namespace http
 			std::shared_ptr<server_base> myServer;
 			// root of url
 			std::string m_webRoot;
-			/// sessions management
-			std::mutex m_sessionsMutex;
 			boost::asio::io_context m_io_context;
 			boost::asio::deadline_timer m_session_clean_timer;
 			std::shared_ptr<std::thread> m_io_context_thread;
@@ -10,25 +10,39 @@
 #include "stdafx.h"
 #include "connection.hpp"
 #include <boost/algorithm/string.hpp>
+#include <sys/stat.h>
 #include "connection_manager.hpp"
 #include "request_handler.hpp"
 #include "mime_types.hpp"
 #include "main/Helper.h"
 #include "main/Logger.h"
+#include "zlib.h"
+
+// frames waiting for a slow websocket client, the oldest update is dropped beyond this
+#define MAX_WEBSOCKET_QUEUED_FRAMES 256
 
 namespace http {
 	namespace server {
 		extern std::string convert_to_http_date(time_t time);
-		extern time_t last_write_time(const std::string& path);
+
+		static time_t last_write_time(const std::string &path)
+		{
+			struct stat st;
+			if (stat(path.c_str(), &st) == 0)
+				return st.st_mtime;
+			_log.Log(LOG_ERROR, "stat returned errno = %d", errno);
+			return 0;
+		}
 
 		// this is the constructor for plain connections
 		connection::connection(boost::asio::io_context &io_context, connection_manager &manager, request_handler &handler, int read_timeout)
 			: send_buffer_(nullptr)
+			, strand_(boost::asio::make_strand(io_context))
 			, read_timeout_(read_timeout)
-			, read_timer_(io_context, boost::posix_time::seconds(read_timeout))
+			, read_timer_(strand_, boost::posix_time::seconds(read_timeout))
 			, default_abandoned_timeout_(20 * 60)
 			// 20mn before stopping abandoned connection
-			, abandoned_timer_(io_context, boost::posix_time::seconds(default_abandoned_timeout_))
+			, abandoned_timer_(strand_, boost::posix_time::seconds(default_abandoned_timeout_))
 			, connection_manager_(manager)
 			, request_handler_(handler)
 			, status_(INITIALIZING)
@@ -39,18 +53,19 @@ namespace http {
 			keepalive_ = false;
 			write_in_progress = false;
 			connection_type = ConnectionType::connection_http;
-			socket_ = std::make_unique<boost::asio::ip::tcp::socket>(io_context);
+			socket_ = std::make_unique<boost::asio::ip::tcp::socket>(strand_);
 		}
 
 #ifdef WWW_ENABLE_SSL
 		// this is the constructor for secure connections
 		connection::connection(boost::asio::io_context &io_context, connection_manager &manager, request_handler &handler, int read_timeout, boost::asio::ssl::context &context)
 			: send_buffer_(nullptr)
+			, strand_(boost::asio::make_strand(io_context))
 			, read_timeout_(read_timeout)
-			, read_timer_(io_context, boost::posix_time::seconds(read_timeout))
+			, read_timer_(strand_, boost::posix_time::seconds(read_timeout))
 			, default_abandoned_timeout_(20 * 60)
 			// 20mn before stopping abandoned connection
-			, abandoned_timer_(io_context, boost::posix_time::seconds(default_abandoned_timeout_))
+			, abandoned_timer_(strand_, boost::posix_time::seconds(default_abandoned_timeout_))
 			, connection_manager_(manager)
 			, request_handler_(handler)
 			, status_(INITIALIZING)
@@ -62,7 +77,7 @@ namespace http {
 			write_in_progress = false;
 			connection_type = ConnectionType::connection_http;
 			socket_ = nullptr;
-			sslsocket_ = std::make_unique<ssl_socket>(io_context, context);
+			sslsocket_ = std::make_unique<ssl_socket>(strand_, context);
 		}
 #endif
 
@@ -238,8 +253,28 @@ namespace http {
 
 		void connection::WS_Write(const std::string& resp)
 		{
+			if (!strand_.running_in_this_thread())
+			{
+				// pushed from a notification thread, the socket may only be used from the connection strand
+				boost::asio::post(strand_, [self = shared_from_this(), resp] { self->WS_Write(resp); });
+				return;
+			}
 			if (connection_type == ConnectionType::connection_websocket) {
-				MyWrite(CWebsocketFrame::Create(opcode_text, resp, false));
+				std::string frame = CWebsocketFrame::Create(opcode_text, resp, false);
+				{
+					std::unique_lock<std::mutex> lock(writeMutex);
+					if (write_in_progress) {
+						// slow client: drop its oldest pending text frame instead of queueing without limit
+						if (writeQ.size() >= MAX_WEBSOCKET_QUEUED_FRAMES) {
+							auto itt = std::find_if(writeQ.begin(), writeQ.end(), [](const std::string &f) { return (!f.empty()) && (((uint8_t)f[0] & 0x0F) == opcode_text); });
+							if (itt != writeQ.end())
+								writeQ.erase(itt);
+						}
+						writeQ.push_back(std::move(frame));
+						return;
+					}
+				}
+				MyWrite(frame);
 			}
 			else {
 				// socket connection not set up yet, add to queue
@@ -298,6 +333,118 @@ namespace http {
 			connection_manager_.stop(shared_from_this());
 		}
 
+		static void DeflateAppend(z_stream *zs, const std::string &in, const bool bFinish, std::string &out)
+		{
+			unsigned char buf[FILE_SEND_BUFFER_SIZE];
+			zs->next_in = (Bytef *)in.data();
+			zs->avail_in = static_cast<uInt>(in.size());
+			do
+			{
+				zs->next_out = buf;
+				zs->avail_out = sizeof(buf);
+				deflate(zs, bFinish ? Z_FINISH : Z_NO_FLUSH);
+				out.append((const char *)buf, sizeof(buf) - zs->avail_out);
+			} while (zs->avail_out == 0);
+		}
+
+		bool connection::send_stream(reply& rep)
+		{
+			std::unique_lock<std::mutex> lock(writeMutex);
+			if (write_in_progress)
+				return false;
+
+			if (rep.bIsGZIP)
+			{
+				std::shared_ptr<z_stream> zs(new z_stream(), [](z_stream *p) {
+					deflateEnd(p);
+					delete p;
+				});
+				// window bits 15 + 16 writes a gzip header and trailer around the deflate data
+				if (deflateInit2(zs.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+					return false;
+				stream_deflate_ = zs;
+			}
+			stream_producer_ = std::move(rep.content_producer);
+			rep.content_producer = nullptr;
+
+			reply::add_header(&rep, "Transfer-Encoding", "chunked");
+			write_in_progress = true;
+			write_buffer = rep.header_to_string();
+			if (secure_) {
+#ifdef WWW_ENABLE_SSL
+				boost::asio::async_write(*sslsocket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write_stream(err, bytes); });
+#endif
+			}
+			else {
+				boost::asio::async_write(*socket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write_stream(err, bytes); });
+			}
+			return true;
+		}
+
+		void connection::handle_write_stream(const boost::system::error_code& error, size_t bytes_transferred)
+		{
+			// produce until there is something to send, the compressor may hold back small parts
+			std::string chunk;
+			bool bMore = !error;
+			try
+			{
+				while (bMore && chunk.empty())
+				{
+					std::string body;
+					while (bMore && (body.size() < FILE_SEND_BUFFER_SIZE))
+						bMore = stream_producer_(body);
+					std::string data;
+					if (stream_deflate_)
+						DeflateAppend(stream_deflate_.get(), body, !bMore, data);
+					else
+						data = std::move(body);
+					if (!data.empty())
+					{
+						char szSize[20];
+						snprintf(szSize, sizeof(szSize), "%zx\r\n", data.size());
+						chunk = szSize + data + "\r\n";
+					}
+				}
+			}
+			catch (std::exception& e)
+			{
+				// the reply can not be completed anymore, the client sees a truncated body
+				_log.Log(LOG_ERROR, "connection::handle_write_stream Exception: %s", e.what());
+				stream_producer_ = nullptr;
+				stream_deflate_.reset();
+				connection_manager_.stop(shared_from_this());
+				return;
+			}
+
+			if (!bMore)
+			{
+				stream_producer_ = nullptr;
+				stream_deflate_.reset();
+				if (error)
+				{
+					handle_write(error, bytes_transferred);
+					return;
+				}
+				chunk += "0\r\n\r\n";
+			}
+
+			write_buffer = std::move(chunk);
+			if (secure_) {
+#ifdef WWW_ENABLE_SSL
+				if (bMore)
+					boost::asio::async_write(*sslsocket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write_stream(err, bytes); });
+				else
+					boost::asio::async_write(*sslsocket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write(err, bytes); });
+#endif
+			}
+			else {
+				if (bMore)
+					boost::asio::async_write(*socket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write_stream(err, bytes); });
+				else
+					boost::asio::async_write(*socket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write(err, bytes); });
+			}
+		}
+
 		bool connection::send_file(const std::string& filename, std::string& attachment_name, reply& rep)
 		{
 			boost::system::error_code write_error;
@@ -492,7 +639,15 @@ namespace http {
 							reply::add_header_if_absent(&reply_, "Keep-Alive", ss.str());
 						}
 
-						MyWrite(reply_.to_string(request_.method));
+						bool bStreamed = false;
+						if (reply_.content_producer)
+						{
+							bStreamed = send_stream(reply_);
+							if (!bStreamed)
+								reply::finish_content_producer(&reply_); // an earlier reply is still being written, send this one in one piece
+						}
+						if (!bStreamed)
+							MyWrite(reply_.to_string(request_.method));
 						if (reply_.status == reply::switching_protocols) {
 							// this was an upgrade request, set this value after MyWrite to allow the 101 response to go out
 							connection_type = ConnectionType::connection_websocket;
@@ -560,7 +715,7 @@ namespace http {
 			bool stopConnection = false;
 			if (!error && !writeQ.empty())
 			{
-				std::string buf = writeQ.front();
+				std::string buf = std::move(writeQ.front());
 				writeQ.pop_front();
 				SocketWrite(buf);
 				if (keepalive_)
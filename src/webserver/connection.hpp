@@ -19,6 +19,8 @@
 #include "request_handler.hpp"
 #include "request_parser.hpp"
 #include "Websockets.hpp"
+
+struct z_stream_s;
 #ifdef WWW_ENABLE_SSL
 #include <boost/asio/ssl.hpp>
 typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> ssl_socket;
@@ -65,6 +67,12 @@ namespace http {
 			/// Stop all asynchronous operations associated with the connection.
 			void stop();
 
+			/// Strand that serializes the handlers of this connection
+			boost::asio::strand<boost::asio::io_context::executor_type>& strand()
+			{
+				return strand_;
+			}
+
 			// send packet over websocket
 			void WS_Write(const std::string& packet_data);
 			/// Add content to write buffer
@@ -97,6 +105,13 @@ namespace http {
 #define FILE_SEND_BUFFER_SIZE 16 * 1024
 			std::unique_ptr<std::array<uint8_t, FILE_SEND_BUFFER_SIZE>> send_buffer_;
 
+			/// Send rep while its body is produced, false if an earlier reply is still being written
+			bool send_stream(reply& rep);
+			void handle_write_stream(const boost::system::error_code& e, size_t bytes_transferred);
+			std::function<bool(std::string &)> stream_producer_;
+			/// gzip compressor of the streamed body, if the client accepts it
+			std::shared_ptr<z_stream_s> stream_deflate_;
+
 			/// Initialize read timeout timer
 			void set_read_timeout();
 			/// Stop read timeout timer
@@ -111,6 +126,9 @@ namespace http {
 			/// Reschedule abandoned timeout timer
 			void reset_abandoned_timeout();
 
+			/// Every handler of the connection (socket, timers) runs on this strand, the io_context may be run by several threads
+			boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+
 			/// Socket for the (PLAIN) connection.
 			std::unique_ptr<boost::asio::ip::tcp::socket> socket_;
 			//Host EndPoints
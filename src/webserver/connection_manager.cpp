@@ -18,23 +18,34 @@ namespace server {
 
 	void connection_manager::start(const connection_ptr &c)
 	{
-		connections_.insert(c);
-		c->start();
+		{
+			std::lock_guard<std::mutex> l(mutex_);
+			connections_.insert(c);
+		}
+		boost::asio::dispatch(c->strand(), [c] { c->start(); });
 	}
 
 	void connection_manager::stop(const connection_ptr &c)
 	{
-		connections_.erase(c);
-		c->stop();
+		{
+			std::lock_guard<std::mutex> l(mutex_);
+			connections_.erase(c);
+		}
+		// the socket and timers of c may only be used from its strand, and the calling handler finishes first
+		boost::asio::post(c->strand(), [c] { c->stop(); });
 	}
 
 void connection_manager::stop_all()
 {
-	for (const auto &con : connections_)
+	std::set<connection_ptr> connections;
 	{
-		con->stop();
+		std::lock_guard<std::mutex> l(mutex_);
+		connections.swap(connections_);
+	}
+	for (const auto &con : connections)
+	{
+		boost::asio::dispatch(con->strand(), [con] { con->stop(); });
 	}
-	connections_.clear();
 }
 
 
@@ -11,6 +11,7 @@
 #ifndef HTTP_CONNECTION_MANAGER_HPP
 #define HTTP_CONNECTION_MANAGER_HPP
 
+#include <mutex>
 #include <set>
 #include "main/Noncopyable.h"
 #include "connection.hpp"
@@ -33,7 +34,8 @@ class connection_manager
   /// Stop all connections.
   void stop_all();
 private:
-  /// The managed connections.
+  /// The managed connections, shared by the webserver threads.
+  std::mutex mutex_;
   std::set<connection_ptr> connections_;
 };
 
@@ -11,6 +11,7 @@
 #include "reply.hpp"
 #include "mime_types.hpp"
 #include "utf.hpp"
+#include "GZipHelper.h"
 #include <string>
 #include <fstream>
 #include <boost/algorithm/string.hpp>
@@ -117,6 +118,7 @@ void reply::reset()
 	headers.clear();
 	content = "";
 	bIsGZIP = false;
+	content_producer = nullptr;
 }
 
 namespace stock_replies {
@@ -293,6 +295,30 @@ void reply::set_content(reply *rep, const std::string &content)
 	rep->content = content;
 }
 
+void reply::set_content_producer(reply *rep, const std::function<bool(std::string &)> &producer)
+{
+	rep->content.clear();
+	rep->content_producer = producer;
+}
+
+void reply::finish_content_producer(reply *rep)
+{
+	if (!rep->content_producer)
+		return;
+	std::string body;
+	while (rep->content_producer(body))
+		;
+	rep->content_producer = nullptr;
+	if (rep->bIsGZIP)
+	{
+		CA2GZIP gzip((char *)body.c_str(), (int)body.size());
+		rep->content.assign((char *)gzip.pgzip, gzip.Length);
+	}
+	else
+		rep->content = std::move(body);
+	add_header(rep, "Content-Length", std::to_string(rep->content.size()));
+}
+
 void reply::set_content(reply *rep, const std::wstring &content_w)
 {
 	cUTF utf( content_w.c_str() );
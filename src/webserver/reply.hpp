@@ -13,6 +13,7 @@
 
 #include <string>
 #include <iterator>
+#include <functional>
 #include <boost/asio.hpp>
 #include "header.hpp"
 
@@ -51,7 +52,12 @@ struct reply
 
   /// The content to be sent in the reply.
   std::string content;
-  bool bIsGZIP;
+  bool bIsGZIP = false;
+
+  /// Produces the body while it is sent (Transfer-Encoding: chunked), content is not used then.
+  /// Each call appends the next part to the string and returns false after the last part.
+  /// When bIsGZIP is set the connection compresses the parts on the fly.
+  std::function<bool(std::string &)> content_producer;
 
   /// The origin of the web request when behind proxies, etc.
   std::string originHost;
@@ -65,6 +71,10 @@ struct reply
   static void add_header_if_absent(reply *rep, const std::string &name, const std::string &value);
   static void set_content(reply *rep, const std::string & content);
   static void set_content(reply *rep, const std::wstring & content_w);
+  static void set_content_producer(reply *rep, const std::function<bool(std::string &)> &producer);
+  /// Produce the complete streamed body into content (gzipped when bIsGZIP is set) and set Content-Length,
+  /// for callers that cannot send it in chunks
+  static void finish_content_producer(reply *rep);
   static bool set_content_from_file(reply *rep, const std::string & file_path);
   static bool set_content_from_file(reply *rep, const std::string & file_path, const std::string & attachment, bool set_content_type = false);
   static bool set_download_file(reply* rep, const std::string& file_path, const std::string& attachment);
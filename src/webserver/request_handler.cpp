@@ -20,7 +20,6 @@
 #include "reply.hpp"
 #include "request.hpp"
 #include "cWebem.h"
-#include "GZipHelper.h"
 #ifndef WEBSERVER_DONT_USE_ZIP
 	#include <iowin32.h>
 #endif
@@ -33,6 +32,7 @@ extern std::string szAppVersion;
 extern bool bDoCachePages;
 
 #define ZIPREADBUFFERSIZE (8192)
+#define STREAMREADBUFFERSIZE (65536)
 
 #define HTTP_DATE_RFC_1123 "%a, %d %b %Y %H:%M:%S %Z" // Sun, 06 Nov 1994 08:49:37 GMT
 #define HTTP_DATE_RFC_850  "%A, %d-%b-%y %H:%M:%S %Z" // Sunday, 06-Nov-94 08:49:37 GMT
@@ -152,19 +152,9 @@ std::string convert_to_http_date(time_t time)
 	return buffer;
 }
 
-time_t last_write_time(const std::string &path)
+bool request_handler::not_modified(const time_t last_written, const std::string &etag, const request &req, reply &rep, modify_info &mInfo)
 {
-	struct stat st;
-	if (stat(path.c_str(), &st) == 0) {
-		return st.st_mtime;
-	}
-	_log.Log(LOG_ERROR, "stat returned errno = %d", errno);
-	return 0;
-}
-
-bool request_handler::not_modified(const std::string &full_path, const request &req, reply &rep, modify_info &mInfo)
-{
-	mInfo.last_written = last_write_time(full_path);
+	mInfo.last_written = last_written;
 	if (mInfo.last_written == 0) {
 		// file system doesn't support this, don't enable header
 		mInfo.mtime_support = false;
@@ -191,10 +181,18 @@ bool request_handler::not_modified(const std::string &full_path, const request &
 	reply::add_header(&rep, "Date", make_web_time(mytime(nullptr)), true);
 	if (bDoCachePages)
 	{
-		reply::add_header(&rep, "ETag", szAppVersion, true);
+		reply::add_header(&rep, "ETag", etag, true);
 		reply::add_header(&rep, "Last-Modified", make_web_time(mInfo.last_written));
 	}
 
+	const char *if_none_match = request::get_req_header(&req, "If-None-Match");
+	if ((if_none_match != nullptr) && (strstr(if_none_match, etag.c_str()) != nullptr))
+	{
+		// the client has this exact representation
+		mInfo.is_modified = false;
+		return true;
+	}
+
 	const char *if_modified = request::get_req_header(&req, "If-Modified-Since");
 	if (nullptr == if_modified)
 	{
@@ -306,19 +304,6 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 	// So we have what seems a valid request and established the extension
 	// Let's try to process it
 
-	const char* if_none_match = request::get_req_header(&req, "If-None-Match");
-	if (if_none_match != nullptr)
-	{
-		//check if etag matches current tag
-		if (strcmp(if_none_match, szAppVersion.c_str()) == 0)
-		{
-			//nothing changed
-			rep = reply::stock_reply(reply::not_modified);
-			return;
-		}
-	}
-
-
 	// Determine if the Client (Browser) supports a gzip'ped response body
 	bool bClientHasGZipSupport = false;
 	if (myWebem->m_gzipmode != WWW_FORCE_NO_GZIP_SUPPORT)
@@ -343,35 +328,19 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 	if (!m_bIsZIP)
 #endif
 	{
-		std::ifstream is;
-
 		// Check gzip source file support. Only for js/htm(l) and css files.
-		if ((extension.find("js")!=std::string::npos) || (extension.find("htm") != std::string::npos) || (extension.find("css") != std::string::npos))
-		{
-			bIsCompressibleType = true;
-			// Let's see if there is an gzipped version of the source file
-			std::string full_path_withgz = full_path + ".gz";
-			is.open(full_path_withgz.c_str(), std::ios::in | std::ios::binary);
-			if (is.is_open())
-			{
-				bHaveLoadedgzip = true;
-				mInfo.delay_status = false;
-				full_path = full_path_withgz;
-			}
-		}
+		bIsCompressibleType = (extension.find("js") != std::string::npos) || (extension.find("htm") != std::string::npos) || (extension.find("css") != std::string::npos);
 
-		if (!is.is_open())
-		{
-			// Try opening the normal (non gzip'ped) source file
-			is.open(full_path.c_str(), std::ios::in | std::ios::binary);
-		}
-
-		// Did we find/open a zipped or non-zipped source file?
-		if (!is.is_open())
+		std::shared_ptr<const asset_cache::asset> pAsset = m_asset_cache.get(full_path, bIsCompressibleType, bClientHasGZipSupport);
+		if (!pAsset)
 		{
 			rep = reply::stock_reply(reply::not_found);
 			return;
 		}
+		const bool bStream = !pAsset->stream_path.empty();
+		const bool bSendGZip = (bStream) ? (pAsset->stream_is_gzip || (bClientHasGZipSupport && bIsCompressibleType)) : (bClientHasGZipSupport && (!pAsset->gzip.empty()));
+		if (bSendGZip)
+			mInfo.delay_status = false;
 
 		if (request_path.find("styles/") != std::string::npos)
 		{
@@ -379,50 +348,43 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 		}
 		else
 		{
-			if (not_modified(full_path, req, rep, mInfo))
+			if (not_modified(pAsset->last_written, (bSendGZip) ? pAsset->gzip_etag : pAsset->etag, req, rep, mInfo))
 			{
 				rep = reply::stock_reply(reply::not_modified);
 				return;
 			}
 		}
 
-		// fill out the reply to be sent to the client.
-		try
+		if (bStream)
 		{
-			if (bHaveLoadedgzip && (!bClientHasGZipSupport))
-			{
-				// We found an already compressed source file, but the client does not seem to support to received it compressed. So we decompress it first.
-				std::string gzcontent((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
-
-				CGZIP2AT<> decompress((LPGZIP)gzcontent.c_str(), static_cast<int>(gzcontent.size()));
-				rep.content.append(decompress.psz, decompress.Length);
-				_log.Debug(DEBUG_WEBSERVER, "[web:%s] decompressed content from %s before sending.", request_path.c_str(), full_path.c_str());
-			}
-			else
-			{
-				// Load the sourcefile (compressed or not)
-				rep.content.append((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
-				rep.bIsGZIP = (bClientHasGZipSupport && bHaveLoadedgzip);
-			}
-			if (bClientHasGZipSupport && bIsCompressibleType && (!bHaveLoadedgzip))
+			// large file, read it in parts while it is sent
+			auto file = std::make_shared<std::ifstream>(pAsset->stream_path.c_str(), std::ios::in | std::ios::binary);
+			if (!file->is_open())
 			{
-				// The sourcefile is not compressed, but the client supports receiving compressed content
-				// and the content is a compressible type so let's compress the content
-				CA2GZIP gzip((char*)rep.content.c_str(), (int)rep.content.size());
-				if ((gzip.Length > 0) && (gzip.Length < (int)rep.content.size()))
-				{
-					bHaveCompressed = true;
-					rep.bIsGZIP = true; // flag for later
-					rep.content.clear();
-					rep.content.append((char*)gzip.pgzip, gzip.Length);
-				}
+				rep = reply::stock_reply(reply::not_found);
+				return;
 			}
+			reply::set_content_producer(&rep, [file](std::string &out) {
+				size_t nOffset = out.size();
+				out.resize(nOffset + STREAMREADBUFFERSIZE);
+				file->read(&out[nOffset], STREAMREADBUFFERSIZE);
+				out.resize(nOffset + static_cast<size_t>(file->gcount()));
+				return file->good();
+			});
+			// a precompressed file is sent as is, a plain one is compressed by the connection
+			rep.bIsGZIP = bSendGZip && (!pAsset->stream_is_gzip);
+			bHaveLoadedgzip = pAsset->stream_is_gzip;
+			bHaveCompressed = rep.bIsGZIP;
+			// chunked transfer encoding needs HTTP/1.1, and a HEAD reply needs the length of the body
+			if ((req.method == "HEAD") || (req.http_version_major < 1) || ((req.http_version_major == 1) && (req.http_version_minor == 0)))
+				reply::finish_content_producer(&rep);
 		}
-		catch(const std::exception& e)
+		else
 		{
-			_log.Debug(DEBUG_WEBSERVER, "[web:%s] unable to server content from %s (%s).", request_path.c_str(), full_path.c_str(), e.what());
-			rep = reply::stock_reply(reply::not_found);
-			return;
+			// fill out the reply to be sent to the client, both variants were prepared when the file was loaded
+			rep.content = (bSendGZip) ? pAsset->gzip : pAsset->content;
+			rep.bIsGZIP = bSendGZip;
+			bHaveCompressed = bSendGZip;
 		}
 		rep.status = reply::ok;
 
@@ -439,6 +401,8 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 
 	  //remove first /
 	  request_path=request_path.substr(1);
+	  // the zip handle and extract buffer are shared by the webserver threads
+	  std::lock_guard<std::mutex> lZip(m_zipMutex);
 	  if (bClientHasGZipSupport)
 	  {
 		  std::string gzpath = request_path + ".gz";
@@ -493,7 +457,8 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 	}
 
 	reply::add_header_content_type(&rep, mime_types::extension_to_type(extension));
-	reply::add_header(&rep, "Content-Length", std::to_string(rep.content.size()));
+	if (!rep.content_producer)
+		reply::add_header(&rep, "Content-Length", std::to_string(rep.content.size()));
 	reply::add_header(&rep, "Access-Control-Allow-Origin", "*");
 	if (myWebem->m_settings.is_secure())
 		reply::add_security_headers(&rep);
@@ -11,8 +11,10 @@
 #ifndef HTTP_REQUEST_HANDLER_HPP
 #define HTTP_REQUEST_HANDLER_HPP
 
+#include <mutex>
 #include <string>
 #include "main/Noncopyable.h"
+#include "asset_cache.hpp"
 #ifndef WEBSERVER_DONT_USE_ZIP
 	#include <minizip/unzip.h>
 #endif
@@ -63,13 +65,16 @@ class request_handler
   cWebem* myWebem;
 
 private:
-	bool not_modified(const std::string &full_path, const request &req, reply &rep, modify_info &mInfo);
+	bool not_modified(time_t last_written, const std::string &etag, const request &req, reply &rep, modify_info &mInfo);
+	/// static files with their gzip variants
+	asset_cache m_asset_cache;
 	//zip support
 #ifndef WEBSERVER_DONT_USE_ZIP
 	  zlib_filefunc_def m_ffunc;
 	  unzFile m_uf;
 	  bool m_bIsZIP;
 	  void *m_pUnzipBuffer;
+	  std::mutex m_zipMutex;
 	  int do_extract_currentfile(unzFile uf, const char* password, std::string &outputstr);
 #endif
 };
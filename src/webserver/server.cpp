@@ -14,7 +14,7 @@ namespace server {
 
 	server_base::server_base(const server_settings &settings, request_handler &user_request_handler)
 		: io_context_()
-		, acceptor_(io_context_)
+		, acceptor_(boost::asio::make_strand(io_context_))
 		, request_handler_(user_request_handler)
 		, settings_(settings)
 		, timeout_(20)
@@ -66,6 +66,7 @@ void server_base::run() {
 	try {
 		is_running = true;
 		heart_beat(boost::system::error_code());
+		start_worker_threads();
 		io_context_.run();
 		is_running = false;
 	} catch (std::exception& e) {
@@ -73,18 +74,55 @@ void server_base::run() {
 		is_running = false;
 		// Note: if acceptor is up everything is OK, we can call run() again
 		//       but if the exception has broken the acceptor we cannot stop/start it and the next run() will exit immediatly.
-		io_context_.restart(); // this call is needed before calling run() again
+		if (io_context_.stopped())
+			io_context_.restart(); // this call is needed before calling run() again
 		throw;
 	} catch (...) {
 		_log.Log(LOG_ERROR, "[web:%s] unknown exception occurred (need to run again)", settings_.listening_port.c_str());
 		is_running = false;
 		// Note: if acceptor is up everything is OK, we can call run() again
 		//       but if the exception has broken the acceptor we cannot stop/start it and the next run() will exit immediatly.
-		io_context_.restart(); // this call is needed before calling run() again
+		if (io_context_.stopped())
+			io_context_.restart(); // this call is needed before calling run() again
 		throw;
 	}
 }
 
+void server_base::start_worker_threads()
+{
+	if (!worker_threads_.empty())
+		return; // already running (run() was called again after an exception)
+	int threads = settings_.number_of_threads;
+	if (threads <= 0)
+		threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+	for (int ii = 1; ii < threads; ii++)
+	{
+		worker_threads_.emplace_back([this] { run_worker(); });
+		SetThreadName(worker_threads_.back().native_handle(), "Webem_worker");
+	}
+	_log.Debug(DEBUG_WEBSERVER, "[web:%s] io_context running on %d thread(s)", settings_.listening_port.c_str(), threads);
+}
+
+void server_base::run_worker()
+{
+	while (true)
+	{
+		try
+		{
+			io_context_.run();
+			return;
+		}
+		catch (std::exception &e)
+		{
+			_log.Log(LOG_ERROR, "[web:%s] exception occurred in worker : '%s'", settings_.listening_port.c_str(), e.what());
+		}
+		catch (...)
+		{
+			_log.Log(LOG_ERROR, "[web:%s] unknown exception occurred in worker", settings_.listening_port.c_str());
+		}
+	}
+}
+
 /// Ask the server to stop using asynchronous command
 void server_base::stop() {
 	if (is_running) {
@@ -92,7 +130,7 @@ void server_base::stop() {
 		// Rene, set is_running to false, because the following is an io_context call, which makes is_running
 		// never set to false whilst in the call itself
 		is_running = false;
-		boost::asio::post(io_context_, [this] { handle_stop(); });
+		boost::asio::post(acceptor_.get_executor(), [this] { handle_stop(); });
 	} else {
 		// if io_context is not running then the post call will not be performed
 		handle_stop();
@@ -113,6 +151,12 @@ void server_base::stop() {
 		sleep_milliseconds(500);
 	}
 	io_context_.stop();
+	for (auto &worker : worker_threads_)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+	worker_threads_.clear();
 
 	// Deregister heartbeat
 	m_mainworker.HeartbeatRemove(std::string("WebServer:") + settings_.listening_port);
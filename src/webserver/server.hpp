@@ -9,6 +9,8 @@
 #include <boost/asio.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <string>
+#include <thread>
+#include <vector>
 #include "main/Noncopyable.h"
 #include "connection_manager.hpp"
 #include "request_handler.hpp"
@@ -77,6 +79,11 @@ namespace http
 
 			boost::asio::steady_timer m_heartbeat_timer;
 			void heart_beat(const boost::system::error_code &error);
+
+			/// Additional threads running the io_context next to the one calling run()
+			std::vector<std::thread> worker_threads_;
+			void start_worker_threads();
+			void run_worker();
 		};
 
 		class server : public server_base
@@ -41,6 +41,9 @@ struct server_settings {
 		listening_port = get_valid_value(listening_port, settings.listening_port);
 		vhostname = get_valid_value(vhostname, settings.vhostname);
 		php_cgi_path = get_valid_value(php_cgi_path, settings.php_cgi_path);
+		if (settings.number_of_threads > 0) {
+			number_of_threads = settings.number_of_threads;
+		}
 		if (listening_port == "0") {
 			listening_port.clear();// server NOT enabled
 		}
@@ -53,6 +56,7 @@ struct server_settings {
 			", listening_port='" + listening_port + "'" +
 			", vhostname='" + vhostname + "'" +
 			", php_cgi_path='" + php_cgi_path + "'" +
+			", number_of_threads=" + std::to_string(number_of_threads) +
 			"]'";
 	}
 
@@ -73,6 +77,7 @@ struct server_settings {
 	std::string listening_port;
 
 	std::string php_cgi_path; //if not empty, php files are handled
+	int number_of_threads{ 0 }; // threads running the io_context (0 = one per core, max 4)
 	//feature
 	//std::string fastcgi_php_server; (like nginx)
 private: